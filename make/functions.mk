@@ -7,6 +7,24 @@ $(1): $(sort $(call objects,$(2)))
 	$$(CXX) $$(LDFLAGS) $$^ -o $$@ $$(LOADLIBES) $$(LDLIBS)
 endef
 
+define static_library =
+all: $(1)
+CLEAN_ITEMS += $(1)
+$(1): $(sort $(call pic_objects,$(2)))
+	@mkdir -p $$(@D)
+	$$(RM) $$@
+	$$(AR) rcs $$@ $$^
+endef
+
+define shared_library =
+all: $(1)
+CLEAN_ITEMS += $(1)
+$(1): LDFLAGS += $($(build_type)_LDFLAGS)
+$(1): $(sort $(call pic_objects,$(2)))
+	@mkdir -p $$(@D)
+	$$(CXX) -shared $$(LDFLAGS) $$^ -o $$@ $$(LOADLIBES) $$(LDLIBS)
+endef
+
 define test =
 _test_marker := obj/.test/tested/$(1).tested
 test: $$(_test_marker)
@@ -3,6 +3,9 @@ $(call add_flag,build_type,release)
 objects = $(patsubst src/%.cc,obj/$(build_type)/%.o,$(sort $(1)))
 release_objects = $(patsubst src/%.cc,obj/release/%.o,$(sort $(1)))
 debug_objects = $(patsubst src/%.cc,obj/debug/%.o,$(sort $(1)))
+# Position-independent objects for libraries, which keep full object code
+# alongside their LTO bytecode so that embedders do not need LTO.
+pic_objects = $(patsubst src/%.cc,obj/$(build_type)-pic/%.o,$(sort $(1)))
 
 obj/debug/%.o: CPPFLAGS += $(debug_CPPFLAGS)
 obj/debug/%.o: CXXFLAGS += $(debug_CXXFLAGS)
@@ -16,6 +19,20 @@ obj/release/%.o: src/%.cc
 	@mkdir -p $(@D)
 	$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c $< -o $@
 
+obj/debug-pic/%.o: CPPFLAGS += $(debug_CPPFLAGS)
+obj/debug-pic/%.o: CXXFLAGS += $(debug_CXXFLAGS) $(pic_CXXFLAGS)
+obj/debug-pic/%.o: src/%.cc
+	@mkdir -p $(@D)
+	$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c $< -o $@
+
+obj/release-pic/%.o: CPPFLAGS += $(release_CPPFLAGS)
+obj/release-pic/%.o: CXXFLAGS += $(release_CXXFLAGS) $(pic_CXXFLAGS)
+obj/release-pic/%.o: src/%.cc
+	@mkdir -p $(@D)
+	$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c $< -o $@
+
 obj/release/%.d: src/%.cc
 obj/debug/%.d: src/%.cc
+obj/release-pic/%.d: src/%.cc
+obj/debug-pic/%.d: src/%.cc
 -include $(shell find obj/ -type f -name "*.d" 2>/dev/null)
@@ -2,9 +2,10 @@ $(call add_flag,extra_warnings)
 
 SHELL := bash
 CXX := g++
+AR := gcc-ar
 CPPFLAGS := -D_FORTIFY_SOURCE=2
-CXXFLAGS := -std=c++17 -pedantic -Wall -Wextra -march=native -Isrc/ -pipe -MMD -MP -fdiagnostics-show-template-tree -fno-exceptions -fno-rtti -fno-canonical-system-headers -fstack-protector -fno-omit-frame-pointer
-LDFLAGS := -Wl,-z,relro,-z,now -no-canonical-prefixes
+CXXFLAGS := -std=c++17 -pthread -pedantic -Wall -Wextra -march=native -Isrc/ -pipe -MMD -MP -fdiagnostics-show-template-tree -fno-exceptions -fno-rtti -fno-canonical-system-headers -fstack-protector -fno-omit-frame-pointer
+LDFLAGS := -pthread -Wl,-z,relro,-z,now -no-canonical-prefixes
 
 release_CPPFLAGS := -DNDEBUG
 release_CXXFLAGS := -O3 -flto -fno-fat-lto-objects -ffunction-sections -fdata-sections
@@ -14,6 +15,9 @@ debug_CPPFLAGS := -DDEBUG -D_GLIBCXX_DEBUG
 debug_CXXFLAGS := -Og -ggdb3 -Werror
 debug_LDFLAGS :=
 
+# Only the C API in gamebun.h is exported from the libraries.
+pic_CXXFLAGS := -fPIC -fvisibility=hidden -ffat-lto-objects
+
 WARNINGS_CXXFLAGS := \
   -Wunused -Wunused-macros \
   -Wdouble-promotion -Wfloat-equal \
@@ -0,0 +1,293 @@
+#include "apu.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr uint16_t kFirstChannelRegister = 0xFF10;
+constexpr uint16_t kMasterVolume = 0xFF24;
+constexpr uint16_t kPanning = 0xFF25;
+constexpr uint16_t kControl = 0xFF26;
+constexpr uint16_t kWaveRam = 0xFF30;
+constexpr uint16_t kEnd = 0xFF40;
+
+constexpr uint8_t kPowerOn = 0x80;
+
+}  // namespace
+
+Apu::Apu(const AudioOptions& options, Arena* arena)
+    : mode_(AudioMode::kSynthesized),
+      mixer_(options.sample_rate, options.buffer_samples, arena),
+      output_(&mixer_),
+      pulse1_(0, true),
+      pulse2_(1, false),
+      wave_(2),
+      noise_(3),
+      time_(0),
+      next_sequencer_step_(kSequencerPeriod),
+      sequencer_step_(0),
+      powered_(true),
+      master_volume_(0),
+      panning_(0) {
+  // The values left behind by the boot ROM, which plays its chime on the
+  // first pulse channel.
+  Write(Address(0xFF10), 0x80);
+  Write(Address(0xFF11), 0xBF);
+  Write(Address(0xFF12), 0xF3);
+  Write(Address(kMasterVolume), 0x77);
+  Write(Address(kPanning), 0xF3);
+  SetMode(options.mode);
+}
+
+uint8_t Apu::Read(Address address) {
+  const uint16_t addr = address.value();
+  if (addr < kFirstChannelRegister || addr >= kEnd) {
+    FATAL("Unexpected APU read address %x", addr);
+  }
+  Synchronize();
+
+  if (addr < kMasterVolume) {
+    const size_t reg = (addr - kFirstChannelRegister) % kChannelRegisterCount;
+    switch ((addr - kFirstChannelRegister) / kChannelRegisterCount) {
+      case 0:
+        return pulse1_.Read(reg);
+      case 1:
+        return pulse2_.Read(reg);
+      case 2:
+        return wave_.Read(reg);
+      default:
+        return noise_.Read(reg);
+    }
+  } else if (addr == kMasterVolume) {
+    return master_volume_;
+  } else if (addr == kPanning) {
+    return panning_;
+  } else if (addr == kControl) {
+    return (powered_ ? kPowerOn : 0) | 0x70 | (pulse1_.enabled() ? 0x01 : 0) |
+           (pulse2_.enabled() ? 0x02 : 0) | (wave_.enabled() ? 0x04 : 0) |
+           (noise_.enabled() ? 0x08 : 0);
+  } else if (addr >= kWaveRam) {
+    return wave_.ReadRam(addr - kWaveRam);
+  }
+  return 0xFF;
+}
+
+void Apu::Write(Address address, uint8_t value) {
+  const uint16_t addr = address.value();
+  if (addr < kFirstChannelRegister || addr >= kEnd) {
+    FATAL("Unexpected APU write address %x", addr);
+  }
+  Synchronize();
+
+  if (addr == kControl) {
+    WriteControl(value);
+    return;
+  } else if (addr >= kWaveRam) {
+    wave_.WriteRam(addr - kWaveRam, value, time_, output_);
+    return;
+  }
+
+  if (addr < kMasterVolume) {
+    const size_t channel =
+        (addr - kFirstChannelRegister) / kChannelRegisterCount;
+    const size_t reg = (addr - kFirstChannelRegister) % kChannelRegisterCount;
+    if (!powered_) {
+      // The DMG still loads the length counters while powered off.
+      if (reg == 1) {
+        Channel(channel).LoadLength(value);
+      }
+      return;
+    }
+    switch (channel) {
+      case 0:
+        pulse1_.Write(reg, value, time_, output_);
+        break;
+      case 1:
+        pulse2_.Write(reg, value, time_, output_);
+        break;
+      case 2:
+        wave_.Write(reg, value, time_, output_);
+        break;
+      default:
+        noise_.Write(reg, value, time_, output_);
+        break;
+    }
+  } else if (!powered_) {
+    return;
+  } else if (addr == kMasterVolume) {
+    master_volume_ = value;
+    SetPanning();
+  } else if (addr == kPanning) {
+    panning_ = value;
+    SetPanning();
+  }
+}
+
+void Apu::WriteControl(uint8_t value) {
+  const bool powered = (value & kPowerOn) != 0;
+  if (powered == powered_) {
+    return;
+  }
+  powered_ = powered;
+  if (powered) {
+    // The frame sequencer starts over from its first step.
+    sequencer_step_ = 0;
+    next_sequencer_step_ = time_ + kSequencerPeriod;
+    return;
+  }
+
+  // Powering off clears every register but wave RAM and the length
+  // counters.
+  pulse1_.Reset(time_, output_);
+  pulse2_.Reset(time_, output_);
+  wave_.Reset(time_, output_);
+  noise_.Reset(time_, output_);
+  master_volume_ = 0;
+  panning_ = 0;
+  SetPanning();
+}
+
+SoundChannel& Apu::Channel(size_t index) {
+  switch (index) {
+    case 0:
+      return pulse1_;
+    case 1:
+      return pulse2_;
+    case 2:
+      return wave_;
+    default:
+      return noise_;
+  }
+}
+
+void Apu::SetPanning() {
+  if (output_ != nullptr) {
+    output_->SetPanning(time_, master_volume_, panning_);
+  }
+}
+
+void Apu::RefreshOutput() {
+  if (output_ != nullptr) {
+    SetPanning();
+    pulse1_.Refresh(time_, output_);
+    pulse2_.Refresh(time_, output_);
+    wave_.Refresh(time_, output_);
+    noise_.Refresh(time_, output_);
+  }
+}
+
+void Apu::FlushSamples() {
+  Synchronize();
+  if (output_ != nullptr) {
+    output_->EndBatch(time_);
+  }
+  pulse1_.Rebase(time_);
+  pulse2_.Rebase(time_);
+  wave_.Rebase(time_);
+  noise_.Rebase(time_);
+  next_sequencer_step_ -= time_;
+  time_ = 0;
+}
+
+void Apu::SetMode(AudioMode mode) {
+  if (mode == mode_) {
+    return;
+  }
+  FlushSamples();
+  mode_ = mode;
+  switch (mode) {
+    case AudioMode::kSynthesized:
+      // The mixer missed every change while it was detached, so it picks up
+      // the current levels from the start of the new batch.
+      output_ = &mixer_;
+      RefreshOutput();
+      break;
+    case AudioMode::kRegistersOnly:
+      output_ = nullptr;
+      break;
+    default:
+      FATAL("Unexpected audio mode %d", static_cast<int>(mode));
+  }
+}
+
+void Apu::SaveState(StateWriter* writer) {
+  FlushSamples();
+  mixer_.SaveState(writer);
+  pulse1_.SaveState(writer);
+  pulse2_.SaveState(writer);
+  wave_.SaveState(writer);
+  noise_.SaveState(writer);
+  writer->Write(next_sequencer_step_);
+  writer->Write(sequencer_step_);
+  writer->Write(powered_);
+  writer->Write(master_volume_);
+  writer->Write(panning_);
+}
+
+void Apu::LoadState(StateReader* reader) {
+  FlushSamples();
+  mixer_.LoadState(reader);
+  pulse1_.LoadState(reader);
+  pulse2_.LoadState(reader);
+  wave_.LoadState(reader);
+  noise_.LoadState(reader);
+  reader->Read(&next_sequencer_step_);
+  reader->Read(&sequencer_step_);
+  reader->Read(&powered_);
+  reader->Read(&master_volume_);
+  reader->Read(&panning_);
+  // The state may come from an APU that only tracked its registers, and
+  // whose mixer missed the latest levels.
+  RefreshOutput();
+}
+
+void Apu::Synchronize() {
+  while (true) {
+    RunChannels(std::min(time_, next_sequencer_step_));
+    if (next_sequencer_step_ > time_) {
+      return;
+    }
+    StepSequencer(next_sequencer_step_);
+    next_sequencer_step_ += kSequencerPeriod;
+  }
+}
+
+void Apu::RunChannels(uint32_t until) {
+  if (output_ == nullptr) {
+    return;
+  }
+  pulse1_.Run(until, output_);
+  pulse2_.Run(until, output_);
+  wave_.Run(until, output_);
+  noise_.Run(until, output_);
+}
+
+void Apu::StepSequencer(uint32_t time) {
+  if (!powered_) {
+    return;
+  }
+  if (sequencer_step_ % 2 == 0) {
+    pulse1_.ClockLength(time, output_);
+    pulse2_.ClockLength(time, output_);
+    wave_.ClockLength(time, output_);
+    noise_.ClockLength(time, output_);
+  }
+  if (sequencer_step_ == 2 || sequencer_step_ == 6) {
+    pulse1_.ClockSweep(time, output_);
+  }
+  if (sequencer_step_ == 7) {
+    pulse1_.ClockEnvelope(time, output_);
+    pulse2_.ClockEnvelope(time, output_);
+    noise_.ClockEnvelope(time, output_);
+  }
+  sequencer_step_ = (sequencer_step_ + 1) % 8;
+}
+
+}  // namespace gamebun
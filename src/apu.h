@@ -0,0 +1,124 @@
+#ifndef APU_H_
+#define APU_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "band_limited_buffer.h"
+#include "memory.h"
+#include "sound_channels.h"
+#include "sound_mixer.h"
+#include "state.h"
+
+namespace gamebun {
+
+class Arena;
+
+enum class AudioMode {
+  // Synthesizes the channels into samples.
+  kSynthesized,
+  // Only keeps up what the CPU can observe: the registers, wave RAM, and the
+  // channels' status as they are disabled by their length counters, sweep
+  // overflows and DACs. No samples are produced.
+  kRegistersOnly,
+};
+
+struct AudioOptions {
+  AudioMode mode = AudioMode::kSynthesized;
+  uint32_t sample_rate = 48000;
+  // Stereo samples held for the host. Once this many are waiting, the oldest
+  // are dropped.
+  size_t buffer_samples = 16384;
+};
+
+// The audio processing unit: two pulse channels, a wave channel and a noise
+// channel, mixed to stereo. Channels are not stepped every clock cycle.
+// Instead, Tick() only counts cycles, and the channels are synthesized in
+// batches up to the current cycle whenever the CPU accesses a sound register
+// or samples are flushed, so that a batch always runs with fixed register
+// values.
+class Apu {
+ public:
+  // The sample buffers come from `arena`.
+  Apu(const AudioOptions& options, Arena* arena);
+
+  void Tick(size_t cycles) {
+    time_ += static_cast<uint32_t>(cycles);
+    if (time_ >= kMaxBatchCycles) {
+      FlushSamples();
+    }
+  }
+
+  // Accesses the sound registers at 0xFF10-0xFF26 and wave RAM at
+  // 0xFF30-0xFF3F. The unused addresses in between read as 0xFF.
+  uint8_t Read(Address address);
+  void Write(Address address, uint8_t value);
+
+  // Synthesizes everything up to the current cycle, completing its samples.
+  void FlushSamples();
+
+  AudioMode mode() const { return mode_; }
+  // Switches modes from the current cycle. Samples already completed stay
+  // available, and synthesis resumes from the channels' current state.
+  void SetMode(AudioMode mode);
+
+  // Saving completes the samples up to the current cycle first, and leaves
+  // them out of the state. Loading drops the samples not yet read. The
+  // audio mode is a setting of the host and is kept as it is.
+  void SaveState(StateWriter* writer);
+  void LoadState(StateReader* reader);
+
+  size_t SamplesAvailable() const { return mixer_.SamplesAvailable(); }
+  // Reads up to `count` stereo samples, left channel first, and returns how
+  // many were read.
+  size_t ReadSamples(int16_t* out, size_t count) {
+    return mixer_.ReadSamples(out, count);
+  }
+
+  Apu(const Apu&) = delete;
+  Apu& operator=(const Apu&) = delete;
+
+ private:
+  static constexpr uint32_t kSequencerPeriod = kSoundClockRate / 512;
+  // Batches end after at most this many cycles even if nothing flushes them.
+  static constexpr uint32_t kMaxBatchCycles = 8 * kSequencerPeriod;
+  static_assert(kMaxBatchCycles <= BandLimitedBuffer::kMaxBatchCycles,
+                "batches must fit the resampling buffers");
+
+  // Runs the channels and the frame sequencer up to `time_`.
+  void Synchronize();
+  void RunChannels(uint32_t until);
+  // Clocks the length counters, sweep and envelopes at 512 Hz.
+  void StepSequencer(uint32_t time);
+  void WriteControl(uint8_t value);
+  // The channel whose registers come `index`th from NR10.
+  SoundChannel& Channel(size_t index);
+  // Passes NR50 and NR51 on to the mixer.
+  void SetPanning();
+  // Passes the panning and every channel's level on to the mixer, if
+  // synthesizing.
+  void RefreshOutput();
+
+  AudioMode mode_;
+  StereoMixer mixer_;
+  // The mixer while synthesizing, or null, which has the channels skip
+  // their output.
+  StereoMixer* output_;
+  PulseChannel pulse1_;
+  PulseChannel pulse2_;
+  WaveChannel wave_;
+  NoiseChannel noise_;
+
+  // Cycles since the current batch started.
+  uint32_t time_;
+  uint32_t next_sequencer_step_;
+  uint8_t sequencer_step_;
+
+  bool powered_;
+  uint8_t master_volume_;
+  uint8_t panning_;
+};
+
+}  // namespace gamebun
+
+#endif  // APU_H_
@@ -0,0 +1,243 @@
+#include "apu.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "memory.h"
+
+namespace gamebun {
+namespace {
+
+// Cycles between steps of the frame sequencer. Length counters are clocked
+// on the first of every two steps, starting 8192 cycles after power-on, and
+// the sweep on the third and seventh of every eight.
+constexpr uint32_t kStep = 8192;
+
+constexpr uint8_t kPulse1 = 0x01;
+constexpr uint8_t kPulse2 = 0x02;
+constexpr uint8_t kWave = 0x04;
+constexpr uint8_t kNoise = 0x08;
+
+AudioOptions Options(AudioMode mode) {
+  AudioOptions options;
+  options.mode = mode;
+  return options;
+}
+
+// The same writes played into a synthesizing APU, one only tracking its
+// registers, and one switching between the two every few hundred cycles,
+// which must all read back the same.
+struct TestApus {
+  TestApus()
+      : arena(1 << 20, false),
+        synthesized(Options(AudioMode::kSynthesized), &arena),
+        registers_only(Options(AudioMode::kRegistersOnly), &arena),
+        switching(Options(AudioMode::kSynthesized), &arena) {}
+
+  void Write(uint16_t address, uint8_t value) {
+    for (Apu* apu : {&synthesized, &registers_only, &switching}) {
+      apu->Write(Address(address), value);
+    }
+  }
+
+  void Tick(uint32_t cycles) {
+    for (uint32_t i = 0; i < cycles; i += 256) {
+      const size_t step = std::min<uint32_t>(256, cycles - i);
+      synthesized.Tick(step);
+      registers_only.Tick(step);
+      switching.Tick(step);
+      switching.SetMode(switching.mode() == AudioMode::kSynthesized
+                            ? AudioMode::kRegistersOnly
+                            : AudioMode::kSynthesized);
+      time += step;
+    }
+  }
+
+  // Reads every sound register and wave RAM byte, checking that all three
+  // APUs agree, and returns NR52.
+  uint8_t Status() {
+    for (uint16_t address = 0xFF10; address < 0xFF40; address++) {
+      INFO("register " << std::hex << address << std::dec << " at cycle "
+                       << time);
+      const uint8_t value = synthesized.Read(Address(address));
+      CHECK(registers_only.Read(Address(address)) == value);
+      CHECK(switching.Read(Address(address)) == value);
+    }
+    return synthesized.Read(Address(0xFF26));
+  }
+
+  // Runs until the channels in `channels` are all off, checking the
+  // registers every 512 cycles, and returns the cycle they were first seen
+  // off on, or 0 if that took more than `limit` cycles.
+  uint32_t RunUntilOff(uint8_t channels, uint32_t limit) {
+    const uint32_t start = time;
+    while (Status() & channels) {
+      if (time - start >= limit) {
+        return 0;
+      }
+      Tick(512);
+    }
+    return time - start;
+  }
+
+  Arena arena;
+  Apu synthesized;
+  Apu registers_only;
+  Apu switching;
+  uint32_t time = 0;
+};
+
+TEST_CASE("Length counters silence channels the same in every mode",
+          "[apu]") {
+  TestApus test;
+  // Lengths of 4, 3, 2 and 1 steps.
+  test.Write(0xFF11, 0x3C);
+  test.Write(0xFF12, 0xF0);
+  test.Write(0xFF16, 0x3D);
+  test.Write(0xFF17, 0xF0);
+  test.Write(0xFF1A, 0x80);
+  test.Write(0xFF1B, 0xFE);
+  test.Write(0xFF20, 0x3F);
+  test.Write(0xFF21, 0xF0);
+  // Triggered with their length counters enabled.
+  test.Write(0xFF14, 0xC0);
+  test.Write(0xFF19, 0xC0);
+  test.Write(0xFF1E, 0xC0);
+  test.Write(0xFF23, 0xC0);
+  CHECK(test.Status() == 0xFF);
+  CHECK(test.registers_only.Read(Address(0xFF14)) == 0xFF);
+
+  CHECK(test.RunUntilOff(kNoise, 10 * kStep) == kStep);
+  CHECK(test.Status() == 0xF7);
+  CHECK(test.RunUntilOff(kWave, 10 * kStep) == 2 * kStep);
+  CHECK(test.Status() == 0xF3);
+  CHECK(test.RunUntilOff(kPulse2, 10 * kStep) == 2 * kStep);
+  CHECK(test.RunUntilOff(kPulse1, 10 * kStep) == 2 * kStep);
+  CHECK(test.Status() == 0xF0);
+
+  // Without the length counter enabled, a channel plays on.
+  test.Write(0xFF11, 0x3F);
+  test.Write(0xFF14, 0x80);
+  CHECK(test.registers_only.Read(Address(0xFF14)) == 0xBF);
+  CHECK(test.RunUntilOff(kPulse1, 20 * kStep) == 0);
+}
+
+TEST_CASE("Lengths loaded while powered off count once powered on",
+          "[apu]") {
+  TestApus test;
+  test.Write(0xFF26, 0x00);
+  CHECK(test.Status() == 0x70);
+  // Everything else written while off is dropped.
+  test.Write(0xFF11, 0x3E);
+  test.Write(0xFF12, 0xF0);
+  CHECK(test.registers_only.Read(Address(0xFF12)) == 0x00);
+  test.Tick(3 * kStep + 100);
+
+  // The sequencer starts over, so the two steps left take 3 steps of time.
+  test.Write(0xFF26, 0x80);
+  test.Write(0xFF12, 0xF0);
+  test.Write(0xFF14, 0xC0);
+  CHECK(test.Status() == 0xF1);
+  CHECK(test.RunUntilOff(kPulse1, 10 * kStep) == 3 * kStep);
+}
+
+TEST_CASE("Sweeps past the highest frequency silence the first channel",
+          "[apu]") {
+  TestApus test;
+  test.Write(0xFF12, 0xF0);
+  test.Write(0xFF13, 0x00);
+
+  SECTION("on the first sweep step") {
+    // A period of 1 and a shift of 1 take 0x400 to 0x600, which is checked
+    // again at 0x900 and overflows.
+    test.Write(0xFF10, 0x11);
+    CHECK(test.Status() == 0xF0);
+    CHECK(test.registers_only.Read(Address(0xFF10)) == 0x91);
+    test.Write(0xFF14, 0x84);
+    CHECK(test.RunUntilOff(kPulse1, 10 * kStep) == 3 * kStep);
+  }
+  SECTION("on a later sweep step") {
+    // A shift of 2 takes 0x400 to 0x500, 0x640 and 0x7D0, which is checked
+    // again at 0x9C4 and overflows.
+    test.Write(0xFF10, 0x12);
+    test.Write(0xFF14, 0x84);
+    CHECK(test.RunUntilOff(kPulse1, 20 * kStep) == 11 * kStep);
+  }
+  SECTION("when triggered") {
+    test.Write(0xFF10, 0x11);
+    test.Write(0xFF13, 0xFF);
+    test.Write(0xFF14, 0x86);
+    CHECK((test.Status() & kPulse1) == 0);
+  }
+  SECTION("never, while sweeping down") {
+    test.Write(0xFF10, 0x19);
+    test.Write(0xFF14, 0x87);
+    CHECK(test.RunUntilOff(kPulse1, 40 * kStep) == 0);
+  }
+}
+
+TEST_CASE("Envelope registers switch DACs the same in every mode", "[apu]") {
+  TestApus test;
+  test.Write(0xFF17, 0xF3);
+  test.Write(0xFF19, 0x80);
+  CHECK(test.Status() & kPulse2);
+  CHECK(test.registers_only.Read(Address(0xFF17)) == 0xF3);
+
+  // A volume of 0 while increasing leaves the DAC on.
+  test.Write(0xFF17, 0x08);
+  CHECK(test.Status() & kPulse2);
+  // While decreasing, it switches the DAC and the channel off, and the
+  // channel stays off until triggered again with the DAC on.
+  test.Write(0xFF17, 0x00);
+  CHECK_FALSE(test.Status() & kPulse2);
+  test.Write(0xFF17, 0xF0);
+  CHECK_FALSE(test.Status() & kPulse2);
+  test.Write(0xFF19, 0x80);
+  CHECK(test.Status() & kPulse2);
+}
+
+// The range of the left channel's samples since the last call.
+int SampleSwing(Apu* apu) {
+  std::vector<int16_t> samples(2 * apu->SamplesAvailable());
+  apu->ReadSamples(samples.data(), samples.size() / 2);
+  if (samples.empty()) {
+    return 0;
+  }
+  int low = samples[0];
+  int high = samples[0];
+  for (size_t i = 2; i < samples.size(); i += 2) {
+    low = std::min<int>(low, samples[i]);
+    high = std::max<int>(high, samples[i]);
+  }
+  return high - low;
+}
+
+TEST_CASE("Envelopes fade synthesized channels out", "[apu]") {
+  TestApus test;
+  // Full volume, decreasing by one every envelope step of 8 sequencer steps.
+  test.Write(0xFF12, 0xF1);
+  test.Write(0xFF13, 0x00);
+  test.Write(0xFF14, 0x84);
+  test.Tick(8 * kStep);
+  test.synthesized.FlushSamples();
+  const int loud = SampleSwing(&test.synthesized);
+  CHECK(loud > 1000);
+
+  // Down to 0 after 15 envelope steps, while the channel stays on.
+  test.Tick(15 * 8 * kStep);
+  CHECK(test.Status() & kPulse1);
+  test.synthesized.FlushSamples();
+  SampleSwing(&test.synthesized);
+  test.Tick(8 * kStep);
+  test.synthesized.FlushSamples();
+  CHECK(SampleSwing(&test.synthesized) < loud / 100);
+  CHECK(test.registers_only.SamplesAvailable() == 0);
+}
+
+}  // namespace
+}  // namespace gamebun
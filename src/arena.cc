@@ -0,0 +1,120 @@
+#include "arena.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// The size of a transparent huge page on x86-64 and on ARM64 with 4 KB base
+// pages.
+constexpr size_t kHugePageSize = 2 << 20;
+
+size_t RoundUp(size_t size, size_t granularity) {
+  return (size + granularity - 1) / granularity * granularity;
+}
+
+}  // namespace
+
+Arena::Arena(size_t max_size, bool huge_pages)
+    : huge_pages_(huge_pages),
+      page_size_(huge_pages ? kHugePageSize
+                            : static_cast<size_t>(sysconf(_SC_PAGESIZE))),
+      base_(nullptr),
+      reserved_(RoundUp(max_size, page_size_)),
+      committed_(0),
+      used_(0) {
+  // Reserving without access keeps the reservation from counting against
+  // the commit limit. Huge pages need an aligned block, so the reservation
+  // starts out a page larger and the misaligned ends are cut off.
+  const size_t mapped = huge_pages_ ? reserved_ + page_size_ : reserved_;
+  void* const block = mmap(nullptr, mapped, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (block == MAP_FAILED) {
+    FATAL("Unable to reserve %zu bytes: %s", mapped, std::strerror(errno));
+  }
+  uint8_t* const start = static_cast<uint8_t*>(block);
+  base_ = start;
+  if (huge_pages_) {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(start);
+    base_ = start + (RoundUp(address, page_size_) - address);
+    const size_t tail = mapped - static_cast<size_t>(base_ - start) - reserved_;
+    if (base_ != start) {
+      munmap(start, static_cast<size_t>(base_ - start));
+    }
+    if (tail != 0) {
+      munmap(base_ + reserved_, tail);
+    }
+    // Only a hint: without transparent huge pages, the block is simply
+    // backed by normal ones.
+    madvise(base_, reserved_, MADV_HUGEPAGE);
+  }
+}
+
+Arena::~Arena() { munmap(base_, reserved_); }
+
+void Arena::Trim() {
+  const size_t end = RoundUp(used_, page_size_);
+  if (end < reserved_) {
+    munmap(base_ + end, reserved_ - end);
+    reserved_ = end;
+  }
+}
+
+void Arena::Discard(void* data, size_t size) {
+  const size_t base_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t start =
+      RoundUp(reinterpret_cast<uintptr_t>(data), base_page_size);
+  const uintptr_t end =
+      (reinterpret_cast<uintptr_t>(data) + size) / base_page_size *
+      base_page_size;
+  if (start < end) {
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+  }
+}
+
+size_t Arena::Resident() const {
+  // mincore() always reports in base pages, even for huge pages.
+  const size_t base_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  std::vector<unsigned char> pages(committed_ / base_page_size);
+  if (pages.empty()) {
+    return 0;
+  }
+  if (mincore(base_, committed_, pages.data()) != 0) {
+    FATAL("Unable to query the arena's pages: %s", std::strerror(errno));
+  }
+  size_t resident = 0;
+  for (const unsigned char page : pages) {
+    resident += page & 1;
+  }
+  return resident * base_page_size;
+}
+
+void* Arena::AllocateBytes(size_t size) {
+  const size_t start = RoundUp(used_, kAlignment);
+  if (size > reserved_ - start) {
+    FATAL("Arena of %zu bytes is out of room for %zu more", reserved_, size);
+  }
+  used_ = start + size;
+  if (used_ > committed_) {
+    const size_t end = RoundUp(used_, page_size_);
+    if (mprotect(base_ + committed_, end - committed_,
+                 PROT_READ | PROT_WRITE) != 0) {
+      FATAL("Unable to commit %zu bytes: %s", end - committed_,
+            std::strerror(errno));
+    }
+    committed_ = end;
+  }
+  return base_ + start;
+}
+
+}  // namespace gamebun
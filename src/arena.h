@@ -0,0 +1,92 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace gamebun {
+
+// Destroys an object made by Arena::New() without freeing its memory, which
+// goes back with the rest of the arena.
+struct ArenaDeleter {
+  template <typename T>
+  void operator()(T* object) const {
+    object->~T();
+  }
+};
+
+template <typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDeleter>;
+
+// A single contiguous, page-aligned block of memory that an emulator's
+// components carve their buffers and objects out of as they are constructed.
+//
+// The arena reserves `max_size` bytes of address space up front and only
+// commits pages as allocations reach them. Once everything is constructed,
+// Trim() gives back the reservation past the last allocation, so each
+// instance costs a single mapping no larger than it needs. Nothing is ever
+// freed on its own; the whole block goes when the arena does.
+class Arena {
+ public:
+  // Every allocation is aligned to a cache line, so that no two components
+  // share one.
+  static constexpr size_t kAlignment = 64;
+
+  // If `huge_pages` is set, the block is aligned to and committed in 2 MB
+  // pages, and the kernel is asked to back it with transparent huge pages.
+  Arena(size_t max_size, bool huge_pages);
+  ~Arena();
+
+  // Returns room for `count` objects of type T, filled with zeros but not
+  // constructed.
+  template <typename T>
+  T* Allocate(size_t count) {
+    static_assert(alignof(T) <= kAlignment, "overaligned arena allocation");
+    return static_cast<T*>(AllocateBytes(count * sizeof(T)));
+  }
+
+  // Constructs a T in the arena. The returned pointer only runs its
+  // destructor.
+  template <typename T, typename... Args>
+  ArenaPtr<T> New(Args&&... args) {
+    return ArenaPtr<T>(new (Allocate<T>(1)) T(std::forward<Args>(args)...));
+  }
+
+  // Gives the pages entirely within `size` bytes at `data` back to the
+  // kernel. They stay mapped, and read as zeros until written again.
+  void Discard(void* data, size_t size);
+
+  // Releases the address space past the last allocation. Nothing can be
+  // allocated past that point afterwards.
+  void Trim();
+
+  const uint8_t* data() const { return base_; }
+  // Bytes handed out so far, and bytes of memory mapped for them.
+  size_t used() const { return used_; }
+  size_t committed() const { return committed_; }
+  // Bytes of the arena the kernel has actually backed with memory, which
+  // leaves out pages that were never written.
+  size_t Resident() const;
+  bool huge_pages() const { return huge_pages_; }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+ private:
+  void* AllocateBytes(size_t size);
+
+  const bool huge_pages_;
+  // The granularity pages are committed and trimmed in.
+  const size_t page_size_;
+  uint8_t* base_;
+  size_t reserved_;
+  size_t committed_;
+  size_t used_;
+};
+
+}  // namespace gamebun
+
+#endif  // ARENA_H_
@@ -0,0 +1,191 @@
+#include "async_file_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// O_DIRECT transfers must start and end on logical block boundaries.
+constexpr size_t kBlockSize = 4096;
+
+}  // namespace
+
+AsyncFileWriter::AsyncFileWriter(const char* path, size_t chunk_count)
+    : path_(path),
+      fd_(-1),
+      direct_(true),
+      memory_(nullptr),
+      chunks_(),
+      filling_(nullptr),
+      filled_(0),
+      size_(0),
+      finished_(false),
+      queued_(),
+      free_(),
+      stopping_(false) {
+  if (chunk_count < 2) {
+    FATAL("AsyncFileWriter needs at least 2 chunks");
+  }
+
+  fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  if (fd_ < 0 && errno == EINVAL) {
+    direct_ = false;
+    fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd_ < 0) {
+    FATAL("Unable to open %s: %s", path, std::strerror(errno));
+  }
+
+  const size_t chunk_capacity = 2 * kChunkSize.value();
+  memory_ = static_cast<uint8_t*>(
+      std::aligned_alloc(kBlockSize, chunk_count * chunk_capacity));
+  if (memory_ == nullptr) {
+    FATAL("Unable to allocate write buffers for %s", path);
+  }
+  for (size_t i = 0; i < chunk_count; i++) {
+    chunks_.push_back(&memory_[i * chunk_capacity]);
+  }
+  filling_ = chunks_[0];
+  free_.assign(chunks_.begin() + 1, chunks_.end());
+
+  writer_ = std::thread(&AsyncFileWriter::RunWriter, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  Finish();
+  close(fd_);
+  std::free(memory_);
+}
+
+uint8_t* AsyncFileWriter::Reserve(size_t size) {
+  if (size > kChunkSize.value()) {
+    FATAL("Reservation of %zu bytes exceeds the chunk size", size);
+  }
+  if (filled_ >= kChunkSize.value()) {
+    SubmitChunk();
+  }
+  return &filling_[filled_];
+}
+
+void AsyncFileWriter::Commit(size_t size) {
+  filled_ += size;
+  size_ += size;
+}
+
+void AsyncFileWriter::Append(const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    const size_t piece = std::min(size, kChunkSize.value());
+    std::memcpy(Reserve(piece), bytes, piece);
+    Commit(piece);
+    bytes += piece;
+    size -= piece;
+  }
+}
+
+void AsyncFileWriter::SubmitChunk() {
+  uint8_t* next;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return !free_.empty(); });
+    next = free_.back();
+    free_.pop_back();
+    queued_.push_back({filling_, kChunkSize.value()});
+  }
+  condition_.notify_all();
+
+  filled_ -= kChunkSize.value();
+  std::memcpy(next, &filling_[kChunkSize.value()], filled_);
+  filling_ = next;
+}
+
+void AsyncFileWriter::Finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filled_ > 0) {
+      queued_.push_back({filling_, filled_});
+    }
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  writer_.join();
+
+  // The last chunk was padded out to a whole block, which is cut off again
+  // here.
+  if (direct_) {
+    if (ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+      FATAL("Unable to truncate %s: %s", path_, std::strerror(errno));
+    }
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+  }
+}
+
+void AsyncFileWriter::WriteAt(uint64_t offset, const void* data,
+                              size_t size) {
+  if (!finished_) {
+    FATAL("WriteAt() called on %s before Finish()", path_);
+  }
+  if (pwrite(fd_, data, size, static_cast<off_t>(offset)) !=
+      static_cast<ssize_t>(size)) {
+    FATAL("Unable to write to %s: %s", path_, std::strerror(errno));
+  }
+}
+
+void AsyncFileWriter::WriteChunk(const Chunk& chunk) {
+  size_t size = chunk.size;
+  if (direct_ && size % kBlockSize != 0) {
+    const size_t padded = (size + kBlockSize - 1) / kBlockSize * kBlockSize;
+    std::memset(&chunk.data[size], 0, padded - size);
+    size = padded;
+  }
+
+  for (size_t written = 0; written < size;) {
+    const ssize_t result = write(fd_, &chunk.data[written], size - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      FATAL("Unable to write to %s: %s", path_, std::strerror(errno));
+    }
+    written += static_cast<size_t>(result);
+  }
+}
+
+void AsyncFileWriter::RunWriter() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] { return !queued_.empty() || stopping_; });
+    if (queued_.empty()) {
+      return;
+    }
+
+    const Chunk chunk = queued_.front();
+    queued_.pop_front();
+    lock.unlock();
+    WriteChunk(chunk);
+    lock.lock();
+
+    free_.push_back(chunk.data);
+    condition_.notify_all();
+  }
+}
+
+}  // namespace gamebun
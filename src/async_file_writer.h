@@ -0,0 +1,84 @@
+#ifndef ASYNC_FILE_WRITER_H_
+#define ASYNC_FILE_WRITER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/byte_size.h"
+
+namespace gamebun {
+
+// Streams data to a file from a background thread, so that the thread
+// producing the data only ever copies into memory. The file is written in
+// large, block-aligned chunks with O_DIRECT where the file system supports
+// it, bypassing the page cache. All chunk memory is allocated up front.
+class AsyncFileWriter {
+ public:
+  static constexpr util::ByteSize kChunkSize = 1 * util::kMegabytes;
+
+  // Creates or truncates `path`. The producer only waits for the disk once
+  // `chunk_count` chunks are queued.
+  explicit AsyncFileWriter(const char* path, size_t chunk_count = 8);
+  ~AsyncFileWriter();
+
+  // Returns room for `size` bytes, at most kChunkSize, at the end of the
+  // stream. The bytes are written out once they are committed.
+  uint8_t* Reserve(size_t size);
+  void Commit(size_t size);
+
+  void Append(const void* data, size_t size);
+
+  // Writes out everything committed and stops the background thread. Only
+  // WriteAt() may be called afterwards.
+  void Finish();
+
+  // Overwrites bytes already written, such as a header whose fields depend
+  // on the length of the stream.
+  void WriteAt(uint64_t offset, const void* data, size_t size);
+
+  // Number of bytes committed so far.
+  uint64_t size() const { return size_; }
+
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+ private:
+  struct Chunk {
+    uint8_t* data;
+    size_t size;
+  };
+
+  // Queues the filled chunk, moving anything committed past kChunkSize to the
+  // start of the next one.
+  void SubmitChunk();
+  void WriteChunk(const Chunk& chunk);
+  void RunWriter();
+
+  const char* const path_;
+  int fd_;
+  bool direct_;
+  // Each chunk has kChunkSize bytes of slack, so a reservation never has to
+  // be split across chunks.
+  uint8_t* memory_;
+  std::vector<uint8_t*> chunks_;
+  uint8_t* filling_;
+  size_t filled_;
+  uint64_t size_;
+  bool finished_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Chunk> queued_;
+  std::vector<uint8_t*> free_;
+  bool stopping_;
+  std::thread writer_;
+};
+
+}  // namespace gamebun
+
+#endif  // ASYNC_FILE_WRITER_H_
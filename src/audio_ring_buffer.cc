@@ -0,0 +1,71 @@
+#include "audio_ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+AudioRingBuffer::AudioRingBuffer(size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+      samples_(2 * (mask_ + 1)),
+      write_position_(0),
+      read_position_(0) {
+  if (capacity == 0) {
+    FATAL("AudioRingBuffer needs a nonzero capacity");
+  }
+}
+
+size_t AudioRingBuffer::Write(const int16_t* samples, size_t count) {
+  const size_t write = write_position_.load(std::memory_order_relaxed);
+  const size_t read = read_position_.load(std::memory_order_acquire);
+  count = std::min(count, capacity() - (write - read));
+  CopyIn(write, samples, count);
+  write_position_.store(write + count, std::memory_order_release);
+  return count;
+}
+
+size_t AudioRingBuffer::Read(int16_t* out, size_t count) {
+  const size_t read = read_position_.load(std::memory_order_relaxed);
+  const size_t write = write_position_.load(std::memory_order_acquire);
+  count = std::min(count, write - read);
+  CopyOut(read, out, count);
+  read_position_.store(read + count, std::memory_order_release);
+  return count;
+}
+
+void AudioRingBuffer::CopyIn(size_t position, const int16_t* samples,
+                             size_t count) {
+  const size_t start = position & mask_;
+  const size_t first = std::min(count, capacity() - start);
+  std::memcpy(&samples_[2 * start], samples, 2 * first * sizeof(int16_t));
+  std::memcpy(&samples_[0], &samples[2 * first],
+              2 * (count - first) * sizeof(int16_t));
+}
+
+void AudioRingBuffer::CopyOut(size_t position, int16_t* out,
+                              size_t count) const {
+  const size_t start = position & mask_;
+  const size_t first = std::min(count, capacity() - start);
+  std::memcpy(out, &samples_[2 * start], 2 * first * sizeof(int16_t));
+  std::memcpy(&out[2 * first], &samples_[0],
+              2 * (count - first) * sizeof(int16_t));
+}
+
+}  // namespace gamebun
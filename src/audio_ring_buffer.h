@@ -0,0 +1,58 @@
+#ifndef AUDIO_RING_BUFFER_H_
+#define AUDIO_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gamebun {
+
+inline constexpr size_t kCacheLineSize = 64;
+
+// A wait-free queue of stereo samples from one producer thread to one
+// consumer thread, such as a host audio callback, which must never wait on
+// a lock. Each side only ever stores its own position and loads the other's.
+class AudioRingBuffer {
+ public:
+  // Holds at least `capacity` stereo samples.
+  explicit AudioRingBuffer(size_t capacity);
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Appends up to `count` stereo samples, left channel first, and returns how
+  // many fit. Called by the producer.
+  size_t Write(const int16_t* samples, size_t count);
+  // Removes up to `count` stereo samples into `out` and returns how many
+  // there were. Called by the consumer.
+  size_t Read(int16_t* out, size_t count);
+
+  // Number of stereo samples queued. Exact on either side as far as its own
+  // operations go; the other side may have moved on since.
+  size_t Size() const {
+    // The read position is loaded first, so that the write position loaded
+    // after it can never be behind it.
+    const size_t read_position = read_position_.load(std::memory_order_acquire);
+    return write_position_.load(std::memory_order_acquire) - read_position;
+  }
+
+  AudioRingBuffer(const AudioRingBuffer&) = delete;
+  AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+ private:
+  // Copies `count` stereo samples between `samples` and the buffer starting
+  // at `position`, wrapping around its end.
+  void CopyIn(size_t position, const int16_t* samples, size_t count);
+  void CopyOut(size_t position, int16_t* out, size_t count) const;
+
+  const size_t mask_;
+  std::vector<int16_t> samples_;
+  // The positions only ever increase, and each is written by one side. They
+  // live on separate cache lines so that the two sides do not contend.
+  alignas(kCacheLineSize) std::atomic<size_t> write_position_;
+  alignas(kCacheLineSize) std::atomic<size_t> read_position_;
+};
+
+}  // namespace gamebun
+
+#endif  // AUDIO_RING_BUFFER_H_
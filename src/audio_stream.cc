@@ -0,0 +1,50 @@
+#include "audio_stream.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gamebun {
+
+namespace {
+
+// Output stereo samples resampled per step of Push().
+constexpr size_t kChunkSamples = 1024;
+
+}  // namespace
+
+AudioStream::AudioStream(uint32_t input_rate,
+                         const AudioStreamOptions& options)
+    : resampler_(input_rate, options.output_rate),
+      target_queued_(std::max<size_t>(
+          1, size_t{options.output_rate} * options.latency_ms / 1000)),
+      max_rate_adjustment_(options.max_rate_adjustment),
+      // Room for bursts of up to three times the target on top of it.
+      queue_(4 * target_queued_),
+      resampled_(2 * kChunkSamples) {}
+
+void AudioStream::Push(const int16_t* samples, size_t count) {
+  // Speeds the output up while the queue is short of its target, and slows
+  // it down while it is over, in proportion to the difference.
+  const double queued = static_cast<double>(queue_.Size());
+  const double target = static_cast<double>(target_queued_);
+  const double error = std::clamp((target - queued) / target, -1.0, 1.0);
+  resampler_.SetRateAdjustment(1.0 + error * max_rate_adjustment_);
+
+  resampler_.Write(samples, count);
+  while (const size_t resampled =
+             resampler_.Read(resampled_.data(), kChunkSamples)) {
+    // A full queue means the audio thread stopped pulling, in which case the
+    // newest samples are dropped.
+    queue_.Write(resampled_.data(), resampled);
+  }
+}
+
+size_t AudioStream::Pull(int16_t* out, size_t count) {
+  const size_t read = queue_.Read(out, count);
+  std::memset(&out[2 * read], 0, 2 * (count - read) * sizeof(int16_t));
+  return read;
+}
+
+}  // namespace gamebun
@@ -0,0 +1,58 @@
+#ifndef AUDIO_STREAM_H_
+#define AUDIO_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audio_ring_buffer.h"
+#include "resampler.h"
+
+namespace gamebun {
+
+struct AudioStreamOptions {
+  // Rate at which the host plays samples.
+  uint32_t output_rate = 48000;
+  // How long samples should wait between being pushed and being played. To
+  // keep this short, push at least this often.
+  uint32_t latency_ms = 40;
+  // Largest relative change to the output rate made to keep the queue at the
+  // target latency. Half a percent is not audible as a change of pitch.
+  double max_rate_adjustment = 0.005;
+};
+
+// Carries audio from the emulation thread to a host audio thread, resampled
+// to the host's rate. The audio thread never waits for the emulation
+// thread. The two sides run on different clocks, so the output rate is
+// continuously adjusted by a small amount to keep the queue at the target
+// latency instead of it slowly filling up or running dry.
+class AudioStream {
+ public:
+  AudioStream(uint32_t input_rate, const AudioStreamOptions& options);
+
+  // Resamples and queues `count` stereo samples, left channel first. Called
+  // from the emulation thread.
+  void Push(const int16_t* samples, size_t count);
+
+  // Fills `out` with `count` stereo samples and returns how many of them
+  // were queued, padding the rest with silence. Called from the audio thread;
+  // never blocks.
+  size_t Pull(int16_t* out, size_t count);
+
+  // Number of stereo samples waiting to be pulled.
+  size_t Queued() const { return queue_.Size(); }
+
+  AudioStream(const AudioStream&) = delete;
+  AudioStream& operator=(const AudioStream&) = delete;
+
+ private:
+  Resampler resampler_;
+  const size_t target_queued_;
+  const double max_rate_adjustment_;
+  AudioRingBuffer queue_;
+  std::vector<int16_t> resampled_;
+};
+
+}  // namespace gamebun
+
+#endif  // AUDIO_STREAM_H_
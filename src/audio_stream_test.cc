@@ -0,0 +1,270 @@
+#include "audio_stream.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "audio_ring_buffer.h"
+#include "resampler.h"
+
+namespace gamebun {
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// `count` stereo samples of a sine of `frequency` on the left channel and
+// a constant on the right.
+std::vector<int16_t> Sine(double frequency, uint32_t rate, size_t count,
+                          double amplitude, int16_t right) {
+  std::vector<int16_t> samples(2 * count);
+  for (size_t i = 0; i < count; i++) {
+    samples[2 * i] = static_cast<int16_t>(std::lround(
+        amplitude * std::sin(2 * kPi * frequency * static_cast<double>(i) /
+                             rate)));
+    samples[2 * i + 1] = right;
+  }
+  return samples;
+}
+
+// Writes all of `samples` to `resampler` and reads back everything it
+// produces.
+std::vector<int16_t> Resample(Resampler* resampler,
+                              const std::vector<int16_t>& samples) {
+  resampler->Write(samples.data(), samples.size() / 2);
+  std::vector<int16_t> out;
+  std::vector<int16_t> chunk(2 * 1000);
+  while (const size_t read = resampler->Read(chunk.data(), 1000)) {
+    out.insert(out.end(), chunk.begin(), chunk.begin() + 2 * read);
+  }
+  return out;
+}
+
+TEST_CASE("Resampling keeps the rate ratio, the channels and the tone",
+          "[audio_stream]") {
+  const uint32_t input_rate = GENERATE(32768u, 44100u, 48000u, 96000u);
+  constexpr uint32_t kOutputRate = 48000;
+  INFO(input_rate << " Hz in");
+  Resampler resampler(input_rate, kOutputRate);
+
+  // A second of a 1 kHz tone, in pieces of uneven sizes.
+  const std::vector<int16_t> input =
+      Sine(1000, input_rate, input_rate, 10000, -1234);
+  std::vector<int16_t> output;
+  for (size_t start = 0; start < input.size();) {
+    const size_t end = std::min(input.size(), start + 2 * (start % 977 + 13));
+    const std::vector<int16_t> piece(input.begin() + start,
+                                     input.begin() + end);
+    const std::vector<int16_t> resampled = Resample(&resampler, piece);
+    output.insert(output.end(), resampled.begin(), resampled.end());
+    start = end;
+  }
+  const size_t count = output.size() / 2;
+  CHECK(count + 2 >= kOutputRate);
+  CHECK(count <= kOutputRate + 2);
+
+  // Once past the filter's delay, the right channel holds its level and the
+  // left one swings as far with as many zero crossings as it went in with.
+  int low = 0;
+  int high = 0;
+  size_t crossings = 0;
+  size_t wrong_right = 0;
+  for (size_t i = 100; i < count; i++) {
+    wrong_right += std::abs(output[2 * i + 1] + 1234) > 2;
+    const int left = output[2 * i];
+    low = std::min(low, left);
+    high = std::max(high, left);
+    crossings += (left >= 0) != (output[2 * i - 2] >= 0);
+  }
+  CHECK(wrong_right == 0);
+  CHECK(high > 9900);
+  CHECK(high < 10100);
+  CHECK(low < -9900);
+  CHECK(low > -10100);
+  const size_t expected = 2 * 1000 * (count - 100) / kOutputRate;
+  CHECK(crossings + 2 >= expected);
+  CHECK(crossings <= expected + 2);
+}
+
+TEST_CASE("Resampling filters out tones the output rate cannot carry",
+          "[audio_stream]") {
+  // 20 kHz is above the Nyquist frequency of 16384 Hz.
+  Resampler resampler(48000, 32768);
+  const std::vector<int16_t> output =
+      Resample(&resampler, Sine(20000, 48000, 48000, 10000, 0));
+  int loudest = 0;
+  for (size_t i = 100; i < output.size() / 2; i++) {
+    loudest = std::max(loudest, std::abs(output[2 * i]));
+  }
+  CHECK(loudest < 200);
+}
+
+TEST_CASE("Rate adjustments change the number of samples produced",
+          "[audio_stream]") {
+  const double adjustment = GENERATE(0.99, 0.995, 1.0, 1.005, 1.01);
+  INFO("adjusted by " << adjustment);
+  Resampler resampler(44100, 48000);
+  resampler.SetRateAdjustment(adjustment);
+  const std::vector<int16_t> output =
+      Resample(&resampler, std::vector<int16_t>(2 * 441000, 5000));
+  const double expected = 480000 * adjustment;
+  CHECK(std::abs(static_cast<double>(output.size() / 2) - expected) < 30);
+  // A constant comes out unchanged, whatever the ratio.
+  size_t wrong = 0;
+  for (size_t i = 100; i < output.size(); i++) {
+    wrong += std::abs(output[i] - 5000) > 1;
+  }
+  CHECK(wrong == 0);
+}
+
+TEST_CASE("Ring buffers keep samples in order as they wrap around",
+          "[audio_stream]") {
+  AudioRingBuffer buffer(100);
+  REQUIRE(buffer.capacity() == 128);
+  int16_t next_written = 0;
+  int16_t next_read = 0;
+  for (size_t round = 0; round < 50; round++) {
+    INFO("round " << round);
+    // More than fit, so that writes are cut short when the buffer is full.
+    const size_t write_count = round % 7 * 31;
+    std::vector<int16_t> samples(2 * write_count);
+    for (size_t i = 0; i < write_count; i++) {
+      samples[2 * i] = static_cast<int16_t>(next_written + i);
+      samples[2 * i + 1] = static_cast<int16_t>(-(next_written + i));
+    }
+    const size_t size = buffer.Size();
+    const size_t written = buffer.Write(samples.data(), write_count);
+    CHECK(written == std::min(write_count, buffer.capacity() - size));
+    CHECK(buffer.Size() == size + written);
+    next_written = static_cast<int16_t>(next_written + written);
+
+    const size_t read_count = round % 5 * 29;
+    std::vector<int16_t> out(2 * read_count);
+    const size_t read = buffer.Read(out.data(), read_count);
+    CHECK(read == std::min(read_count, size + written));
+    size_t wrong = 0;
+    for (size_t i = 0; i < read; i++) {
+      wrong += out[2 * i] != static_cast<int16_t>(next_read + i) ||
+               out[2 * i + 1] != static_cast<int16_t>(-(next_read + i));
+    }
+    CHECK(wrong == 0);
+    next_read = static_cast<int16_t>(next_read + read);
+    CHECK(buffer.Size() == size + written - read);
+  }
+}
+
+TEST_CASE("Ring buffers carry samples between two threads",
+          "[audio_stream]") {
+  constexpr size_t kTotal = 1 << 18;
+  AudioRingBuffer buffer(256);
+  std::thread producer([&buffer] {
+    std::vector<int16_t> samples(2 * 100);
+    for (size_t sent = 0; sent < kTotal;) {
+      const size_t count = std::min<size_t>(100, kTotal - sent);
+      for (size_t i = 0; i < count; i++) {
+        samples[2 * i] = static_cast<int16_t>(sent + i);
+        samples[2 * i + 1] = static_cast<int16_t>((sent + i) >> 16);
+      }
+      const size_t written = buffer.Write(samples.data(), count);
+      if (written < count) {
+        std::this_thread::yield();
+      }
+      sent += written;
+    }
+  });
+  std::vector<int16_t> out(2 * 70);
+  size_t mismatches = 0;
+  for (size_t received = 0; received < kTotal;) {
+    const size_t read = buffer.Read(out.data(), 70);
+    for (size_t i = 0; i < read; i++) {
+      const size_t index = received + i;
+      mismatches += out[2 * i] != static_cast<int16_t>(index) ||
+                    out[2 * i + 1] != static_cast<int16_t>(index >> 16);
+    }
+    if (read == 0) {
+      std::this_thread::yield();
+    }
+    received += read;
+  }
+  producer.join();
+  CHECK(mismatches == 0);
+  CHECK(buffer.Size() == 0);
+}
+
+// Plays `seconds` of audio through a stream at 44.1 kHz in and 48 kHz out,
+// pushed and pulled every 10 ms, with the consumer's clock running fast by
+// `drift`. Returns the fewest and most samples queued after the first
+// second, and counts the samples pulled that were not queued.
+void RunStream(const AudioStreamOptions& options, double drift,
+               size_t seconds, size_t* least_queued, size_t* most_queued,
+               size_t* underruns) {
+  AudioStream stream(44100, options);
+  const std::vector<int16_t> input(2 * 441, 1000);
+  std::vector<int16_t> out(2 * 1000);
+  // Starts playing once the first pushes are queued.
+  for (size_t i = 0; i < 4; i++) {
+    stream.Push(input.data(), 441);
+  }
+  *least_queued = SIZE_MAX;
+  *most_queued = 0;
+  *underruns = 0;
+  double owed = 0;
+  for (size_t tick = 0; tick < seconds * 100; tick++) {
+    stream.Push(input.data(), 441);
+    owed += 480 * (1 + drift);
+    const size_t count = static_cast<size_t>(owed);
+    owed -= static_cast<double>(count);
+    const size_t pulled = stream.Pull(out.data(), count);
+    if (tick >= 100) {
+      *underruns += count - pulled;
+      *least_queued = std::min(*least_queued, stream.Queued());
+      *most_queued = std::max(*most_queued, stream.Queued());
+    }
+    // Whatever was not queued is silence.
+    CHECK(std::all_of(&out[2 * pulled], &out[2 * count],
+                      [](int16_t sample) { return sample == 0; }));
+  }
+}
+
+TEST_CASE("Streams hold their queue near the target latency",
+          "[audio_stream]") {
+  // 40 ms at 48 kHz.
+  constexpr size_t kTarget = 1920;
+  AudioStreamOptions options;
+  size_t least_queued;
+  size_t most_queued;
+  size_t underruns;
+
+  SECTION("with a consumer running fast") {
+    RunStream(options, 0.003, 60, &least_queued, &most_queued, &underruns);
+    CHECK(underruns == 0);
+    CHECK(least_queued > kTarget / 4);
+    CHECK(most_queued < kTarget);
+  }
+  SECTION("with a consumer running slow") {
+    RunStream(options, -0.003, 60, &least_queued, &most_queued, &underruns);
+    CHECK(underruns == 0);
+    CHECK(least_queued > kTarget);
+    CHECK(most_queued < 2 * kTarget);
+  }
+  SECTION("with the same clocks") {
+    RunStream(options, 0, 60, &least_queued, &most_queued, &underruns);
+    CHECK(underruns == 0);
+    CHECK(least_queued > kTarget / 2);
+    CHECK(most_queued < 3 * kTarget / 2);
+  }
+  SECTION("but without adjusting the rate, run dry or fill up") {
+    options.max_rate_adjustment = 0;
+    RunStream(options, 0.003, 60, &least_queued, &most_queued, &underruns);
+    CHECK(underruns > 0);
+    RunStream(options, -0.003, 60, &least_queued, &most_queued, &underruns);
+    CHECK(most_queued >= 3 * kTarget);
+  }
+}
+
+}  // namespace
+}  // namespace gamebun
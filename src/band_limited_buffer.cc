@@ -0,0 +1,174 @@
+#include "band_limited_buffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "arena.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// Each step is spread over kTaps samples, at one of kPhases sub-sample
+// offsets. The impulse is centered, so output lags the input by kTaps / 2
+// samples.
+constexpr size_t kTaps = 32;
+constexpr int kPhaseBits = 6;
+constexpr size_t kPhases = 1 << kPhaseBits;
+// The taps of every phase add up to kUnit, so a step of 1 raises the
+// integrated signal by exactly kUnit.
+constexpr int kUnitBits = 15;
+constexpr int32_t kUnit = 1 << kUnitBits;
+// Levels are scaled up by this many bits for output. Four channels at full
+// volume add up to 480, which becomes 30720.
+constexpr int kOutputGainBits = 6;
+// The integrator leaks 1/2^kLeakBits of its value every sample, which filters
+// out a constant level, as the capacitors on the hardware's outputs do.
+constexpr int kLeakBits = 9;
+
+using Kernel = std::array<std::array<int32_t, kTaps>, kPhases>;
+
+// Blackman-windowed sinc impulses, cut off a little below the Nyquist
+// frequency so that the window's transition band stays inaudible.
+Kernel BuildKernel() {
+  constexpr double kPi = 3.14159265358979323846;
+  constexpr double kCutoff = 0.9;
+  Kernel kernel;
+  for (size_t phase = 0; phase < kPhases; phase++) {
+    std::array<double, kTaps> taps;
+    double sum = 0;
+    for (size_t tap = 0; tap < kTaps; tap++) {
+      // The step falls `phase / kPhases` of a sample after the impulse
+      // center's sample, kTaps / 2 taps in.
+      const double x = static_cast<double>(tap) + 0.5 -
+                       static_cast<double>(phase) / kPhases -
+                       static_cast<double>(kTaps) / 2;
+      const double sinc = std::fabs(x) < 1e-9 ? 1
+                                              : std::sin(kPi * kCutoff * x) /
+                                                    (kPi * kCutoff * x);
+      const double window_position = (x + kTaps / 2.0) / kTaps;
+      const double window = 0.42 - 0.5 * std::cos(2 * kPi * window_position) +
+                            0.08 * std::cos(4 * kPi * window_position);
+      taps[tap] = sinc * window;
+      sum += taps[tap];
+    }
+
+    // Rounding errors go to the center tap, so that every phase adds up to
+    // exactly kUnit and steps never leave a residue in the integrator.
+    int32_t total = 0;
+    for (size_t tap = 0; tap < kTaps; tap++) {
+      kernel[phase][tap] =
+          static_cast<int32_t>(std::lround(taps[tap] / sum * kUnit));
+      total += kernel[phase][tap];
+    }
+    kernel[phase][kTaps / 2] += kUnit - total;
+  }
+  return kernel;
+}
+
+// Built on first use and shared by every buffer.
+const Kernel& GetKernel() {
+  static const Kernel kernel = BuildKernel();
+  return kernel;
+}
+
+}  // namespace
+
+BandLimitedBuffer::BandLimitedBuffer(uint32_t clock_rate, uint32_t sample_rate,
+                                     size_t capacity, Arena* arena)
+    : capacity_(capacity),
+      step_((static_cast<uint64_t>(sample_rate) << 32) / clock_rate),
+      offset_(0),
+      // A batch adds at most one sample more than its length in samples,
+      // plus the tail of the impulses around its end.
+      delta_count_(capacity + ((kMaxBatchCycles * step_) >> 32) + 1 + kTaps),
+      deltas_(arena->Allocate<int32_t>(delta_count_)),
+      touched_(0),
+      available_(0),
+      integrator_(0) {
+  if (sample_rate == 0 || sample_rate >= clock_rate) {
+    FATAL("Unsupported sample rate %u for a %u Hz clock", sample_rate,
+          clock_rate);
+  }
+}
+
+void BandLimitedBuffer::AddDelta(uint32_t time, int32_t delta) {
+  const uint64_t position = offset_ + time * step_;
+  const size_t phase = (position >> (32 - kPhaseBits)) & (kPhases - 1);
+  const size_t start = available_ + (position >> 32);
+  int32_t* out = &deltas_[start];
+  touched_ = std::max(touched_, start + kTaps);
+  const std::array<int32_t, kTaps>& taps = GetKernel()[phase];
+  for (size_t tap = 0; tap < kTaps; tap++) {
+    out[tap] += taps[tap] * delta;
+  }
+}
+
+void BandLimitedBuffer::EndBatch(uint32_t duration) {
+  const uint64_t position = offset_ + duration * step_;
+  available_ += position >> 32;
+  offset_ = position & 0xFFFFFFFF;
+  if (available_ > capacity_) {
+    ReadSamples(nullptr, available_ - capacity_, 0);
+  }
+}
+
+size_t BandLimitedBuffer::ReadSamples(int16_t* out, size_t count,
+                                      size_t stride) {
+  count = std::min(count, available_);
+  integrator_ = Integrate(out, count, stride);
+
+  // Moves the incomplete samples, still touched by the current batch, to the
+  // front.
+  if (count >= touched_) {
+    std::memset(deltas_, 0, touched_ * sizeof(int32_t));
+    touched_ = 0;
+  } else {
+    const size_t remaining = touched_ - count;
+    std::memmove(deltas_, &deltas_[count], remaining * sizeof(int32_t));
+    std::memset(&deltas_[remaining], 0, count * sizeof(int32_t));
+    touched_ = remaining;
+  }
+  available_ -= count;
+  return count;
+}
+
+void BandLimitedBuffer::SaveState(StateWriter* writer) const {
+  writer->Write(offset_);
+  writer->Write(Integrate(nullptr, available_, 0));
+  // Only the tails of the impulses of the last batch reach past the
+  // complete samples.
+  writer->WriteBytes(&deltas_[available_], kTaps * sizeof(int32_t));
+}
+
+void BandLimitedBuffer::LoadState(StateReader* reader) {
+  std::fill(deltas_, deltas_ + touched_, 0);
+  available_ = 0;
+  reader->Read(&offset_);
+  reader->Read(&integrator_);
+  reader->ReadBytes(deltas_, kTaps * sizeof(int32_t));
+  touched_ = kTaps;
+}
+
+int32_t BandLimitedBuffer::Integrate(int16_t* out, size_t count,
+                                     size_t stride) const {
+  int32_t integrator = integrator_;
+  for (size_t i = 0; i < count; i++) {
+    integrator += deltas_[i];
+    if (out != nullptr) {
+      const int32_t sample = integrator >> (kUnitBits - kOutputGainBits);
+      out[i * stride] = static_cast<int16_t>(
+          std::clamp<int32_t>(sample, INT16_MIN, INT16_MAX));
+    }
+    integrator -= integrator >> kLeakBits;
+  }
+  return integrator;
+}
+
+}  // namespace gamebun
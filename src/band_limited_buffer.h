@@ -0,0 +1,79 @@
+#ifndef BAND_LIMITED_BUFFER_H_
+#define BAND_LIMITED_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gamebun {
+
+class Arena;
+class StateReader;
+class StateWriter;
+
+// Resamples a signal made of steps at clock cycle timestamps without
+// aliasing. Each step is added as a windowed sinc impulse to a buffer of
+// differences between output samples, which is integrated as the samples are
+// read, so the cost depends only on how often the signal changes and not on
+// the clock rate.
+//
+// Time is counted in clock cycles from the start of the current batch. A
+// batch can last up to kMaxBatchCycles.
+class BandLimitedBuffer {
+ public:
+  static constexpr uint32_t kMaxBatchCycles = 1 << 20;
+
+  // Holds up to `capacity` samples which have not been read yet, in memory
+  // from `arena`.
+  BandLimitedBuffer(uint32_t clock_rate, uint32_t sample_rate, size_t capacity,
+                    Arena* arena);
+
+  // Adds a step of `delta` at cycle `time` of the current batch.
+  void AddDelta(uint32_t time, int32_t delta);
+
+  // Ends the current batch `duration` cycles after it started, completing the
+  // samples it covers. If they do not fit, the oldest samples are dropped.
+  void EndBatch(uint32_t duration);
+
+  size_t SamplesAvailable() const { return available_; }
+
+  // Reads up to `count` samples, `stride` samples apart in `out`, and returns
+  // how many were read. Reading into null drops the samples.
+  size_t ReadSamples(int16_t* out, size_t count, size_t stride);
+
+  // Saves or restores what the samples after the unread ones depend on,
+  // between batches. Unread samples are left out, so a restored buffer
+  // starts out empty.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  BandLimitedBuffer(const BandLimitedBuffer&) = delete;
+  BandLimitedBuffer& operator=(const BandLimitedBuffer&) = delete;
+
+ private:
+  // Integrates the first `count` deltas from integrator_, writing the
+  // samples to `out` unless it is null, and returns the integrator after
+  // them.
+  int32_t Integrate(int16_t* out, size_t count, size_t stride) const;
+
+  const size_t capacity_;
+  // Samples per clock cycle, as a 32.32 fixed-point number.
+  const uint64_t step_;
+  // Position of the start of the current batch past the last complete
+  // sample, as a 32-bit fraction of a sample.
+  uint64_t offset_;
+  // Differences between consecutive samples, starting from the oldest unread
+  // one. The first `available_` are complete, and the rest have only been
+  // touched by the current batch.
+  const size_t delta_count_;
+  int32_t* const deltas_;
+  // One past the last delta that may not be zero. Only this far is moved
+  // as samples are read, so the rest of the buffer is never touched and
+  // costs no memory until the host falls behind.
+  size_t touched_;
+  size_t available_;
+  int32_t integrator_;
+};
+
+}  // namespace gamebun
+
+#endif  // BAND_LIMITED_BUFFER_H_
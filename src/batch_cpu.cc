@@ -0,0 +1,449 @@
+#include "batch_cpu.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "emulator.h"
+#include "memory.h"
+#include "registers.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// Register indices as encoded in opcodes.
+constexpr size_t kB = 0;
+constexpr size_t kC = 1;
+constexpr size_t kD = 2;
+constexpr size_t kE = 3;
+constexpr size_t kH = 4;
+constexpr size_t kL = 5;
+constexpr size_t kMemoryHl = 6;
+constexpr size_t kA = 7;
+// F has no index of its own, so it takes that of (HL).
+constexpr size_t kF = kMemoryHl;
+constexpr size_t kSp = 3;
+
+constexpr uint8_t kZeroFlag = 0x80;
+constexpr uint8_t kSubtractFlag = 0x40;
+constexpr uint8_t kHalfCarryFlag = 0x20;
+constexpr uint8_t kCarryFlag = 0x10;
+
+enum AluOperation : size_t {
+  kAdd,
+  kAddWithCarry,
+  kSubtract,
+  kSubtractWithCarry,
+  kAnd,
+  kXor,
+  kOr,
+  kCompare,
+};
+
+// Lockstep covers the cartridge ROM. Every lane has the same copy of the
+// fixed bank, and of the switchable one while they all select the same bank.
+// No instruction is longer than 3 bytes.
+constexpr uint16_t kSwitchableBankStart = 0x4000;
+constexpr uint16_t kRomEnd = 0x8000;
+constexpr uint16_t kMaxInstructionSize = 3;
+constexpr uint16_t kLockstepEnd = kRomEnd - (kMaxInstructionSize - 1);
+
+// Cartridge RAM, which nothing but the CPU reads or writes, so that lanes
+// can access it without their peripherals being clocked up.
+constexpr uint16_t kCartridgeRamStart = 0xA000;
+constexpr uint16_t kCartridgeRamEnd = 0xC000;
+
+// Deferring more would delay interrupts well past the line they belong to.
+constexpr uint32_t kMaxDeferredCycles = 456;
+
+}  // namespace
+
+BatchCpu::BatchCpu(const std::vector<Emulator*>& lanes)
+    : lanes_(lanes),
+      lane_count_(lanes.size()),
+      registers_(),
+      sp_(),
+      pc_(),
+      deferred_(),
+      elapsed_(),
+      immediate_(),
+      memory_operand_(),
+      lockstep_steps_(0),
+      scalar_steps_(0) {
+  if (lane_count_ == 0 || lane_count_ > kMaxLanes) {
+    FATAL("A batch needs between 1 and %zu lanes, not %zu", kMaxLanes,
+          lane_count_);
+  }
+}
+
+void BatchCpu::RunCycles(uint64_t cycles) {
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    Load(lane);
+    elapsed_[lane] = 0;
+  }
+
+  while (true) {
+    bool done = true;
+    for (size_t lane = 0; lane < lane_count_; lane++) {
+      done &= elapsed_[lane] + deferred_[lane] >= cycles;
+    }
+    if (done) {
+      break;
+    }
+
+    if (InLockstep() && StepLockstep()) {
+      lockstep_steps_++;
+      if (*std::max_element(deferred_, deferred_ + lane_count_) >=
+          kMaxDeferredCycles) {
+        Flush();
+      }
+      continue;
+    }
+    Flush();
+    StepScalar();
+  }
+  Flush();
+
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    Store(lane);
+  }
+}
+
+bool BatchCpu::InLockstep() const {
+  const uint16_t pc = pc_[0];
+  if (pc >= kLockstepEnd) {
+    return false;
+  }
+  bool same = !lanes_[0]->cpu_.InterruptsLive();
+  for (size_t lane = 1; lane < lane_count_; lane++) {
+    same &= pc_[lane] == pc && !lanes_[lane]->cpu_.InterruptsLive();
+  }
+  if (!same || pc <= kSwitchableBankStart - kMaxInstructionSize) {
+    return same;
+  }
+  const size_t bank = lanes_[0]->memory_.SelectedRomBank();
+  for (size_t lane = 1; lane < lane_count_; lane++) {
+    same &= lanes_[lane]->memory_.SelectedRomBank() == bank;
+  }
+  return same;
+}
+
+bool BatchCpu::StepLockstep() {
+  const Memory& memory = lanes_[0]->memory_;
+  const uint16_t pc = pc_[0];
+  const uint8_t opcode = memory.Read(Address(pc));
+  const auto read_immediate = [&memory, pc](uint16_t offset) {
+    return memory.Read(Address(pc + offset));
+  };
+  const auto broadcast_immediate = [this, &read_immediate]() {
+    std::fill(immediate_, immediate_ + kMaxLanes, read_immediate(1));
+  };
+  const size_t high_field = (opcode >> 3) & 0x07;
+  const size_t low_field = opcode & 0x07;
+
+  if (opcode == 0x00) {
+    // NOP
+    AddPc(1, 4);
+  } else if (opcode == 0x76) {
+    // HALT is left to the CPU.
+    return false;
+  } else if (0x40 <= opcode && opcode < 0x80) {
+    // LD r, r', LD r, (HL) and LD (HL), r
+    if (high_field == kMemoryHl) {
+      if (!HlInCartridgeRam()) {
+        return false;
+      }
+      WriteHl(registers_[low_field]);
+      AddPc(1, 8);
+    } else if (low_field == kMemoryHl) {
+      if (!HlInCartridge()) {
+        return false;
+      }
+      ReadHl();
+      LoadRegister(high_field, memory_operand_);
+      AddPc(1, 8);
+    } else {
+      LoadRegister(high_field, registers_[low_field]);
+      AddPc(1, 4);
+    }
+  } else if ((opcode & 0xC7) == 0x06) {
+    // LD r, n and LD (HL), n
+    broadcast_immediate();
+    if (high_field == kMemoryHl) {
+      if (!HlInCartridgeRam()) {
+        return false;
+      }
+      WriteHl(immediate_);
+      AddPc(2, 12);
+    } else {
+      LoadRegister(high_field, immediate_);
+      AddPc(2, 8);
+    }
+  } else if ((opcode & 0xC6) == 0x04) {
+    // INC r and DEC r, and the same on (HL).
+    const bool decrement = (opcode & 0x01) != 0;
+    if (high_field == kMemoryHl) {
+      if (!HlInCartridgeRam()) {
+        return false;
+      }
+      ReadHl();
+      Increment(memory_operand_, decrement);
+      WriteHl(memory_operand_);
+      AddPc(1, 12);
+    } else {
+      Increment(registers_[high_field], decrement);
+      AddPc(1, 4);
+    }
+  } else if (0x80 <= opcode && opcode < 0xC0) {
+    // ADD, ADC, SUB, SBC, AND, XOR, OR and CP with a register or (HL).
+    if (low_field == kMemoryHl) {
+      if (!HlInCartridge()) {
+        return false;
+      }
+      ReadHl();
+      Alu(high_field, memory_operand_);
+      AddPc(1, 8);
+    } else {
+      Alu(high_field, registers_[low_field]);
+      AddPc(1, 4);
+    }
+  } else if ((opcode & 0xC7) == 0xC6) {
+    // The same with an immediate.
+    broadcast_immediate();
+    Alu(high_field, immediate_);
+    AddPc(2, 8);
+  } else if ((opcode & 0xC7) == 0x03) {
+    // INC rr and DEC rr
+    IncrementPair(opcode >> 4, (opcode & 0x08) != 0);
+    AddPc(1, 8);
+  } else if (opcode == 0x18) {
+    // JR e
+    JumpRelative(static_cast<int8_t>(read_immediate(1)), 0, 0);
+  } else if ((opcode & 0xE7) == 0x20) {
+    // JR NZ, JR Z, JR NC and JR C, on the zero or carry flag.
+    const uint8_t flag = (opcode & 0x10) != 0 ? kCarryFlag : kZeroFlag;
+    JumpRelative(static_cast<int8_t>(read_immediate(1)), flag,
+                 (opcode & 0x08) != 0 ? flag : 0);
+  } else if (opcode == 0xC3) {
+    // JP nn
+    const uint16_t target = read_immediate(1) | read_immediate(2) << 8;
+    for (size_t lane = 0; lane < kMaxLanes; lane++) {
+      pc_[lane] = target;
+      deferred_[lane] += 16;
+    }
+  } else if (opcode == 0x2F || opcode == 0x37 || opcode == 0x3F) {
+    // CPL, SCF and CCF
+    uint8_t* a = registers_[kA];
+    uint8_t* f = registers_[kF];
+    for (size_t lane = 0; lane < kMaxLanes; lane++) {
+      if (opcode == 0x2F) {
+        a[lane] = ~a[lane];
+        f[lane] |= kSubtractFlag | kHalfCarryFlag;
+      } else {
+        const uint8_t carry =
+            opcode == 0x37 ? kCarryFlag : ~f[lane] & kCarryFlag;
+        f[lane] = (f[lane] & kZeroFlag) | carry;
+      }
+    }
+    AddPc(1, 4);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void BatchCpu::StepScalar() {
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    Emulator& emulator = *lanes_[lane];
+    Store(lane);
+    const size_t cycles = emulator.cpu_.Step();
+    Load(lane);
+    emulator.Advance(cycles);
+    elapsed_[lane] += cycles;
+    scalar_steps_++;
+  }
+}
+
+void BatchCpu::Flush() {
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    if (deferred_[lane] != 0) {
+      lanes_[lane]->Advance(deferred_[lane]);
+      elapsed_[lane] += deferred_[lane];
+    }
+  }
+  std::fill(deferred_, deferred_ + kMaxLanes, 0);
+}
+
+void BatchCpu::Load(size_t lane) {
+  const Registers& registers = lanes_[lane]->cpu_.registers();
+  registers_[kB][lane] = registers.B();
+  registers_[kC][lane] = registers.C();
+  registers_[kD][lane] = registers.D();
+  registers_[kE][lane] = registers.E();
+  registers_[kH][lane] = registers.H();
+  registers_[kL][lane] = registers.L();
+  registers_[kA][lane] = registers.A();
+  registers_[kF][lane] = registers.AF() & 0xFF;
+  sp_[lane] = registers.SP();
+  pc_[lane] = registers.PC();
+}
+
+void BatchCpu::Store(size_t lane) {
+  Registers& registers = lanes_[lane]->cpu_.registers();
+  registers.AF() = registers_[kA][lane] << 8 | registers_[kF][lane];
+  registers.B() = registers_[kB][lane];
+  registers.C() = registers_[kC][lane];
+  registers.D() = registers_[kD][lane];
+  registers.E() = registers_[kE][lane];
+  registers.H() = registers_[kH][lane];
+  registers.L() = registers_[kL][lane];
+  registers.SP() = sp_[lane];
+  registers.PC() = pc_[lane];
+}
+
+bool BatchCpu::HlInCartridge() const {
+  bool in_cartridge = true;
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    const uint16_t hl = registers_[kH][lane] << 8 | registers_[kL][lane];
+    in_cartridge &= hl < kRomEnd ||
+                    (kCartridgeRamStart <= hl && hl < kCartridgeRamEnd);
+  }
+  return in_cartridge;
+}
+
+bool BatchCpu::HlInCartridgeRam() const {
+  bool in_ram = true;
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    const uint16_t hl = registers_[kH][lane] << 8 | registers_[kL][lane];
+    in_ram &= kCartridgeRamStart <= hl && hl < kCartridgeRamEnd;
+  }
+  return in_ram;
+}
+
+void BatchCpu::ReadHl() {
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    const uint16_t hl = registers_[kH][lane] << 8 | registers_[kL][lane];
+    memory_operand_[lane] = lanes_[lane]->memory_.Read(Address(hl));
+  }
+}
+
+void BatchCpu::WriteHl(const uint8_t* values) {
+  for (size_t lane = 0; lane < lane_count_; lane++) {
+    const uint16_t hl = registers_[kH][lane] << 8 | registers_[kL][lane];
+    lanes_[lane]->memory_.Write(Address(hl), values[lane]);
+  }
+}
+
+void BatchCpu::LoadRegister(size_t dest, const uint8_t* src) {
+  std::copy(src, src + kMaxLanes, registers_[dest]);
+}
+
+void BatchCpu::Alu(size_t operation, const uint8_t* operand) {
+  uint8_t* a = registers_[kA];
+  uint8_t* f = registers_[kF];
+  switch (operation) {
+    case kAdd:
+    case kAddWithCarry: {
+      const bool with_carry = operation == kAddWithCarry;
+      for (size_t lane = 0; lane < kMaxLanes; lane++) {
+        const unsigned carry = with_carry ? (f[lane] >> 4) & 1 : 0;
+        const unsigned sum = a[lane] + operand[lane] + carry;
+        const uint8_t result = sum & 0xFF;
+        f[lane] = (result == 0 ? kZeroFlag : 0) |
+                  ((a[lane] ^ operand[lane] ^ result) & 0x10) << 1 |
+                  (sum >> 8) << 4;
+        a[lane] = result;
+      }
+      return;
+    }
+    case kSubtract:
+    case kSubtractWithCarry:
+    case kCompare: {
+      const bool with_carry = operation == kSubtractWithCarry;
+      const bool store = operation != kCompare;
+      for (size_t lane = 0; lane < kMaxLanes; lane++) {
+        const int carry = with_carry ? (f[lane] >> 4) & 1 : 0;
+        const int difference = a[lane] - operand[lane] - carry;
+        const uint8_t result = difference & 0xFF;
+        f[lane] = (result == 0 ? kZeroFlag : 0) | kSubtractFlag |
+                  ((a[lane] ^ operand[lane] ^ result) & 0x10) << 1 |
+                  (difference < 0 ? kCarryFlag : 0);
+        a[lane] = store ? result : a[lane];
+      }
+      return;
+    }
+    case kAnd:
+      for (size_t lane = 0; lane < kMaxLanes; lane++) {
+        a[lane] &= operand[lane];
+        f[lane] = (a[lane] == 0 ? kZeroFlag : 0) | kHalfCarryFlag;
+      }
+      return;
+    case kXor:
+      for (size_t lane = 0; lane < kMaxLanes; lane++) {
+        a[lane] ^= operand[lane];
+        f[lane] = a[lane] == 0 ? kZeroFlag : 0;
+      }
+      return;
+    case kOr:
+      for (size_t lane = 0; lane < kMaxLanes; lane++) {
+        a[lane] |= operand[lane];
+        f[lane] = a[lane] == 0 ? kZeroFlag : 0;
+      }
+      return;
+    default:
+      FATAL("Unknown ALU operation %zu", operation);
+  }
+}
+
+void BatchCpu::Increment(uint8_t* r, bool decrement) {
+  uint8_t* f = registers_[kF];
+  const uint8_t subtract = decrement ? kSubtractFlag : 0;
+  // The half carry is out of (or the borrow into) the low nibble.
+  const uint8_t half_carry_nibble = decrement ? 0x0F : 0x00;
+  for (size_t lane = 0; lane < kMaxLanes; lane++) {
+    const uint8_t result = decrement ? r[lane] - 1 : r[lane] + 1;
+    const bool half_carry = (result & 0x0F) == half_carry_nibble;
+    f[lane] = (f[lane] & kCarryFlag) | (result == 0 ? kZeroFlag : 0) |
+              subtract | (half_carry ? kHalfCarryFlag : 0);
+    r[lane] = result;
+  }
+}
+
+void BatchCpu::IncrementPair(size_t pair, bool decrement) {
+  const uint16_t delta = decrement ? 0xFFFF : 1;
+  if (pair == kSp) {
+    for (size_t lane = 0; lane < kMaxLanes; lane++) {
+      sp_[lane] += delta;
+    }
+    return;
+  }
+  uint8_t* high = registers_[2 * pair];
+  uint8_t* low = registers_[2 * pair + 1];
+  for (size_t lane = 0; lane < kMaxLanes; lane++) {
+    const uint16_t value = (high[lane] << 8 | low[lane]) + delta;
+    high[lane] = value >> 8;
+    low[lane] = value & 0xFF;
+  }
+}
+
+void BatchCpu::JumpRelative(int8_t offset, uint8_t condition_mask,
+                            uint8_t condition_value) {
+  const uint8_t* f = registers_[kF];
+  for (size_t lane = 0; lane < kMaxLanes; lane++) {
+    const bool taken = (f[lane] & condition_mask) == condition_value;
+    pc_[lane] += 2 + (taken ? offset : 0);
+    deferred_[lane] += taken ? 12 : 8;
+  }
+}
+
+void BatchCpu::AddPc(uint16_t bytes, uint32_t cycles) {
+  for (size_t lane = 0; lane < kMaxLanes; lane++) {
+    pc_[lane] += bytes;
+    deferred_[lane] += cycles;
+  }
+}
+
+}  // namespace gamebun
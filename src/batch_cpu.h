@@ -0,0 +1,107 @@
+#ifndef BATCH_CPU_H_
+#define BATCH_CPU_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "emulator.h"
+
+namespace gamebun {
+
+// Experimental: runs up to 32 emulators of the same cartridge in lockstep,
+// executing each instruction for all of them at once.
+//
+// The CPU registers of every instance are kept here in structure-of-arrays
+// form, one array of lanes per register. While all lanes are at the same PC
+// in cartridge ROM, either in the fixed bank or in a switchable bank they all
+// select, they fetch the same instruction, and the common ones (8-bit loads,
+// arithmetic and logic, 16-bit increments and jumps) are executed as plain
+// loops over the lanes, which the compiler turns into AVX2 or AVX-512 code.
+// Conditional jumps may send lanes different ways. Operands at (HL) are read
+// and written for each lane on its own, as long as every lane's HL points
+// into cartridge ROM, or cartridge RAM for writes. Whenever lanes disagree
+// on the PC, the instruction is another one, or any lane has interrupts
+// enabled, each lane is stepped on its own by its emulator's CPU instead.
+//
+// Lanes in lockstep touch nothing outside their registers and cartridge
+// memory, so clocking their peripherals is deferred until they leave it or a
+// few hundred cycles have passed.
+class BatchCpu {
+ public:
+  static constexpr size_t kMaxLanes = 32;
+
+  // The emulators must outlive the batch and may not be run on their own
+  // while it is running them.
+  explicit BatchCpu(const std::vector<Emulator*>& lanes);
+
+  // Runs every lane for at least `cycles` cycles. Lanes that get there first
+  // keep running while in lockstep with the rest, so they may overshoot by
+  // more than an instruction.
+  void RunCycles(uint64_t cycles);
+
+  // Instructions executed for all lanes at once, and for a single lane.
+  uint64_t lockstep_steps() const { return lockstep_steps_; }
+  uint64_t scalar_steps() const { return scalar_steps_; }
+
+  BatchCpu(const BatchCpu&) = delete;
+  BatchCpu& operator=(const BatchCpu&) = delete;
+
+ private:
+  // Returns whether every lane is at the same PC in cartridge ROM mapped the
+  // same way for all of them, with no interrupt that could be serviced.
+  bool InLockstep() const;
+  // Executes the instruction at the common PC for every lane, returning
+  // false without changing anything if it is not one that can be.
+  bool StepLockstep();
+  // Runs a single instruction of each lane on its emulator's CPU.
+  void StepScalar();
+  // Clocks every lane's peripherals by the cycles deferred in lockstep.
+  void Flush();
+
+  // Return whether every lane's HL points into cartridge ROM or RAM, or into
+  // cartridge RAM alone.
+  bool HlInCartridge() const;
+  bool HlInCartridgeRam() const;
+  // Read every lane's (HL) into memory_operand_, or write `values` to it.
+  void ReadHl();
+  void WriteHl(const uint8_t* values);
+
+  void Load(size_t lane);
+  void Store(size_t lane);
+
+  // Operations on all lanes at once. Registers are indexed as in opcodes.
+  void LoadRegister(size_t dest, const uint8_t* src);
+  void Alu(size_t operation, const uint8_t* operand);
+  void Increment(uint8_t* values, bool decrement);
+  void IncrementPair(size_t pair, bool decrement);
+  void JumpRelative(int8_t offset, uint8_t condition_mask,
+                    uint8_t condition_value);
+  void AddPc(uint16_t bytes, uint32_t cycles);
+
+  std::vector<Emulator*> lanes_;
+  size_t lane_count_;
+
+  // Every operation covers all kMaxLanes lanes, which keeps the loops a
+  // fixed length; lanes past lane_count_ are left out of everything else.
+  // Indexed by the 3-bit register field of opcodes, B, C, D, E, H, L, (HL)
+  // and A, with F kept in the unused slot of (HL).
+  alignas(64) uint8_t registers_[8][kMaxLanes];
+  alignas(64) uint16_t sp_[kMaxLanes];
+  alignas(64) uint16_t pc_[kMaxLanes];
+  // Cycles run in lockstep whose peripherals have yet to be clocked.
+  alignas(64) uint32_t deferred_[kMaxLanes];
+  // Cycles each lane ran in the current RunCycles().
+  uint64_t elapsed_[kMaxLanes];
+  // A lane-sized copy of an immediate operand.
+  alignas(64) uint8_t immediate_[kMaxLanes];
+  // Each lane's operand at (HL).
+  alignas(64) uint8_t memory_operand_[kMaxLanes];
+
+  uint64_t lockstep_steps_;
+  uint64_t scalar_steps_;
+};
+
+}  // namespace gamebun
+
+#endif  // BATCH_CPU_H_
@@ -0,0 +1,183 @@
+#include "batch_cpu.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cartridge.h"
+#include "emulator.h"
+#include "memory.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Enables cartridge RAM and switches to ROM bank 2, where the rest runs.
+const std::vector<uint8_t> kEntryProgram = {
+    0x3E, 0x0A,        // 0x100: LD A, 0x0A
+    0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A
+    0x3E, 0x02,        // 0x105: LD A, 0x02
+    0xEA, 0x00, 0x20,  // 0x107: LD (0x2000), A
+    0xC3, 0x00, 0x40,  // 0x10A: JP 0x4000
+};
+
+// Mixes the table at 0x4100 into cartridge RAM at 0xA100 through (HL), then
+// copies the result into the first 16 tiles, shows them and turns the LCD
+// on. Everything up to the copy can run in lockstep.
+const std::vector<uint8_t> kBankProgram = {
+    0x21, 0x00, 0x41,  // 0x4000: LD HL, 0x4100
+    0x06, 0x00,        // 0x4003: LD B, 0x00
+    0x0E, 0x00,        // 0x4005: LD C, 0x00
+    0x26, 0x41,        // 0x4007: LD H, 0x41
+    0x7E,              // 0x4009: LD A, (HL)
+    0x80,              // 0x400A: ADD A, B
+    0xA9,              // 0x400B: XOR C
+    0x47,              // 0x400C: LD B, A
+    0x0C,              // 0x400D: INC C
+    0x26, 0xA1,        // 0x400E: LD H, 0xA1
+    0x77,              // 0x4010: LD (HL), A
+    0x34,              // 0x4011: INC (HL)
+    0x8E,              // 0x4012: ADC A, (HL)
+    0x77,              // 0x4013: LD (HL), A
+    0x2C,              // 0x4014: INC L
+    0x20, 0xF0,        // 0x4015: JR NZ, 0x4007
+    0x11, 0x00, 0x80,  // 0x4017: LD DE, 0x8000
+    0x7E,              // 0x401A: LD A, (HL)
+    0x12,              // 0x401B: LD (DE), A
+    0x13,              // 0x401C: INC DE
+    0x2C,              // 0x401D: INC L
+    0x20, 0xFA,        // 0x401E: JR NZ, 0x401A
+    0x11, 0x00, 0x98,  // 0x4020: LD DE, 0x9800
+    0x7D,              // 0x4023: LD A, L
+    0x12,              // 0x4024: LD (DE), A
+    0x13,              // 0x4025: INC DE
+    0x2C,              // 0x4026: INC L
+    0x20, 0xFA,        // 0x4027: JR NZ, 0x4023
+    0x3E, 0x91,        // 0x4029: LD A, 0x91
+    0xE0, 0x40,        // 0x402B: LDH (0x40), A
+    0x18, 0xFE,        // 0x402D: JR 0x402D
+};
+
+// A 64 KB cartridge running kBankProgram from bank 2.
+Cartridge MakeBankedCartridge() {
+  std::vector<uint8_t> rom = MakeTestRom(kEntryProgram);
+  rom.resize(4 * kRomBankSize.value());
+  rom[0x148] = 0x01;
+  const size_t bank = 2 * kRomBankSize.value();
+  for (size_t i = 0; i < kBankProgram.size(); i++) {
+    rom[bank + i] = kBankProgram[i];
+  }
+  for (size_t i = 0; i < 0x100; i++) {
+    rom[bank + 0x100 + i] = static_cast<uint8_t>(i * 7 + 3);
+  }
+  return LoadTestCartridge(rom);
+}
+
+uint64_t FrameHash(Emulator* emulator) {
+  const Frame frame = emulator->AcquireFrame();
+  const uint64_t hash = frame.hash;
+  emulator->ReleaseFrame(frame);
+  return hash;
+}
+
+constexpr uint64_t kCyclesPerFrame = 70224;
+
+// Emulators of a cartridge, lane i of which has run `stagger` * i cycles
+// on its own, and a batch running them.
+struct TestBatch {
+  TestBatch(const Cartridge& cart, size_t lanes, uint64_t stagger) {
+    std::vector<Emulator*> pointers;
+    for (size_t i = 0; i < lanes; i++) {
+      emulators.push_back(
+          std::make_unique<Emulator>(cart, EmulatorOptions()));
+      if (i != 0 && stagger != 0) {
+        emulators.back()->RunCycles(stagger * i);
+      }
+      pointers.push_back(emulators.back().get());
+    }
+    batch = std::make_unique<BatchCpu>(pointers);
+  }
+
+  void RunFrames(size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+      batch->RunCycles(kCyclesPerFrame);
+    }
+  }
+
+  std::vector<std::unique_ptr<Emulator>> emulators;
+  std::unique_ptr<BatchCpu> batch;
+};
+
+uint64_t ReferenceHash(const Cartridge& cart, size_t frames) {
+  Emulator emulator(cart, EmulatorOptions());
+  for (size_t i = 0; i < frames; i++) {
+    emulator.RunFrame();
+  }
+  return FrameHash(&emulator);
+}
+
+TEST_CASE("Lanes in lockstep compute what the CPU does", "[batch_cpu]") {
+  const Cartridge cart = MakeBankedCartridge();
+  const uint64_t expected = ReferenceHash(cart, 10);
+
+  TestBatch test(cart, BatchCpu::kMaxLanes, 0);
+  test.RunFrames(10);
+  for (const auto& emulator : test.emulators) {
+    CHECK(FrameHash(emulator.get()) == expected);
+  }
+  // Only the few instructions before the bank switch and the copy into
+  // video RAM leave lockstep.
+  const BatchCpu& batch = *test.batch;
+  INFO("lockstep " << batch.lockstep_steps() << ", scalar "
+                   << batch.scalar_steps());
+  CHECK(batch.lockstep_steps() * BatchCpu::kMaxLanes >
+        20 * batch.scalar_steps());
+}
+
+TEST_CASE("Lanes out of step compute what the CPU does", "[batch_cpu]") {
+  const Cartridge cart = MakeBankedCartridge();
+  const uint64_t expected = ReferenceHash(cart, 10);
+
+  TestBatch test(cart, 7, 1000);
+  test.RunFrames(10);
+  for (const auto& emulator : test.emulators) {
+    CHECK(FrameHash(emulator.get()) == expected);
+  }
+}
+
+// Run with "[.benchmark]" to compare a batch with running the same
+// emulators one after another.
+TEST_CASE("Batch throughput", "[.benchmark][batch_cpu]") {
+  constexpr size_t kLanes = BatchCpu::kMaxLanes;
+  constexpr size_t kFrames = 600;
+  const Cartridge cart = MakeBankedCartridge();
+  using Clock = std::chrono::steady_clock;
+
+  TestBatch scalar(cart, kLanes, 0);
+  const Clock::time_point scalar_start = Clock::now();
+  for (const auto& emulator : scalar.emulators) {
+    for (size_t i = 0; i < kFrames; i++) {
+      emulator->RunCycles(kCyclesPerFrame);
+    }
+  }
+  const std::chrono::duration<double> scalar_time =
+      Clock::now() - scalar_start;
+
+  TestBatch batched(cart, kLanes, 0);
+  const Clock::time_point batch_start = Clock::now();
+  batched.RunFrames(kFrames);
+  const std::chrono::duration<double> batch_time = Clock::now() - batch_start;
+
+  const BatchCpu& batch = *batched.batch;
+  WARN(kLanes << " lanes for " << kFrames << " frames: one at a time "
+              << scalar_time.count() << " s, batched " << batch_time.count()
+              << " s; " << batch.lockstep_steps() << " lockstep and "
+              << batch.scalar_steps() << " scalar steps");
+}
+
+}  // namespace
+}  // namespace gamebun
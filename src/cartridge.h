@@ -9,8 +9,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <istream>
+#include <memory>
 #include <string_view>
-#include <vector>
 
 namespace gamebun {
 
@@ -37,11 +37,17 @@ struct CartridgeHeader {
   uint16_t global_checksum;
 };
 
+// Returns whether the `size` bytes at `rom` hold a cartridge Cartridge
+// loads: one of a known type and sizes, and no shorter than its header says.
+// Loading anything else is fatal.
+bool IsValidCartridge(const uint8_t* rom, size_t size);
+
 struct Cartridge {
   explicit Cartridge(std::istream* program);
 
   CartridgeHeader header;
-  std::vector<std::array<uint8_t, kRomBankSize.value()>> rom_banks;
+  // Shared by every emulator of the cartridge, since it is never written.
+  std::shared_ptr<const RomBanks> rom_banks;
 };
 
 }  // namespace gamebun
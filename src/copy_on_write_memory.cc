@@ -0,0 +1,100 @@
+#include "copy_on_write_memory.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "arena.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+CopyOnWriteMemory::CopyOnWriteMemory(size_t size, Arena* arena)
+    : page_count_(size / kPageSize),
+      pages_(arena->Allocate<Page*>(page_count_)) {
+  if (size % kPageSize != 0) {
+    FATAL("Memory size %zu is not a multiple of the page size", size);
+  }
+  for (size_t i = 0; i < page_count_; i++) {
+    pages_[i] = Hold(ZeroPage());
+  }
+}
+
+CopyOnWriteMemory::~CopyOnWriteMemory() {
+  for (size_t i = 0; i < page_count_; i++) {
+    Drop(pages_[i]);
+  }
+}
+
+void CopyOnWriteMemory::ShareFrom(const CopyOnWriteMemory& other) {
+  if (other.page_count_ != page_count_) {
+    FATAL("Unable to share %zu pages of memory with %zu", other.page_count_,
+          page_count_);
+  }
+  for (size_t i = 0; i < page_count_; i++) {
+    Page* const page = Hold(other.pages_[i]);
+    Drop(pages_[i]);
+    pages_[i] = page;
+  }
+}
+
+size_t CopyOnWriteMemory::PrivatePageCount() const {
+  return std::count_if(pages_, pages_ + page_count_, [](const Page* page) {
+    return page->references.load(std::memory_order_relaxed) == 1;
+  });
+}
+
+void CopyOnWriteMemory::SaveState(StateWriter* writer) const {
+  for (size_t i = 0; i < page_count_; i++) {
+    writer->WriteBytes(pages_[i]->bytes.data(), kPageSize);
+  }
+}
+
+void CopyOnWriteMemory::LoadState(StateReader* reader) {
+  std::array<uint8_t, kPageSize> loaded;
+  for (size_t i = 0; i < page_count_; i++) {
+    Page*& page = pages_[i];
+    reader->ReadBytes(loaded.data(), kPageSize);
+    if (std::memcmp(loaded.data(), ZeroPage()->bytes.data(), kPageSize) ==
+        0) {
+      Drop(page);
+      page = Hold(ZeroPage());
+      continue;
+    }
+    if (page->references.load(std::memory_order_acquire) != 1) {
+      Drop(page);
+      page = new Page;
+    }
+    page->bytes = loaded;
+  }
+}
+
+CopyOnWriteMemory::Page* CopyOnWriteMemory::Hold(Page* page) {
+  page->references.fetch_add(1, std::memory_order_relaxed);
+  return page;
+}
+
+void CopyOnWriteMemory::Drop(Page* page) {
+  if (page->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete page;
+  }
+}
+
+// It is never written or freed, since this reference keeps it shared.
+CopyOnWriteMemory::Page* CopyOnWriteMemory::ZeroPage() {
+  static Page* const page = new Page{};
+  return page;
+}
+
+void CopyOnWriteMemory::Unshare(Page** page) {
+  Page* const copy = new Page;
+  copy->bytes = (*page)->bytes;
+  Drop(*page);
+  *page = copy;
+}
+
+}  // namespace gamebun
@@ -0,0 +1,82 @@
+#ifndef COPY_ON_WRITE_MEMORY_H_
+#define COPY_ON_WRITE_MEMORY_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace gamebun {
+
+class Arena;
+class StateReader;
+class StateWriter;
+
+// RAM split into pages that copies of an emulator share until one of them
+// writes to a page, at which point the writer gets its own copy of it. Every
+// page starts out as a shared page of zeros, so memory is only committed for
+// pages that have been written.
+//
+// Pages are shared between threads through their reference counts alone:
+// a page is only written in place while nothing else holds it. Dropping a
+// reference releases the page and the writer's check of the count acquires
+// it, so whatever other copies did with the page happens before the write.
+class CopyOnWriteMemory {
+ public:
+  static constexpr size_t kPageSize = 1024;
+
+  // `size` must be a multiple of kPageSize. The table of pages is kept in
+  // `arena`, but the pages themselves are allocated on their own, since
+  // other copies may hold on to them.
+  CopyOnWriteMemory(size_t size, Arena* arena);
+  ~CopyOnWriteMemory();
+
+  size_t size() const { return page_count_ * kPageSize; }
+
+  uint8_t Read(size_t offset) const {
+    return pages_[offset / kPageSize]->bytes[offset % kPageSize];
+  }
+  void Write(size_t offset, uint8_t value) {
+    Page*& page = pages_[offset / kPageSize];
+    if (page->references.load(std::memory_order_acquire) != 1) {
+      Unshare(&page);
+    }
+    page->bytes[offset % kPageSize] = value;
+  }
+
+  // Makes this memory a copy of `other`, sharing all of its pages. `other`
+  // may not be written at the same time.
+  void ShareFrom(const CopyOnWriteMemory& other);
+
+  // Number of pages this memory holds that nothing else shares.
+  size_t PrivatePageCount() const;
+
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  CopyOnWriteMemory(const CopyOnWriteMemory&) = delete;
+  CopyOnWriteMemory& operator=(const CopyOnWriteMemory&) = delete;
+
+ private:
+  struct Page {
+    // Starts out held by its creator alone.
+    std::atomic<size_t> references{1};
+    std::array<uint8_t, kPageSize> bytes;
+  };
+
+  // Takes another reference to `page`, and returns it.
+  static Page* Hold(Page* page);
+  // Drops a reference to `page`, freeing it if it was the last.
+  static void Drop(Page* page);
+  // The page of zeros every memory starts out with.
+  static Page* ZeroPage();
+  // Replaces `page` with a copy only this memory holds.
+  static void Unshare(Page** page);
+
+  const size_t page_count_;
+  Page** const pages_;
+};
+
+}  // namespace gamebun
+
+#endif  // COPY_ON_WRITE_MEMORY_H_
@@ -15,27 +15,118 @@
 
 namespace gamebun {
 
-Cpu::Cpu(Memory* memory) : memory_(*memory) {}
+namespace {
+
+// The cycles a halted CPU waits before checking for interrupts again.
+constexpr size_t kHaltedCycles = 4;
+// The cycles taken to push PC and jump to an interrupt handler.
+constexpr size_t kServiceInterruptCycles = 20;
+// Handlers are 8 bytes apart from 0x40, in order of priority.
+constexpr uint16_t kFirstInterruptHandler = 0x40;
+
+}  // namespace
+
+Cpu::Cpu(Memory* memory, Interrupts* interrupts)
+    : memory_(*memory),
+      interrupts_(*interrupts),
+      interrupt_master_enable_(false),
+      enable_pending_(false),
+      halted_(false) {}
+
+size_t Cpu::Step() {
+  const uint8_t pending = interrupts_.Pending();
+  if (pending != 0) {
+    halted_ = false;
+    if (interrupt_master_enable_) {
+      return ServiceInterrupt(pending);
+    }
+  }
+  if (halted_) {
+    return kHaltedCycles;
+  }
+
+  const bool enabling = enable_pending_;
+  const uint8_t instruction_prefix = memory_.Read(Address(registers_.PC()));
+  const Instruction instruction = FetchInstruction(instruction_prefix);
+  const size_t cycles = GetInstructionCycles(instruction_prefix) +
+                        ExecuteInstruction(instruction);
+  // Unless the instruction was DI, the EI before it now takes effect.
+  if (enabling && enable_pending_) {
+    interrupt_master_enable_ = true;
+    enable_pending_ = false;
+  }
+  return cycles;
+}
 
-void Cpu::Step() {
-  const Instruction& instruction = FetchInstruction();
-  ExecuteInstruction(instruction);
+void Cpu::SaveState(StateWriter* writer) const {
+  registers_.SaveState(writer);
+  writer->Write(interrupt_master_enable_);
+  writer->Write(enable_pending_);
+  writer->Write(halted_);
 }
 
-Instruction Cpu::FetchInstruction() {
-  const uint8_t instruction_prefix = memory_.Read(Address(registers_.PC()));
-  const Instruction& instruction =
+void Cpu::LoadState(StateReader* reader) {
+  registers_.LoadState(reader);
+  reader->Read(&interrupt_master_enable_);
+  reader->Read(&enable_pending_);
+  reader->Read(&halted_);
+}
+
+size_t Cpu::ServiceInterrupt(uint8_t pending) {
+  size_t index = 0;
+  while (!(pending & (1 << index))) {
+    index++;
+  }
+  interrupt_master_enable_ = false;
+  enable_pending_ = false;
+  interrupts_.Acknowledge(static_cast<uint8_t>(1 << index));
+  Push(registers_.PC());
+  registers_.PC() = static_cast<uint16_t>(kFirstInterruptHandler + 8 * index);
+  return kServiceInterruptCycles;
+}
+
+Instruction Cpu::FetchInstruction(uint8_t instruction_prefix) {
+  const Address operands = Address(registers_.PC() + 1);
+  if (instruction_prefix == 0xCB) {
+    registers_.PC() += 2;
+    return GetCbInstructionPrefixInfo(memory_.Read(operands)).instruction;
+  }
+
+  Instruction instruction =
       GetInstructionPrefixInfo(instruction_prefix).instruction;
+  const size_t operand1_size = InstructionBytesConsumed(instruction.operand1);
+  ReadImmediate(operands, &instruction.operand1);
+  ReadImmediate(operands + operand1_size, &instruction.operand2);
 
   const size_t instruction_size =
-      InstructionBytesConsumed(instruction.operand1) +
-      InstructionBytesConsumed(instruction.operand2);
+      1 + operand1_size + InstructionBytesConsumed(instruction.operand2);
   registers_.PC() += instruction_size;
 
   return instruction;
 }
 
-void Cpu::ExecuteInstruction(const Instruction& instruction) {
+void Cpu::ReadImmediate(Address address, InstructionOperand* operand) const {
+  const auto read_byte_pair = [this, address]() {
+    return static_cast<uint16_t>(memory_.Read(address) |
+                                 memory_.Read(address + 1) << 8);
+  };
+  if (ByteOperand* byte = std::get_if<ByteOperand>(operand)) {
+    if (std::holds_alternative<ImmediateByte>(byte->value)) {
+      byte->value = ImmediateByte(memory_.Read(address));
+    } else if (std::holds_alternative<ImmediateByteAddress>(byte->value)) {
+      byte->value = ImmediateByteAddress(memory_.Read(address));
+    } else if (std::holds_alternative<ImmediateBytePairAddress>(
+                   byte->value)) {
+      byte->value = ImmediateBytePairAddress(read_byte_pair());
+    }
+  } else if (BytePairOperand* pair = std::get_if<BytePairOperand>(operand)) {
+    if (std::holds_alternative<ImmediateBytePair>(pair->value)) {
+      pair->value = ImmediateBytePair(read_byte_pair());
+    }
+  }
+}
+
+size_t Cpu::ExecuteInstruction(const Instruction& instruction) {
   switch (instruction.op) {
     case Opcode::LD: {
       if (std::holds_alternative<ByteOperand>(instruction.operand1) &&
@@ -54,6 +145,16 @@ void Cpu::ExecuteInstruction(const Instruction& instruction) {
         const BytePairOperand& operand2 =
             std::get<BytePairOperand>(instruction.operand2);
         SetBytePair(operand1, GetBytePair(operand2));
+      } else if (std::holds_alternative<ByteOperand>(instruction.operand1) &&
+                 std::holds_alternative<BytePairOperand>(
+                     instruction.operand2)) {
+        // LD (nn), SP stores both bytes, low first.
+        const Address address = Address(GetAddress(
+            std::get<ByteOperand>(instruction.operand1)));
+        const uint16_t value =
+            GetBytePair(std::get<BytePairOperand>(instruction.operand2));
+        memory_.Write(address, value & 0xFF);
+        memory_.Write(address + 1, value >> 8);
       } else {
         FATAL("Invalid operands for LD");
       }
@@ -116,29 +217,24 @@ void Cpu::ExecuteInstruction(const Instruction& instruction) {
 
       registers_.HL() =
           GetRegisterBytePair(std::get<RegisterBytePairIndex>(operand1.value));
-      AddBytePair(RegisterBytePairIndex::HL, GetByte(operand2));
+      AddBytePair(RegisterBytePairIndex::HL, GetSignedByte(operand2));
       break;
     }
     case Opcode::PUSH: {
       const BytePairOperand& operand =
           std::get<BytePairOperand>(instruction.operand1);
-      const uint16_t value = GetBytePair(operand);
-      const Address sp = Address(registers_.SP());
-
-      memory_.Write(sp, (value >> 8) & 0xFF);
-      memory_.Write(sp + 1, value & 0xFF);
-      registers_.SP() -= 2;
+      Push(GetBytePair(operand));
       break;
     }
     case Opcode::POP: {
       const BytePairOperand& operand =
           std::get<BytePairOperand>(instruction.operand1);
-      const Address sp = Address(registers_.SP());
-
-      const uint16_t value =
-          static_cast<uint16_t>((memory_.Read(sp) << 8) | memory_.Read(sp + 1));
-      SetBytePair(operand, value);
-      registers_.SP() += 2;
+      const uint16_t value = Pop();
+      // The low 4 bits of F always read as 0.
+      SetBytePair(operand, std::get<RegisterBytePairIndex>(operand.value) ==
+                                   RegisterBytePairIndex::AF
+                               ? value & 0xFFF0
+                               : value);
       break;
     }
     case Opcode::ADD: {
@@ -160,7 +256,7 @@ void Cpu::ExecuteInstruction(const Instruction& instruction) {
         } else if (std::holds_alternative<ByteOperand>(instruction.operand2)) {
           const ByteOperand& operand2 =
               std::get<ByteOperand>(instruction.operand2);
-          AddBytePair(operand1, GetByte(operand2));
+          AddBytePair(operand1, GetSignedByte(operand2));
         } else {
           FATAL("invalid operands for ADD");
         }
@@ -273,7 +369,7 @@ void Cpu::ExecuteInstruction(const Instruction& instruction) {
       registers_.F().subtract = false;
       registers_.F().half_carry = false;
       registers_.F().carry = false;
-      break;
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::DAA: {
       // TODO: implement DAA
@@ -306,88 +402,185 @@ void Cpu::ExecuteInstruction(const Instruction& instruction) {
     case Opcode::NOP:
       break;
     case Opcode::HALT:
-      // TODO: implement HALT
+      // With IME clear and an interrupt already pending, the hardware fails
+      // to advance PC past the next byte. That is not emulated; the CPU
+      // simply carries on.
+      halted_ = true;
       break;
     case Opcode::STOP:
       // TODO: implement STOP
       break;
     case Opcode::DI:
-      // TODO: implement DI
+      interrupt_master_enable_ = false;
+      enable_pending_ = false;
       break;
     case Opcode::EI:
-      // TODO: implement EI
+      if (!interrupt_master_enable_) {
+        enable_pending_ = true;
+      }
       break;
     case Opcode::RLCA: {
       RotateByteLeft(RegisterByteIndex::A, /*through_carry=*/false);
+      registers_.F().zero = false;
       break;
     }
     case Opcode::RLA: {
       RotateByteLeft(RegisterByteIndex::A, /*through_carry=*/true);
+      registers_.F().zero = false;
       break;
     }
     case Opcode::RRCA: {
       RotateByteRight(RegisterByteIndex::A, /*through_carry=*/false);
+      registers_.F().zero = false;
       break;
     }
     case Opcode::RRA: {
       RotateByteRight(RegisterByteIndex::A, /*through_carry=*/true);
+      registers_.F().zero = false;
       break;
     }
     case Opcode::RLC: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      RotateByteLeft(std::get<RegisterByteIndex>(operand.value),
-                     /*through_carry=*/false);
-      break;
+      RotateByteLeft(operand, /*through_carry=*/false);
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::RL: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      RotateByteLeft(std::get<RegisterByteIndex>(operand.value),
-                     /*through_carry=*/true);
-      break;
+      RotateByteLeft(operand, /*through_carry=*/true);
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::RRC: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      RotateByteRight(std::get<RegisterByteIndex>(operand.value),
-                      /*through_carry=*/false);
-      break;
+      RotateByteRight(operand, /*through_carry=*/false);
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::RR: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      RotateByteRight(std::get<RegisterByteIndex>(operand.value),
-                      /*through_carry=*/true);
-      break;
+      RotateByteRight(operand, /*through_carry=*/true);
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::SLA: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      ShiftByteLeft(std::get<RegisterByteIndex>(operand.value));
-      break;
+      ShiftByteLeft(operand);
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::SRA: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      ShiftByteRight(std::get<RegisterByteIndex>(operand.value),
-                     /*arithmetic_shift=*/true);
-      break;
+      ShiftByteRight(operand, /*arithmetic_shift=*/true);
+      return MemoryOperandCycles(operand, 8);
     }
     case Opcode::SRL: {
       const ByteOperand& operand = std::get<ByteOperand>(instruction.operand1);
-      ShiftByteRight(std::get<RegisterByteIndex>(operand.value),
-                     /*arithmetic_shift=*/false);
-      break;
+      ShiftByteRight(operand, /*arithmetic_shift=*/false);
+      return MemoryOperandCycles(operand, 8);
+    }
+    case Opcode::BIT: {
+      const uint8_t bit = std::get<BitIndex>(instruction.operand1).value();
+      const ByteOperand& operand = std::get<ByteOperand>(instruction.operand2);
+      registers_.F().zero = (GetByte(operand) >> bit & 0x1) == 0;
+      registers_.F().subtract = false;
+      registers_.F().half_carry = true;
+      // BIT only reads (HL), so it takes less time than the rest.
+      return MemoryOperandCycles(operand, 4);
     }
-    case Opcode::BIT:
     case Opcode::SET:
-    case Opcode::RES:
-    case Opcode::JP:
-    case Opcode::JR:
-    case Opcode::CALL:
-    case Opcode::RST:
-    case Opcode::RET:
+    case Opcode::RES: {
+      const uint8_t mask = static_cast<uint8_t>(
+          1 << std::get<BitIndex>(instruction.operand1).value());
+      const ByteOperand& operand = std::get<ByteOperand>(instruction.operand2);
+      const uint8_t val = GetByte(operand);
+      SetByte(operand, instruction.op == Opcode::SET
+                           ? val | mask
+                           : val & static_cast<uint8_t>(~mask));
+      return MemoryOperandCycles(operand, 8);
+    }
+    case Opcode::JP: {
+      const bool conditional =
+          std::holds_alternative<BitOperand>(instruction.operand1);
+      const ByteOperand& target = std::get<ByteOperand>(
+          conditional ? instruction.operand2 : instruction.operand1);
+      if (!BranchTaken(instruction.operand1)) {
+        break;
+      }
+      registers_.PC() = GetAddress(target);
+      return conditional ? 4 : 0;
+    }
+    case Opcode::JR: {
+      const bool conditional =
+          std::holds_alternative<BitOperand>(instruction.operand1);
+      const ByteOperand& offset = std::get<ByteOperand>(
+          conditional ? instruction.operand2 : instruction.operand1);
+      if (!BranchTaken(instruction.operand1)) {
+        break;
+      }
+      registers_.PC() += GetSignedByte(offset);
+      return conditional ? 4 : 0;
+    }
+    case Opcode::CALL: {
+      const bool conditional =
+          std::holds_alternative<BitOperand>(instruction.operand1);
+      const ByteOperand& target = std::get<ByteOperand>(
+          conditional ? instruction.operand2 : instruction.operand1);
+      if (!BranchTaken(instruction.operand1)) {
+        break;
+      }
+      Push(registers_.PC());
+      registers_.PC() = GetAddress(target);
+      return conditional ? 12 : 0;
+    }
+    case Opcode::RST: {
+      const ByteOperand& target = std::get<ByteOperand>(instruction.operand1);
+      Push(registers_.PC());
+      registers_.PC() = std::get<Address>(target.value).value();
+      break;
+    }
+    case Opcode::RET: {
+      const bool conditional =
+          std::holds_alternative<BitOperand>(instruction.operand1);
+      if (!BranchTaken(instruction.operand1)) {
+        break;
+      }
+      registers_.PC() = Pop();
+      return conditional ? 12 : 0;
+    }
     case Opcode::RETI:
-      // TODO: Implement the rest of the GB instructions
-      FATAL("Opcode is not implemented");
+      // Unlike EI, this enables interrupts at once.
+      interrupt_master_enable_ = true;
+      enable_pending_ = false;
+      registers_.PC() = Pop();
+      break;
     default:
       FATAL("Invalid opcode");
   }
+  return 0;
+}
+
+size_t Cpu::MemoryOperandCycles(const ByteOperand& operand, size_t cycles) {
+  return std::holds_alternative<AddressIndex>(operand.value) ? cycles : 0;
+}
+
+void Cpu::Push(uint16_t value) {
+  registers_.SP() -= 2;
+  const Address sp = Address(registers_.SP());
+  memory_.Write(sp, value & 0xFF);
+  memory_.Write(sp + 1, value >> 8);
+}
+
+uint16_t Cpu::Pop() {
+  const Address sp = Address(registers_.SP());
+  registers_.SP() += 2;
+  return static_cast<uint16_t>(memory_.Read(sp) | memory_.Read(sp + 1) << 8);
+}
+
+uint16_t Cpu::GetAddress(const ByteOperand& operand) const {
+  if (std::holds_alternative<ImmediateBytePairAddress>(operand.value)) {
+    return std::get<ImmediateBytePairAddress>(operand.value).value();
+  }
+  return GetRegisterBytePair(std::get<AddressIndex>(operand.value).idx);
+}
+
+uint16_t Cpu::GetSignedByte(const ByteOperand& operand) const {
+  return static_cast<uint16_t>(static_cast<int8_t>(GetByte(operand)));
 }
 
 void Cpu::AddByte(const ByteOperand dest, const uint8_t src, bool carry) {
@@ -437,16 +630,15 @@ void Cpu::SubByte(const ByteOperand dest, const uint8_t src, bool carry) {
   SetByte(dest, static_cast<uint8_t>(total));
   registers_.F().zero = static_cast<uint8_t>(total) == 0;
   registers_.F().subtract = true;
-  registers_.F().half_carry = static_cast<int16_t>(destVal & 0xF) -
-                                  static_cast<int16_t>(src & 0xF) - carry <
-                              0;
+  registers_.F().half_carry = (destVal & 0xF) < (src & 0xF) + carryVal;
   registers_.F().carry = total < 0;
 }
 
 void Cpu::RotateByteLeft(const ByteOperand dest, bool through_carry) {
   const uint8_t val = GetByte(dest);
-  const uint8_t carry =
-      static_cast<uint8_t>(through_carry && registers_.F().carry);
+  const uint8_t carry = through_carry
+                            ? static_cast<uint8_t>(registers_.F().carry)
+                            : static_cast<uint8_t>(val >> 7);
 
   SetByte(dest, static_cast<uint8_t>(val << 1) | carry);
   registers_.F().zero = GetByte(dest) == 0;
@@ -458,7 +650,8 @@ void Cpu::RotateByteLeft(const ByteOperand dest, bool through_carry) {
 void Cpu::RotateByteRight(const ByteOperand dest, bool through_carry) {
   const uint8_t val = GetByte(dest);
   const uint8_t carry =
-      static_cast<uint8_t>((through_carry && registers_.F().carry) << 7);
+      through_carry ? static_cast<uint8_t>(registers_.F().carry << 7)
+                    : static_cast<uint8_t>(val << 7);
 
   SetByte(dest, static_cast<uint8_t>(val >> 1) | carry);
   registers_.F().zero = GetByte(dest) == 0;
@@ -479,7 +672,7 @@ void Cpu::ShiftByteLeft(const ByteOperand dest) {
 
 void Cpu::ShiftByteRight(const ByteOperand dest, bool arithmetic_shift) {
   const uint8_t val = GetByte(dest);
-  const uint8_t new_msb = arithmetic_shift ? val & 0x8 : 0;
+  const uint8_t new_msb = arithmetic_shift ? val & 0x80 : 0;
 
   SetByte(dest, static_cast<uint8_t>(val >> 1) | new_msb);
   registers_.F().zero = GetByte(dest) == 0;
@@ -572,7 +765,7 @@ void Cpu::SetRegisterBytePair(RegisterBytePairIndex idx, uint16_t value) {
 
 uint8_t Cpu::GetByte(const ByteOperand& operand) const {
   return std::visit(
-      [*this](auto&& arg) {
+      [this](auto&& arg) {
         using T = std::decay_t<decltype(arg)>;
         if constexpr (std::is_same_v<T, RegisterByteIndex>) {
           return GetRegisterByte(arg);
@@ -580,17 +773,11 @@ uint8_t Cpu::GetByte(const ByteOperand& operand) const {
           return memory_.Read(arg);
         } else if constexpr (std::is_same_v<T, AddressIndex>) {
           return memory_.Read(Address(GetRegisterBytePair(arg.idx)));
-        } else if constexpr (std::is_same_v<T, ImmediateByte>) {
-          return memory_.Read(Address(registers_.PC() + 1));
-        } else if constexpr (std::is_same_v<T, ImmediateByteAddress>) {
-          const Address address =
-              Address(memory_.Read(Address(registers_.PC() + 1)));
-          return memory_.Read(address);
+        } else if constexpr (std::is_same_v<T, ImmediateByte> ||
+                             std::is_same_v<T, ImmediateByteAddress>) {
+          return arg.value();
         } else if constexpr (std::is_same_v<T, ImmediateBytePairAddress>) {
-          const Address pc = Address(registers_.PC());
-          const Address address = Address(static_cast<uint16_t>(
-              (memory_.Read(pc + 1) << 8) | memory_.Read(pc + 2)));
-          return memory_.Read(address);
+          return memory_.Read(Address(arg.value()));
         }
       },
       operand.value);
@@ -606,17 +793,11 @@ void Cpu::SetByte(const ByteOperand& operand, uint8_t value) {
           memory_.Write(arg, value);
         } else if constexpr (std::is_same_v<T, AddressIndex>) {
           memory_.Write(Address(GetRegisterBytePair(arg.idx)), value);
-        } else if constexpr (std::is_same_v<T, ImmediateByte>) {
+        } else if constexpr (std::is_same_v<T, ImmediateByte> ||
+                             std::is_same_v<T, ImmediateByteAddress>) {
           FATAL("Attempted to set the value of an immediate byte operand");
-        } else if constexpr (std::is_same_v<T, ImmediateByteAddress>) {
-          const Address address =
-              Address(memory_.Read(Address(registers_.PC() + 1)));
-          memory_.Write(address, value);
-        } else if constexpr (std::is_same_v<T, ImmediateByte>) {
-          const Address pc = Address(registers_.PC());
-          const Address address = Address(static_cast<uint16_t>(
-              (memory_.Read(pc + 1) << 8) | memory_.Read(pc + 2)));
-          memory_.Write(address, value);
+        } else if constexpr (std::is_same_v<T, ImmediateBytePairAddress>) {
+          memory_.Write(Address(arg.value()), value);
         }
       },
       operand.value);
@@ -624,14 +805,12 @@ void Cpu::SetByte(const ByteOperand& operand, uint8_t value) {
 
 uint16_t Cpu::GetBytePair(const BytePairOperand& operand) const {
   return std::visit(
-      [*this](auto&& arg) {
+      [this](auto&& arg) {
         using T = std::decay_t<decltype(arg)>;
         if constexpr (std::is_same_v<T, RegisterBytePairIndex>) {
           return GetRegisterBytePair(arg);
         } else if constexpr (std::is_same_v<T, ImmediateBytePair>) {
-          const Address pc = Address(registers_.PC());
-          return static_cast<uint16_t>((memory_.Read(pc + 1) << 8) |
-                                       memory_.Read(pc + 2));
+          return arg.value();
         }
       },
       operand.value);
@@ -648,7 +827,7 @@ void Cpu::SetBytePair(const BytePairOperand& operand, uint16_t value) {
         }
       },
       operand.value);
-}  // namespace gamebun
+}
 
 bool Cpu::GetBit(const BitOperand& operand) const {
   switch (operand.value) {
@@ -664,4 +843,9 @@ bool Cpu::GetBit(const BitOperand& operand) const {
   FATAL("Unknown flag index %x", static_cast<uint8_t>(operand.value));
 }
 
+bool Cpu::BranchTaken(const InstructionOperand& condition) const {
+  return !std::holds_alternative<BitOperand>(condition) ||
+         GetBit(std::get<BitOperand>(condition));
+}
+
 }  // namespace gamebun
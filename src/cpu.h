@@ -1,27 +1,56 @@
 #ifndef CPU_H_
 #define CPU_H_
 
+#include <cstddef>
 #include <cstdint>
 
 #include "instruction.h"
 #include "instruction_operand.h"
+#include "interrupts.h"
 #include "memory.h"
 #include "registers.h"
+#include "state.h"
 
 namespace gamebun {
 
 class Cpu {
  public:
-  Cpu(Memory* memory);
+  Cpu(Memory* memory, Interrupts* interrupts);
 
-  void Step();
+  // Executes a single instruction, or services an interrupt, or waits for
+  // one while halted, and returns the number of clock cycles that took.
+  size_t Step();
+
+  Registers& registers() { return registers_; }
+
+  // Whether an interrupt may be serviced before the CPU next executes DI,
+  // or is halted waiting for one. Neither is the case from power on.
+  bool InterruptsLive() const {
+    return interrupt_master_enable_ || enable_pending_ || halted_;
+  }
+
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
 
   Cpu(const Cpu&) = delete;
   Cpu& operator=(const Cpu&) = delete;
 
  private:
-  Instruction FetchInstruction();
-  void ExecuteInstruction(const Instruction& instruction);
+  // Decodes the instruction at PC, filling in its immediate operands, and
+  // moves PC past it.
+  Instruction FetchInstruction(uint8_t instruction_prefix);
+  void ReadImmediate(Address address, InstructionOperand* operand) const;
+  // Returns the clock cycles the instruction took beyond those listed for it
+  // in kInstructionCycles, which is the case for taken conditional branches
+  // and for CB-prefixed instructions on (HL).
+  size_t ExecuteInstruction(const Instruction& instruction);
+
+  // The extra cycles a CB-prefixed instruction takes on (HL), or 0 if
+  // `operand` is a register.
+  static size_t MemoryOperandCycles(const ByteOperand& operand, size_t cycles);
+
+  void Push(uint16_t value);
+  uint16_t Pop();
 
   void AddByte(const ByteOperand dest, const uint8_t src, bool carry);
   void AddBytePair(const BytePairOperand dest, const uint16_t src);
@@ -42,12 +71,30 @@ class Cpu {
   void SetByte(const ByteOperand& operand, uint8_t value);
 
   uint16_t GetBytePair(const BytePairOperand& operand) const;
+  // The address an immediate address or (rr) operand refers to.
+  uint16_t GetAddress(const ByteOperand& operand) const;
+  // A byte operand sign-extended to 16 bits, for relative jumps and SP
+  // offsets.
+  uint16_t GetSignedByte(const ByteOperand& operand) const;
   void SetBytePair(const BytePairOperand& operand, uint16_t value);
 
   bool GetBit(const BitOperand& operand) const;
+  // Whether a branch whose first operand is `condition` is taken. Branches
+  // without a condition always are.
+  bool BranchTaken(const InstructionOperand& condition) const;
+
+  // Pushes PC and jumps to the handler of the highest priority interrupt
+  // of `pending`, returning the cycles that takes.
+  size_t ServiceInterrupt(uint8_t pending);
 
   Memory& memory_;
+  Interrupts& interrupts_;
   Registers registers_;
+  // IME, which gates the servicing of interrupts.
+  bool interrupt_master_enable_;
+  // EI sets IME only after the instruction that follows it.
+  bool enable_pending_;
+  bool halted_;
 };
 
 }  // namespace gamebun
@@ -0,0 +1,140 @@
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cartridge.h"
+#include "emulator.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Runs `count` instructions one at a time, returning the cycles each took.
+std::vector<uint64_t> RunInstructions(Emulator* emulator, size_t count) {
+  std::vector<uint64_t> cycles;
+  for (size_t i = 0; i < count; i++) {
+    cycles.push_back(emulator->RunCycles(1).cycles);
+  }
+  return cycles;
+}
+
+std::vector<uint64_t> RunInstructions(const std::vector<uint8_t>& program,
+                                      size_t count) {
+  const Cartridge cart = MakeTestCartridge(program);
+  Emulator emulator(cart, EmulatorOptions());
+  return RunInstructions(&emulator, count);
+}
+
+// Returns a cartridge running `program` whose interrupt handlers at 0x40 and
+// 0x50 are a lone RETI.
+Cartridge MakeInterruptCartridge(const std::vector<uint8_t>& program) {
+  std::vector<uint8_t> rom = MakeTestRom(program);
+  rom[0x40] = 0xD9;
+  rom[0x50] = 0xD9;
+  return LoadTestCartridge(rom);
+}
+
+TEST_CASE("Conditional branches take longer when taken", "[cpu]") {
+  std::vector<uint8_t> program = {
+      0x3E, 0x0A,        // 0x100: LD A, 0x0A
+      0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A, enabling cartridge RAM
+      0x31, 0x00, 0xB0,  // 0x105: LD SP, 0xB000
+      0xAF,              // 0x108: XOR A, setting Z
+      0x20, 0x05,        // 0x109: JR NZ, +5
+      0x28, 0x00,        // 0x10B: JR Z, +0
+      0xC2, 0x00, 0x00,  // 0x10D: JP NZ, 0x0000
+      0xCA, 0x14, 0x01,  // 0x110: JP Z, 0x0114
+      0x00,              // 0x113: NOP, jumped over
+      0xCC, 0x50, 0x01,  // 0x114: CALL Z, 0x0150
+      0xC4, 0x50, 0x01,  // 0x117: CALL NZ, 0x0150
+      0x18, 0xFE,        // 0x11A: JR -2
+  };
+  program.resize(0x50);
+  program.push_back(0xC0);  // 0x150: RET NZ
+  program.push_back(0xC8);  // 0x151: RET Z
+
+  const std::vector<uint64_t> expected = {
+      8, 16, 12, 4, 8, 12, 12, 16, 24, 8, 20, 12, 12, 12,
+  };
+  CHECK(RunInstructions(program, expected.size()) == expected);
+}
+
+TEST_CASE("CB-prefixed instructions take longer on (HL)", "[cpu]") {
+  const std::vector<uint8_t> program = {
+      0x3E, 0x0A,        // LD A, 0x0A
+      0xEA, 0x00, 0x00,  // LD (0x0000), A, enabling cartridge RAM
+      0x21, 0x00, 0xA0,  // LD HL, 0xA000
+      0xCB, 0xDE,        // SET 3, (HL)
+      0xCB, 0x5E,        // BIT 3, (HL)
+      0x20, 0x00,        // JR NZ, +0, taken since the bit is set
+      0xCB, 0x9E,        // RES 3, (HL)
+      0xCB, 0x5E,        // BIT 3, (HL)
+      0x20, 0x00,        // JR NZ, +0, no longer taken
+      0xCB, 0x06,        // RLC (HL)
+      0xCB, 0x37,        // SWAP A
+      0xCB, 0x47,        // BIT 0, A
+  };
+  const std::vector<uint64_t> expected = {
+      8, 16, 12, 16, 12, 12, 16, 12, 8, 16, 8, 8,
+  };
+  CHECK(RunInstructions(program, expected.size()) == expected);
+}
+
+TEST_CASE("Interrupts are serviced in priority order once EI takes effect",
+          "[cpu]") {
+  const Cartridge cart = MakeInterruptCartridge({
+      0x3E, 0x0A,        // 0x100: LD A, 0x0A
+      0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A, enabling cartridge RAM
+      0x31, 0x00, 0xB0,  // 0x105: LD SP, 0xB000
+      0x3E, 0x05,        // 0x108: LD A, 0x05
+      0xE0, 0xFF,        // 0x10A: LDH (0xFF), A, enabling VBlank and timer
+      0xE0, 0x0F,        // 0x10C: LDH (0x0F), A, requesting both
+      0x00,              // 0x10E: NOP, with IME still clear
+      0xFB,              // 0x10F: EI
+      0x00,              // 0x110: NOP, before which EI has no effect
+      0xF3,              // 0x111: DI
+      0x18, 0xFE,        // 0x112: JR -2
+  });
+  Emulator emulator(cart, EmulatorOptions());
+  const std::vector<uint64_t> expected = {
+      8, 16, 12, 8, 12, 12, 4, 4, 4,
+      20, 16,  // VBlank, to 0x40, and its RETI
+      20, 16,  // the timer, to 0x50, and its RETI
+      4, 12, 12,
+  };
+  CHECK(RunInstructions(&emulator, expected.size()) == expected);
+}
+
+TEST_CASE("HALT waits for an interrupt", "[cpu]") {
+  const Cartridge cart = MakeInterruptCartridge({
+      0x3E, 0x0A,        // 0x100: LD A, 0x0A
+      0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A, enabling cartridge RAM
+      0x31, 0x00, 0xB0,  // 0x105: LD SP, 0xB000
+      0x3E, 0x01,        // 0x108: LD A, 0x01
+      0xE0, 0xFF,        // 0x10A: LDH (0xFF), A, enabling VBlank
+      0xFB,              // 0x10C: EI
+      0x76,              // 0x10D: HALT
+      0xF3,              // 0x10E: DI
+      0x76,              // 0x10F: HALT
+      0x18, 0xFE,        // 0x110: JR -2
+  });
+  Emulator emulator(cart, EmulatorOptions());
+  CHECK(RunInstructions(&emulator, 7) ==
+        std::vector<uint64_t>{8, 16, 12, 8, 12, 4, 4});
+  // Halted until the LCD reaches VBlank, most of a frame later.
+  CHECK(RunInstructions(&emulator, 3) == std::vector<uint64_t>{4, 4, 4});
+  const RunResult first = emulator.RunUntil(kVBlankEvent);
+  CHECK(first.events == kVBlankEvent);
+  CHECK(first.cycles > 60000);
+  // Woken with IME set, so VBlank is serviced, and then with it clear, so
+  // the CPU just carries on after HALT.
+  CHECK(RunInstructions(&emulator, 4) == std::vector<uint64_t>{20, 16, 4, 4});
+  CHECK(RunInstructions(&emulator, 3) == std::vector<uint64_t>{4, 4, 4});
+  CHECK(emulator.RunUntil(kVBlankEvent).cycles > 60000);
+  CHECK(RunInstructions(&emulator, 2) == std::vector<uint64_t>{12, 12});
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -1,19 +1,345 @@
 #include "emulator.h"
 
 #include "cartridge.h"
+#include "frame_hash.h"
+#include "joypad.h"
+#include "lz_codec.h"
+#include "state.h"
+#include "util/logging.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace gamebun {
 
-Emulator::Emulator(const Cartridge& cart)
-    : memory_(cart.rom_banks, cart.header.ram_bank_num,
-              cart.header.hardware.controller_type),
-      cpu_(&memory_) {}
+namespace {
+
+// Emulated time between pushes into an attached audio stream, about 4 ms,
+// which bounds how low the stream's latency can usefully be set.
+constexpr size_t kAudioPushCycles = 16384;
+
+// Address space reserved for an emulator's arena while it is constructed,
+// far more than any options need. The rest is released right after.
+constexpr size_t kArenaReservation = 256 << 20;
+
+// "GBST" in little-endian byte order, at the start of every saved state.
+constexpr uint32_t kStateMagic = 0x54534247;
+// Changes whenever the layout of any section does.
+constexpr uint16_t kStateVersion = 2;
+
+// Input events queued ahead are the only part of the state whose size
+// varies. Room is kept for this many of them.
+constexpr size_t kMaxSavedInputEvents = 2 * JoypadQueue::kCapacity;
+
+enum class StateSection : uint16_t {
+  kInterrupts = 1,
+  kPpu,
+  kApu,
+  kJoypad,
+  kSerial,
+  kMemory,
+  kCpu,
+  kCartridgeRam,
+};
+
+// The sections of a saved state, in order.
+constexpr StateSection kStateSections[] = {
+    StateSection::kInterrupts, StateSection::kPpu,    StateSection::kApu,
+    StateSection::kJoypad,     StateSection::kSerial, StateSection::kMemory,
+    StateSection::kCpu,        StateSection::kCartridgeRam,
+};
+
+template <typename Component>
+void SaveSection(StateSection section, Component* component,
+                 StateWriter* writer) {
+  const size_t start = writer->BeginSection(static_cast<uint16_t>(section));
+  component->SaveState(writer);
+  writer->EndSection(start);
+}
+
+// Sections are only loaded once the framing of the whole state has been
+// checked, so one that reads differently from how it was written is a bug.
+template <typename Component>
+void LoadSection(StateSection section, Component* component,
+                 StateReader* reader) {
+  size_t end;
+  reader->BeginSection(static_cast<uint16_t>(section), &end);
+  component->LoadState(reader);
+  if (!reader->EndSection(end)) {
+    FATAL("State section %d does not match its length",
+          static_cast<int>(section));
+  }
+}
+
+}  // namespace
+
+Emulator::Emulator(const Cartridge& cart, const EmulatorOptions& options)
+    : Emulator(cart.rom_banks, cart.header, options) {}
+
+Emulator::Emulator(std::shared_ptr<const RomBanks> rom_banks,
+                   const CartridgeHeader& header,
+                   const EmulatorOptions& options)
+    : header_(header),
+      options_(options),
+      arena_(kArenaReservation, options.huge_pages),
+      frame_buffers_(options.pixel_format, options.frame_buffers, &arena_),
+      ppu_(&interrupts_, &frame_buffers_, options.render_mode,
+           {header.color_gb, options.pixel_format, options.color_correction},
+           &arena_),
+      apu_(options.audio, &arena_),
+      joypad_(&interrupts_),
+      serial_(&interrupts_),
+      memory_(std::move(rom_banks), header.ram_bank_num,
+              header.hardware.controller_type, &ppu_, &apu_, &joypad_,
+              &serial_, &interrupts_, &arena_),
+      cpu_(&memory_, &interrupts_),
+      state_buffer_(nullptr),
+      state_buffer_size_(0) {
+  StateWriter measure(nullptr, 0);
+  WriteState(&measure);
+  WriteRamState(&measure);
+  state_buffer_size_ =
+      measure.size() + kMaxSavedInputEvents * sizeof(JoypadEvent);
+  state_buffer_ = arena_.Allocate<uint8_t>(state_buffer_size_);
+  arena_.Trim();
+}
+
+std::unique_ptr<Emulator> Emulator::Clone() {
+  EmulatorOptions options = options_;
+  options.frame_buffers.memory = {};
+  options.audio.mode = apu_.mode();
+  std::unique_ptr<Emulator> clone(
+      new Emulator(memory_.rom_banks(), header_, options));
+
+  StateWriter measure(nullptr, 0);
+  WriteState(&measure);
+  std::vector<uint8_t> state(measure.size());
+  StateWriter writer(state.data(), state.size());
+  WriteState(&writer);
+  StateReader reader(state.data(), state.size());
+  clone->ReadState(&reader);
+  clone->memory_.ShareRamFrom(memory_);
+  return clone;
+}
+
+size_t Emulator::SaveState(void* buffer, size_t capacity) {
+  StateWriter raw(state_buffer_, state_buffer_size_);
+  WriteState(&raw);
+  WriteRamState(&raw);
+
+  size_t size = 0;
+  StateWriter measure(nullptr, 0);
+  WriteStateHeader(&measure, 0, 0, 0);
+  const size_t header_size = measure.size();
+  if (!raw.overflowed() && capacity > header_size) {
+    uint8_t* const out = static_cast<uint8_t*>(buffer);
+    const size_t compressed_size =
+        LzCompress(state_buffer_, raw.size(), &out[header_size],
+                   capacity - header_size);
+    if (compressed_size != 0) {
+      StateWriter header(out, header_size);
+      WriteStateHeader(&header, static_cast<uint32_t>(raw.size()),
+                       static_cast<uint32_t>(compressed_size),
+                       HashFrame(state_buffer_, raw.size(), raw.size(), 1));
+      size = header_size + compressed_size;
+    }
+  }
+  arena_.Discard(state_buffer_, state_buffer_size_);
+  return size;
+}
+
+size_t Emulator::MaxSaveStateSize() const {
+  StateWriter header(nullptr, 0);
+  WriteStateHeader(&header, 0, 0, 0);
+  return header.size() + LzMaxCompressedSize(state_buffer_size_);
+}
+
+bool Emulator::LoadState(const void* data, size_t size) {
+  const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+  StateReader header(bytes, size);
+  uint32_t raw_size;
+  uint32_t compressed_size;
+  uint64_t checksum;
+  if (!ReadStateHeader(&header, &raw_size, &compressed_size, &checksum) ||
+      compressed_size != header.remaining() ||
+      raw_size > state_buffer_size_) {
+    return false;
+  }
+
+  bool valid = LzDecompress(&bytes[size - compressed_size], compressed_size,
+                            state_buffer_, raw_size) &&
+               HashFrame(state_buffer_, raw_size, raw_size, 1) == checksum;
+  if (valid) {
+    StateReader framing(state_buffer_, raw_size);
+    for (const StateSection section : kStateSections) {
+      framing.SkipSection(static_cast<uint16_t>(section));
+    }
+    valid = !framing.failed() && framing.remaining() == 0;
+  }
+  if (valid) {
+    StateReader reader(state_buffer_, raw_size);
+    ReadState(&reader);
+    ReadRamState(&reader);
+  }
+  arena_.Discard(state_buffer_, state_buffer_size_);
+  return valid;
+}
 
 bool Emulator::Run() {
   while (true) {
-    cpu_.Step();
+    Step();
   }
   return true;
 }
 
+RunResult Emulator::RunFrame() {
+  const RunResult result = RunUntil(kFrameEvent);
+  apu_.FlushSamples();
+  if (audio_stream_ != nullptr) {
+    PushAudio();
+    audio_cycles_ = 0;
+  }
+  return result;
+}
+
+Frame Emulator::AcquireFrame() {
+  ppu_.FlushFrames();
+  return frame_buffers_.Acquire();
+}
+
+void Emulator::ReleaseFrame(const Frame& frame) {
+  frame_buffers_.Release(frame);
+}
+
+size_t Emulator::Step() {
+  const size_t cycles = cpu_.Step();
+  Advance(cycles);
+  return cycles;
+}
+
+void Emulator::Advance(size_t cycles) {
+  const uint64_t frame = ppu_.FrameCount();
+  ppu_.Tick(cycles);
+  apu_.Tick(cycles);
+  joypad_.Tick(cycles);
+  serial_.Tick(cycles);
+  if (ppu_.FrameCount() != frame) {
+    joypad_.StartFrame(ppu_.FrameCount());
+    events_ |= kFrameEvent;
+  }
+  events_ |= interrupts_.TakeRequests();
+
+  audio_cycles_ += cycles;
+  if (audio_stream_ != nullptr && audio_cycles_ >= kAudioPushCycles) {
+    PushAudio();
+    audio_cycles_ = 0;
+  }
+}
+
+uint64_t Emulator::RomHash() const {
+  const RomBanks& banks = *memory_.rom_banks();
+  return HashFrame(banks.front().data(), kRomBankSize.value(),
+                   kRomBankSize.value(), banks.size());
+}
+
+EmulatorFootprint Emulator::Footprint() const {
+  EmulatorFootprint footprint;
+  footprint.object = sizeof(*this);
+  footprint.arena_mapped = arena_.committed();
+  footprint.arena_resident = arena_.Resident();
+  footprint.private_ram = memory_.PrivateRamSize();
+  footprint.shared_rom = memory_.rom_banks()->size() * kRomBankSize.value();
+  return footprint;
+}
+
+void Emulator::PushAudio() {
+  apu_.FlushSamples();
+  int16_t samples[2 * 512];
+  while (const size_t count =
+             apu_.ReadSamples(samples, std::size(samples) / 2)) {
+    audio_stream_->Push(samples, count);
+  }
+}
+
+void Emulator::WriteState(StateWriter* writer) {
+  SaveSection(StateSection::kInterrupts, &interrupts_, writer);
+  SaveSection(StateSection::kPpu, &ppu_, writer);
+  SaveSection(StateSection::kApu, &apu_, writer);
+  SaveSection(StateSection::kJoypad, &joypad_, writer);
+  SaveSection(StateSection::kSerial, &serial_, writer);
+  SaveSection(StateSection::kMemory, &memory_, writer);
+  SaveSection(StateSection::kCpu, &cpu_, writer);
+}
+
+void Emulator::ReadState(StateReader* reader) {
+  LoadSection(StateSection::kInterrupts, &interrupts_, reader);
+  LoadSection(StateSection::kPpu, &ppu_, reader);
+  LoadSection(StateSection::kApu, &apu_, reader);
+  LoadSection(StateSection::kJoypad, &joypad_, reader);
+  LoadSection(StateSection::kSerial, &serial_, reader);
+  LoadSection(StateSection::kMemory, &memory_, reader);
+  LoadSection(StateSection::kCpu, &cpu_, reader);
+}
+
+void Emulator::WriteRamState(StateWriter* writer) const {
+  const size_t start =
+      writer->BeginSection(static_cast<uint16_t>(StateSection::kCartridgeRam));
+  memory_.SaveRam(writer);
+  writer->EndSection(start);
+}
+
+void Emulator::ReadRamState(StateReader* reader) {
+  size_t end;
+  reader->BeginSection(static_cast<uint16_t>(StateSection::kCartridgeRam),
+                       &end);
+  memory_.LoadRam(reader);
+  if (!reader->EndSection(end)) {
+    FATAL("Cartridge RAM does not match the size of its state section");
+  }
+}
+
+void Emulator::WriteStateHeader(StateWriter* writer, uint32_t raw_size,
+                                uint32_t compressed_size,
+                                uint64_t checksum) const {
+  writer->Write(kStateMagic);
+  writer->Write(kStateVersion);
+  writer->Write(header_.global_checksum);
+  writer->Write(header_.header_checksum);
+  writer->Write(static_cast<uint8_t>(header_.color_gb));
+  writer->Write(static_cast<uint32_t>(header_.ram_bank_num));
+  writer->Write(raw_size);
+  writer->Write(compressed_size);
+  writer->Write(checksum);
+}
+
+bool Emulator::ReadStateHeader(StateReader* reader, uint32_t* raw_size,
+                               uint32_t* compressed_size,
+                               uint64_t* checksum) const {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t global_checksum;
+  uint8_t header_checksum;
+  uint8_t color_gb;
+  uint32_t ram_bank_num;
+  reader->Read(&magic);
+  reader->Read(&version);
+  reader->Read(&global_checksum);
+  reader->Read(&header_checksum);
+  reader->Read(&color_gb);
+  reader->Read(&ram_bank_num);
+  reader->Read(raw_size);
+  reader->Read(compressed_size);
+  reader->Read(checksum);
+  return !reader->failed() && magic == kStateMagic &&
+         version == kStateVersion &&
+         global_checksum == header_.global_checksum &&
+         header_checksum == header_.header_checksum &&
+         color_gb == static_cast<uint8_t>(header_.color_gb) &&
+         ram_bank_num == header_.ram_bank_num;
+}
+
 }  // namespace gamebun
@@ -1,26 +1,276 @@
 #ifndef EMULATOR_H_
 #define EMULATOR_H_
 
+#include "apu.h"
+#include "arena.h"
+#include "audio_stream.h"
 #include "cartridge.h"
 #include "cpu.h"
+#include "frame_buffers.h"
+#include "interrupts.h"
+#include "joypad.h"
 #include "memory.h"
+#include "palette.h"
+#include "ppu.h"
+#include "renderer.h"
+#include "serial.h"
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
 
 namespace gamebun {
 
+// Identifies how the emulator behaves. Incremented whenever a change could
+// make the same input play out differently, which invalidates recorded
+// movies.
+inline constexpr uint32_t kEmulatorVersion = 1;
+
+// Events RunUntil() can stop at, as bits of a mask. The interrupt events
+// happen whenever the interrupt is requested, even if it is disabled.
+using RunEventMask = uint32_t;
+inline constexpr RunEventMask kVBlankEvent =
+    static_cast<uint8_t>(Interrupt::kVBlank);
+inline constexpr RunEventMask kLcdStatEvent =
+    static_cast<uint8_t>(Interrupt::kLcdStat);
+inline constexpr RunEventMask kTimerEvent =
+    static_cast<uint8_t>(Interrupt::kTimer);
+inline constexpr RunEventMask kSerialEvent =
+    static_cast<uint8_t>(Interrupt::kSerial);
+inline constexpr RunEventMask kJoypadEvent =
+    static_cast<uint8_t>(Interrupt::kJoypad);
+// The PPU completing a frame.
+inline constexpr RunEventMask kFrameEvent = 0x100;
+
+struct RunResult {
+  // Cycles actually run, which overshoot the requested boundary by the rest
+  // of the last instruction.
+  uint64_t cycles;
+  // The events that stopped the run, or 0 if it ran out of cycles.
+  RunEventMask events;
+};
+
+// The memory an emulator takes up, in bytes. Frame buffers passed in
+// through FrameBufferOptions::memory belong to the caller and are left out.
+struct EmulatorFootprint {
+  // The Emulator object itself, wherever it was allocated.
+  size_t object;
+  // The emulator's arena: the pages mapped for it, and those of them that
+  // have been written and so are actually backed by memory.
+  size_t arena_mapped;
+  size_t arena_resident;
+  // Pages of cartridge RAM that no clone shares.
+  size_t private_ram;
+  // The ROM, held once for every emulator of the cartridge.
+  size_t shared_rom;
+
+  // What freeing the emulator would give back.
+  size_t private_total() const {
+    return object + arena_resident + private_ram;
+  }
+};
+
+struct EmulatorOptions {
+  RenderMode render_mode = RenderMode::kInline;
+  PixelFormat pixel_format = PixelFormat::kRgba8888;
+  bool color_correction = false;
+  FrameBufferOptions frame_buffers;
+  AudioOptions audio;
+  // Backs the emulator's memory with transparent huge pages where the kernel
+  // has them, at the cost of a 2 MB minimum footprint.
+  bool huge_pages = false;
+};
+
 class Emulator {
  public:
-  explicit Emulator(const Cartridge& cart);
+  Emulator(const Cartridge& cart, const EmulatorOptions& options);
+
+  // Returns an emulator that carries on from exactly where this one is, for
+  // exploring several futures from the same point. The copy shares the ROM
+  // and, until either of them writes to it, each page of cartridge RAM, so
+  // forking is cheap and memory only grows with what each copy changes.
+  //
+  // The copy has the same options, except that it renders into buffers of
+  // its own. It starts with no audio waiting to be read, no input queued
+  // from other threads, nothing plugged into the serial port, and no audio
+  // stream, and the frame it is in the middle of only shows the lines from
+  // there on.
+  std::unique_ptr<Emulator> Clone();
+
+  // Saves everything Clone() carries over, plus cartridge RAM, into
+  // `buffer`, compressed, and returns the size of the saved state, or 0 if
+  // it does not fit in `capacity` bytes. Nothing is allocated.
+  //
+  // The state starts with a versioned header naming the cartridge, so that
+  // it is only ever loaded back into an emulator of the same cartridge and
+  // hardware by the same version of the format. Its fields are in the
+  // host's byte order.
+  size_t SaveState(void* buffer, size_t capacity);
+  // The most SaveState() can need. States only grow past their usual size
+  // with input queued far ahead, and saving fails with more than a few
+  // hundred such events.
+  size_t MaxSaveStateSize() const;
+  // Restores a state saved by SaveState(), dropping any audio waiting to be
+  // read, and returns true. If the state is damaged or from another
+  // cartridge or version, returns false and changes nothing. As with
+  // Clone(), the frame the state was saved in the middle of only shows the
+  // lines from there on.
+  bool LoadState(const void* data, size_t size);
 
   bool Run();
 
+  // The bounded runs below return promptly at their boundary, so that a
+  // host can interleave many emulators on a few threads. None of them calls
+  // back into the host between instructions.
+
+  // Runs for at least `cycles` cycles, up to the end of the instruction that
+  // reaches them.
+  RunResult RunCycles(uint64_t cycles) {
+    return RunUntil(0, cycles);
+  }
+
+  // Runs until the PPU completes the current frame, and completes the audio
+  // samples up to that point.
+  RunResult RunFrame();
+
+  // Runs until one of `events` happens, stopping after the instruction that
+  // caused it, or until `max_cycles` have run.
+  RunResult RunUntil(RunEventMask events,
+                     uint64_t max_cycles = kUnlimitedCycles) {
+    return RunUntil(events, max_cycles, [] { return true; });
+  }
+  // As above, but each time one of `events` happens, only stops if `stop()`
+  // returns true. The predicate is only evaluated at those events.
+  template <typename Predicate>
+  RunResult RunUntil(RunEventMask events, uint64_t max_cycles,
+                     Predicate stop);
+
+  static constexpr uint64_t kUnlimitedCycles =
+      std::numeric_limits<uint64_t>::max();
+
+  // Borrows the most recently completed frame in place. Its pixels stay
+  // valid and unchanged until it is passed to ReleaseFrame(), which may
+  // happen on another thread while emulation carries on.
+  //
+  // With the default of two frame buffers, holding a frame holds up the
+  // next one. With RenderMode::kInline, frames completed meanwhile are
+  // dropped, so a frame may be held across RunFrame() on the emulating
+  // thread. With RenderMode::kDeferred, rendering stops until the frame is
+  // released, and emulation soon after, so it must be released from
+  // another thread or before running on; three buffers avoid that.
+  Frame AcquireFrame();
+  void ReleaseFrame(const Frame& frame);
+
+  // Reads up to `count` stereo samples of completed audio, left channel
+  // first, and returns how many were read.
+  size_t ReadAudio(int16_t* out, size_t count) {
+    return apu_.ReadSamples(out, count);
+  }
+
+  // Queues a button press or release to be applied at its timestamp, and
+  // returns false if too many events are already queued. Unlike everything
+  // else here, this may be called from any thread.
+  bool QueueInput(const JoypadEvent& event) { return joypad_.Queue(event); }
+
+  // Plugs a link cable into the serial port, or unplugs it if `link` is
+  // null. The cable must outlive the emulator or be unplugged first.
+  void ConnectSerial(SerialLink* link) { serial_.Connect(link); }
+
+  // Switches between synthesizing audio and only tracking the sound
+  // registers, which is much cheaper when nobody listens.
+  void SetAudioMode(AudioMode mode) { apu_.SetMode(mode); }
+
+  // Pushes completed audio into `stream` every few milliseconds of emulated
+  // time while running, instead of leaving it for ReadAudio(). Passing null
+  // detaches the stream.
+  void SetAudioStream(AudioStream* stream) { audio_stream_ = stream; }
+
+  // Hashes the cartridge's ROM, identifying the game by its contents rather
+  // than by its header. Takes time in proportion to the size of the ROM.
+  uint64_t RomHash() const;
+
+  // Measures how much memory the emulator takes up right now.
+  EmulatorFootprint Footprint() const;
+
   Emulator(const Emulator&) = delete;
   Emulator& operator=(const Emulator&) = delete;
 
  private:
+  Emulator(std::shared_ptr<const RomBanks> rom_banks,
+           const CartridgeHeader& header, const EmulatorOptions& options);
+
+  // Holds the CPU registers of the emulators it runs, and clocks the rest
+  // through Advance().
+  friend class BatchCpu;
+  // Snapshots the raw state, as SaveState() does before compressing it.
+  friend class RewindBuffer;
+
+  // Runs a single instruction and everything it clocks, returning the number
+  // of cycles it took and adding the events it caused to `events_`.
+  size_t Step();
+  // Clocks everything but the CPU by `cycles`, as Step() does after each
+  // instruction.
+  void Advance(size_t cycles);
+  // Flushes the APU and pushes its samples into audio_stream_.
+  void PushAudio();
+
+  // Saves or restores the state of every component, except for cartridge
+  // RAM, as a series of sections.
+  void WriteState(StateWriter* writer);
+  void ReadState(StateReader* reader);
+  // The same for cartridge RAM, as a section of its own.
+  void WriteRamState(StateWriter* writer) const;
+  void ReadRamState(StateReader* reader);
+  // Writes or checks the header SaveState() puts in front of the
+  // compressed state.
+  void WriteStateHeader(StateWriter* writer, uint32_t raw_size,
+                        uint32_t compressed_size, uint64_t checksum) const;
+  bool ReadStateHeader(StateReader* reader, uint32_t* raw_size,
+                       uint32_t* compressed_size, uint64_t* checksum) const;
+
+  const CartridgeHeader header_;
+  const EmulatorOptions options_;
+  // Holds the buffers and objects of every component below, so that each
+  // instance is a single block of memory.
+  Arena arena_;
+
+  Interrupts interrupts_;
+  FrameBuffers frame_buffers_;
+  Ppu ppu_;
+  Apu apu_;
+  Joypad joypad_;
+  Serial serial_;
   Memory memory_;
   Cpu cpu_;
+  // Room in the arena for the uncompressed state, which SaveState() and
+  // LoadState() pass through. Its pages are given back after each use.
+  uint8_t* state_buffer_;
+  size_t state_buffer_size_;
+  AudioStream* audio_stream_ = nullptr;
+  size_t audio_cycles_ = 0;
+  RunEventMask events_ = 0;
 };
 
+template <typename Predicate>
+RunResult Emulator::RunUntil(RunEventMask events, uint64_t max_cycles,
+                             Predicate stop) {
+  uint64_t cycles = 0;
+  events_ = 0;
+  while (cycles < max_cycles) {
+    cycles += Step();
+    if ((events_ & events) != 0) {
+      const RunEventMask happened = events_ & events;
+      events_ = 0;
+      if (stop()) {
+        return {cycles, happened};
+      }
+    }
+  }
+  return {cycles, 0};
+}
+
 }  // namespace gamebun
 
 #endif  // EMULATOR_H_
@@ -0,0 +1,120 @@
+#include "emulator.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "apu.h"
+#include "cartridge.h"
+#include "copy_on_write_memory.h"
+#include "joypad.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Keeps copying P1, with every button selected, into the first 4 KB of
+// cartridge RAM.
+const std::vector<uint8_t> kInputProgram = {
+    0x3E, 0x0A,        // 0x100: LD A, 0x0A
+    0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A, enabling cartridge RAM
+    0x21, 0x00, 0xA0,  // 0x105: LD HL, 0xA000
+    0xAF,              // 0x108: XOR A
+    0xE0, 0x00,        // 0x109: LDH (0x00), A
+    0xF0, 0x00,        // 0x10B: LDH A, (0x00)
+    0x22,              // 0x10D: LD (HL+), A
+    0xCB, 0xA4,        // 0x10E: RES 4, H, wrapping 0xB000 to 0xA000
+    0x18, 0xF6,        // 0x110: JR 0x108
+};
+
+constexpr size_t kWrittenRam = 4096;
+
+EmulatorOptions Options() {
+  EmulatorOptions options;
+  options.audio.mode = AudioMode::kRegistersOnly;
+  return options;
+}
+
+std::vector<uint8_t> SaveState(Emulator* emulator) {
+  std::vector<uint8_t> state(emulator->MaxSaveStateSize());
+  const size_t size = emulator->SaveState(state.data(), state.size());
+  REQUIRE(size != 0);
+  state.resize(size);
+  return state;
+}
+
+void RunFrames(Emulator* emulator, size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    emulator->RunFrame();
+  }
+}
+
+TEST_CASE("Clones carry on from where they were made", "[clone]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  Emulator original(cart, Options());
+  RunFrames(&original, 10);
+  original.RunCycles(1234);
+
+  const std::unique_ptr<Emulator> clone = original.Clone();
+  CHECK(clone->Footprint().private_ram == 0);
+  CHECK(original.Footprint().private_ram == 0);
+  CHECK(SaveState(clone.get()) == SaveState(&original));
+  for (size_t i = 0; i < 5; i++) {
+    original.RunFrame();
+    clone->RunFrame();
+    CHECK(SaveState(clone.get()) == SaveState(&original));
+  }
+  // Both wrote to the same pages, so each now has its own copy of them.
+  CHECK(clone->Footprint().private_ram == kWrittenRam);
+  CHECK(original.Footprint().private_ram == kWrittenRam);
+}
+
+TEST_CASE("Clones diverge without affecting each other", "[clone]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  Emulator original(cart, Options());
+  RunFrames(&original, 10);
+
+  // The reference is left alone until the others are done.
+  const std::unique_ptr<Emulator> reference = original.Clone();
+  const std::unique_ptr<Emulator> clone = original.Clone();
+  REQUIRE(clone->QueueInput(
+      {0, JoypadEvent::TimeUnit::kCycles, Button::kA, /*pressed=*/true}));
+  // Clones sharing pages may run on different threads.
+  std::thread clone_thread([&clone] { RunFrames(clone.get(), 5); });
+  RunFrames(&original, 5);
+  clone_thread.join();
+  RunFrames(reference.get(), 5);
+
+  CHECK(SaveState(&original) == SaveState(reference.get()));
+  CHECK(SaveState(clone.get()) != SaveState(&original));
+
+  // Loading a state back makes the clone the same as the original again,
+  // down to which pages of cartridge RAM are zero.
+  const std::vector<uint8_t> state = SaveState(&original);
+  REQUIRE(clone->LoadState(state.data(), state.size()));
+  CHECK(SaveState(clone.get()) == state);
+  CHECK(clone->Footprint().private_ram == kWrittenRam);
+}
+
+TEST_CASE("Emulators cloned many times share their untouched pages",
+          "[clone]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  Emulator original(cart, Options());
+  RunFrames(&original, 5);
+  std::vector<std::unique_ptr<Emulator>> clones;
+  for (size_t i = 0; i < 8; i++) {
+    clones.push_back((i == 0 ? original : *clones.back()).Clone());
+  }
+  CHECK(original.Footprint().private_ram == 0);
+  // Dropping clones gives their references back.
+  clones.clear();
+  CHECK(original.Footprint().private_ram == kWrittenRam);
+  static_assert(kWrittenRam % CopyOnWriteMemory::kPageSize == 0);
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -0,0 +1,244 @@
+#include "emulator_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// The cores this process may run on.
+std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+void PinCurrentThread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    WARNING("Unable to pin a worker to CPU %d", cpu);
+  }
+}
+
+}  // namespace
+
+EmulatorPool::EmulatorPool(const Cartridge& cart, size_t instance_count,
+                           const EmulatorPoolOptions& options)
+    : instances_(instance_count),
+      remaining_(instance_count, 0),
+      ready_(0),
+      run_(0),
+      outstanding_(0),
+      working_(0),
+      callback_(nullptr),
+      stopping_(false),
+      idle_generation_(0),
+      idle_workers_(0) {
+  if (options.emulator.render_mode != RenderMode::kInline) {
+    // Each deferred renderer brings its own thread, which the workers would
+    // compete with.
+    FATAL("EmulatorPool only supports inline rendering");
+  }
+  const std::vector<int> cpus = AllowedCpus();
+  size_t thread_count = options.threads;
+  if (thread_count == 0) {
+    thread_count = std::max<size_t>(1, cpus.size());
+  }
+  thread_count = std::max<size_t>(1, std::min(thread_count, instance_count));
+
+  for (size_t i = 0; i < thread_count; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < thread_count; i++) {
+    const bool pin = options.pin_threads && !cpus.empty();
+    workers_[i]->thread =
+        std::thread(&EmulatorPool::RunWorker, this, i, std::cref(cart),
+                    std::cref(options.emulator), pin ? cpus[i % cpus.size()]
+                                                     : -1);
+  }
+
+  // The cartridge and options are only borrowed until every instance
+  // exists.
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this] { return ready_ == workers_.size(); });
+}
+
+EmulatorPool::~EmulatorPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread.join();
+  }
+  // Instances are destroyed here rather than on their workers; only their
+  // allocation needed to happen on the right core.
+}
+
+void EmulatorPool::RunFrames(uint64_t frames,
+                             const FrameCallback& callback) {
+  if (frames == 0 || instances_.empty()) {
+    return;
+  }
+  // Each worker starts with the instances it created.
+  for (size_t i = 0; i < instances_.size(); i++) {
+    remaining_[i] = frames;
+    Worker& worker = *workers_[Owner(i)];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(i);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  callback_ = callback ? &callback : nullptr;
+  outstanding_.store(frames * instances_.size(), std::memory_order_relaxed);
+  working_ = workers_.size();
+  run_++;
+  condition_.notify_all();
+  condition_.wait(lock, [this] { return working_ == 0; });
+  callback_ = nullptr;
+}
+
+void EmulatorPool::RunWorker(size_t index, const Cartridge& cart,
+                             const EmulatorOptions& options, int cpu) {
+  if (cpu >= 0) {
+    PinCurrentThread(cpu);
+  }
+  // Worker `index` owns a contiguous range of instances, matching the
+  // assignment in RunFrames().
+  for (size_t i = 0; i < instances_.size(); i++) {
+    if (Owner(i) == index) {
+      instances_[i] = std::make_unique<Emulator>(cart, options);
+    }
+  }
+
+  uint64_t run = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_++;
+  condition_.notify_all();
+  while (true) {
+    condition_.wait(lock, [this, run] { return stopping_ || run_ != run; });
+    if (stopping_) {
+      return;
+    }
+    run = run_;
+    lock.unlock();
+    WorkOnRun(index);
+    lock.lock();
+    if (--working_ == 0) {
+      condition_.notify_all();
+    }
+  }
+}
+
+void EmulatorPool::WorkOnRun(size_t index) {
+  while (true) {
+    uint64_t generation;
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      generation = idle_generation_;
+    }
+    if (outstanding_.load(std::memory_order_acquire) == 0) {
+      return;
+    }
+    size_t instance;
+    if (!TakeTask(index, &instance)) {
+      // The last tasks are running elsewhere, and may yet come back to a
+      // queue between frames. Anything queued since `generation` was read
+      // is caught by the wait.
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      idle_workers_++;
+      idle_condition_.wait(
+          lock, [this, generation] { return idle_generation_ != generation; });
+      idle_workers_--;
+      continue;
+    }
+    Emulator& emu = *instances_[instance];
+    emu.RunFrame();
+    if (callback_ != nullptr) {
+      (*callback_)(instance, &emu);
+    }
+    if (--remaining_[instance] != 0) {
+      QueueTask(instance);
+    }
+    if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      NotifyIdle(/*all=*/true);
+    }
+  }
+}
+
+void EmulatorPool::QueueTask(size_t instance) {
+  {
+    // The next frame goes back to the core the instance's memory is local
+    // to, even if it was stolen, and is the next one its owner runs.
+    Worker& owner = *workers_[Owner(instance)];
+    std::lock_guard<std::mutex> lock(owner.mutex);
+    owner.tasks.push_front(instance);
+  }
+  NotifyIdle(/*all=*/false);
+}
+
+void EmulatorPool::NotifyIdle(bool all) {
+  bool waiting;
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_generation_++;
+    waiting = idle_workers_ != 0;
+  }
+  if (!waiting) {
+    return;
+  }
+  if (all) {
+    idle_condition_.notify_all();
+  } else {
+    idle_condition_.notify_one();
+  }
+}
+
+bool EmulatorPool::TakeTask(size_t index, size_t* instance) {
+  {
+    Worker& own = *workers_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *instance = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  // Steals from the back of the other queues, where the instances furthest
+  // from being run again are, starting with the next worker along.
+  for (size_t offset = 1; offset < workers_.size(); offset++) {
+    Worker& victim = *workers_[(index + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *instance = victim.tasks.back();
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace gamebun
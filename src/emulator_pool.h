@@ -0,0 +1,117 @@
+#ifndef EMULATOR_POOL_H_
+#define EMULATOR_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cartridge.h"
+#include "emulator.h"
+
+namespace gamebun {
+
+struct EmulatorPoolOptions {
+  EmulatorOptions emulator;
+  // Worker threads, or 0 for one per core the process may run on.
+  size_t threads = 0;
+  // Whether each worker is pinned to its own core.
+  bool pin_threads = true;
+};
+
+// Runs many emulators of the same cartridge on a pool of worker threads.
+//
+// Each instance belongs to one worker, which creates it on its own core so
+// that the instance's memory is first touched, and therefore allocated, on
+// that core's NUMA node. A run is broken into tasks of one frame of one
+// instance. Workers take tasks from their own queue first and steal from
+// the others once it is empty, so that uneven frames still keep every core
+// busy. A stolen instance's next frame goes back to the worker that owns
+// it. Workers that find nothing to take sleep until a task is queued or the
+// run ends.
+class EmulatorPool {
+ public:
+  // Called on a worker thread after each frame an instance runs. Calls for
+  // the same instance never overlap.
+  using FrameCallback = std::function<void(size_t instance, Emulator* emu)>;
+
+  EmulatorPool(const Cartridge& cart, size_t instance_count,
+               const EmulatorPoolOptions& options);
+  ~EmulatorPool();
+
+  size_t size() const { return instances_.size(); }
+  size_t thread_count() const { return workers_.size(); }
+
+  // Only valid between runs.
+  Emulator& instance(size_t index) { return *instances_[index]; }
+
+  // Advances every instance by `frames` frames and returns once all of them
+  // are done. `callback` may be empty.
+  void RunFrames(uint64_t frames, const FrameCallback& callback = nullptr);
+
+  EmulatorPool(const EmulatorPool&) = delete;
+  EmulatorPool& operator=(const EmulatorPool&) = delete;
+
+ private:
+  struct Worker {
+    std::thread thread;
+    std::mutex mutex;
+    // Instances with frames left to run.
+    std::deque<size_t> tasks;
+  };
+
+  // The worker that creates `instance`, and whose queue it returns to.
+  size_t Owner(size_t instance) const {
+    return instance * workers_.size() / instances_.size();
+  }
+
+  // Creates the worker's instances, pinned to `cpu` unless it is negative,
+  // and then takes part in every run.
+  void RunWorker(size_t index, const Cartridge& cart,
+                 const EmulatorOptions& options, int cpu);
+  // Runs tasks until the current run is over.
+  void WorkOnRun(size_t index);
+  // Takes a task from worker `index`, or steals one from another worker.
+  bool TakeTask(size_t index, size_t* instance);
+  // Queues the next frame of `instance` with the worker that owns it.
+  void QueueTask(size_t instance);
+  // Wakes workers waiting for tasks, after one is queued or the run ends.
+  void NotifyIdle(bool all);
+
+  std::vector<std::unique_ptr<Emulator>> instances_;
+  // Frames each instance has left in the current run.
+  std::vector<uint64_t> remaining_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // Workers that have created their instances.
+  size_t ready_;
+  // Counts runs, so that workers know when a new one starts.
+  uint64_t run_;
+  // Frames of the current run that no worker has finished.
+  std::atomic<uint64_t> outstanding_;
+  // Workers still taking part in the current run.
+  size_t working_;
+  const FrameCallback* callback_;
+  bool stopping_;
+
+  // Workers that found no task wait here for one to be queued, or for the
+  // run to end.
+  std::mutex idle_mutex_;
+  std::condition_variable idle_condition_;
+  // Counts tasks queued and runs ended, so that waiting workers can tell
+  // whether either happened since they last looked.
+  uint64_t idle_generation_;
+  size_t idle_workers_;
+};
+
+}  // namespace gamebun
+
+#endif  // EMULATOR_POOL_H_
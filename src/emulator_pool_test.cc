@@ -0,0 +1,60 @@
+#include "emulator_pool.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cartridge.h"
+#include "emulator.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+TEST_CASE("Every instance runs every frame", "[emulator_pool]") {
+  const Cartridge cart = MakeTestCartridge({0x18, 0xFE});  // JR -2
+  EmulatorPoolOptions options;
+  options.threads = 4;
+  options.pin_threads = false;
+  EmulatorPool pool(cart, 37, options);
+
+  std::vector<std::atomic<uint64_t>> frames(pool.size());
+  for (uint64_t run = 1; run <= 3; run++) {
+    pool.RunFrames(5, [&frames](size_t instance, Emulator* emu) {
+      frames[instance]++;
+      const Frame frame = emu->AcquireFrame();
+      emu->ReleaseFrame(frame);
+    });
+    for (size_t i = 0; i < pool.size(); i++) {
+      CHECK(frames[i] == 5 * run);
+    }
+  }
+}
+
+TEST_CASE("Instances with uneven frames finish", "[emulator_pool]") {
+  const Cartridge cart = MakeTestCartridge({0x18, 0xFE});  // JR -2
+  EmulatorPoolOptions options;
+  options.threads = 3;
+  options.pin_threads = false;
+  EmulatorPool pool(cart, 6, options);
+
+  std::vector<std::atomic<uint64_t>> frames(pool.size());
+  pool.RunFrames(20, [&frames](size_t instance, Emulator* emu) {
+    frames[instance]++;
+    // The first worker's instances take several times longer, so the
+    // others run dry and steal them.
+    if (instance < 2) {
+      emu->RunFrame();
+      emu->RunFrame();
+    }
+  });
+  for (size_t i = 0; i < pool.size(); i++) {
+    CHECK(frames[i] == 20);
+  }
+}
+
+}  // namespace
+}  // namespace gamebun
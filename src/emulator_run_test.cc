@@ -0,0 +1,175 @@
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "cartridge.h"
+#include "emulator.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+constexpr uint64_t kFrameCycles = 70224;
+constexpr uint64_t kLineCycles = 456;
+// The longest instruction the program below runs.
+constexpr uint64_t kJumpCycles = 16;
+
+// Enables the STAT interrupt at HBlank, which stays disabled in IE, and
+// then jumps in place, so that every instruction from the third on takes 16
+// cycles.
+const std::vector<uint8_t> kHBlankProgram = {
+    0x3E, 0x08,        // 0x100: LD A, 0x08
+    0xE0, 0x41,        // 0x102: LDH (0x41), A
+    0xC3, 0x04, 0x01,  // 0x104: JP 0x104
+};
+
+// Checks that `cycles` is `expected` or overshoots it by less than an
+// instruction.
+void CheckCycles(uint64_t cycles, uint64_t expected) {
+  CHECK(cycles + kJumpCycles > expected);
+  CHECK(cycles < expected + kJumpCycles);
+}
+
+std::vector<uint8_t> SaveState(Emulator* emulator) {
+  std::vector<uint8_t> state(emulator->MaxSaveStateSize());
+  state.resize(emulator->SaveState(state.data(), state.size()));
+  return state;
+}
+
+TEST_CASE("RunCycles stops at the end of the instruction reaching the count",
+          "[emulator]") {
+  const Cartridge cart = MakeTestCartridge(kHBlankProgram);
+  Emulator emulator(cart, EmulatorOptions());
+  CHECK(emulator.RunCycles(1).cycles == 8);
+  CHECK(emulator.RunCycles(1).cycles == 12);
+  CHECK(emulator.RunCycles(0).cycles == 0);
+  for (const uint64_t cycles : {1, 15, 16, 17, 100, 4096, 70224, 100000}) {
+    INFO(cycles << " cycles");
+    const RunResult result = emulator.RunCycles(cycles);
+    CHECK(result.cycles == (cycles + kJumpCycles - 1) / kJumpCycles *
+                               kJumpCycles);
+    // Frames and interrupts on the way do not stop it.
+    CHECK(result.events == 0);
+  }
+  // Nor are they left over to stop the next run.
+  CHECK(emulator.RunUntil(kFrameEvent | kLcdStatEvent).cycles > kJumpCycles);
+}
+
+TEST_CASE("Runs split anywhere end up where a single run does",
+          "[emulator]") {
+  const Cartridge cart = MakeTestCartridge(kHBlankProgram);
+  Emulator emulator(cart, EmulatorOptions());
+  std::unique_ptr<Emulator> reference = emulator.Clone();
+
+  std::mt19937 random(11);
+  uint64_t total = 0;
+  for (size_t run = 0; run < 200; run++) {
+    switch (run % 4) {
+      case 0:
+        total += emulator.RunCycles(random() % 5000).cycles;
+        break;
+      case 1:
+        total += emulator.RunUntil(kLcdStatEvent).cycles;
+        break;
+      case 2:
+        total += emulator.RunUntil(kVBlankEvent | kLcdStatEvent,
+                                   random() % 20000)
+                     .cycles;
+        break;
+      default:
+        total += emulator.RunFrame().cycles;
+        break;
+    }
+  }
+  const RunResult result = reference->RunCycles(total);
+  CHECK(result.cycles == total);
+  CHECK(SaveState(&emulator) == SaveState(reference.get()));
+}
+
+TEST_CASE("RunUntil stops right after the events asked for", "[emulator]") {
+  const Cartridge cart = MakeTestCartridge(kHBlankProgram);
+  Emulator emulator(cart, EmulatorOptions());
+  emulator.RunFrame();
+
+  SECTION("at frames") {
+    for (size_t frame = 0; frame < 5; frame++) {
+      const RunResult result = emulator.RunFrame();
+      CHECK(result.events == kFrameEvent);
+      CheckCycles(result.cycles, kFrameCycles);
+    }
+  }
+  SECTION("at VBlank, though its interrupt is disabled") {
+    emulator.RunUntil(kVBlankEvent);
+    for (size_t frame = 0; frame < 5; frame++) {
+      const RunResult result = emulator.RunUntil(kVBlankEvent);
+      CHECK(result.events == kVBlankEvent);
+      CheckCycles(result.cycles, kFrameCycles);
+    }
+  }
+  SECTION("at HBlank") {
+    emulator.RunUntil(kLcdStatEvent);
+    uint64_t cycles = 0;
+    for (uint64_t line = 1; line < 100; line++) {
+      const RunResult result = emulator.RunUntil(kLcdStatEvent);
+      CHECK(result.events == kLcdStatEvent);
+      cycles += result.cycles;
+      CheckCycles(cycles, line * kLineCycles);
+    }
+  }
+  SECTION("at whichever comes first") {
+    uint64_t cycles = 0;
+    size_t lines = 0;
+    while (true) {
+      const RunResult result =
+          emulator.RunUntil(kLcdStatEvent | kVBlankEvent, kFrameCycles);
+      REQUIRE(result.events != 0);
+      cycles += result.cycles;
+      if (result.events & kVBlankEvent) {
+        break;
+      }
+      CHECK(result.events == kLcdStatEvent);
+      lines++;
+    }
+    // One HBlank on each of the visible lines, and then VBlank as the next
+    // line starts.
+    CHECK(lines == 144);
+    CheckCycles(cycles, 144 * kLineCycles);
+  }
+  SECTION("or once they run out of cycles") {
+    const RunResult result = emulator.RunUntil(kSerialEvent, 1000);
+    CHECK(result.events == 0);
+    CheckCycles(result.cycles, 1000);
+  }
+}
+
+TEST_CASE("RunUntil only stops when the predicate says so", "[emulator]") {
+  const Cartridge cart = MakeTestCartridge(kHBlankProgram);
+  Emulator emulator(cart, EmulatorOptions());
+  emulator.RunFrame();
+  emulator.RunUntil(kLcdStatEvent);
+
+  size_t calls = 0;
+  const RunResult result =
+      emulator.RunUntil(kLcdStatEvent, Emulator::kUnlimitedCycles,
+                        [&calls] { return ++calls == 5; });
+  CHECK(calls == 5);
+  CHECK(result.events == kLcdStatEvent);
+  CheckCycles(result.cycles, 5 * kLineCycles);
+
+  // The predicate is only asked at the events in the mask, and a run that
+  // reaches its limit first stops anyway.
+  calls = 0;
+  const RunResult limited =
+      emulator.RunUntil(kLcdStatEvent, 3 * kLineCycles + 100,
+                        [&calls] { return ++calls == 5; });
+  CHECK(calls == 3);
+  CHECK(limited.events == 0);
+  CheckCycles(limited.cycles, 3 * kLineCycles + 100);
+}
+
+}  // namespace
+}  // namespace gamebun
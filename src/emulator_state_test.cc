@@ -0,0 +1,147 @@
+#include "emulator.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cartridge.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Keeps writing cartridge RAM with the LCD on, so that every frame changes
+// the state.
+const std::vector<uint8_t> kStateProgram = {
+    0x3E, 0x0A,        // 0x100: LD A, 0x0A
+    0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A, enabling cartridge RAM
+    0x21, 0x00, 0xA0,  // 0x105: LD HL, 0xA000
+    0x3E, 0x91,        // 0x108: LD A, 0x91
+    0xE0, 0x40,        // 0x10A: LDH (0x40), A
+    0x7D,              // 0x10C: LD A, L
+    0x22,              // 0x10D: LD (HL+), A
+    0xCB, 0xA4,        // 0x10E: RES 4, H, wrapping 0xB000 to 0xA000
+    0x18, 0xFA,        // 0x110: JR 0x10C
+};
+
+std::vector<uint8_t> SaveState(Emulator* emulator) {
+  std::vector<uint8_t> state(emulator->MaxSaveStateSize());
+  const size_t size = emulator->SaveState(state.data(), state.size());
+  REQUIRE(size != 0);
+  state.resize(size);
+  return state;
+}
+
+uint64_t FrameHash(Emulator* emulator) {
+  const Frame frame = emulator->AcquireFrame();
+  const uint64_t hash = frame.hash;
+  emulator->ReleaseFrame(frame);
+  return hash;
+}
+
+TEST_CASE("Saved states load back", "[state]") {
+  const Cartridge cart = MakeTestCartridge(kStateProgram);
+  Emulator original(cart, EmulatorOptions());
+  Emulator copy(cart, EmulatorOptions());
+  for (size_t i = 0; i < 10; i++) {
+    original.RunFrame();
+  }
+  original.RunCycles(1234);
+  const std::vector<uint8_t> state = SaveState(&original);
+  // The state compresses well below the size it is saved in.
+  CHECK(state.size() * 4 < original.MaxSaveStateSize());
+
+  REQUIRE(copy.LoadState(state.data(), state.size()));
+  CHECK(SaveState(&copy) == state);
+  // The frame the state was saved in the middle of is only rendered from
+  // there on, so frames only match from the next one.
+  original.RunFrame();
+  copy.RunFrame();
+  for (size_t i = 0; i < 5; i++) {
+    original.RunFrame();
+    copy.RunFrame();
+    CHECK(FrameHash(&copy) == FrameHash(&original));
+  }
+  CHECK(SaveState(&copy) == SaveState(&original));
+}
+
+TEST_CASE("Damaged or foreign states are rejected", "[state]") {
+  const Cartridge cart = MakeTestCartridge(kStateProgram);
+  Emulator original(cart, EmulatorOptions());
+  Emulator other(cart, EmulatorOptions());
+  for (size_t i = 0; i < 3; i++) {
+    original.RunFrame();
+  }
+  const std::vector<uint8_t> state = SaveState(&original);
+  other.RunFrame();
+  const std::vector<uint8_t> other_state = SaveState(&other);
+
+  SECTION("with a corrupted checksum") {
+    // The checksum is the last field of the header: magic, version, the
+    // cartridge's checksums, colour flag and RAM banks, and the raw and
+    // compressed sizes come before it.
+    constexpr size_t kChecksumOffset = 4 + 2 + 2 + 1 + 1 + 4 + 4 + 4;
+    std::vector<uint8_t> damaged = state;
+    damaged[kChecksumOffset] ^= 0x01;
+    CHECK_FALSE(other.LoadState(damaged.data(), damaged.size()));
+  }
+  SECTION("with corrupted contents") {
+    std::vector<uint8_t> damaged = state;
+    damaged[damaged.size() - 10] ^= 0x10;
+    CHECK_FALSE(other.LoadState(damaged.data(), damaged.size()));
+  }
+  SECTION("truncated") {
+    CHECK_FALSE(other.LoadState(state.data(), state.size() - 1));
+    CHECK_FALSE(other.LoadState(state.data(), 10));
+    CHECK_FALSE(other.LoadState(state.data(), 0));
+  }
+  SECTION("from another cartridge") {
+    std::vector<uint8_t> rom = MakeTestRom(kStateProgram);
+    rom[0x14E] ^= 0xFF;
+    const Cartridge other_cart = LoadTestCartridge(rom);
+    Emulator foreign(other_cart, EmulatorOptions());
+    CHECK_FALSE(foreign.LoadState(state.data(), state.size()));
+  }
+  // Rejected states leave the emulator as it was.
+  CHECK(SaveState(&other) == other_state);
+}
+
+// Run with "[.benchmark]" to time saving and loading the state of a
+// cartridge with 32 KB of RAM.
+TEST_CASE("State timing", "[.benchmark][state]") {
+  constexpr size_t kIterations = 10000;
+  std::vector<uint8_t> rom = MakeTestRom(kStateProgram);
+  rom[0x149] = 0x03;
+  const Cartridge cart = LoadTestCartridge(rom);
+  using Clock = std::chrono::steady_clock;
+  Emulator emulator(cart, EmulatorOptions());
+  for (size_t i = 0; i < 10; i++) {
+    emulator.RunFrame();
+  }
+
+  std::vector<uint8_t> state(emulator.MaxSaveStateSize());
+  size_t size = 0;
+  const Clock::time_point save_start = Clock::now();
+  for (size_t i = 0; i < kIterations; i++) {
+    size = emulator.SaveState(state.data(), state.size());
+  }
+  const Clock::duration save = Clock::now() - save_start;
+  REQUIRE(size != 0);
+
+  const Clock::time_point load_start = Clock::now();
+  for (size_t i = 0; i < kIterations; i++) {
+    REQUIRE(emulator.LoadState(state.data(), size));
+  }
+  const Clock::duration load = Clock::now() - load_start;
+
+  using Microseconds = std::chrono::duration<double, std::micro>;
+  WARN(size << " byte state; save " << Microseconds(save).count() / kIterations
+            << " us, load " << Microseconds(load).count() / kIterations
+            << " us");
+}
+
+}  // namespace
+}  // namespace gamebun
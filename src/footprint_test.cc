@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "apu.h"
+#include "cartridge.h"
+#include "emulator.h"
+#include "frame_buffers.h"
+#include "palette.h"
+#include "scanline_renderer.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+constexpr size_t kTargetFootprint = 64 * 1024;
+
+// Fills video RAM, so that the background shows tile 0xAA everywhere, and
+// turns the LCD and background on.
+const std::vector<uint8_t> kBackgroundProgram = {
+    0x21, 0x00, 0x80,  // 0x100: LD HL, 0x8000
+    0x0E, 0xAA,        // 0x103: LD C, 0xAA
+    0x79,              // 0x105: LD A, C
+    0x22,              // 0x106: LD (HL+), A
+    0x7C,              // 0x107: LD A, H
+    0xFE, 0xA0,        // 0x108: CP 0xA0
+    0x20, 0xF9,        // 0x10A: JR NZ, 0x105
+    0x3E, 0x91,        // 0x10C: LD A, 0x91
+    0xE0, 0x40,        // 0x10E: LDH (0x40), A
+    0x18, 0xFE,        // 0x110: JR 0x110
+};
+
+// The footprint of a DMG emulator after running `frames` frames and reading
+// the audio each one. It renders into frame buffers of the caller's unless
+// `internal_frame_buffers` is set.
+EmulatorFootprint RunningFootprint(
+    AudioMode audio_mode, size_t frames, bool internal_frame_buffers = false,
+    PixelFormat format = PixelFormat::kRgba8888) {
+  const Cartridge cart = MakeTestCartridge(kBackgroundProgram);
+  std::vector<std::vector<uint8_t>> frame_memory(
+      2, std::vector<uint8_t>(kScreenHeight * kScreenWidth * 4));
+  EmulatorOptions options;
+  if (!internal_frame_buffers) {
+    options.frame_buffers.memory = {frame_memory[0].data(),
+                                    frame_memory[1].data()};
+  }
+  options.pixel_format = format;
+  options.audio.mode = audio_mode;
+  Emulator emulator(cart, options);
+
+  std::vector<int16_t> samples(2 * 4096);
+  for (size_t i = 0; i < frames; i++) {
+    emulator.RunFrame();
+    while (emulator.ReadAudio(samples.data(), samples.size() / 2) != 0) {
+    }
+  }
+  return emulator.Footprint();
+}
+
+TEST_CASE("A running DMG emulator takes under 64 KB", "[footprint]") {
+  SECTION("with synthesized audio") {
+    const EmulatorFootprint footprint =
+        RunningFootprint(AudioMode::kSynthesized, 120);
+    INFO("object " << footprint.object << ", arena "
+                   << footprint.arena_resident << " of "
+                   << footprint.arena_mapped << ", cartridge RAM "
+                   << footprint.private_ram);
+    CHECK(footprint.private_total() < kTargetFootprint);
+  }
+  SECTION("with only the sound registers") {
+    const EmulatorFootprint footprint =
+        RunningFootprint(AudioMode::kRegistersOnly, 120);
+    INFO("object " << footprint.object << ", arena "
+                   << footprint.arena_resident << " of "
+                   << footprint.arena_mapped << ", cartridge RAM "
+                   << footprint.private_ram);
+    CHECK(footprint.private_total() < kTargetFootprint);
+  }
+}
+
+// Run with "[.benchmark]" to report the footprint in each configuration.
+TEST_CASE("Footprint report", "[.benchmark][footprint]") {
+  const auto report = [](const char* name,
+                         const EmulatorFootprint& footprint) {
+    WARN(name << ": " << footprint.private_total() / 1024
+              << " KB private; object " << footprint.object << ", arena "
+              << footprint.arena_resident << " of " << footprint.arena_mapped
+              << ", cartridge RAM " << footprint.private_ram);
+  };
+  report("synthesized audio", RunningFootprint(AudioMode::kSynthesized, 120));
+  report("registers-only audio",
+         RunningFootprint(AudioMode::kRegistersOnly, 120));
+  report("internal RGBA frame buffers",
+         RunningFootprint(AudioMode::kSynthesized, 120, true));
+  report("internal RGB565 frame buffers",
+         RunningFootprint(AudioMode::kSynthesized, 120, true,
+                          PixelFormat::kRgb565));
+}
+
+TEST_CASE("Emulators of a cartridge share its ROM", "[footprint]") {
+  const Cartridge cart = MakeTestCartridge(kBackgroundProgram);
+  Emulator first(cart, EmulatorOptions());
+  Emulator second(cart, EmulatorOptions());
+  CHECK(cart.rom_banks.use_count() >= 3);
+  CHECK(first.Footprint().shared_rom ==
+        cart.rom_banks->size() * kRomBankSize.value());
+  CHECK(second.Footprint().shared_rom == first.Footprint().shared_rom);
+}
+
+}  // namespace
+}  // namespace gamebun
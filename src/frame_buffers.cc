@@ -0,0 +1,127 @@
+#include "frame_buffers.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "arena.h"
+#include "frame_hash.h"
+#include "palette.h"
+#include "scanline_renderer.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+FrameBuffers::FrameBuffers(PixelFormat format,
+                           const FrameBufferOptions& options, Arena* arena)
+    : count_(options.count),
+      line_size_(kScreenWidth * BytesPerPixel(format)),
+      pitch_(options.pitch == 0 ? line_size_ : options.pitch),
+      buffers_(),
+      hashes_(),
+      rendered_lines_(),
+      back_(1),
+      completed_(0),
+      latest_(0),
+      sequence_(0),
+      repeated_(false),
+      borrowers_() {
+  if (count_ < 2 || count_ > kMaxFrameBuffers) {
+    FATAL("Unsupported frame buffer count %zu", count_);
+  }
+  if (pitch_ < line_size_) {
+    FATAL("Frame buffer pitch %zu is shorter than a line", pitch_);
+  }
+
+  const size_t buffer_size = kScreenHeight * pitch_;
+  if (options.memory[0] == nullptr) {
+    uint8_t* const storage = arena->Allocate<uint8_t>(count_ * buffer_size);
+    for (size_t i = 0; i < count_; i++) {
+      buffers_[i] = &storage[i * buffer_size];
+    }
+  } else {
+    for (size_t i = 0; i < count_; i++) {
+      if (options.memory[i] == nullptr) {
+        FATAL("Missing memory for frame buffer %zu", i);
+      }
+      buffers_[i] = options.memory[i];
+      std::memset(buffers_[i], 0, buffer_size);
+    }
+  }
+  hashes_[latest_] =
+      HashFrame(buffers_[latest_], pitch_, line_size_, kScreenHeight);
+}
+
+uint8_t* FrameBuffers::Line(uint8_t ly) {
+  rendered_lines_.set(ly);
+  return &buffers_[back_][ly * pitch_];
+}
+
+void FrameBuffers::EndFrame(bool wait) {
+  completed_++;
+  if (rendered_lines_.none()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sequence_ = completed_;
+    repeated_ = true;
+    return;
+  }
+
+  // Only the renderer changes latest_, so it can be read here unlocked.
+  if (!rendered_lines_.all()) {
+    for (size_t ly = 0; ly < kScreenHeight; ly++) {
+      if (!rendered_lines_[ly]) {
+        std::memcpy(&buffers_[back_][ly * pitch_],
+                    &buffers_[latest_][ly * pitch_], line_size_);
+      }
+    }
+  }
+  // Hashing here keeps it on the rendering thread, off the emulation thread
+  // when rendering is deferred.
+  hashes_[back_] =
+      HashFrame(buffers_[back_], pitch_, line_size_, kScreenHeight);
+
+  // Any buffer other than `excluded` that no consumer holds can be rendered
+  // into next.
+  const auto find_free = [this](size_t excluded) {
+    for (size_t i = 0; i < count_; i++) {
+      if (i != excluded && borrowers_[i] == 0) {
+        return i;
+      }
+    }
+    return count_;
+  };
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!wait && find_free(back_) == count_) {
+    // The back buffer now holds the whole frame, which the next one is
+    // rendered over.
+    rendered_lines_.set();
+    return;
+  }
+  rendered_lines_.reset();
+  latest_ = back_;
+  sequence_ = completed_;
+  repeated_ = false;
+  released_.wait(lock, [this, &find_free] {
+    back_ = find_free(latest_);
+    return back_ != count_;
+  });
+}
+
+Frame FrameBuffers::Acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  borrowers_[latest_]++;
+  return {buffers_[latest_], pitch_, sequence_, repeated_, hashes_[latest_],
+          latest_};
+}
+
+void FrameBuffers::Release(const Frame& frame) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    borrowers_[frame.buffer]--;
+  }
+  released_.notify_all();
+}
+
+}  // namespace gamebun
@@ -0,0 +1,110 @@
+#ifndef FRAME_BUFFERS_H_
+#define FRAME_BUFFERS_H_
+
+#include <array>
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "palette.h"
+#include "scanline_renderer.h"
+
+namespace gamebun {
+
+class Arena;
+
+inline constexpr size_t kMaxFrameBuffers = 3;
+
+struct FrameBufferOptions {
+  // Either 2 or 3. With two buffers, a frame completed while the previous
+  // one is still held cannot be published until it is released: rendering
+  // on a worker waits for that, while rendering inline, which may be on the
+  // very thread holding the frame, drops the new frame instead. With three,
+  // a consumer holding one frame at a time never holds up rendering.
+  size_t count = 2;
+  // The first `count` entries may point at caller-owned buffers of at least
+  // kScreenHeight * `pitch` bytes each, such as a shared memory region, which
+  // must outlive the emulator. If they are null, the buffers are allocated
+  // with the emulator.
+  std::array<uint8_t*, kMaxFrameBuffers> memory = {};
+  // Bytes from the start of one line to the next, or 0 to pack lines
+  // together.
+  size_t pitch = 0;
+};
+
+// A completed frame lent out by FrameBuffers. Its pixels do not change until
+// it is released.
+struct Frame {
+  const uint8_t* pixels;
+  size_t pitch;
+  // Counts completed frames from 1, including those dropped rather than
+  // published, so that a frame's number only depends on how far emulation
+  // has got. Frame 0 is the blank picture shown before the first frame
+  // completes.
+  uint64_t sequence;
+  // Whether nothing visible changed since the previous frame, in which case
+  // this frame shares the previous frame's buffer.
+  bool repeated;
+  // HashFrame() of the visible pixels, computed as the frame is published.
+  uint64_t hash;
+  size_t buffer;
+};
+
+// Rotates frames between a fixed set of buffers so that consumers can read a
+// completed frame in place while the next one is rendered, without copying or
+// allocating anything per frame. The renderer is the only producer, and may
+// run on a different thread from the consumers.
+class FrameBuffers {
+ public:
+  // Buffers that are not caller-owned come from `arena`.
+  FrameBuffers(PixelFormat format, const FrameBufferOptions& options,
+               Arena* arena);
+
+  // Returns line `ly` of the frame being rendered. Called by the renderer.
+  uint8_t* Line(uint8_t ly);
+
+  // Publishes the frame being rendered as the latest frame, and waits for a
+  // buffer to render the next one into. Lines that were not rendered are
+  // carried over from the previous frame, and a frame with no rendered lines
+  // is published as a repeat of the previous frame. Called by the renderer.
+  //
+  // If `wait` is false and consumers hold every other buffer, the frame is
+  // not published, and the next one is rendered over it, so that this never
+  // blocks.
+  void EndFrame(bool wait);
+
+  // Borrows the latest frame. Safe to call from any thread.
+  Frame Acquire();
+  // Returns a frame from Acquire(). Safe to call from any thread.
+  void Release(const Frame& frame);
+
+  FrameBuffers(const FrameBuffers&) = delete;
+  FrameBuffers& operator=(const FrameBuffers&) = delete;
+
+ private:
+  const size_t count_;
+  const size_t line_size_;
+  const size_t pitch_;
+  std::array<uint8_t*, kMaxFrameBuffers> buffers_;
+  std::array<uint64_t, kMaxFrameBuffers> hashes_;
+
+  // Only touched by the renderer.
+  std::bitset<kScreenHeight> rendered_lines_;
+  size_t back_;
+  // Frames completed so far, published or dropped.
+  uint64_t completed_;
+
+  std::mutex mutex_;
+  std::condition_variable released_;
+  size_t latest_;
+  // The number of the latest frame.
+  uint64_t sequence_;
+  bool repeated_;
+  std::array<size_t, kMaxFrameBuffers> borrowers_;
+};
+
+}  // namespace gamebun
+
+#endif  // FRAME_BUFFERS_H_
@@ -0,0 +1,71 @@
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.h"
+#include "frame_buffers.h"
+#include "palette.h"
+#include "scanline_renderer.h"
+
+namespace gamebun {
+namespace {
+
+void RenderFrame(FrameBuffers* frame_buffers, uint8_t value, bool wait) {
+  for (size_t ly = 0; ly < kScreenHeight; ly++) {
+    uint8_t* const line = frame_buffers->Line(static_cast<uint8_t>(ly));
+    for (size_t x = 0; x < kScreenWidth * 4; x++) {
+      line[x] = value;
+    }
+  }
+  frame_buffers->EndFrame(wait);
+}
+
+TEST_CASE("Frames are dropped rather than waited for when not waiting",
+          "[frame_buffers]") {
+  Arena arena(1 << 20, false);
+  FrameBuffers frame_buffers(PixelFormat::kRgba8888, FrameBufferOptions(),
+                             &arena);
+  RenderFrame(&frame_buffers, 1, /*wait=*/false);
+  const Frame held = frame_buffers.Acquire();
+  CHECK(held.sequence == 1);
+
+  // With both buffers taken, these would wait forever.
+  RenderFrame(&frame_buffers, 2, /*wait=*/false);
+  RenderFrame(&frame_buffers, 3, /*wait=*/false);
+  const Frame latest = frame_buffers.Acquire();
+  CHECK(latest.sequence == 1);
+  CHECK(latest.pixels[0] == 1);
+  frame_buffers.Release(latest);
+  frame_buffers.Release(held);
+
+  // Dropped frames still count.
+  RenderFrame(&frame_buffers, 4, /*wait=*/false);
+  const Frame next = frame_buffers.Acquire();
+  CHECK(next.sequence == 4);
+  CHECK(next.pixels[0] == 4);
+  frame_buffers.Release(next);
+}
+
+TEST_CASE("A dropped frame carries its lines over to the next one",
+          "[frame_buffers]") {
+  Arena arena(1 << 20, false);
+  FrameBuffers frame_buffers(PixelFormat::kRgba8888, FrameBufferOptions(),
+                             &arena);
+  RenderFrame(&frame_buffers, 1, /*wait=*/false);
+  const Frame held = frame_buffers.Acquire();
+  RenderFrame(&frame_buffers, 2, /*wait=*/false);
+  frame_buffers.Release(held);
+
+  // Only the first line is rendered, and the rest are those of the dropped
+  // frame rather than of the one published before it.
+  frame_buffers.Line(0)[0] = 3;
+  frame_buffers.EndFrame(/*wait=*/false);
+  const Frame next = frame_buffers.Acquire();
+  CHECK(next.pixels[0] == 3);
+  CHECK(next.pixels[next.pitch] == 2);
+  frame_buffers.Release(next);
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -0,0 +1,159 @@
+#include "frame_hash.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace gamebun {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "pixels are hashed as little-endian 64-bit words");
+
+namespace {
+
+// Each line is consumed in 64-byte stripes by 8 independent 64-bit lanes, in
+// the style of XXH3: every word is mixed with a key through a 32x32-bit
+// multiply, which SIMD units do natively, and also added to the neighboring
+// lane. The keys change from stripe to stripe and the lanes are scrambled
+// after every line, so moving a stripe or a line changes the hash.
+constexpr size_t kLanes = 8;
+constexpr size_t kStripeSize = kLanes * sizeof(uint64_t);
+
+using Lanes = std::array<uint64_t, kLanes>;
+
+constexpr Lanes kKeys = {0xBE4BA423396CFEB8, 0x1CAD21F72C81017C,
+                         0xDB979083E96DD4DE, 0x1F67B3B7A4A44072,
+                         0x78E5C0CC4EE679CB, 0x2172FFCC7DD05A82,
+                         0x8E2443F7744608B8, 0x4C263A81E69035E0};
+constexpr uint64_t kKeyStep = 0x9E3779B97F4A7C15;
+constexpr uint64_t kScramblePrime = 0x9E3779B1;
+
+void AccumulateLine(const uint8_t* line, size_t stripe_count, Lanes* acc) {
+  size_t stripe = 0;
+#if defined(__AVX2__)
+  {
+    __m256i acc_lo =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(&(*acc)[0]));
+    __m256i acc_hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(&(*acc)[4]));
+    __m256i key_lo =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(&kKeys[0]));
+    __m256i key_hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(&kKeys[4]));
+    const __m256i step = _mm256_set1_epi64x(static_cast<int64_t>(kKeyStep));
+    const auto accumulate = [](__m256i acc_ymm, __m256i data, __m256i key) {
+      const __m256i mixed = _mm256_xor_si256(data, key);
+      const __m256i product =
+          _mm256_mul_epu32(mixed, _mm256_srli_epi64(mixed, 32));
+      const __m256i swapped = _mm256_shuffle_epi32(data, 0x4E);
+      return _mm256_add_epi64(acc_ymm, _mm256_add_epi64(product, swapped));
+    };
+    for (; stripe < stripe_count; stripe++) {
+      const uint8_t* data = &line[stripe * kStripeSize];
+      acc_lo = accumulate(
+          acc_lo,
+          _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(&data[0])),
+          key_lo);
+      acc_hi = accumulate(
+          acc_hi,
+          _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(&data[32])),
+          key_hi);
+      key_lo = _mm256_add_epi64(key_lo, step);
+      key_hi = _mm256_add_epi64(key_hi, step);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i_u*>(&(*acc)[0]), acc_lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i_u*>(&(*acc)[4]), acc_hi);
+  }
+#elif defined(__SSE2__)
+  {
+    constexpr size_t kRegisters = kLanes / 2;
+    __m128i acc_xmm[kRegisters];
+    __m128i key_xmm[kRegisters];
+    for (size_t i = 0; i < kRegisters; i++) {
+      acc_xmm[i] =
+          _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(&(*acc)[i * 2]));
+      key_xmm[i] =
+          _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(&kKeys[i * 2]));
+    }
+    const __m128i step = _mm_set1_epi64x(static_cast<int64_t>(kKeyStep));
+    for (; stripe < stripe_count; stripe++) {
+      const uint8_t* data = &line[stripe * kStripeSize];
+      for (size_t i = 0; i < kRegisters; i++) {
+        const __m128i words =
+            _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(&data[i * 16]));
+        const __m128i mixed = _mm_xor_si128(words, key_xmm[i]);
+        const __m128i product =
+            _mm_mul_epu32(mixed, _mm_srli_epi64(mixed, 32));
+        const __m128i swapped = _mm_shuffle_epi32(words, 0x4E);
+        acc_xmm[i] =
+            _mm_add_epi64(acc_xmm[i], _mm_add_epi64(product, swapped));
+        key_xmm[i] = _mm_add_epi64(key_xmm[i], step);
+      }
+    }
+    for (size_t i = 0; i < kRegisters; i++) {
+      _mm_storeu_si128(reinterpret_cast<__m128i_u*>(&(*acc)[i * 2]),
+                       acc_xmm[i]);
+    }
+  }
+#endif
+  for (; stripe < stripe_count; stripe++) {
+    Lanes words;
+    std::memcpy(words.data(), &line[stripe * kStripeSize], kStripeSize);
+    for (size_t i = 0; i < kLanes; i++) {
+      const uint64_t mixed = words[i] ^ (kKeys[i] + stripe * kKeyStep);
+      (*acc)[i] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+      (*acc)[i ^ 1] += words[i];
+    }
+  }
+}
+
+void ScrambleLanes(Lanes* acc) {
+  for (size_t i = 0; i < kLanes; i++) {
+    uint64_t lane = (*acc)[i];
+    lane ^= lane >> 47;
+    lane ^= kKeys[i];
+    (*acc)[i] = lane * kScramblePrime;
+  }
+}
+
+uint64_t Avalanche(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCD;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+}  // namespace
+
+uint64_t HashFrame(const uint8_t* pixels, size_t pitch, size_t line_size,
+                   size_t line_count) {
+  const size_t stripe_count = line_size / kStripeSize;
+  const size_t tail_size = line_size % kStripeSize;
+
+  Lanes acc = kKeys;
+  for (size_t line = 0; line < line_count; line++) {
+    const uint8_t* data = &pixels[line * pitch];
+    AccumulateLine(data, stripe_count, &acc);
+    if (tail_size != 0) {
+      std::array<uint8_t, kStripeSize> tail{};
+      std::memcpy(tail.data(), &data[stripe_count * kStripeSize], tail_size);
+      AccumulateLine(tail.data(), 1, &acc);
+    }
+    ScrambleLanes(&acc);
+  }
+
+  uint64_t hash = (line_size * line_count) * kKeyStep;
+  for (const uint64_t lane : acc) {
+    hash = Avalanche(hash ^ lane);
+  }
+  return hash;
+}
+
+}  // namespace gamebun
@@ -0,0 +1,18 @@
+#ifndef FRAME_HASH_H_
+#define FRAME_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gamebun {
+
+// Hashes `line_count` lines of `line_size` bytes each, starting `pitch` bytes
+// apart, into 64 bits. The result depends only on the bytes hashed, so it is
+// the same for every host, build and pitch. It is meant for telling frames
+// apart, not for resisting deliberate collisions.
+uint64_t HashFrame(const uint8_t* pixels, size_t pitch, size_t line_size,
+                   size_t line_count);
+
+}  // namespace gamebun
+
+#endif  // FRAME_HASH_H_
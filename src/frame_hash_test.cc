@@ -0,0 +1,129 @@
+#include "frame_hash.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace gamebun {
+namespace {
+
+constexpr std::array<uint64_t, 8> kKeys = {
+    0xBE4BA423396CFEB8, 0x1CAD21F72C81017C, 0xDB979083E96DD4DE,
+    0x1F67B3B7A4A44072, 0x78E5C0CC4EE679CB, 0x2172FFCC7DD05A82,
+    0x8E2443F7744608B8, 0x4C263A81E69035E0};
+constexpr uint64_t kKeyStep = 0x9E3779B97F4A7C15;
+
+uint64_t Avalanche(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCD;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// HashFrame() a word at a time, as it is specified. A line's last partial
+// stripe is zero-padded and keyed as if it were the line's first.
+uint64_t ReferenceHash(const uint8_t* pixels, size_t pitch, size_t line_size,
+                       size_t line_count) {
+  std::array<uint64_t, 8> acc = kKeys;
+  for (size_t line = 0; line < line_count; line++) {
+    for (size_t start = 0; start < line_size; start += 64) {
+      uint8_t stripe[64] = {};
+      const size_t size = std::min<size_t>(64, line_size - start);
+      std::memcpy(stripe, &pixels[line * pitch + start], size);
+      const uint64_t key_offset = size == 64 ? start / 64 * kKeyStep : 0;
+      for (size_t i = 0; i < 8; i++) {
+        uint64_t word;
+        std::memcpy(&word, &stripe[i * 8], sizeof(word));
+        const uint64_t mixed = word ^ (kKeys[i] + key_offset);
+        acc[i] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+        acc[i ^ 1] += word;
+      }
+    }
+    for (size_t i = 0; i < 8; i++) {
+      const uint64_t lane = acc[i] ^ (acc[i] >> 47) ^ kKeys[i];
+      acc[i] = lane * 0x9E3779B1;
+    }
+  }
+  uint64_t hash = line_size * line_count * kKeyStep;
+  for (const uint64_t lane : acc) {
+    hash = Avalanche(hash ^ lane);
+  }
+  return hash;
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, std::mt19937* random) {
+  std::vector<uint8_t> data(size);
+  for (uint8_t& byte : data) {
+    byte = static_cast<uint8_t>((*random)());
+  }
+  return data;
+}
+
+TEST_CASE("Frame hashes match a word-at-a-time hash", "[frame_hash]") {
+  std::mt19937 random(7);
+  // Lines of whole stripes, as of RGBA and RGB565 screens, and with tails
+  // of various sizes.
+  for (const size_t line_size : {0, 1, 8, 63, 64, 65, 200, 320, 640, 700}) {
+    for (const size_t line_count : {0, 1, 3, 144}) {
+      // Lines packed together, and with bytes between them that are not
+      // hashed.
+      for (const size_t pitch : {line_size, line_size + 13}) {
+        INFO(line_count << " lines of " << line_size << " bytes, " << pitch
+                        << " apart");
+        const std::vector<uint8_t> pixels =
+            RandomBytes(pitch * line_count + 1, &random);
+        CHECK(HashFrame(pixels.data(), pitch, line_size, line_count) ==
+              ReferenceHash(pixels.data(), pitch, line_size, line_count));
+      }
+    }
+  }
+}
+
+TEST_CASE("Frame hashes depend only on the bytes hashed", "[frame_hash]") {
+  constexpr size_t kLineSize = 640;
+  constexpr size_t kLineCount = 144;
+  std::mt19937 random(9);
+  const std::vector<uint8_t> packed =
+      RandomBytes(kLineSize * kLineCount, &random);
+  const uint64_t hash = HashFrame(packed.data(), kLineSize, kLineSize,
+                                  kLineCount);
+
+  constexpr size_t kPitch = 768;
+  std::vector<uint8_t> padded = RandomBytes(kPitch * kLineCount, &random);
+  for (size_t line = 0; line < kLineCount; line++) {
+    std::memcpy(&padded[line * kPitch], &packed[line * kLineSize],
+                kLineSize);
+  }
+  CHECK(HashFrame(padded.data(), kPitch, kLineSize, kLineCount) == hash);
+
+  // Any one byte changing, or two lines swapping, changes the hash.
+  std::vector<uint8_t> changed = packed;
+  changed[kLineSize * 100 + 17] ^= 0x20;
+  CHECK(HashFrame(changed.data(), kLineSize, kLineSize, kLineCount) != hash);
+  changed = packed;
+  std::swap_ranges(&changed[0], &changed[kLineSize],
+                   &changed[kLineSize * 5]);
+  CHECK(HashFrame(changed.data(), kLineSize, kLineSize, kLineCount) != hash);
+}
+
+TEST_CASE("Frame hashes are the same on every build", "[frame_hash]") {
+  // Golden logs recorded on one host are checked on others, so the hash of
+  // a given frame may never change.
+  std::vector<uint8_t> pixels(640 * 144);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = static_cast<uint8_t>(i * 7 + i / 640);
+  }
+  CHECK(HashFrame(pixels.data(), 640, 640, 144) == 0x6B0525422793F267);
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -0,0 +1,159 @@
+#include "gamebun.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "apu.h"
+#include "cartridge.h"
+#include "emulator.h"
+#include "frame_buffers.h"
+#include "joypad.h"
+#include "palette.h"
+#include "scanline_renderer.h"
+
+using ::gamebun::AudioMode;
+using ::gamebun::Button;
+using ::gamebun::Cartridge;
+using ::gamebun::Emulator;
+using ::gamebun::EmulatorOptions;
+using ::gamebun::Frame;
+using ::gamebun::IsValidCartridge;
+using ::gamebun::JoypadEvent;
+using ::gamebun::PixelFormat;
+
+namespace {
+
+Cartridge ReadCartridge(const uint8_t* rom, size_t rom_size) {
+  std::istringstream stream(
+      std::string(reinterpret_cast<const char*>(rom), rom_size));
+  return Cartridge(&stream);
+}
+
+EmulatorOptions ToEmulatorOptions(const GameBunOptions* options) {
+  EmulatorOptions emulator_options;
+  if (options == nullptr) {
+    emulator_options.audio.mode = AudioMode::kRegistersOnly;
+    return emulator_options;
+  }
+  emulator_options.pixel_format = options->pixel_format == GAMEBUN_PIXEL_RGB565
+                                      ? PixelFormat::kRgb565
+                                      : PixelFormat::kRgba8888;
+  if (options->sample_rate == 0) {
+    emulator_options.audio.mode = AudioMode::kRegistersOnly;
+  } else {
+    emulator_options.audio.sample_rate = options->sample_rate;
+  }
+  return emulator_options;
+}
+
+}  // namespace
+
+struct GameBun {
+  GameBun(const uint8_t* rom, size_t rom_size, const GameBunOptions* options)
+      : options(ToEmulatorOptions(options)),
+        emulator(ReadCartridge(rom, rom_size), this->options),
+        frame(),
+        audio(2 * this->options.audio.buffer_samples),
+        buttons(0),
+        queued_buttons(0) {}
+
+  // Gives back the frame lent out by gamebun_frame(), which would otherwise
+  // hold up rendering.
+  void ReleaseFrame() {
+    if (frame.pixels != nullptr) {
+      emulator.ReleaseFrame(frame);
+      frame.pixels = nullptr;
+    }
+  }
+
+  // Queues an event for each button whose state differs from the last one
+  // queued for it. Events stamped at cycle 0 are already due, so they apply
+  // right away. Should the queue be full, the rest are left for the next
+  // call, by which time only the latest state of each button is queued.
+  void QueueButtons() {
+    const uint8_t changed = queued_buttons ^ buttons;
+    for (unsigned bit = 1; bit <= 0x80; bit <<= 1) {
+      if ((changed & bit) == 0) {
+        continue;
+      }
+      if (!emulator.QueueInput({0, JoypadEvent::TimeUnit::kCycles,
+                                static_cast<Button>(bit),
+                                (buttons & bit) != 0})) {
+        return;
+      }
+      queued_buttons ^= bit;
+    }
+  }
+
+  const EmulatorOptions options;
+  Emulator emulator;
+  Frame frame;
+  std::vector<int16_t> audio;
+  // The buttons last set, and those the emulator has been told of.
+  uint8_t buttons;
+  uint8_t queued_buttons;
+};
+
+int gamebun_api_version() { return GAMEBUN_API_VERSION; }
+
+GameBun* gamebun_create(const uint8_t* rom, size_t rom_size,
+                        const GameBunOptions* options) {
+  if (rom == nullptr || !IsValidCartridge(rom, rom_size)) {
+    return nullptr;
+  }
+  return new GameBun(rom, rom_size, options);
+}
+
+void gamebun_destroy(GameBun* gamebun) {
+  if (gamebun != nullptr) {
+    gamebun->ReleaseFrame();
+  }
+  delete gamebun;
+}
+
+uint64_t gamebun_run_frames(GameBun* gamebun, uint32_t frames) {
+  gamebun->ReleaseFrame();
+  uint64_t cycles = 0;
+  for (uint32_t i = 0; i < frames; i++) {
+    gamebun->QueueButtons();
+    cycles += gamebun->emulator.RunFrame().cycles;
+  }
+  return cycles;
+}
+
+void gamebun_set_buttons(GameBun* gamebun, uint8_t buttons) {
+  gamebun->buttons = buttons;
+  gamebun->QueueButtons();
+}
+
+const uint8_t* gamebun_frame(GameBun* gamebun, uint32_t* width,
+                             uint32_t* height, size_t* pitch) {
+  gamebun->ReleaseFrame();
+  gamebun->frame = gamebun->emulator.AcquireFrame();
+  *width = gamebun::kScreenWidth;
+  *height = gamebun::kScreenHeight;
+  *pitch = gamebun->frame.pitch;
+  return gamebun->frame.pixels;
+}
+
+const int16_t* gamebun_audio(GameBun* gamebun, size_t* count) {
+  *count = gamebun->emulator.ReadAudio(gamebun->audio.data(),
+                                       gamebun->audio.size() / 2);
+  return gamebun->audio.data();
+}
+
+size_t gamebun_state_size(GameBun* gamebun) {
+  return gamebun->emulator.MaxSaveStateSize();
+}
+
+size_t gamebun_save_state(GameBun* gamebun, void* buffer, size_t size) {
+  return gamebun->emulator.SaveState(buffer, size);
+}
+
+int gamebun_load_state(GameBun* gamebun, const void* buffer, size_t size) {
+  gamebun->ReleaseFrame();
+  return gamebun->emulator.LoadState(buffer, size) ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#ifndef GAMEBUN_H_
+#define GAMEBUN_H_
+
+/*
+ * C interface to the emulator, for embedding it through libgamebun.a or
+ * libgamebun.so. Apart from gamebun_create() and gamebun_destroy(), no call
+ * allocates memory. An emulator may be used from any one thread at a time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GAMEBUN_EXPORT __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented whenever the interface changes incompatibly. */
+#define GAMEBUN_API_VERSION 1
+
+typedef struct GameBun GameBun;
+
+typedef enum {
+  GAMEBUN_PIXEL_RGBA8888 = 0,
+  GAMEBUN_PIXEL_RGB565 = 1,
+} GameBunPixelFormat;
+
+/* Bits of the mask passed to gamebun_set_buttons(). */
+typedef enum {
+  GAMEBUN_BUTTON_RIGHT = 0x01,
+  GAMEBUN_BUTTON_LEFT = 0x02,
+  GAMEBUN_BUTTON_UP = 0x04,
+  GAMEBUN_BUTTON_DOWN = 0x08,
+  GAMEBUN_BUTTON_A = 0x10,
+  GAMEBUN_BUTTON_B = 0x20,
+  GAMEBUN_BUTTON_SELECT = 0x40,
+  GAMEBUN_BUTTON_START = 0x80,
+} GameBunButton;
+
+typedef struct {
+  GameBunPixelFormat pixel_format;
+  /* Audio is synthesized at this rate, or not at all if it is 0. */
+  uint32_t sample_rate;
+} GameBunOptions;
+
+GAMEBUN_EXPORT int gamebun_api_version(void);
+
+/*
+ * Creates an emulator running the cartridge ROM in `rom`, which is copied.
+ * `options` may be null for RGBA pixels and no audio. Returns null if the
+ * ROM is of an unknown cartridge type or shorter than its header says.
+ */
+GAMEBUN_EXPORT GameBun* gamebun_create(const uint8_t* rom, size_t rom_size,
+                                       const GameBunOptions* options);
+GAMEBUN_EXPORT void gamebun_destroy(GameBun* gamebun);
+
+/* Runs `frames` frames and returns the number of cycles that took. */
+GAMEBUN_EXPORT uint64_t gamebun_run_frames(GameBun* gamebun, uint32_t frames);
+
+/*
+ * Sets the buttons held from the current cycle on. Should more changes be
+ * made between runs than the emulator can take in, the buttons left over
+ * take their latest state when the next frame starts.
+ */
+GAMEBUN_EXPORT void gamebun_set_buttons(GameBun* gamebun, uint8_t buttons);
+
+/*
+ * Returns the pixels of the last completed frame, which stay valid until the
+ * next run. Lines are `*pitch` bytes apart.
+ */
+GAMEBUN_EXPORT const uint8_t* gamebun_frame(GameBun* gamebun, uint32_t* width,
+                                            uint32_t* height, size_t* pitch);
+
+/*
+ * Returns the stereo samples completed since the last call, left channel
+ * first, and stores their count in `*count`. They stay valid until the next
+ * call to gamebun_audio() or the next run.
+ */
+GAMEBUN_EXPORT const int16_t* gamebun_audio(GameBun* gamebun, size_t* count);
+
+/* Returns the most bytes gamebun_save_state() can write. */
+GAMEBUN_EXPORT size_t gamebun_state_size(GameBun* gamebun);
+/*
+ * Saves the emulator's state into `buffer` of `size` bytes, returning the
+ * number of bytes written or 0 on failure.
+ */
+GAMEBUN_EXPORT size_t gamebun_save_state(GameBun* gamebun, void* buffer,
+                                         size_t size);
+/* Restores a saved state, returning nonzero on success. */
+GAMEBUN_EXPORT int gamebun_load_state(GameBun* gamebun, const void* buffer,
+                                      size_t size);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // GAMEBUN_H_
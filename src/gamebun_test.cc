@@ -0,0 +1,88 @@
+#include "gamebun.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Enables cartridge RAM and writes to it, then selects ROM bank 0x1F, and
+// copies what it reads from the bank and from cartridge RAM into rows 0 and
+// 1 of tile 0, which fills the background.
+const std::vector<uint8_t> kBankProgram = {
+    0x3E, 0x0A,        // 0x100: LD A, 0x0A
+    0xEA, 0x00, 0x00,  // 0x102: LD (0x0000), A
+    0xEA, 0x00, 0xA0,  // 0x105: LD (0xA000), A
+    0x3E, 0x1F,        // 0x108: LD A, 0x1F
+    0xEA, 0x00, 0x20,  // 0x10A: LD (0x2000), A
+    0xFA, 0x00, 0x40,  // 0x10D: LD A, (0x4000)
+    0xEA, 0x00, 0x80,  // 0x110: LD (0x8000), A
+    0xEA, 0x01, 0x80,  // 0x113: LD (0x8001), A
+    0xFA, 0x00, 0xA0,  // 0x116: LD A, (0xA000)
+    0xEA, 0x02, 0x80,  // 0x119: LD (0x8002), A
+    0xEA, 0x03, 0x80,  // 0x11C: LD (0x8003), A
+    0x18, 0xFE,        // 0x11F: JR 0x11F
+};
+
+uint32_t Pixel(const uint8_t* pixels, size_t pitch, size_t y, size_t x) {
+  uint32_t pixel;
+  std::memcpy(&pixel, pixels + y * pitch + x * 4, sizeof(pixel));
+  return pixel;
+}
+
+TEST_CASE("Banks past the end of the cartridge are never reached",
+          "[gamebun]") {
+  // A 32 KB MBC1 cartridge without RAM, so bank 0x1F is bank 1 again.
+  std::vector<uint8_t> rom = MakeTestRom(kBankProgram);
+  rom[0x149] = 0x00;
+  rom[0x4000] = 0xF0;
+
+  GameBun* const gamebun = gamebun_create(rom.data(), rom.size(), nullptr);
+  REQUIRE(gamebun != nullptr);
+  gamebun_run_frames(gamebun, 3);
+  uint32_t width;
+  uint32_t height;
+  size_t pitch;
+  const uint8_t* const pixels =
+      gamebun_frame(gamebun, &width, &height, &pitch);
+  REQUIRE(width == 160);
+  REQUIRE(height == 144);
+
+  // Row 0 shows the 0xF0 at the start of bank 1: four pixels of color 3,
+  // then four of color 0.
+  const uint32_t dark = Pixel(pixels, pitch, 0, 0);
+  const uint32_t light = Pixel(pixels, pitch, 0, 4);
+  CHECK(dark != light);
+  for (size_t x = 0; x < 16; x++) {
+    INFO("x " << x);
+    CHECK(Pixel(pixels, pitch, 0, x) == (x % 8 < 4 ? dark : light));
+    // Missing cartridge RAM kept nothing and reads back as 0.
+    CHECK(Pixel(pixels, pitch, 1, x) == light);
+  }
+  gamebun_destroy(gamebun);
+}
+
+TEST_CASE("Unusable ROMs are rejected", "[gamebun]") {
+  std::vector<uint8_t> rom = MakeTestRom(kBankProgram);
+  CHECK(gamebun_create(nullptr, 0, nullptr) == nullptr);
+  CHECK(gamebun_create(rom.data(), 0x100, nullptr) == nullptr);
+  CHECK(gamebun_create(rom.data(), rom.size() - 1, nullptr) == nullptr);
+
+  SECTION("of an unknown cartridge type") {
+    rom[0x147] = 0xEE;
+    CHECK(gamebun_create(rom.data(), rom.size(), nullptr) == nullptr);
+  }
+  SECTION("of an unknown RAM size") {
+    rom[0x149] = 0x07;
+    CHECK(gamebun_create(rom.data(), rom.size(), nullptr) == nullptr);
+  }
+}
+
+}  // namespace
+}  // namespace gamebun
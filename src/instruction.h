@@ -5,7 +5,6 @@
 
 namespace gamebun {
 
-// TODO: Add CB prefix instructions
 enum class Opcode {
   LD,
   LDI,
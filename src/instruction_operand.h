@@ -43,14 +43,22 @@ struct AddressIndex {
 
 DEFINE_STRONG_INT_TYPE(ImmediateByte, uint8_t)
 DEFINE_STRONG_INT_TYPE(ImmediateBytePair, uint16_t)
+// An immediate byte that is a signed offset from the next instruction.
+DEFINE_STRONG_INT_TYPE(ImmediateByteAddress, uint8_t)
+// An immediate byte pair that is an address.
+DEFINE_STRONG_INT_TYPE(ImmediateBytePairAddress, uint16_t)
 
 struct ByteOperand {
   ByteOperand(RegisterByteIndex value) : value(value) {}
   ByteOperand(AddressIndex value) : value(value) {}
   ByteOperand(Address value) : value(value) {}
   ByteOperand(ImmediateByte value) : value(value) {}
+  ByteOperand(ImmediateByteAddress value) : value(value) {}
+  ByteOperand(ImmediateBytePairAddress value) : value(value) {}
 
-  std::variant<RegisterByteIndex, AddressIndex, Address, ImmediateByte> value;
+  std::variant<RegisterByteIndex, AddressIndex, Address, ImmediateByte,
+               ImmediateByteAddress, ImmediateBytePairAddress>
+      value;
 };
 
 struct BytePairOperand {
@@ -66,8 +74,30 @@ struct BitOperand {
   FlagIndex value;
 };
 
-using InstructionOperand =
-    std::variant<std::monostate, ByteOperand, BytePairOperand, BitOperand>;
+// The bit of a byte that BIT, SET and RES act on, encoded in the opcode.
+DEFINE_STRONG_INT_TYPE(BitIndex, uint8_t)
+
+using InstructionOperand = std::variant<std::monostate, ByteOperand,
+                                        BytePairOperand, BitOperand, BitIndex>;
+
+// Number of bytes following the opcode that `operand` is encoded in.
+inline size_t InstructionBytesConsumed(const InstructionOperand& operand) {
+  if (const ByteOperand* byte = std::get_if<ByteOperand>(&operand)) {
+    if (std::holds_alternative<ImmediateByte>(byte->value) ||
+        std::holds_alternative<ImmediateByteAddress>(byte->value)) {
+      return 1;
+    }
+    if (std::holds_alternative<ImmediateBytePairAddress>(byte->value)) {
+      return 2;
+    }
+  } else if (const BytePairOperand* pair =
+                 std::get_if<BytePairOperand>(&operand)) {
+    if (std::holds_alternative<ImmediateBytePair>(pair->value)) {
+      return 2;
+    }
+  }
+  return 0;
+}
 
 }  // namespace gamebun
 
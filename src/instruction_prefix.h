@@ -5,6 +5,7 @@
 #include "instruction_operand.h"
 #include "util/logging.h"
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 
@@ -387,6 +388,10 @@ constexpr const InstructionPrefixEntry GetInstructionPrefixInfo(
                       RegisterByteIndex::L));
     case 0x76:
       return InstructionPrefixEntry(Instruction(Opcode::HALT));
+    case 0x77:
+      return InstructionPrefixEntry(
+          Instruction(Opcode::LD, AddressIndex(RegisterBytePairIndex::HL),
+                      RegisterByteIndex::A));
     case 0x78:
       return InstructionPrefixEntry(
           Instruction(Opcode::LD, RegisterByteIndex::A, RegisterByteIndex::B));
@@ -757,6 +762,83 @@ constexpr const InstructionPrefixEntry GetInstructionPrefixInfo(
         instruction_prefix);
 }
 
+// The byte operand in the low 3 bits of a CB-prefixed opcode.
+inline ByteOperand GetCbByteOperand(uint8_t instruction_prefix) {
+  switch (instruction_prefix & 0x07) {
+    case 0x00:
+      return ByteOperand(RegisterByteIndex::B);
+    case 0x01:
+      return ByteOperand(RegisterByteIndex::C);
+    case 0x02:
+      return ByteOperand(RegisterByteIndex::D);
+    case 0x03:
+      return ByteOperand(RegisterByteIndex::E);
+    case 0x04:
+      return ByteOperand(RegisterByteIndex::H);
+    case 0x05:
+      return ByteOperand(RegisterByteIndex::L);
+    case 0x06:
+      return ByteOperand(AddressIndex(RegisterBytePairIndex::HL));
+    default:
+      return ByteOperand(RegisterByteIndex::A);
+  }
+}
+
+// Decodes the byte following a 0xCB prefix. The top 2 bits select between
+// the rotates and shifts, BIT, RES and SET, the next 3 the rotate or shift,
+// or the bit, and the low 3 the operand.
+inline InstructionPrefixEntry GetCbInstructionPrefixInfo(
+    uint8_t instruction_prefix) {
+  const ByteOperand operand = GetCbByteOperand(instruction_prefix);
+  const uint8_t field = (instruction_prefix >> 3) & 0x07;
+  switch (instruction_prefix >> 6) {
+    case 0x00: {
+      constexpr Opcode kRotatesAndShifts[] = {
+          Opcode::RLC, Opcode::RRC, Opcode::RL,   Opcode::RR,
+          Opcode::SLA, Opcode::SRA, Opcode::SWAP, Opcode::SRL,
+      };
+      return InstructionPrefixEntry(
+          Instruction(kRotatesAndShifts[field], operand));
+    }
+    case 0x01:
+      return InstructionPrefixEntry(
+          Instruction(Opcode::BIT, BitIndex(field), operand));
+    case 0x02:
+      return InstructionPrefixEntry(
+          Instruction(Opcode::RES, BitIndex(field), operand));
+    default:
+      return InstructionPrefixEntry(
+          Instruction(Opcode::SET, BitIndex(field), operand));
+  }
+}
+
+// Clock cycles taken by each instruction. Conditional jumps, calls and returns
+// are listed with the cost of the branch not being taken, and 0xCB with the
+// cost of a CB-prefixed register operation; the CPU adds the rest when
+// executing them. Invalid opcodes are listed as 0.
+inline constexpr std::array<uint8_t, 256> kInstructionCycles = {
+    4, 12, 8, 8, 4, 4, 8, 4, 20, 8, 8, 8, 4, 4, 8, 4,  // 0x00
+    4, 12, 8, 8, 4, 4, 8, 4, 12, 8, 8, 8, 4, 4, 8, 4,  // 0x10
+    8, 12, 8, 8, 4, 4, 8, 4, 8, 8, 8, 8, 4, 4, 8, 4,  // 0x20
+    8, 12, 8, 8, 12, 12, 12, 4, 8, 8, 8, 8, 4, 4, 8, 4,  // 0x30
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0x40
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0x50
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0x60
+    8, 8, 8, 8, 8, 8, 4, 8, 4, 4, 4, 4, 4, 4, 8, 4,  // 0x70
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0x80
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0x90
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0xA0
+    4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4,  // 0xB0
+    8, 12, 12, 16, 12, 16, 8, 16, 8, 16, 12, 8, 12, 24, 8, 16,  // 0xC0
+    8, 12, 12, 0, 12, 16, 8, 16, 8, 16, 12, 0, 12, 0, 8, 16,  // 0xD0
+    12, 12, 8, 0, 0, 16, 8, 16, 16, 4, 16, 0, 0, 0, 8, 16,  // 0xE0
+    12, 12, 8, 4, 0, 16, 8, 16, 12, 8, 16, 4, 0, 0, 8, 16,  // 0xF0
+};
+
+constexpr size_t GetInstructionCycles(uint8_t instruction_prefix) {
+  return kInstructionCycles[instruction_prefix];
+}
+
 }  // namespace gamebun
 
 #endif  // OPCODE_H_
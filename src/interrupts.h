@@ -0,0 +1,73 @@
+#ifndef INTERRUPTS_H_
+#define INTERRUPTS_H_
+
+#include <cstdint>
+
+#include "state.h"
+
+namespace gamebun {
+
+enum class Interrupt : uint8_t {
+  kVBlank = 0x01,
+  kLcdStat = 0x02,
+  kTimer = 0x04,
+  kSerial = 0x08,
+  kJoypad = 0x10,
+};
+
+// Backing storage for the interrupt flag (0xFF0F) and interrupt enable (0xFFFF)
+// registers, shared between the CPU and the peripherals that raise interrupts.
+class Interrupts {
+ public:
+  Interrupts() : flag_(0), enable_(0), requests_(0) {}
+
+  void Request(Interrupt interrupt) {
+    flag_ |= static_cast<uint8_t>(interrupt);
+    requests_ |= static_cast<uint8_t>(interrupt);
+  }
+
+  // Returns the interrupts requested since the last call, whether or not
+  // they are enabled or were already pending.
+  uint8_t TakeRequests() {
+    const uint8_t requests = requests_;
+    requests_ = 0;
+    return requests;
+  }
+
+  // The upper three bits of IF are unused and always read back as set.
+  uint8_t Flag() const { return flag_ | 0xE0; }
+  void SetFlag(uint8_t value) { flag_ = value & 0x1F; }
+
+  uint8_t Enable() const { return enable_; }
+  void SetEnable(uint8_t value) { enable_ = value; }
+
+  // The interrupts both requested and enabled, lowest bit first in priority.
+  uint8_t Pending() const { return flag_ & enable_; }
+  // Clears the request of `interrupts` once the CPU has serviced them.
+  void Acknowledge(uint8_t interrupts) {
+    flag_ = static_cast<uint8_t>(flag_ & ~interrupts);
+  }
+
+  // Requests are not part of the state, since they are only collected
+  // while running.
+  void SaveState(StateWriter* writer) const {
+    writer->Write(flag_);
+    writer->Write(enable_);
+  }
+  void LoadState(StateReader* reader) {
+    reader->Read(&flag_);
+    reader->Read(&enable_);
+  }
+
+  Interrupts(const Interrupts&) = delete;
+  Interrupts& operator=(const Interrupts&) = delete;
+
+ private:
+  uint8_t flag_;
+  uint8_t enable_;
+  uint8_t requests_;
+};
+
+}  // namespace gamebun
+
+#endif  // INTERRUPTS_H_
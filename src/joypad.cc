@@ -0,0 +1,215 @@
+#include "joypad.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "interrupts.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr uint16_t kJoypad = 0xFF00;
+
+constexpr uint8_t kSelectMask = 0x30;
+constexpr uint8_t kSelectDirections = 0x10;
+constexpr uint8_t kSelectActions = 0x20;
+constexpr uint8_t kLineMask = 0x0F;
+constexpr uint8_t kUnusedBits = 0xC0;
+
+constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+// Orders pending events latest first, so that the next one due is at the
+// back.
+bool Later(const JoypadEvent& a, const JoypadEvent& b) {
+  if (a.time != b.time) {
+    return a.time > b.time;
+  } else if (a.button != b.button) {
+    return a.button > b.button;
+  }
+  return a.pressed > b.pressed;
+}
+
+void SaveEvents(const std::vector<JoypadEvent>& events, StateWriter* writer) {
+  const uint64_t count = events.size();
+  writer->Write(count);
+  // Field by field, so that the padding never ends up in the state.
+  for (const JoypadEvent& event : events) {
+    writer->Write(event.time);
+    writer->Write(event.unit);
+    writer->Write(event.button);
+    writer->Write(event.pressed);
+  }
+}
+
+void LoadEvents(StateReader* reader, std::vector<JoypadEvent>* events) {
+  uint64_t count;
+  reader->Read(&count);
+  events->clear();
+  events->reserve(JoypadQueue::kCapacity);
+  // A damaged count stops at the end of the state.
+  for (uint64_t i = 0; i < count && !reader->failed(); i++) {
+    JoypadEvent event;
+    reader->Read(&event.time);
+    reader->Read(&event.unit);
+    reader->Read(&event.button);
+    reader->Read(&event.pressed);
+    events->push_back(event);
+  }
+  std::sort(events->begin(), events->end(), Later);
+}
+
+// Time of the next event due in `events`.
+uint64_t NextEventTime(const std::vector<JoypadEvent>& events) {
+  return events.empty() ? kNever : events.back().time;
+}
+
+}  // namespace
+
+JoypadQueue::JoypadQueue() : tail_(0), head_(0) {
+  for (size_t i = 0; i < kCapacity; i++) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool JoypadQueue::Push(const JoypadEvent& event) {
+  uint64_t position = tail_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[position % kCapacity];
+    const uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      // The cell is free; claim it unless another host got there first.
+      if (tail_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (sequence < position) {
+      // The cell still holds the event from the previous lap.
+      return false;
+    } else {
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->event = event;
+  cell->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+bool JoypadQueue::Pop(JoypadEvent* event) {
+  if (Empty()) {
+    return false;
+  }
+  Cell& cell = cells_[head_ % kCapacity];
+  *event = cell.event;
+  cell.sequence.store(head_ + kCapacity, std::memory_order_release);
+  head_++;
+  return true;
+}
+
+Joypad::Joypad(Interrupts* interrupts)
+    : interrupts_(*interrupts),
+      time_(0),
+      frame_(0),
+      next_event_(kNever),
+      pressed_(0),
+      select_(kSelectMask) {
+  // Live input rarely has more than a few events pending, so this keeps
+  // emulation from allocating.
+  pending_cycles_.reserve(JoypadQueue::kCapacity);
+  pending_frames_.reserve(JoypadQueue::kCapacity);
+}
+
+void Joypad::StartFrame(uint64_t frame) {
+  frame_ = frame;
+  Update();
+}
+
+void Joypad::Update() {
+  JoypadEvent event;
+  while (queue_.Pop(&event)) {
+    std::vector<JoypadEvent>& pending =
+        event.unit == JoypadEvent::TimeUnit::kFrames ? pending_frames_
+                                                     : pending_cycles_;
+    // Few events are pending at once, so keeping them sorted is cheap.
+    pending.insert(
+        std::upper_bound(pending.begin(), pending.end(), event, Later),
+        event);
+  }
+
+  const auto apply_due = [this](std::vector<JoypadEvent>* pending,
+                                uint64_t now) {
+    while (NextEventTime(*pending) <= now) {
+      const uint8_t bit = static_cast<uint8_t>(pending->back().button);
+      const bool pressed = pending->back().pressed;
+      pending->pop_back();
+      SetState(pressed ? pressed_ | bit : pressed_ & ~bit, select_);
+    }
+  };
+  // Frame events apply at the start of the frame, before any cycle of it.
+  apply_due(&pending_frames_, frame_);
+  apply_due(&pending_cycles_, time_);
+
+  next_event_ = NextEventTime(pending_cycles_);
+}
+
+uint8_t Joypad::Read(Address address) const {
+  if (address.value() != kJoypad) {
+    FATAL("Unexpected joypad read address %x", address.value());
+  }
+  return kUnusedBits | select_ | Lines();
+}
+
+void Joypad::Write(Address address, uint8_t value) {
+  if (address.value() != kJoypad) {
+    FATAL("Unexpected joypad write address %x", address.value());
+  }
+  SetState(pressed_, value & kSelectMask);
+}
+
+void Joypad::SaveState(StateWriter* writer) const {
+  writer->Write(time_);
+  writer->Write(frame_);
+  writer->Write(pressed_);
+  writer->Write(select_);
+  SaveEvents(pending_cycles_, writer);
+  SaveEvents(pending_frames_, writer);
+}
+
+void Joypad::LoadState(StateReader* reader) {
+  reader->Read(&time_);
+  reader->Read(&frame_);
+  reader->Read(&pressed_);
+  reader->Read(&select_);
+  LoadEvents(reader, &pending_cycles_);
+  LoadEvents(reader, &pending_frames_);
+  next_event_ = NextEventTime(pending_cycles_);
+}
+
+uint8_t Joypad::Lines() const {
+  uint8_t low = 0;
+  if ((select_ & kSelectDirections) == 0) {
+    low |= pressed_ & kLineMask;
+  }
+  if ((select_ & kSelectActions) == 0) {
+    low |= pressed_ >> 4;
+  }
+  return ~low & kLineMask;
+}
+
+void Joypad::SetState(uint8_t pressed, uint8_t select) {
+  const uint8_t lines = Lines();
+  pressed_ = pressed;
+  select_ = select;
+  if ((lines & ~Lines()) != 0) {
+    interrupts_.Request(Interrupt::kJoypad);
+  }
+}
+
+}  // namespace gamebun
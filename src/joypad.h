@@ -0,0 +1,144 @@
+#ifndef JOYPAD_H_
+#define JOYPAD_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory.h"
+
+namespace gamebun {
+
+class Interrupts;
+class StateReader;
+class StateWriter;
+
+enum class Button : uint8_t {
+  kRight = 0x01,
+  kLeft = 0x02,
+  kUp = 0x04,
+  kDown = 0x08,
+  kA = 0x10,
+  kB = 0x20,
+  kSelect = 0x40,
+  kStart = 0x80,
+};
+
+// A button being pressed or released at a set point in emulated time.
+struct JoypadEvent {
+  enum class TimeUnit : uint8_t {
+    // Cycles since power-on.
+    kCycles,
+    // Completed frames; the event applies as the frame after them starts.
+    kFrames,
+  };
+
+  uint64_t time;
+  TimeUnit unit;
+  Button button;
+  bool pressed;
+};
+
+// A bounded queue of events from any number of host threads to the
+// emulation thread. Pushing never waits on the emulation thread, and hosts
+// only contend with each other for a slot.
+class JoypadQueue {
+ public:
+  static constexpr size_t kCapacity = 256;
+
+  JoypadQueue();
+
+  // Returns false if the queue is full. Thread-safe.
+  bool Push(const JoypadEvent& event);
+
+  // Called only from the emulation thread.
+  bool Empty() const {
+    return cells_[head_ % kCapacity].sequence.load(
+               std::memory_order_acquire) != head_ + 1;
+  }
+  bool Pop(JoypadEvent* event);
+
+  JoypadQueue(const JoypadQueue&) = delete;
+  JoypadQueue& operator=(const JoypadQueue&) = delete;
+
+ private:
+  // Each cell's sequence number tells which lap of the queue it is on: equal
+  // to its position when it is free to push to, and one past it once it
+  // holds an event to pop.
+  struct Cell {
+    std::atomic<uint64_t> sequence;
+    JoypadEvent event;
+  };
+
+  std::array<Cell, kCapacity> cells_;
+  std::atomic<uint64_t> tail_;
+  uint64_t head_;
+};
+
+// The buttons, read through P1 (0xFF00) as two groups of four selected by
+// its upper bits.
+//
+// Events are applied exactly at their timestamps, in timestamp order,
+// whatever order they were queued in, with ties broken by button and then
+// releases before presses. Replays are therefore deterministic as long as
+// each event is queued before emulation reaches it; an event stamped in the
+// past applies right away, which suits live input.
+class Joypad {
+ public:
+  explicit Joypad(Interrupts* interrupts);
+
+  // Thread-safe; see JoypadQueue::Push().
+  bool Queue(const JoypadEvent& event) { return queue_.Push(event); }
+
+  void Tick(size_t cycles) {
+    time_ += cycles;
+    if (time_ >= next_event_ || !queue_.Empty()) {
+      Update();
+    }
+  }
+  // Called as the frame after `frame` completed frames starts.
+  void StartFrame(uint64_t frame);
+
+  uint8_t Read(Address address) const;
+  void Write(Address address, uint8_t value);
+
+  // The state includes the events waiting for their timestamps, but not
+  // those still in the queue, which are only taken from it while running.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  Joypad(const Joypad&) = delete;
+  Joypad& operator=(const Joypad&) = delete;
+
+ private:
+  // Moves queued events to the pending ones and applies those that are due.
+  void Update();
+  // Returns the low bits of P1, where a selected pressed button reads as 0.
+  uint8_t Lines() const;
+  // Changes the pressed buttons or the selection, requesting the joypad
+  // interrupt if any line goes low.
+  void SetState(uint8_t pressed, uint8_t select);
+
+  Interrupts& interrupts_;
+  JoypadQueue queue_;
+  // Events taken from the queue but not yet due, sorted latest first.
+  std::vector<JoypadEvent> pending_cycles_;
+  std::vector<JoypadEvent> pending_frames_;
+
+  uint64_t time_;
+  uint64_t frame_;
+  // Time of the earliest pending event in cycles.
+  uint64_t next_event_;
+
+  // A set bit for each pressed button.
+  uint8_t pressed_;
+  // Bits 4 and 5 of P1, where a 0 selects the directions and the action
+  // buttons respectively.
+  uint8_t select_;
+};
+
+}  // namespace gamebun
+
+#endif  // JOYPAD_H_
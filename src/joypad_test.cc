@@ -0,0 +1,120 @@
+#include "joypad.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+
+#include "interrupts.h"
+#include "memory.h"
+
+namespace gamebun {
+namespace {
+
+constexpr uint8_t kJoypadInterrupt = static_cast<uint8_t>(Interrupt::kJoypad);
+
+JoypadEvent CycleEvent(uint64_t cycle, Button button, bool pressed) {
+  return {cycle, JoypadEvent::TimeUnit::kCycles, button, pressed};
+}
+
+JoypadEvent FrameEvent(uint64_t frame, Button button, bool pressed) {
+  return {frame, JoypadEvent::TimeUnit::kFrames, button, pressed};
+}
+
+// A joypad with the directions selected.
+struct TestJoypad {
+  TestJoypad() : joypad(&interrupts) { joypad.Write(Address(0xFF00), 0x20); }
+
+  // The low bits of P1, where a pressed direction reads as 0.
+  uint8_t Lines() const { return joypad.Read(Address(0xFF00)) & 0x0F; }
+
+  // Returns whether the joypad interrupt was requested since the last call.
+  bool TakeInterrupt() {
+    const bool requested = interrupts.Flag() & kJoypadInterrupt;
+    interrupts.SetFlag(0);
+    return requested;
+  }
+
+  Interrupts interrupts;
+  Joypad joypad;
+};
+
+TEST_CASE("Joypad events apply at their timestamps in any order queued",
+          "[joypad]") {
+  TestJoypad test;
+  REQUIRE(test.joypad.Queue(CycleEvent(300, Button::kRight, true)));
+  REQUIRE(test.joypad.Queue(FrameEvent(2, Button::kDown, true)));
+  REQUIRE(test.joypad.Queue(CycleEvent(200, Button::kLeft, false)));
+  REQUIRE(test.joypad.Queue(FrameEvent(1, Button::kUp, true)));
+  REQUIRE(test.joypad.Queue(CycleEvent(100, Button::kLeft, true)));
+
+  test.joypad.Tick(99);
+  CHECK(test.Lines() == 0x0F);
+  CHECK_FALSE(test.TakeInterrupt());
+  test.joypad.Tick(1);
+  CHECK(test.Lines() == 0x0D);
+  CHECK(test.TakeInterrupt());
+
+  test.joypad.Tick(99);
+  CHECK(test.Lines() == 0x0D);
+  test.joypad.Tick(1);
+  CHECK(test.Lines() == 0x0F);
+  // Releases raise the line, which does not request the interrupt.
+  CHECK_FALSE(test.TakeInterrupt());
+
+  // Past cycle 300 in a single tick.
+  test.joypad.Tick(150);
+  CHECK(test.Lines() == 0x0E);
+  CHECK(test.TakeInterrupt());
+
+  test.joypad.StartFrame(1);
+  CHECK(test.Lines() == 0x0A);
+  CHECK(test.TakeInterrupt());
+  test.joypad.Tick(1000);
+  CHECK(test.Lines() == 0x0A);
+  CHECK_FALSE(test.TakeInterrupt());
+  test.joypad.StartFrame(2);
+  CHECK(test.Lines() == 0x02);
+  CHECK(test.TakeInterrupt());
+}
+
+TEST_CASE("Joypad events at the same time apply releases first",
+          "[joypad]") {
+  TestJoypad test;
+  REQUIRE(test.joypad.Queue(CycleEvent(10, Button::kUp, true)));
+  REQUIRE(test.joypad.Queue(CycleEvent(10, Button::kUp, false)));
+  REQUIRE(test.joypad.Queue(CycleEvent(20, Button::kDown, false)));
+  REQUIRE(test.joypad.Queue(CycleEvent(20, Button::kDown, true)));
+  test.joypad.Tick(10);
+  CHECK(test.Lines() == 0x0B);
+  test.joypad.Tick(10);
+  CHECK(test.Lines() == 0x03);
+}
+
+TEST_CASE("Joypad events stamped in the past apply right away", "[joypad]") {
+  TestJoypad test;
+  test.joypad.Tick(500);
+  test.joypad.StartFrame(3);
+  REQUIRE(test.joypad.Queue(CycleEvent(100, Button::kRight, true)));
+  test.joypad.Tick(0);
+  CHECK(test.Lines() == 0x0E);
+  REQUIRE(test.joypad.Queue(FrameEvent(1, Button::kLeft, true)));
+  test.joypad.Tick(0);
+  CHECK(test.Lines() == 0x0C);
+  CHECK(test.TakeInterrupt());
+}
+
+TEST_CASE("Selecting a group with a button held requests the interrupt",
+          "[joypad]") {
+  TestJoypad test;
+  REQUIRE(test.joypad.Queue(CycleEvent(0, Button::kStart, true)));
+  test.joypad.Tick(0);
+  // Start is an action button, which is not selected.
+  CHECK(test.Lines() == 0x0F);
+  CHECK_FALSE(test.TakeInterrupt());
+  test.joypad.Write(Address(0xFF00), 0x10);
+  CHECK(test.Lines() == 0x07);
+  CHECK(test.TakeInterrupt());
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -0,0 +1,55 @@
+#include "link_cable.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace gamebun {
+
+namespace {
+
+constexpr int kFullShift = 8;
+constexpr uint16_t kFull = 1 << kFullShift;
+constexpr int kClockTimeShift = kFullShift + 1;
+
+}  // namespace
+
+LinkCable::LinkCable() {
+  for (Slots& slots : slots_) {
+    slots.clock.store(0, std::memory_order_relaxed);
+    slots.reply.store(0, std::memory_order_relaxed);
+  }
+  ends_[0].Attach(&slots_[0], &slots_[1]);
+  ends_[1].Attach(&slots_[1], &slots_[0]);
+}
+
+void LinkCable::End::SendClock(uint64_t time, uint8_t byte) {
+  outgoing_->clock.store((time << kClockTimeShift) | kFull | byte,
+                         std::memory_order_release);
+}
+
+bool LinkCable::End::ReceiveClock(uint64_t* time, uint8_t* byte) {
+  if (incoming_->clock.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  const uint64_t message =
+      incoming_->clock.exchange(0, std::memory_order_acquire);
+  *time = message >> kClockTimeShift;
+  *byte = static_cast<uint8_t>(message);
+  return true;
+}
+
+void LinkCable::End::SendReply(uint8_t byte) {
+  outgoing_->reply.store(kFull | byte, std::memory_order_release);
+}
+
+bool LinkCable::End::ReceiveReply(uint8_t* byte) {
+  if (incoming_->reply.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  const uint16_t message =
+      incoming_->reply.exchange(0, std::memory_order_acquire);
+  *byte = static_cast<uint8_t>(message);
+  return true;
+}
+
+}  // namespace gamebun
@@ -0,0 +1,64 @@
+#ifndef LINK_CABLE_H_
+#define LINK_CABLE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "serial.h"
+
+namespace gamebun {
+
+// A link cable between two emulators in the same process, which may run on
+// different threads. Each direction holds at most one clock and one reply
+// at a time, passed through an atomic slot, so neither end ever waits on a
+// lock.
+class LinkCable {
+ public:
+  LinkCable();
+
+  // The two ends of the cable, 0 and 1.
+  SerialLink* end(size_t index) { return &ends_[index]; }
+
+  LinkCable(const LinkCable&) = delete;
+  LinkCable& operator=(const LinkCable&) = delete;
+
+ private:
+  // Messages are packed into a single word with a flag marking the slot as
+  // full, so that a slot is read and emptied in one exchange.
+  struct Slots {
+    // The end of the transfer in the upper bits, then the flag, then the
+    // byte.
+    std::atomic<uint64_t> clock;
+    // The flag, then the byte.
+    std::atomic<uint16_t> reply;
+  };
+
+  class End final : public SerialLink {
+   public:
+    End() : outgoing_(nullptr), incoming_(nullptr) {}
+
+    void Attach(Slots* outgoing, Slots* incoming) {
+      outgoing_ = outgoing;
+      incoming_ = incoming;
+    }
+
+    void SendClock(uint64_t time, uint8_t byte) override;
+    bool ReceiveClock(uint64_t* time, uint8_t* byte) override;
+    void SendReply(uint8_t byte) override;
+    bool ReceiveReply(uint8_t* byte) override;
+
+   private:
+    Slots* outgoing_;
+    Slots* incoming_;
+  };
+
+  // Messages sent by each end.
+  std::array<Slots, 2> slots_;
+  std::array<End, 2> ends_;
+};
+
+}  // namespace gamebun
+
+#endif  // LINK_CABLE_H_
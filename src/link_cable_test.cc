@@ -0,0 +1,219 @@
+#include "link_cable.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "cartridge.h"
+#include "emulator.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "serial.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+constexpr uint64_t kTransferCycles = 4096;
+
+// A serial port on its own, with the interrupt flag it raises.
+struct TestPort {
+  TestPort() : serial(&interrupts) {}
+
+  // Starts a transfer shifting out `byte`, on the port's own clock if
+  // `internal` and otherwise on the other end's.
+  void Start(uint8_t byte, bool internal) {
+    interrupts.SetFlag(0);
+    serial.Write(Address(0xFF01), byte);
+    serial.Write(Address(0xFF02), internal ? 0x81 : 0x80);
+  }
+
+  bool Done() const { return (serial.Read(Address(0xFF02)) & 0x80) == 0; }
+  uint8_t Data() const { return serial.Read(Address(0xFF01)); }
+  bool Interrupted() const {
+    return interrupts.Flag() & static_cast<uint8_t>(Interrupt::kSerial);
+  }
+
+  Interrupts interrupts;
+  Serial serial;
+};
+
+// Two ports plugged into either end of a cable.
+struct TestLink {
+  TestLink() {
+    driver.serial.Connect(cable.end(0));
+    listener.serial.Connect(cable.end(1));
+  }
+
+  LinkCable cable;
+  TestPort driver;
+  TestPort listener;
+};
+
+TEST_CASE("Transfers over a link cable swap the bytes of the two ends",
+          "[link_cable]") {
+  TestLink link;
+  link.listener.Start(0x99, false);
+  link.driver.Start(0x42, true);
+  // The byte written to SB while shifting is dropped.
+  link.driver.serial.Write(Address(0xFF01), 0x11);
+  CHECK(link.driver.Data() == 0x42);
+
+  // The listener replies as soon as the clock comes in, and the driver ends
+  // its transfer right on time.
+  link.listener.serial.Tick(512);
+  CHECK(link.listener.Done());
+  CHECK(link.listener.Data() == 0x42);
+  CHECK(link.listener.Interrupted());
+  link.driver.serial.Tick(kTransferCycles - 1);
+  CHECK_FALSE(link.driver.Done());
+  CHECK_FALSE(link.driver.Interrupted());
+  link.driver.serial.Tick(1);
+  CHECK(link.driver.Done());
+  CHECK(link.driver.Data() == 0x99);
+  CHECK(link.driver.Interrupted());
+}
+
+TEST_CASE("Transfers over a link cable wait for a late reply",
+          "[link_cable]") {
+  TestLink link;
+  link.driver.Start(0x42, true);
+  link.driver.serial.Tick(6000);
+  CHECK_FALSE(link.driver.Done());
+
+  // The listener starts waiting after the clock came in, but before its own
+  // time reached the end of the transfer, so it still takes part.
+  link.listener.Start(0x99, false);
+  CHECK(link.listener.Done());
+  CHECK(link.listener.Data() == 0x42);
+  link.driver.serial.Tick(512);
+  CHECK(link.driver.Done());
+  CHECK(link.driver.Data() == 0x99);
+}
+
+TEST_CASE("Ends not waiting for a transfer by its end reply 0xFF",
+          "[link_cable]") {
+  TestLink link;
+  link.listener.serial.Write(Address(0xFF01), 0x99);
+  link.driver.Start(0x42, true);
+  link.listener.serial.Tick(kTransferCycles - 1);
+  link.driver.serial.Tick(kTransferCycles + 512);
+  CHECK_FALSE(link.driver.Done());
+
+  link.listener.serial.Tick(kTransferCycles);
+  CHECK(link.listener.Data() == 0x99);
+  CHECK_FALSE(link.listener.Interrupted());
+  link.driver.serial.Tick(512);
+  CHECK(link.driver.Done());
+  CHECK(link.driver.Data() == 0xFF);
+}
+
+TEST_CASE("Without a cable, only transfers on the internal clock end",
+          "[link_cable]") {
+  TestPort port;
+  port.Start(0x42, true);
+  port.serial.Tick(kTransferCycles - 1);
+  CHECK_FALSE(port.Done());
+  port.serial.Tick(1);
+  CHECK(port.Done());
+  CHECK(port.Data() == 0xFF);
+  CHECK(port.Interrupted());
+
+  port.Start(0x42, false);
+  port.serial.Tick(100 * kTransferCycles);
+  CHECK_FALSE(port.Done());
+  CHECK_FALSE(port.Interrupted());
+  // While waiting, SB can still be written.
+  port.serial.Write(Address(0xFF01), 0x11);
+  CHECK(port.Data() == 0x11);
+}
+
+TEST_CASE("Link cables carry transfers between two threads",
+          "[link_cable]") {
+  constexpr size_t kTransfers = 2000;
+  TestLink link;
+  std::vector<uint8_t> received_by_listener(kTransfers);
+  std::thread listener([&link, &received_by_listener] {
+    for (size_t i = 0; i < kTransfers; i++) {
+      link.listener.Start(static_cast<uint8_t>(~i), false);
+      while (!link.listener.Done()) {
+        link.listener.serial.Tick(512);
+        std::this_thread::yield();
+      }
+      received_by_listener[i] = link.listener.Data();
+    }
+  });
+  std::vector<uint8_t> received_by_driver(kTransfers);
+  for (size_t i = 0; i < kTransfers; i++) {
+    link.driver.Start(static_cast<uint8_t>(i), true);
+    while (!link.driver.Done()) {
+      link.driver.serial.Tick(512);
+      std::this_thread::yield();
+    }
+    received_by_driver[i] = link.driver.Data();
+  }
+  listener.join();
+
+  // The listener always waits for the next transfer before running on, so
+  // every byte gets through.
+  size_t mismatches = 0;
+  for (size_t i = 0; i < kTransfers; i++) {
+    mismatches += received_by_listener[i] != static_cast<uint8_t>(i) ||
+                  received_by_driver[i] != static_cast<uint8_t>(~i);
+  }
+  CHECK(mismatches == 0);
+}
+
+// Shifts out 0x42 on the internal clock, then waits.
+const std::vector<uint8_t> kDriverProgram = {
+    0x3E, 0x42,  // 0x100: LD A, 0x42
+    0xE0, 0x01,  // 0x102: LDH (0x01), A
+    0x3E, 0x81,  // 0x104: LD A, 0x81
+    0xE0, 0x02,  // 0x106: LDH (0x02), A
+    0x18, 0xFE,  // 0x108: JR 0x108
+};
+
+// Waits to shift out 0x99 on the other end's clock.
+const std::vector<uint8_t> kListenerProgram = {
+    0x3E, 0x99,  // 0x100: LD A, 0x99
+    0xE0, 0x01,  // 0x102: LDH (0x01), A
+    0x3E, 0x80,  // 0x104: LD A, 0x80
+    0xE0, 0x02,  // 0x106: LDH (0x02), A
+    0x18, 0xFE,  // 0x108: JR 0x108
+};
+
+TEST_CASE("Emulators plugged into a link cable stop at its transfers",
+          "[link_cable]") {
+  const Cartridge driver_cart = MakeTestCartridge(kDriverProgram);
+  const Cartridge listener_cart = MakeTestCartridge(kListenerProgram);
+  Emulator driver(driver_cart, EmulatorOptions());
+  Emulator listener(listener_cart, EmulatorOptions());
+  LinkCable cable;
+  driver.ConnectSerial(cable.end(0));
+  listener.ConnectSerial(cable.end(1));
+
+  // Without a clock, the listener runs on.
+  RunResult result = listener.RunUntil(kSerialEvent, 1000);
+  CHECK(result.events == 0);
+  uint64_t driver_cycles = driver.RunCycles(100).cycles;
+  result = listener.RunUntil(kSerialEvent, 10000);
+  CHECK(result.events == kSerialEvent);
+  CHECK(result.cycles <= 1024);
+
+  // The reply is in, so the driver's transfer ends 4096 cycles after it
+  // started, a few instructions in.
+  result = driver.RunUntil(kSerialEvent, 10000);
+  CHECK(result.events == kSerialEvent);
+  driver_cycles += result.cycles;
+  CHECK(driver_cycles > kTransferCycles);
+  CHECK(driver_cycles < kTransferCycles + 100);
+
+  driver.ConnectSerial(nullptr);
+  listener.ConnectSerial(nullptr);
+}
+
+}  // namespace
+}  // namespace gamebun
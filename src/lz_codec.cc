@@ -0,0 +1,232 @@
+#include "lz_codec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gamebun {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "matches are extended 8 bytes at a time as little-endian words");
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 0xFFFF;
+constexpr size_t kHashBits = 12;
+// Nibble values that mean more length bytes follow.
+constexpr size_t kLengthMask = 15;
+// After this many positions in a row without a match, the search starts
+// skipping ahead, so incompressible stretches cost little.
+constexpr int kSkipShift = 5;
+
+uint32_t Load32(const uint8_t* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint64_t Load64(const uint8_t* bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+size_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// Returns how many bytes from `a` and `b` match, up to `limit`.
+size_t MatchLength(const uint8_t* a, const uint8_t* b, size_t limit) {
+  size_t length = 0;
+  while (length + sizeof(uint64_t) <= limit) {
+    const uint64_t difference = Load64(a + length) ^ Load64(b + length);
+    if (difference != 0) {
+      return length + static_cast<size_t>(__builtin_ctzll(difference)) / 8;
+    }
+    length += sizeof(uint64_t);
+  }
+  while (length < limit && a[length] == b[length]) {
+    length++;
+  }
+  return length;
+}
+
+// Appends sequences to the output, and notices when they stop fitting.
+class SequenceWriter {
+ public:
+  SequenceWriter(uint8_t* out, size_t capacity)
+      : out_(out), capacity_(capacity), size_(0) {}
+
+  // Appends `literal_count` bytes from `literals`, followed by a match of
+  // `match_length` bytes `offset` back, or by nothing if `match_length` is
+  // 0. Returns false if the sequence does not fit.
+  bool Append(const uint8_t* literals, size_t literal_count, size_t offset,
+              size_t match_length) {
+    // The token, the offset, and a length byte per 255 of each length.
+    const size_t worst_case = 1 + literal_count / 255 + 1 + literal_count +
+                              2 + match_length / 255 + 1;
+    if (worst_case > capacity_ - size_) {
+      return false;
+    }
+    const size_t match_code = match_length == 0 ? 0 : match_length - kMinMatch;
+    uint8_t& token = out_[size_++];
+    token = static_cast<uint8_t>(
+        ((literal_count < kLengthMask ? literal_count : kLengthMask) << 4) |
+        (match_code < kLengthMask ? match_code : kLengthMask));
+    AppendLength(literal_count);
+    std::memcpy(&out_[size_], literals, literal_count);
+    size_ += literal_count;
+    if (match_length != 0) {
+      out_[size_++] = static_cast<uint8_t>(offset);
+      out_[size_++] = static_cast<uint8_t>(offset >> 8);
+      AppendLength(match_code);
+    }
+    return true;
+  }
+
+  size_t size() const { return size_; }
+
+ private:
+  void AppendLength(size_t length) {
+    if (length < kLengthMask) {
+      return;
+    }
+    length -= kLengthMask;
+    while (length >= 255) {
+      out_[size_++] = 255;
+      length -= 255;
+    }
+    out_[size_++] = static_cast<uint8_t>(length);
+  }
+
+  uint8_t* const out_;
+  const size_t capacity_;
+  size_t size_;
+};
+
+// Reads a length whose nibble was `code`, adding the extra bytes that follow
+// a nibble of 15. Returns false if they run past `end`.
+bool ReadLength(size_t code, const uint8_t** in, const uint8_t* end,
+                size_t* length) {
+  *length = code;
+  if (code != kLengthMask) {
+    return true;
+  }
+  uint8_t extra;
+  do {
+    if (*in == end) {
+      return false;
+    }
+    extra = *(*in)++;
+    *length += extra;
+  } while (extra == 255);
+  return true;
+}
+
+}  // namespace
+
+size_t LzCompress(const uint8_t* in, size_t size, uint8_t* out,
+                  size_t capacity) {
+  // Positions of the last sequence seen with each hash. Stale or colliding
+  // entries are caught by comparing the bytes.
+  uint32_t table[size_t{1} << kHashBits] = {};
+  SequenceWriter writer(out, capacity);
+
+  size_t anchor = 0;
+  size_t position = 0;
+  size_t misses = 0;
+  while (position + kMinMatch <= size) {
+    const uint32_t sequence = Load32(&in[position]);
+    const size_t hash = Hash(sequence);
+    const size_t candidate = table[hash];
+    table[hash] = static_cast<uint32_t>(position);
+    if (candidate >= position || position - candidate > kMaxOffset ||
+        Load32(&in[candidate]) != sequence) {
+      position += 1 + (misses++ >> kSkipShift);
+      continue;
+    }
+
+    size_t start = position;
+    size_t source = candidate;
+    while (start > anchor && source > 0 && in[start - 1] == in[source - 1]) {
+      start--;
+      source--;
+    }
+    const size_t length =
+        kMinMatch + MatchLength(&in[position + kMinMatch],
+                                &in[candidate + kMinMatch],
+                                size - position - kMinMatch) +
+        (position - start);
+    if (!writer.Append(&in[anchor], start - anchor, start - source, length)) {
+      return 0;
+    }
+    position = start + length;
+    anchor = position;
+    misses = 0;
+  }
+
+  if (!writer.Append(&in[anchor], size - anchor, 0, 0)) {
+    return 0;
+  }
+  return writer.size();
+}
+
+bool LzDecompress(const uint8_t* in, size_t in_size, uint8_t* out,
+                  size_t size) {
+  const uint8_t* const in_end = in + in_size;
+  size_t written = 0;
+  while (in != in_end) {
+    const uint8_t token = *in++;
+
+    size_t literal_count;
+    if (!ReadLength(token >> 4, &in, in_end, &literal_count) ||
+        literal_count > static_cast<size_t>(in_end - in) ||
+        literal_count > size - written) {
+      return false;
+    }
+    std::memcpy(&out[written], in, literal_count);
+    in += literal_count;
+    written += literal_count;
+    if (in == in_end) {
+      break;
+    }
+
+    if (in_end - in < 2) {
+      return false;
+    }
+    const size_t offset = static_cast<size_t>(in[0] | in[1] << 8);
+    in += 2;
+    size_t match_length;
+    if (!ReadLength(token & kLengthMask, &in, in_end, &match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if (offset == 0 || offset > written || match_length > size - written) {
+      return false;
+    }
+
+    uint8_t* const destination = &out[written];
+    const uint8_t* const source = destination - offset;
+    if (offset >= match_length) {
+      std::memcpy(destination, source, match_length);
+    } else if (offset == 1) {
+      std::memset(destination, *source, match_length);
+    } else {
+      // The match overlaps itself, repeating its first `offset` bytes, so
+      // once those are copied, every copy can double in size.
+      std::memcpy(destination, source, offset);
+      size_t copied = offset;
+      while (copied < match_length) {
+        const size_t chunk = std::min(copied, match_length - copied);
+        std::memcpy(&destination[copied], destination, chunk);
+        copied += chunk;
+      }
+    }
+    written += match_length;
+  }
+  return written == size;
+}
+
+}  // namespace gamebun
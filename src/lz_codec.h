@@ -0,0 +1,37 @@
+#ifndef LZ_CODEC_H_
+#define LZ_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gamebun {
+
+// A byte-oriented LZ77 codec in the style of LZ4, tuned for speed over
+// ratio: one hash probe per position and no entropy coding. Emulator states
+// are mostly zeros and repeated tiles, which it squeezes well regardless.
+//
+// The compressed data is a series of sequences, each a token byte holding a
+// literal count and a match length in its high and low nibbles, extra
+// length bytes for counts of 15 or more, the literals, a little-endian
+// 16-bit match offset, and extra match length bytes. Matches are at least 4
+// bytes long. The last sequence has literals only.
+
+// The most LzCompress() can produce from `size` bytes.
+constexpr size_t LzMaxCompressedSize(size_t size) {
+  return size + size / 255 + 16;
+}
+
+// Compresses `size` bytes from `in` into `out`, returning the compressed
+// size, or 0 if it does not fit in `capacity` bytes. Nothing is allocated.
+size_t LzCompress(const uint8_t* in, size_t size, uint8_t* out,
+                  size_t capacity);
+
+// Decompresses `in_size` bytes from `in` into exactly `size` bytes of `out`.
+// Returns false if the data is malformed or does not decompress to `size`
+// bytes, never reading or writing out of bounds either way.
+bool LzDecompress(const uint8_t* in, size_t in_size, uint8_t* out,
+                  size_t size);
+
+}  // namespace gamebun
+
+#endif  // LZ_CODEC_H_
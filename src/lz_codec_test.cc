@@ -0,0 +1,150 @@
+#include "lz_codec.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace gamebun {
+namespace {
+
+std::vector<uint8_t> Compress(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> compressed(LzMaxCompressedSize(data.size()));
+  const size_t size =
+      LzCompress(data.data(), data.size(), compressed.data(),
+                 compressed.size());
+  REQUIRE(size != 0);
+  compressed.resize(size);
+  return compressed;
+}
+
+bool Decompress(const std::vector<uint8_t>& compressed, size_t size,
+                std::vector<uint8_t>* data) {
+  data->assign(size, 0xCC);
+  return LzDecompress(compressed.data(), compressed.size(), data->data(),
+                      size);
+}
+
+void CheckRoundTrip(const std::vector<uint8_t>& data) {
+  const std::vector<uint8_t> compressed = Compress(data);
+  std::vector<uint8_t> decompressed;
+  CHECK(Decompress(compressed, data.size(), &decompressed));
+  CHECK(decompressed == data);
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<uint8_t> data(size);
+  for (uint8_t& byte : data) {
+    byte = static_cast<uint8_t>(random());
+  }
+  return data;
+}
+
+TEST_CASE("Zero-filled data round trips and shrinks", "[lz_codec]") {
+  for (const size_t size : {0, 1, 4, 5, 100, 65536, 200000}) {
+    const std::vector<uint8_t> data(size);
+    CheckRoundTrip(data);
+  }
+  const std::vector<uint8_t> data(65536);
+  CHECK(Compress(data).size() < 300);
+}
+
+TEST_CASE("Random data round trips", "[lz_codec]") {
+  for (const size_t size : {1, 3, 4, 7, 8, 9, 1000, 70000}) {
+    CheckRoundTrip(RandomBytes(size, static_cast<uint32_t>(size)));
+  }
+}
+
+TEST_CASE("Repetitive data round trips", "[lz_codec]") {
+  // Periods of 1 to 3 bytes make matches that overlap what they copy, with
+  // those offsets.
+  for (const size_t period : {1, 2, 3, 5, 8, 37, 4096}) {
+    const std::vector<uint8_t> pattern = RandomBytes(period, 7);
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < 50000; i++) {
+      data.push_back(pattern[i % period]);
+    }
+    CheckRoundTrip(data);
+    CHECK(Compress(data).size() < 1000 + period);
+  }
+
+  // Runs and repeats between stretches of noise, as in saved states.
+  std::vector<uint8_t> data = RandomBytes(100000, 11);
+  std::mt19937 random(13);
+  for (size_t i = 0; i < 500; i++) {
+    const size_t start = random() % (data.size() - 300);
+    const size_t length = random() % 300;
+    const size_t source = random() % (data.size() - length);
+    for (size_t j = 0; j < length; j++) {
+      data[start + j] = i % 2 == 0 ? 0 : data[source + j];
+    }
+  }
+  CheckRoundTrip(data);
+}
+
+TEST_CASE("Overlapping matches repeat their first bytes", "[lz_codec]") {
+  for (const size_t offset : {1, 2, 3}) {
+    // `offset` literals, then a match of 18 bytes at that offset.
+    std::vector<uint8_t> compressed = {
+        static_cast<uint8_t>(offset << 4 | (18 - 4)), 'a', 'b', 'c'};
+    compressed.resize(1 + offset);
+    compressed.push_back(static_cast<uint8_t>(offset));
+    compressed.push_back(0);
+    std::vector<uint8_t> data;
+    REQUIRE(Decompress(compressed, offset + 18, &data));
+    for (size_t i = 0; i < data.size(); i++) {
+      CHECK(data[i] == "abc"[i % offset]);
+    }
+  }
+}
+
+TEST_CASE("Compressing into too little room fails", "[lz_codec]") {
+  const std::vector<uint8_t> data = RandomBytes(1000, 3);
+  const std::vector<uint8_t> compressed = Compress(data);
+  std::vector<uint8_t> out(compressed.size() - 1);
+  CHECK(LzCompress(data.data(), data.size(), out.data(), out.size()) == 0);
+}
+
+TEST_CASE("Truncated data is rejected", "[lz_codec]") {
+  std::vector<uint8_t> data = RandomBytes(3000, 5);
+  data.insert(data.begin() + 1000, 2000, 0);
+  const std::vector<uint8_t> compressed = Compress(data);
+  std::vector<uint8_t> decompressed;
+  for (size_t size = 0; size < compressed.size(); size++) {
+    const std::vector<uint8_t> truncated(compressed.begin(),
+                                         compressed.begin() + size);
+    CHECK_FALSE(Decompress(truncated, data.size(), &decompressed));
+  }
+  // Nor may it decompress to a size other than the original.
+  CHECK_FALSE(Decompress(compressed, data.size() - 1, &decompressed));
+  CHECK_FALSE(Decompress(compressed, data.size() + 1, &decompressed));
+}
+
+TEST_CASE("Bad offsets and lengths are rejected", "[lz_codec]") {
+  std::vector<uint8_t> data;
+  // An offset of 0.
+  CHECK_FALSE(Decompress({0x40, 'a', 'b', 'c', 'd', 0, 0}, 8, &data));
+  // An offset before the start of the data.
+  CHECK_FALSE(Decompress({0x40, 'a', 'b', 'c', 'd', 5, 0}, 8, &data));
+  // A match running past the end of the data.
+  CHECK_FALSE(Decompress({0x41, 'a', 'b', 'c', 'd', 4, 0}, 8, &data));
+  // More literals than follow.
+  CHECK_FALSE(Decompress({0x50, 'a', 'b', 'c', 'd'}, 5, &data));
+  // More literals than the data holds.
+  CHECK_FALSE(Decompress({0x50, 'a', 'b', 'c', 'd', 'e'}, 4, &data));
+  // Extra length bytes that never end.
+  CHECK_FALSE(Decompress({0xF0, 255, 255}, 600, &data));
+  CHECK_FALSE(Decompress({0x4F, 'a', 'b', 'c', 'd', 4, 0, 255}, 300, &data));
+  // A missing offset.
+  CHECK_FALSE(Decompress({0x40, 'a', 'b', 'c', 'd', 4}, 8, &data));
+
+  // The well-formed version of the above.
+  CHECK(Decompress({0x40, 'a', 'b', 'c', 'd', 4, 0}, 8, &data));
+  CHECK(data == std::vector<uint8_t>{'a', 'b', 'c', 'd', 'a', 'b', 'c', 'd'});
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -1,30 +1,187 @@
 #include "cartridge.h"
 #include "emulator.h"
+#include "frame_buffers.h"
+#include "socket_link.h"
 #include "util/logging.h"
+#include "wav_writer.h"
+#include "y4m_writer.h"
 
+#include <array>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
 
+using ::gamebun::AudioMode;
 using ::gamebun::Cartridge;
 using ::gamebun::Emulator;
+using ::gamebun::EmulatorOptions;
+using ::gamebun::Frame;
+using ::gamebun::SocketLink;
+using ::gamebun::WavWriter;
+using ::gamebun::Y4mWriter;
+
+namespace {
+
+void PrintUsage(const char* program) {
+  std::cout << "usage: " << program
+            << " [--frames <count>] [--frame-hashes <log>]"
+               " [--golden-hashes <log>] [--dump-video <y4m>]"
+               " [--dump-audio <wav>] [--link-listen <socket>]"
+               " [--link-connect <socket>] <cart_file>"
+            << std::endl;
+}
+
+// Hash logs list one frame per line as its sequence number followed by its
+// hash in hexadecimal. Frames are in increasing order, with gaps where they
+// were dropped. Returns the hashes by sequence number.
+std::map<uint64_t, uint64_t> ReadHashLog(const char* path) {
+  std::ifstream log(path);
+  if (log.fail()) {
+    FATAL("Unable to open %s", path);
+  }
+  std::map<uint64_t, uint64_t> hashes;
+  uint64_t sequence;
+  uint64_t hash;
+  while (log >> std::dec >> sequence >> std::hex >> hash) {
+    if (sequence == 0 ||
+        (!hashes.empty() && sequence <= hashes.rbegin()->first)) {
+      FATAL("Unexpected frame %llu in %s",
+            static_cast<unsigned long long>(sequence), path);
+    }
+    hashes.emplace(sequence, hash);
+  }
+  return hashes;
+}
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cout << "usage: " << argv[0] << " <cart_file>" << std::endl;
+  uint64_t frame_limit = 0;
+  const char* frame_hash_path = nullptr;
+  const char* golden_hash_path = nullptr;
+  const char* video_path = nullptr;
+  const char* audio_path = nullptr;
+  const char* link_listen_path = nullptr;
+  const char* link_connect_path = nullptr;
+  const char* cart_path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frame_limit = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--frame-hashes") == 0 && i + 1 < argc) {
+      frame_hash_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--golden-hashes") == 0 && i + 1 < argc) {
+      golden_hash_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--dump-video") == 0 && i + 1 < argc) {
+      video_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--dump-audio") == 0 && i + 1 < argc) {
+      audio_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--link-listen") == 0 && i + 1 < argc) {
+      link_listen_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--link-connect") == 0 && i + 1 < argc) {
+      link_connect_path = argv[++i];
+    } else if (cart_path == nullptr && argv[i][0] != '-') {
+      cart_path = argv[i];
+    } else {
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (cart_path == nullptr) {
+    PrintUsage(argv[0]);
     return EXIT_FAILURE;
   }
 
-  std::ifstream cart_file(argv[1], std::ios::binary);
+  std::ifstream cart_file(cart_path, std::ios::binary);
   if (cart_file.fail()) {
-    FATAL("Unable to open %s", argv[1]);
+    FATAL("Unable to open %s", cart_path);
   }
   Cartridge cart(&cart_file);
 
-  Emulator emu(cart);
-  bool success = emu.Run();
-  if (!success) {
-    FATAL("Emulator returned an error");
+  EmulatorOptions options;
+  // Nothing plays the audio, so it is only synthesized to be dumped.
+  if (audio_path == nullptr) {
+    options.audio.mode = AudioMode::kRegistersOnly;
+  }
+  Emulator emu(cart, options);
+  std::unique_ptr<SocketLink> link;
+  if (link_listen_path != nullptr) {
+    link = SocketLink::Listen(link_listen_path);
+  } else if (link_connect_path != nullptr) {
+    link = SocketLink::Connect(link_connect_path);
+  }
+  emu.ConnectSerial(link.get());
+  if (frame_limit == 0 && frame_hash_path == nullptr &&
+      golden_hash_path == nullptr && video_path == nullptr &&
+      audio_path == nullptr) {
+    bool success = emu.Run();
+    if (!success) {
+      FATAL("Emulator returned an error");
+    }
+    return EXIT_SUCCESS;
+  }
+
+  std::ofstream frame_hash_log;
+  if (frame_hash_path != nullptr) {
+    frame_hash_log.open(frame_hash_path);
+    if (frame_hash_log.fail()) {
+      FATAL("Unable to open %s", frame_hash_path);
+    }
+    frame_hash_log << std::hex << std::setfill('0');
+  }
+
+  // Without an explicit limit, a golden log decides how many frames to run.
+  std::map<uint64_t, uint64_t> golden_hashes;
+  if (golden_hash_path != nullptr) {
+    golden_hashes = ReadHashLog(golden_hash_path);
+    if (frame_limit == 0 && !golden_hashes.empty()) {
+      frame_limit = golden_hashes.rbegin()->first;
+    }
+  }
+
+  // Dumps are written from background threads, so the loop below only ever
+  // copies into memory.
+  std::unique_ptr<Y4mWriter> video_dump;
+  if (video_path != nullptr) {
+    video_dump = std::make_unique<Y4mWriter>(video_path, options.pixel_format);
+  }
+  std::unique_ptr<WavWriter> audio_dump;
+  if (audio_path != nullptr) {
+    audio_dump =
+        std::make_unique<WavWriter>(audio_path, options.audio.sample_rate);
+  }
+  std::array<int16_t, 2 * 1024> samples;
+
+  for (uint64_t i = 0; frame_limit == 0 || i < frame_limit; i++) {
+    emu.RunFrame();
+    const Frame frame = emu.AcquireFrame();
+    if (video_dump) {
+      video_dump->WriteFrame(frame);
+    }
+    // Reading the audio every frame keeps it from piling up in the
+    // emulator whether or not it is dumped.
+    while (const size_t count =
+               emu.ReadAudio(samples.data(), samples.size() / 2)) {
+      if (audio_dump) {
+        audio_dump->WriteSamples(samples.data(), count);
+      }
+    }
+    if (frame_hash_log.is_open()) {
+      frame_hash_log << std::dec << frame.sequence << ' ' << std::hex
+                     << std::setw(16) << frame.hash << '\n';
+    }
+    const auto golden = golden_hashes.find(frame.sequence);
+    if (golden != golden_hashes.end() && frame.hash != golden->second) {
+      FATAL("Frame %llu hash %016llx differs from golden hash %016llx",
+            static_cast<unsigned long long>(frame.sequence),
+            static_cast<unsigned long long>(frame.hash),
+            static_cast<unsigned long long>(golden->second));
+    }
+    emu.ReleaseFrame(frame);
   }
 
   return EXIT_SUCCESS;
@@ -3,56 +3,109 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "apu.h"
+#include "interrupts.h"
+#include "joypad.h"
 #include "memory_bank_controller.h"
+#include "ppu.h"
+#include "serial.h"
+#include "state.h"
 #include "util/logging.h"
 
 namespace gamebun {
 
-Memory::Memory(
-    const std::vector<std::array<uint8_t, kRomBankSize.value()>>& rom_banks,
-    size_t ram_bank_num, MemoryBankControllerType controller_type)
-    : rom_banks_(rom_banks),
-      ram_banks_(ram_bank_num),
+namespace {
+
+// VBK and the palette registers, which the PPU ignores outside CGB mode.
+bool IsColorPpuRegister(Address address) {
+  return address.value() == 0xFF4F ||
+         (0xFF68 <= address.value() && address.value() < 0xFF6C);
+}
+
+}  // namespace
+
+Memory::Memory(std::shared_ptr<const RomBanks> rom_banks, size_t ram_bank_num,
+               MemoryBankControllerType controller_type, Ppu* ppu, Apu* apu,
+               Joypad* joypad, Serial* serial, Interrupts* interrupts,
+               Arena* arena)
+    : rom_banks_(std::move(rom_banks)),
+      ram_bank_num_(ram_bank_num),
+      ram_(ram_bank_num * kRamBankSize.value(), arena),
       memory_bank_controller_(
-          MemoryBankController::SelectController(controller_type)) {}
+          MemoryBankController::SelectController(controller_type, arena)),
+      ppu_(*ppu),
+      apu_(*apu),
+      joypad_(*joypad),
+      serial_(*serial),
+      interrupts_(*interrupts),
+      oam_dma_source_(0) {}
+
+size_t Memory::SelectedRomBank() const {
+  return memory_bank_controller_->GetSelectedRomBank() % rom_banks_->size();
+}
+
+bool Memory::RamOffset(Address address, size_t* offset) const {
+  if (ram_bank_num_ == 0 || !memory_bank_controller_->RamEnabled()) {
+    return false;
+  }
+  const size_t bank =
+      memory_bank_controller_->GetSelectedRamBank() % ram_bank_num_;
+  *offset = bank * kRamBankSize.value() + (address.value() - 0xA000);
+  return true;
+}
 
 uint8_t Memory::Read(Address address) const {
   if (address.value() < 0x4000) {
-    return rom_banks_[0][address.value()];
+    return (*rom_banks_)[0][address.value()];
   } else if (0x4000 <= address.value() && address.value() < 0x8000) {
     const Address effective_addr = address - 0x4000;
-    return rom_banks_[memory_bank_controller_->GetSelectedRomBank()]
-                     [effective_addr.value()];
+    return (*rom_banks_)[SelectedRomBank()][effective_addr.value()];
   } else if (0x8000 <= address.value() && address.value() < 0xA000) {
-    // TODO: Implement reading from video RAM
+    return ppu_.Read(address);
   } else if (0xA000 <= address.value() && address.value() < 0xC000) {
-    if (!memory_bank_controller_->RamEnabled()) {
+    size_t offset;
+    if (!RamOffset(address, &offset)) {
       return 0;
     }
-
-    const Address effective_addr = address - 0xA000;
-    return ram_banks_[memory_bank_controller_->GetSelectedRamBank()]
-                     [effective_addr.value()];
+    return ram_.Read(offset);
   } else if (0xC000 <= address.value() && address.value() < 0xE000) {
     // TODO: Implement reading from internal RAM
   } else if (0xE000 <= address.value() && address.value() < 0xFE00) {
     // TODO: Implement reading from internal RAM
   } else if (0xFE00 <= address.value() && address.value() < 0xFEA0) {
-    // TODO: Implement reading from sprite attribute memory
+    return ppu_.Read(address);
   } else if (0xFEA0 <= address.value() && address.value() < 0xFF00) {
     // Empty, but unusable for I/O
     return 0;
   } else if (0xFF00 <= address.value() && address.value() < 0xFF4C) {
-    // TODO: Implement reading from I/O ports
+    if (address.value() == 0xFF0F) {
+      return interrupts_.Flag();
+    } else if (address.value() == 0xFF46) {
+      return oam_dma_source_;
+    } else if (0xFF40 <= address.value()) {
+      return ppu_.Read(address);
+    } else if (0xFF10 <= address.value()) {
+      return apu_.Read(address);
+    } else if (address.value() == 0xFF01 || address.value() == 0xFF02) {
+      return serial_.Read(address);
+    } else if (address.value() == 0xFF00) {
+      return joypad_.Read(address);
+    }
+    // TODO: Implement reading from the remaining I/O ports
   } else if (0xFF4C <= address.value() && address.value() < 0xFF80) {
+    if (IsColorPpuRegister(address)) {
+      return ppu_.Read(address);
+    }
     // Empty, but unusable for I/O
     return 0;
   } else if (0xFF80 <= address.value() && address.value() < 0xFFFF) {
     // TODO: Implement reading from internal RAM
   } else if (address.value() == 0xFFFF) {
-    // TODO: Implement reading from interrupt enable register
+    return interrupts_.Enable();
   }
   FATAL("Unexpected read address %x", address.value());
 }
@@ -60,36 +113,79 @@ uint8_t Memory::Read(Address address) const {
 void Memory::Write(Address address, uint8_t value) {
   if (address.value() < 0x8000) {
     memory_bank_controller_->Write(address, value);
+    return;
   } else if (0x8000 <= address.value() && address.value() < 0xA000) {
-    // TODO: Implement writing to video RAM
+    ppu_.Write(address, value);
+    return;
   } else if (0xA000 <= address.value() && address.value() < 0xC000) {
-    if (!memory_bank_controller_->RamEnabled()) {
-      return;
+    size_t offset;
+    if (RamOffset(address, &offset)) {
+      ram_.Write(offset, value);
     }
-
-    const Address effective_addr = address - 0xA000;
-    ram_banks_[memory_bank_controller_->GetSelectedRamBank()]
-              [effective_addr.value()] = value;
+    return;
   } else if (0xC000 <= address.value() && address.value() < 0xE000) {
     // TODO: Implement writing to internal RAM
   } else if (0xE000 <= address.value() && address.value() < 0xFE00) {
     // TODO: Implement writing to internal RAM
   } else if (0xFE00 <= address.value() && address.value() < 0xFEA0) {
-    // TODO: Implement writing to sprite attribute memory
+    ppu_.Write(address, value);
+    return;
   } else if (0xFEA0 <= address.value() && address.value() < 0xFF00) {
     // Empty, but unusable for I/O
     return;
   } else if (0xFF00 <= address.value() && address.value() < 0xFF4C) {
-    // TODO: Implement writing to I/O ports
+    if (address.value() == 0xFF0F) {
+      interrupts_.SetFlag(value);
+      return;
+    } else if (address.value() == 0xFF46) {
+      OamDma(value);
+      return;
+    } else if (0xFF40 <= address.value()) {
+      ppu_.Write(address, value);
+      return;
+    } else if (0xFF10 <= address.value()) {
+      apu_.Write(address, value);
+      return;
+    } else if (address.value() == 0xFF01 || address.value() == 0xFF02) {
+      serial_.Write(address, value);
+      return;
+    } else if (address.value() == 0xFF00) {
+      joypad_.Write(address, value);
+      return;
+    }
+    // TODO: Implement writing to the remaining I/O ports
   } else if (0xFF4C <= address.value() && address.value() < 0xFF80) {
+    if (IsColorPpuRegister(address)) {
+      ppu_.Write(address, value);
+      return;
+    }
     // Empty, but unusable for I/O
     return;
   } else if (0xFF80 <= address.value() && address.value() < 0xFFFF) {
     // TODO: Implement writing to internal RAM
   } else if (address.value() == 0xFFFF) {
-    // TODO: Implement writing to interrupt enable register
+    interrupts_.SetEnable(value);
+    return;
   }
   FATAL("Unexpected write address %x", address.value());
 }
 
+void Memory::SaveState(StateWriter* writer) const {
+  memory_bank_controller_->SaveState(writer);
+  writer->Write(oam_dma_source_);
+}
+
+void Memory::LoadState(StateReader* reader) {
+  memory_bank_controller_->LoadState(reader);
+  reader->Read(&oam_dma_source_);
+}
+
+void Memory::OamDma(uint8_t source) {
+  oam_dma_source_ = source;
+  const uint16_t base = static_cast<uint16_t>(source << 8);
+  for (uint16_t i = 0; i < kOamSize.value(); i++) {
+    ppu_.Write(Address(0xFE00 + i), Read(Address(base + i)));
+  }
+}
+
 }  // namespace gamebun
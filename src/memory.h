@@ -7,6 +7,8 @@
 #include <memory>
 #include <vector>
 
+#include "arena.h"
+#include "copy_on_write_memory.h"
 #include "util/byte_size.h"
 #include "util/strong_int.h"
 
@@ -17,7 +19,16 @@ inline constexpr util::ByteSize kRamBankSize = 8 * util::kKilobytes;
 
 DEFINE_STRONG_INT_TYPE(Address, uint16_t)
 
+using RomBanks = std::vector<std::array<uint8_t, kRomBankSize.value()>>;
+
+class Apu;
+class Joypad;
 class MemoryBankController;
+class Ppu;
+class Serial;
+class StateReader;
+class StateWriter;
+class Interrupts;
 
 // TODO: Add MMM01
 // TODO: Add Pocket Camera
@@ -34,21 +45,66 @@ enum class MemoryBankControllerType {
 
 class Memory {
  public:
-  Memory(
-      const std::vector<std::array<uint8_t, kRomBankSize.value()>>& rom_banks,
-      size_t ram_bank_num, MemoryBankControllerType controller_type);
+  // The ROM is never written, so emulators of the same cartridge share it.
+  // Everything else is placed in `arena`.
+  Memory(std::shared_ptr<const RomBanks> rom_banks, size_t ram_bank_num,
+         MemoryBankControllerType controller_type, Ppu* ppu, Apu* apu,
+         Joypad* joypad, Serial* serial, Interrupts* interrupts, Arena* arena);
 
   uint8_t Read(Address address) const;
   void Write(Address address, uint8_t value);
 
+  const std::shared_ptr<const RomBanks>& rom_banks() const {
+    return rom_banks_;
+  }
+  // The ROM bank mapped at 0x4000. Bank numbers past the end of the ROM
+  // wrap around, as the cartridge ignores the bank lines it has no use for.
+  size_t SelectedRomBank() const;
+
+  // Saves or restores the bank controller and DMA registers. Cartridge RAM
+  // is handled on its own, since clones share it instead.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  void SaveRam(StateWriter* writer) const { ram_.SaveState(writer); }
+  void LoadRam(StateReader* reader) { ram_.LoadState(reader); }
+  // Bytes of cartridge RAM held by this memory alone.
+  size_t PrivateRamSize() const {
+    return ram_.PrivatePageCount() * CopyOnWriteMemory::kPageSize;
+  }
+  // Makes cartridge RAM a copy-on-write copy of that of `other`.
+  void ShareRamFrom(const Memory& other) { ram_.ShareFrom(other.ram_); }
+
   Memory(const Memory&) = delete;
   Memory& operator=(const Memory&) = delete;
 
  private:
-  const std::vector<std::array<uint8_t, kRomBankSize.value()>> rom_banks_;
-  std::vector<std::array<uint8_t, kRamBankSize.value()>> ram_banks_;
+  // Copies 160 bytes from `source` * 0x100 into sprite attribute memory.
+  //
+  // The copy is done at once, where the hardware takes 160 machine cycles
+  // over it, during which the CPU can only reach high RAM. Games wait out
+  // the transfer in a loop in high RAM, so only code touching the rest of
+  // memory before the transfer would have ended sees a difference.
+  void OamDma(uint8_t source);
+
+  // Returns the offset into `ram_` that `address` in 0xA000-0xBFFF reaches,
+  // or false if cartridge RAM is disabled or missing. RAM bank numbers wrap
+  // around like ROM bank numbers.
+  bool RamOffset(Address address, size_t* offset) const;
+
+  const std::shared_ptr<const RomBanks> rom_banks_;
+  const size_t ram_bank_num_;
+  // All the RAM banks, one after another.
+  CopyOnWriteMemory ram_;
+
+  ArenaPtr<MemoryBankController> memory_bank_controller_;
 
-  std::unique_ptr<MemoryBankController> memory_bank_controller_;
+  Ppu& ppu_;
+  Apu& apu_;
+  Joypad& joypad_;
+  Serial& serial_;
+  Interrupts& interrupts_;
+  uint8_t oam_dma_source_;
 };
 
 }  // namespace gamebun
@@ -2,27 +2,28 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <memory>
 #include <variant>
 
+#include "arena.h"
 #include "memory.h"
+#include "state.h"
 #include "util/logging.h"
 
 namespace gamebun {
 
-std::unique_ptr<MemoryBankController> MemoryBankController::SelectController(
-    MemoryBankControllerType controller_type) {
+ArenaPtr<MemoryBankController> MemoryBankController::SelectController(
+    MemoryBankControllerType controller_type, Arena* arena) {
   switch (controller_type) {
     case MemoryBankControllerType::kNone:
-      return std::make_unique<NoController>();
+      return arena->New<NoController>();
     case MemoryBankControllerType::kController1:
-      return std::make_unique<Controller1>();
+      return arena->New<Controller1>();
     case MemoryBankControllerType::kController2:
-      return std::make_unique<Controller2>();
+      return arena->New<Controller2>();
     case MemoryBankControllerType::kController3:
-      return std::make_unique<Controller3>();
+      return arena->New<Controller3>();
     case MemoryBankControllerType::kController5:
-      return std::make_unique<Controller5>();
+      return arena->New<Controller5>();
     default:
       FATAL("Unknown memory bank type");
   }
@@ -39,6 +40,11 @@ size_t NoController::GetSelectedRamBank() const { return 0; }
 
 bool NoController::RamEnabled() const { return true; }
 
+void NoController::SaveState(
+    StateWriter* writer __attribute__((unused))) const {}
+
+void NoController::LoadState(StateReader* reader __attribute__((unused))) {}
+
 Controller1::Controller1()
     : memory_mode_(MemoryMode::k16MRom8KRam),
       selected_ram_bank_(0),
@@ -77,6 +83,22 @@ size_t Controller1::GetSelectedRamBank() const { return selected_ram_bank_; }
 
 bool Controller1::RamEnabled() const { return ram_enabled_; }
 
+void Controller1::SaveState(StateWriter* writer) const {
+  writer->Write(memory_mode_);
+  writer->Write(selected_ram_bank_);
+  writer->Write(selected_rom_bank_low_);
+  writer->Write(selected_rom_bank_high_);
+  writer->Write(ram_enabled_);
+}
+
+void Controller1::LoadState(StateReader* reader) {
+  reader->Read(&memory_mode_);
+  reader->Read(&selected_ram_bank_);
+  reader->Read(&selected_rom_bank_low_);
+  reader->Read(&selected_rom_bank_high_);
+  reader->Read(&ram_enabled_);
+}
+
 Controller2::Controller2() : selected_rom_bank_(1), ram_enabled_(false) {}
 
 void Controller2::Write(Address address, uint8_t value) {
@@ -97,6 +119,16 @@ size_t Controller2::GetSelectedRamBank() const { return 0; }
 
 bool Controller2::RamEnabled() const { return ram_enabled_; }
 
+void Controller2::SaveState(StateWriter* writer) const {
+  writer->Write(selected_rom_bank_);
+  writer->Write(ram_enabled_);
+}
+
+void Controller2::LoadState(StateReader* reader) {
+  reader->Read(&selected_rom_bank_);
+  reader->Read(&ram_enabled_);
+}
+
 // TODO: Implement MBC3
 void Controller3::Write(Address address __attribute__((unused)),
                         uint8_t value __attribute__((unused))) {}
@@ -107,6 +139,11 @@ size_t Controller3::GetSelectedRamBank() const { return 0; }
 
 bool Controller3::RamEnabled() const { return false; }
 
+void Controller3::SaveState(
+    StateWriter* writer __attribute__((unused))) const {}
+
+void Controller3::LoadState(StateReader* reader __attribute__((unused))) {}
+
 // TODO: Implement MBC5
 void Controller5::Write(Address address __attribute__((unused)),
                         uint8_t value __attribute__((unused))) {}
@@ -117,4 +154,9 @@ size_t Controller5::GetSelectedRamBank() const { return 0; }
 
 bool Controller5::RamEnabled() const { return false; }
 
+void Controller5::SaveState(
+    StateWriter* writer __attribute__((unused))) const {}
+
+void Controller5::LoadState(StateReader* reader __attribute__((unused))) {}
+
 }  // namespace gamebun
@@ -3,17 +3,21 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <memory>
 #include <variant>
 
+#include "arena.h"
 #include "memory.h"
 
 namespace gamebun {
 
+class StateReader;
+class StateWriter;
+
 class MemoryBankController {
  public:
-  static std::unique_ptr<MemoryBankController> SelectController(
-      MemoryBankControllerType controller_type);
+  // Creates the controller in `arena`.
+  static ArenaPtr<MemoryBankController> SelectController(
+      MemoryBankControllerType controller_type, Arena* arena);
 
   virtual ~MemoryBankController() {}
 
@@ -22,6 +26,10 @@ class MemoryBankController {
   virtual size_t GetSelectedRomBank() const = 0;
   virtual size_t GetSelectedRamBank() const = 0;
   virtual bool RamEnabled() const = 0;
+
+  // Saves or restores the registers set through Write().
+  virtual void SaveState(StateWriter* writer) const = 0;
+  virtual void LoadState(StateReader* reader) = 0;
 };
 
 class NoController : public MemoryBankController {
@@ -31,6 +39,9 @@ class NoController : public MemoryBankController {
   size_t GetSelectedRomBank() const override;
   size_t GetSelectedRamBank() const override;
   bool RamEnabled() const override;
+
+  void SaveState(StateWriter* writer) const override;
+  void LoadState(StateReader* reader) override;
 };
 
 class Controller1 : public MemoryBankController {
@@ -43,6 +54,9 @@ class Controller1 : public MemoryBankController {
   size_t GetSelectedRamBank() const override;
   bool RamEnabled() const override;
 
+  void SaveState(StateWriter* writer) const override;
+  void LoadState(StateReader* reader) override;
+
  private:
   enum class MemoryMode {
     k16MRom8KRam,
@@ -66,6 +80,9 @@ class Controller2 : public MemoryBankController {
   size_t GetSelectedRamBank() const override;
   bool RamEnabled() const override;
 
+  void SaveState(StateWriter* writer) const override;
+  void LoadState(StateReader* reader) override;
+
  private:
   size_t selected_rom_bank_;
   bool ram_enabled_;
@@ -78,6 +95,9 @@ class Controller3 : public MemoryBankController {
   size_t GetSelectedRomBank() const override;
   size_t GetSelectedRamBank() const override;
   bool RamEnabled() const override;
+
+  void SaveState(StateWriter* writer) const override;
+  void LoadState(StateReader* reader) override;
 };
 
 class Controller5 : public MemoryBankController {
@@ -87,6 +107,9 @@ class Controller5 : public MemoryBankController {
   size_t GetSelectedRomBank() const override;
   size_t GetSelectedRamBank() const override;
   bool RamEnabled() const override;
+
+  void SaveState(StateWriter* writer) const override;
+  void LoadState(StateReader* reader) override;
 };
 
 }  // namespace gamebun
@@ -0,0 +1,219 @@
+#include "movie.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "emulator.h"
+#include "joypad.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// "GBMV" in little-endian byte order, at the start of every movie.
+constexpr uint32_t kMovieMagic = 0x564D4247;
+// Changes whenever the layout of a serialized movie does.
+constexpr uint16_t kMovieVersion = 1;
+
+constexpr uint8_t kAllButtons = 0xFF;
+
+// Keyframes are saved at the start and before every `interval`th frame
+// after it, but not after the last frame.
+uint64_t KeyframeCount(uint64_t frame_count, uint64_t interval) {
+  return frame_count == 0 ? 1 : (frame_count - 1) / interval + 1;
+}
+
+// Queues the `changed` bits of `buttons`, stamped at cycle 0 so that they
+// apply as the next frame starts running. At most eight are queued between
+// frames, which always fit.
+void QueueButtons(Emulator* emulator, uint8_t changed, uint8_t buttons) {
+  for (unsigned bit = 1; bit <= 0x80; bit <<= 1) {
+    if ((changed & bit) != 0) {
+      emulator->QueueInput({0, JoypadEvent::TimeUnit::kCycles,
+                            static_cast<Button>(bit), (buttons & bit) != 0});
+    }
+  }
+}
+
+}  // namespace
+
+Movie::Movie()
+    : emulator_version_(kEmulatorVersion),
+      rom_hash_(0),
+      keyframe_interval_(1) {}
+
+std::vector<uint8_t> Movie::Serialize() const {
+  StateWriter measure(nullptr, 0);
+  Write(&measure);
+  std::vector<uint8_t> data(measure.size());
+  StateWriter writer(data.data(), data.size());
+  Write(&writer);
+  return data;
+}
+
+void Movie::Write(StateWriter* writer) const {
+  writer->Write(kMovieMagic);
+  writer->Write(kMovieVersion);
+  writer->Write(emulator_version_);
+  writer->Write(rom_hash_);
+  writer->Write(keyframe_interval_);
+  const uint64_t frame_count = buttons_.size();
+  writer->Write(frame_count);
+  writer->WriteBytes(buttons_.data(), buttons_.size());
+  const uint64_t keyframe_count = keyframes_.size();
+  writer->Write(keyframe_count);
+  for (const std::vector<uint8_t>& keyframe : keyframes_) {
+    const uint64_t size = keyframe.size();
+    writer->Write(size);
+    writer->WriteBytes(keyframe.data(), keyframe.size());
+  }
+}
+
+bool Movie::Deserialize(const uint8_t* data, size_t size) {
+  StateReader reader(data, size);
+  uint32_t magic;
+  uint16_t version;
+  uint32_t emulator_version;
+  uint64_t rom_hash;
+  uint64_t keyframe_interval;
+  uint64_t frame_count;
+  reader.Read(&magic);
+  reader.Read(&version);
+  reader.Read(&emulator_version);
+  reader.Read(&rom_hash);
+  reader.Read(&keyframe_interval);
+  reader.Read(&frame_count);
+  if (reader.failed() || magic != kMovieMagic || version != kMovieVersion ||
+      keyframe_interval == 0 || frame_count > reader.remaining()) {
+    return false;
+  }
+  std::vector<uint8_t> buttons(frame_count);
+  reader.ReadBytes(buttons.data(), buttons.size());
+
+  uint64_t keyframe_count;
+  reader.Read(&keyframe_count);
+  if (reader.failed() ||
+      keyframe_count != KeyframeCount(frame_count, keyframe_interval)) {
+    return false;
+  }
+  std::vector<std::vector<uint8_t>> keyframes;
+  for (uint64_t i = 0; i < keyframe_count; i++) {
+    uint64_t keyframe_size;
+    reader.Read(&keyframe_size);
+    if (reader.failed() || keyframe_size > reader.remaining()) {
+      return false;
+    }
+    keyframes.emplace_back(keyframe_size);
+    reader.ReadBytes(keyframes.back().data(), keyframes.back().size());
+  }
+  if (reader.remaining() != 0) {
+    return false;
+  }
+
+  emulator_version_ = emulator_version;
+  rom_hash_ = rom_hash;
+  keyframe_interval_ = keyframe_interval;
+  buttons_ = std::move(buttons);
+  keyframes_ = std::move(keyframes);
+  return true;
+}
+
+MovieRecorder::MovieRecorder(Emulator* emulator, Movie* movie,
+                             size_t keyframe_interval)
+    : emulator_(*emulator),
+      movie_(*movie),
+      buttons_(0),
+      buttons_known_(false),
+      state_(emulator->MaxSaveStateSize()) {
+  if (keyframe_interval == 0) {
+    FATAL("Movie keyframe interval must not be 0");
+  }
+  movie_.emulator_version_ = kEmulatorVersion;
+  movie_.rom_hash_ = emulator_.RomHash();
+  movie_.keyframe_interval_ = keyframe_interval;
+  movie_.buttons_.clear();
+  movie_.keyframes_.clear();
+  SaveKeyframe();
+}
+
+RunResult MovieRecorder::RunFrame(uint8_t buttons) {
+  const uint64_t frame = movie_.buttons_.size();
+  if (frame != 0 && frame % movie_.keyframe_interval_ == 0) {
+    SaveKeyframe();
+  }
+  QueueButtons(&emulator_, buttons_known_ ? buttons_ ^ buttons : kAllButtons,
+               buttons);
+  buttons_ = buttons;
+  buttons_known_ = true;
+  movie_.buttons_.push_back(buttons);
+  return emulator_.RunFrame();
+}
+
+void MovieRecorder::SaveKeyframe() {
+  const size_t size = emulator_.SaveState(state_.data(), state_.size());
+  if (size == 0) {
+    FATAL("Unable to save a movie keyframe with input queued far ahead");
+  }
+  movie_.keyframes_.emplace_back(state_.begin(), state_.begin() + size);
+}
+
+MoviePlayer::MoviePlayer(Emulator* emulator, const Movie* movie)
+    : emulator_(*emulator),
+      movie_(*movie),
+      rom_hash_(emulator->RomHash()),
+      positioned_(false),
+      frame_(0),
+      buttons_(0),
+      buttons_known_(false) {}
+
+bool MoviePlayer::Seek(uint64_t frame) {
+  if (movie_.emulator_version_ != kEmulatorVersion ||
+      movie_.rom_hash_ != rom_hash_ || movie_.keyframes_.empty() ||
+      frame > movie_.frame_count()) {
+    return false;
+  }
+  const uint64_t keyframe =
+      std::min<uint64_t>(frame / movie_.keyframe_interval_,
+                         movie_.keyframes_.size() - 1);
+  const std::vector<uint8_t>& state = movie_.keyframes_[keyframe];
+  if (!emulator_.LoadState(state.data(), state.size())) {
+    return false;
+  }
+  positioned_ = true;
+  frame_ = keyframe * movie_.keyframe_interval_;
+  buttons_known_ = frame_ != 0;
+  buttons_ = buttons_known_ ? movie_.buttons_[frame_ - 1] : 0;
+  while (frame_ < frame) {
+    PlayFrame();
+  }
+  int16_t discarded[2 * 512];
+  while (emulator_.ReadAudio(discarded, std::size(discarded) / 2) != 0) {
+  }
+  return true;
+}
+
+bool MoviePlayer::RunFrame() {
+  if (!positioned_ || frame_ == movie_.frame_count()) {
+    return false;
+  }
+  PlayFrame();
+  return true;
+}
+
+void MoviePlayer::PlayFrame() {
+  const uint8_t buttons = movie_.buttons_[frame_];
+  QueueButtons(&emulator_, buttons_known_ ? buttons_ ^ buttons : kAllButtons,
+               buttons);
+  buttons_ = buttons;
+  buttons_known_ = true;
+  frame_++;
+  emulator_.RunFrame();
+}
+
+}  // namespace gamebun
@@ -0,0 +1,128 @@
+#ifndef MOVIE_H_
+#define MOVIE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "emulator.h"
+#include "state.h"
+
+namespace gamebun {
+
+// A recorded session: the buttons held during each frame, along with the
+// emulator's saved state every `keyframe_interval` frames. Since emulation
+// is deterministic, playing the buttons back from the first state
+// reproduces the session exactly, and any frame can be reached from the
+// keyframe before it without playing anything earlier.
+//
+// A movie names the ROM it was recorded with by its hash, and the
+// emulator by kEmulatorVersion, and only plays back on a match.
+class Movie {
+ public:
+  Movie();
+
+  // The movie as a single block of bytes, for storing it, and back.
+  // Deserialize() returns false if `data` is not a whole movie, leaving the
+  // movie unchanged. Like saved states, the fields are in the host's byte
+  // order.
+  std::vector<uint8_t> Serialize() const;
+  bool Deserialize(const uint8_t* data, size_t size);
+
+  // Number of frames recorded.
+  uint64_t frame_count() const { return buttons_.size(); }
+  // The Button bits held during `frame`.
+  uint8_t buttons(uint64_t frame) const { return buttons_[frame]; }
+
+  Movie(const Movie&) = delete;
+  Movie& operator=(const Movie&) = delete;
+
+ private:
+  // Fill movies in and play them back.
+  friend class MovieRecorder;
+  friend class MoviePlayer;
+
+  void Write(StateWriter* writer) const;
+
+  uint32_t emulator_version_;
+  uint64_t rom_hash_;
+  uint64_t keyframe_interval_;
+  std::vector<uint8_t> buttons_;
+  // The state saved before frame `i * keyframe_interval_` runs, for each i.
+  std::vector<std::vector<uint8_t>> keyframes_;
+};
+
+// Records an emulator's session into a movie. While recording, input must
+// only reach the emulator through RunFrame().
+class MovieRecorder {
+ public:
+  // Replaces whatever `movie` held with a recording starting from where
+  // `emulator` is now. Both must outlive the recorder. Each keyframe is a
+  // saved state of a few kilobytes, and seeking plays up to
+  // `keyframe_interval` frames, so a few hundred suits most uses.
+  MovieRecorder(Emulator* emulator, Movie* movie, size_t keyframe_interval);
+
+  // Holds down the Button bits of `buttons` and runs a frame, recording
+  // both. Recording costs a byte a frame, plus a saved state at each
+  // keyframe.
+  RunResult RunFrame(uint8_t buttons);
+
+  MovieRecorder(const MovieRecorder&) = delete;
+  MovieRecorder& operator=(const MovieRecorder&) = delete;
+
+ private:
+  void SaveKeyframe();
+
+  Emulator& emulator_;
+  Movie& movie_;
+  // The buttons held in the last frame. Until the first frame, those held
+  // are whatever the emulator started with, so all eight are set then.
+  uint8_t buttons_;
+  bool buttons_known_;
+  // Room for a saved state, before it is copied into the movie.
+  std::vector<uint8_t> state_;
+};
+
+// Plays a movie back on an emulator of the same cartridge.
+class MoviePlayer {
+ public:
+  // Both must outlive the player. Nothing plays until Seek() succeeds.
+  MoviePlayer(Emulator* emulator, const Movie* movie);
+
+  // Puts the emulator where it was just before `frame` was recorded, or
+  // after the last frame if `frame` is the movie's frame count, and returns
+  // true. This loads the keyframe at or before `frame` and plays the rest,
+  // so it takes at most a keyframe interval of frames however long the
+  // movie is. Audio from the frames played is dropped.
+  //
+  // Returns false, leaving the emulator as it was, if the movie was
+  // recorded with another ROM or emulator version, or if `frame` is past
+  // its end.
+  bool Seek(uint64_t frame);
+
+  // Plays the next frame with the buttons recorded for it and returns true,
+  // or returns false at the end of the movie.
+  bool RunFrame();
+
+  // The frame RunFrame() plays next.
+  uint64_t frame() const { return frame_; }
+
+  MoviePlayer(const MoviePlayer&) = delete;
+  MoviePlayer& operator=(const MoviePlayer&) = delete;
+
+ private:
+  void PlayFrame();
+
+  Emulator& emulator_;
+  const Movie& movie_;
+  const uint64_t rom_hash_;
+  bool positioned_;
+  uint64_t frame_;
+  // The buttons held in the last frame, tracked as the recorder did.
+  uint8_t buttons_;
+  bool buttons_known_;
+};
+
+}  // namespace gamebun
+
+#endif  // MOVIE_H_
@@ -0,0 +1,196 @@
+#include "movie.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "apu.h"
+#include "cartridge.h"
+#include "emulator.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Turns the LCD on and then keeps copying P1, with every button selected,
+// into the tile data, so that what is shown depends on the buttons held.
+const std::vector<uint8_t> kInputProgram = {
+    0x3E, 0x91,        // 0x100: LD A, 0x91
+    0xE0, 0x40,        // 0x102: LDH (0x40), A
+    0x21, 0x00, 0x80,  // 0x104: LD HL, 0x8000
+    0xAF,              // 0x107: XOR A
+    0xE0, 0x00,        // 0x108: LDH (0x00), A
+    0xF0, 0x00,        // 0x10A: LDH A, (0x00)
+    0x22,              // 0x10C: LD (HL+), A
+    0x7C,              // 0x10D: LD A, H
+    0xFE, 0x98,        // 0x10E: CP 0x98
+    0x20, 0xF5,        // 0x110: JR NZ, 0x107
+    0x18, 0xF0,        // 0x112: JR 0x104
+};
+
+constexpr uint64_t kFrames = 200;
+constexpr size_t kKeyframeInterval = 32;
+
+EmulatorOptions Options() {
+  EmulatorOptions options;
+  options.audio.mode = AudioMode::kRegistersOnly;
+  return options;
+}
+
+std::vector<uint8_t> SaveState(Emulator* emulator) {
+  std::vector<uint8_t> state(emulator->MaxSaveStateSize());
+  const size_t size = emulator->SaveState(state.data(), state.size());
+  REQUIRE(size != 0);
+  state.resize(size);
+  return state;
+}
+
+uint64_t FrameHash(Emulator* emulator) {
+  const Frame frame = emulator->AcquireFrame();
+  const uint64_t hash = frame.hash;
+  emulator->ReleaseFrame(frame);
+  return hash;
+}
+
+// A movie of kFrames frames of buttons that change every few frames, along
+// with the emulator's state before each frame, and after the last, and the
+// hash of each frame.
+struct Recording {
+  explicit Recording(const Cartridge& cart) {
+    Emulator emulator(cart, Options());
+    MovieRecorder recorder(&emulator, &movie, kKeyframeInterval);
+    uint32_t random = 1;
+    uint8_t buttons = 0;
+    for (uint64_t frame = 0; frame < kFrames; frame++) {
+      random = random * 1103515245 + 12345;
+      if ((random >> 16) % 4 == 0) {
+        buttons = static_cast<uint8_t>(random >> 24);
+      }
+      states.push_back(SaveState(&emulator));
+      recorder.RunFrame(buttons);
+      hashes.push_back(FrameHash(&emulator));
+    }
+    states.push_back(SaveState(&emulator));
+  }
+
+  Movie movie;
+  std::vector<std::vector<uint8_t>> states;
+  std::vector<uint64_t> hashes;
+};
+
+TEST_CASE("Played back movies reproduce the recording", "[movie]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  const Recording recording(cart);
+  REQUIRE(recording.movie.frame_count() == kFrames);
+  // Frames differ with the buttons held, so matching them means something.
+  CHECK(recording.hashes.front() != recording.hashes.back());
+
+  Emulator emulator(cart, Options());
+  MoviePlayer player(&emulator, &recording.movie);
+  CHECK_FALSE(player.RunFrame());
+  REQUIRE(player.Seek(0));
+  CHECK(SaveState(&emulator) == recording.states[0]);
+  for (uint64_t frame = 0; frame < kFrames; frame++) {
+    REQUIRE(player.RunFrame());
+    CHECK(FrameHash(&emulator) == recording.hashes[frame]);
+  }
+  CHECK_FALSE(player.RunFrame());
+  CHECK(SaveState(&emulator) == recording.states[kFrames]);
+}
+
+TEST_CASE("Movies seek to any frame", "[movie]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  const Recording recording(cart);
+  Emulator emulator(cart, Options());
+  MoviePlayer player(&emulator, &recording.movie);
+
+  // Keyframes, the frames either side of them, and the ends, out of order.
+  for (const uint64_t frame : {uint64_t{150}, uint64_t{0}, uint64_t{31},
+                               uint64_t{32}, uint64_t{33}, kFrames - 1,
+                               uint64_t{64}, uint64_t{1}, kFrames}) {
+    INFO("frame " << frame);
+    REQUIRE(player.Seek(frame));
+    CHECK(player.frame() == frame);
+    CHECK(SaveState(&emulator) == recording.states[frame]);
+    if (frame < kFrames) {
+      REQUIRE(player.RunFrame());
+      CHECK(FrameHash(&emulator) == recording.hashes[frame]);
+    }
+  }
+
+  const std::vector<uint8_t> before = SaveState(&emulator);
+  CHECK_FALSE(player.Seek(kFrames + 1));
+  CHECK(SaveState(&emulator) == before);
+}
+
+TEST_CASE("Movies only play back on their own cartridge", "[movie]") {
+  const Recording recording(MakeTestCartridge(kInputProgram));
+  std::vector<uint8_t> program = kInputProgram;
+  program.push_back(0x00);
+  program.push_back(0x01);
+  const Cartridge other_cart = MakeTestCartridge(program);
+  Emulator emulator(other_cart, Options());
+  MoviePlayer player(&emulator, &recording.movie);
+  CHECK_FALSE(player.Seek(0));
+  CHECK_FALSE(player.RunFrame());
+}
+
+TEST_CASE("Serialized movies load back", "[movie]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  const Recording recording(cart);
+  const std::vector<uint8_t> data = recording.movie.Serialize();
+
+  Movie movie;
+  REQUIRE(movie.Deserialize(data.data(), data.size()));
+  CHECK(movie.frame_count() == kFrames);
+  CHECK(movie.Serialize() == data);
+
+  Emulator emulator(cart, Options());
+  MoviePlayer player(&emulator, &movie);
+  REQUIRE(player.Seek(100));
+  CHECK(SaveState(&emulator) == recording.states[100]);
+}
+
+TEST_CASE("Damaged movies are rejected", "[movie]") {
+  const Cartridge cart = MakeTestCartridge(kInputProgram);
+  const Recording recording(cart);
+  const std::vector<uint8_t> data = recording.movie.Serialize();
+  Movie movie;
+  REQUIRE(movie.Deserialize(data.data(), data.size()));
+
+  SECTION("truncated") {
+    for (size_t size = 0; size < data.size(); size += 97) {
+      INFO("size " << size);
+      CHECK_FALSE(movie.Deserialize(data.data(), size));
+    }
+    CHECK_FALSE(movie.Deserialize(data.data(), data.size() - 1));
+  }
+  SECTION("with extra data") {
+    std::vector<uint8_t> longer = data;
+    longer.push_back(0);
+    CHECK_FALSE(movie.Deserialize(longer.data(), longer.size()));
+  }
+  SECTION("with the wrong keyframe count") {
+    // The count follows the magic, version, emulator version, ROM hash,
+    // keyframe interval, frame count and the buttons of each frame.
+    constexpr size_t kKeyframeCountOffset = 4 + 2 + 4 + 8 + 8 + 8 + kFrames;
+    for (const uint8_t delta : {uint8_t{1}, uint8_t{0xFF}}) {
+      std::vector<uint8_t> damaged = data;
+      damaged[kKeyframeCountOffset] += delta;
+      CHECK_FALSE(movie.Deserialize(damaged.data(), damaged.size()));
+    }
+  }
+  SECTION("with a zero keyframe interval") {
+    constexpr size_t kIntervalOffset = 4 + 2 + 4 + 8;
+    std::vector<uint8_t> damaged = data;
+    damaged[kIntervalOffset] = 0;
+    CHECK_FALSE(movie.Deserialize(damaged.data(), damaged.size()));
+  }
+  // Failures leave the movie as it was.
+  CHECK(movie.Serialize() == data);
+}
+
+}  // namespace
+}  // namespace gamebun
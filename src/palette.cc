@@ -0,0 +1,226 @@
+#include "palette.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "util/logging.h"
+
+namespace gamebun {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "host pixels are stored in little-endian byte order");
+
+namespace {
+
+using ColorTable = std::array<uint32_t, 1 << 15>;
+
+// The four DMG shades as 15-bit colors, from lightest to darkest.
+constexpr std::array<uint16_t, 4> kDmgShades = {0x7FFF, 0x56B5, 0x294A,
+                                                0x0000};
+
+uint32_t ExpandComponent(uint32_t component) {
+  return (component << 3) | (component >> 2);
+}
+
+// Approximates how colors appear on the CGB's LCD, which is darker and less
+// saturated than a modern display, by mixing the channels and capping their
+// brightness.
+void CorrectColor(uint32_t* r, uint32_t* g, uint32_t* b) {
+  const uint32_t red = *r * 26 + *g * 4 + *b * 2;
+  const uint32_t green = *g * 24 + *b * 8;
+  const uint32_t blue = *r * 6 + *g * 4 + *b * 22;
+  *r = std::min<uint32_t>(red, 960) >> 2;
+  *g = std::min<uint32_t>(green, 960) >> 2;
+  *b = std::min<uint32_t>(blue, 960) >> 2;
+}
+
+ColorTable BuildColorTable(PixelFormat format, bool color_correction) {
+  ColorTable table;
+  for (uint32_t color = 0; color < table.size(); color++) {
+    uint32_t r = color & 0x1F;
+    uint32_t g = (color >> 5) & 0x1F;
+    uint32_t b = (color >> 10) & 0x1F;
+    if (color_correction) {
+      CorrectColor(&r, &g, &b);
+    } else {
+      r = ExpandComponent(r);
+      g = ExpandComponent(g);
+      b = ExpandComponent(b);
+    }
+
+    switch (format) {
+      case PixelFormat::kRgba8888:
+        table[color] = r | (g << 8) | (b << 16) | 0xFF000000;
+        break;
+      case PixelFormat::kRgb565:
+        table[color] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        break;
+    }
+  }
+  return table;
+}
+
+// The tables are built on first use and shared by every emulator instance.
+const ColorTable& GetColorTable(PixelFormat format, bool color_correction) {
+  switch (format) {
+    case PixelFormat::kRgba8888:
+      if (color_correction) {
+        static const ColorTable table =
+            BuildColorTable(PixelFormat::kRgba8888, true);
+        return table;
+      } else {
+        static const ColorTable table =
+            BuildColorTable(PixelFormat::kRgba8888, false);
+        return table;
+      }
+    case PixelFormat::kRgb565:
+      if (color_correction) {
+        static const ColorTable table =
+            BuildColorTable(PixelFormat::kRgb565, true);
+        return table;
+      } else {
+        static const ColorTable table =
+            BuildColorTable(PixelFormat::kRgb565, false);
+        return table;
+      }
+    default:
+      FATAL("Unknown pixel format");
+  }
+}
+
+}  // namespace
+
+size_t BytesPerPixel(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgba8888:
+      return 4;
+    case PixelFormat::kRgb565:
+      return 2;
+    default:
+      FATAL("Unknown pixel format");
+  }
+}
+
+PaletteTable::PaletteTable(PixelFormat format, bool color_correction)
+    : format_(format),
+      color_table_(GetColorTable(format, color_correction)),
+      pixels_(),
+      planes_(),
+      used_entries_(0) {}
+
+void PaletteTable::SetDmgPalette(size_t palette, uint8_t value) {
+  for (size_t color = 0; color < 4; color++) {
+    const size_t shade = (value >> (color * 2)) & 0x3;
+    SetPixel(palette * 4 + color, color_table_[kDmgShades[shade]]);
+  }
+}
+
+void PaletteTable::SetColor(size_t entry, uint16_t rgb15) {
+  SetPixel(entry, color_table_[rgb15 & 0x7FFF]);
+}
+
+void PaletteTable::SetPixel(size_t entry, uint32_t pixel) {
+  pixels_[entry] = pixel;
+  if (entry < 16) {
+    for (size_t byte = 0; byte < planes_.size(); byte++) {
+      planes_[byte][entry] = static_cast<uint8_t>(pixel >> (byte * 8));
+    }
+  }
+  used_entries_ = std::max(used_entries_, entry + 1);
+}
+
+// With at most 16 entries in use, each byte of the output pixels is a byte
+// shuffle of one plane. Otherwise whole pixels are gathered from the table.
+void PaletteTable::ConvertLine(const uint8_t* entries, size_t count,
+                               uint8_t* out) const {
+  size_t i = 0;
+  if (used_entries_ <= 16) {
+#if defined(__SSSE3__)
+    const auto load_plane = [this](size_t byte) {
+      return _mm_loadu_si128(
+          reinterpret_cast<const __m128i_u*>(planes_[byte].data()));
+    };
+    switch (format_) {
+      case PixelFormat::kRgba8888: {
+        const __m128i r_plane = load_plane(0);
+        const __m128i g_plane = load_plane(1);
+        const __m128i b_plane = load_plane(2);
+        const __m128i a_plane = load_plane(3);
+        for (; i + 16 <= count; i += 16) {
+          const __m128i indices = _mm_loadu_si128(
+              reinterpret_cast<const __m128i_u*>(&entries[i]));
+          const __m128i r = _mm_shuffle_epi8(r_plane, indices);
+          const __m128i g = _mm_shuffle_epi8(g_plane, indices);
+          const __m128i b = _mm_shuffle_epi8(b_plane, indices);
+          const __m128i a = _mm_shuffle_epi8(a_plane, indices);
+          const __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+          const __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+          const __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+          const __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+          __m128i_u* dest = reinterpret_cast<__m128i_u*>(&out[i * 4]);
+          _mm_storeu_si128(&dest[0], _mm_unpacklo_epi16(rg_lo, ba_lo));
+          _mm_storeu_si128(&dest[1], _mm_unpackhi_epi16(rg_lo, ba_lo));
+          _mm_storeu_si128(&dest[2], _mm_unpacklo_epi16(rg_hi, ba_hi));
+          _mm_storeu_si128(&dest[3], _mm_unpackhi_epi16(rg_hi, ba_hi));
+        }
+        break;
+      }
+      case PixelFormat::kRgb565: {
+        const __m128i lo_plane = load_plane(0);
+        const __m128i hi_plane = load_plane(1);
+        for (; i + 16 <= count; i += 16) {
+          const __m128i indices = _mm_loadu_si128(
+              reinterpret_cast<const __m128i_u*>(&entries[i]));
+          const __m128i lo = _mm_shuffle_epi8(lo_plane, indices);
+          const __m128i hi = _mm_shuffle_epi8(hi_plane, indices);
+          __m128i_u* dest = reinterpret_cast<__m128i_u*>(&out[i * 2]);
+          _mm_storeu_si128(&dest[0], _mm_unpacklo_epi8(lo, hi));
+          _mm_storeu_si128(&dest[1], _mm_unpackhi_epi8(lo, hi));
+        }
+        break;
+      }
+    }
+#endif
+  } else {
+#if defined(__AVX2__)
+    const int* table = reinterpret_cast<const int*>(pixels_.data());
+    const auto gather = [table, entries](size_t first) {
+      const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+          reinterpret_cast<const __m128i_u*>(&entries[first])));
+      return _mm256_i32gather_epi32(table, indices, 4);
+    };
+    switch (format_) {
+      case PixelFormat::kRgba8888:
+        for (; i + 8 <= count; i += 8) {
+          _mm256_storeu_si256(reinterpret_cast<__m256i_u*>(&out[i * 4]),
+                              gather(i));
+        }
+        break;
+      case PixelFormat::kRgb565:
+        // Packing works within 128-bit lanes, so the middle two quarters
+        // come out swapped.
+        for (; i + 16 <= count; i += 16) {
+          const __m256i packed = _mm256_packus_epi32(gather(i), gather(i + 8));
+          _mm256_storeu_si256(reinterpret_cast<__m256i_u*>(&out[i * 2]),
+                              _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+        break;
+    }
+#endif
+  }
+
+  const size_t bytes_per_pixel = BytesPerPixel(format_);
+  for (; i < count; i++) {
+    std::memcpy(&out[i * bytes_per_pixel],
+                &pixels_[entries[i] % kPaletteEntryCount], bytes_per_pixel);
+  }
+}
+
+}  // namespace gamebun
@@ -0,0 +1,66 @@
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace gamebun {
+
+enum class PixelFormat {
+  // 4 bytes per pixel, in R, G, B, A order in memory.
+  kRgba8888,
+  // 2 bytes per pixel, red in the top 5 bits and blue in the bottom 5.
+  kRgb565,
+};
+
+size_t BytesPerPixel(PixelFormat format);
+
+// Palette entry indices are the PPU's internal pixel format. On DMG, entries
+// 0-3, 4-7 and 8-11 are the four colors of BGP, OBP0 and OBP1. On CGB,
+// entries 0-31 are the eight background palettes and 32-63 the eight sprite
+// palettes, four colors each.
+inline constexpr size_t kPaletteEntryCount = 64;
+inline constexpr size_t kDmgPaletteEntryCount = 12;
+
+// Maps palette entry indices to host pixels. Each entry's host pixel is
+// looked up once, when the palette register or palette RAM byte that defines
+// it is written, so converting a scanline is a single table lookup per pixel.
+class PaletteTable {
+ public:
+  PaletteTable(PixelFormat format, bool color_correction);
+
+  // Sets the four entries of DMG palette `palette` (0 for BGP, 1 for OBP0, 2
+  // for OBP1) from the register's value.
+  void SetDmgPalette(size_t palette, uint8_t value);
+
+  // Sets `entry` from a CGB palette RAM color, with red in the low 5 bits.
+  void SetColor(size_t entry, uint16_t rgb15);
+
+  // Converts `count` palette entry indices to host pixels in `out`, which
+  // must have room for `count` * BytesPerPixel() bytes.
+  void ConvertLine(const uint8_t* entries, size_t count, uint8_t* out) const;
+
+  PaletteTable(const PaletteTable&) = delete;
+  PaletteTable& operator=(const PaletteTable&) = delete;
+
+ private:
+  void SetPixel(size_t entry, uint32_t pixel);
+
+  const PixelFormat format_;
+  // Converts 15-bit colors to host pixels; shared by every table with the
+  // same format and color correction setting.
+  const std::array<uint32_t, 1 << 15>& color_table_;
+
+  // Host pixels by entry, zero-extended to 32 bits.
+  std::array<uint32_t, kPaletteEntryCount> pixels_;
+  // Byte i of each host pixel for the first 16 entries, which is all a DMG
+  // screen uses, laid out for byte shuffles.
+  std::array<std::array<uint8_t, 16>, 4> planes_;
+  // One more than the highest entry set since construction.
+  size_t used_entries_;
+};
+
+}  // namespace gamebun
+
+#endif  // PALETTE_H_
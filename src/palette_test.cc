@@ -0,0 +1,146 @@
+#include "palette.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace gamebun {
+namespace {
+
+// The four DMG shades as 15-bit colors, from lightest to darkest.
+constexpr std::array<uint16_t, 4> kDmgShades = {0x7FFF, 0x56B5, 0x294A,
+                                                0x0000};
+
+// The host pixel of `rgb15`, worked out one byte at a time.
+std::vector<uint8_t> ReferencePixel(PixelFormat format, bool color_correction,
+                                    uint16_t rgb15) {
+  uint32_t r = rgb15 & 0x1F;
+  uint32_t g = (rgb15 >> 5) & 0x1F;
+  uint32_t b = (rgb15 >> 10) & 0x1F;
+  if (color_correction) {
+    const uint32_t red = r * 26 + g * 4 + b * 2;
+    const uint32_t green = g * 24 + b * 8;
+    const uint32_t blue = r * 6 + g * 4 + b * 22;
+    r = std::min<uint32_t>(red, 960) / 4;
+    g = std::min<uint32_t>(green, 960) / 4;
+    b = std::min<uint32_t>(blue, 960) / 4;
+  } else {
+    r = r * 8 + r / 4;
+    g = g * 8 + g / 4;
+    b = b * 8 + b / 4;
+  }
+  switch (format) {
+    case PixelFormat::kRgba8888:
+      return {static_cast<uint8_t>(r), static_cast<uint8_t>(g),
+              static_cast<uint8_t>(b), 0xFF};
+    case PixelFormat::kRgb565: {
+      const uint32_t pixel = (r / 8) * 2048 + (g / 4) * 32 + b / 8;
+      return {static_cast<uint8_t>(pixel), static_cast<uint8_t>(pixel >> 8)};
+    }
+  }
+  return {};
+}
+
+// Converts `entries` with the 15-bit colors `colors` by entry, a pixel at a
+// time, and checks that `table` converts them the same.
+void CheckLine(const PaletteTable& table, PixelFormat format,
+               bool color_correction, const std::vector<uint16_t>& colors,
+               const std::vector<uint8_t>& entries) {
+  std::vector<uint8_t> expected;
+  for (const uint8_t entry : entries) {
+    const std::vector<uint8_t> pixel =
+        ReferencePixel(format, color_correction, colors[entry]);
+    expected.insert(expected.end(), pixel.begin(), pixel.end());
+  }
+  std::vector<uint8_t> actual(entries.size() * BytesPerPixel(format));
+  table.ConvertLine(entries.data(), entries.size(), actual.data());
+  INFO(entries.size() << " pixels");
+  CHECK(actual == expected);
+}
+
+std::vector<uint8_t> RandomEntries(size_t count, size_t entry_count,
+                                   std::mt19937* random) {
+  std::vector<uint8_t> entries(count);
+  for (uint8_t& entry : entries) {
+    entry = static_cast<uint8_t>((*random)() % entry_count);
+  }
+  return entries;
+}
+
+// Covers lines shorter than a vector, whole screen widths, and tails of
+// every length.
+constexpr std::array<size_t, 10> kLineLengths = {0,  1,  7,   8,   15,
+                                                 16, 17, 100, 160, 167};
+
+TEST_CASE("DMG palettes convert lines like a pixel at a time", "[palette]") {
+  const PixelFormat format =
+      GENERATE(PixelFormat::kRgba8888, PixelFormat::kRgb565);
+  PaletteTable table(format, /*color_correction=*/false);
+  std::mt19937 random(3);
+  std::vector<uint16_t> colors(kDmgPaletteEntryCount);
+  for (size_t round = 0; round < 20; round++) {
+    for (size_t palette = 0; palette < 3; palette++) {
+      const uint8_t value = static_cast<uint8_t>(random());
+      table.SetDmgPalette(palette, value);
+      for (size_t color = 0; color < 4; color++) {
+        colors[palette * 4 + color] = kDmgShades[(value >> (color * 2)) & 3];
+      }
+    }
+    for (const size_t length : kLineLengths) {
+      CheckLine(table, format, false, colors,
+                RandomEntries(length, kDmgPaletteEntryCount, &random));
+    }
+  }
+}
+
+TEST_CASE("Color palettes convert lines like a pixel at a time",
+          "[palette]") {
+  const PixelFormat format =
+      GENERATE(PixelFormat::kRgba8888, PixelFormat::kRgb565);
+  const bool color_correction = GENERATE(false, true);
+  // With no more than 16 entries in use, lines take a different path.
+  const size_t entry_count = GENERATE(size_t{16}, kPaletteEntryCount);
+  PaletteTable table(format, color_correction);
+  std::mt19937 random(5);
+  std::vector<uint16_t> colors(entry_count);
+  for (size_t round = 0; round < 20; round++) {
+    for (size_t entry = 0; entry < entry_count; entry++) {
+      // The unused top bit is ignored.
+      const uint16_t rgb15 = static_cast<uint16_t>(random());
+      table.SetColor(entry, rgb15);
+      colors[entry] = rgb15 & 0x7FFF;
+    }
+    for (const size_t length : kLineLengths) {
+      CheckLine(table, format, color_correction, colors,
+                RandomEntries(length, entry_count, &random));
+    }
+  }
+}
+
+TEST_CASE("Every 15-bit color converts like a pixel at a time",
+          "[palette]") {
+  const PixelFormat format =
+      GENERATE(PixelFormat::kRgba8888, PixelFormat::kRgb565);
+  const bool color_correction = GENERATE(false, true);
+  PaletteTable table(format, color_correction);
+  std::vector<uint16_t> colors(kPaletteEntryCount);
+  std::vector<uint8_t> entries(kPaletteEntryCount);
+  for (size_t entry = 0; entry < entries.size(); entry++) {
+    entries[entry] = static_cast<uint8_t>(entry);
+  }
+  for (uint32_t first = 0; first < 1 << 15; first += kPaletteEntryCount) {
+    for (size_t entry = 0; entry < kPaletteEntryCount; entry++) {
+      colors[entry] = static_cast<uint16_t>(first + entry);
+      table.SetColor(entry, colors[entry]);
+    }
+    CheckLine(table, format, color_correction, colors, entries);
+  }
+}
+
+}  // namespace
+}  // namespace gamebun
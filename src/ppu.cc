@@ -0,0 +1,447 @@
+#include "ppu.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "arena.h"
+#include "frame_buffers.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "renderer.h"
+#include "scanline_renderer.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr size_t kOamScanCycles = 80;
+constexpr size_t kPixelTransferCycles = 172;
+constexpr size_t kHBlankCycles = 204;
+constexpr size_t kScanlineCycles = 456;
+constexpr uint8_t kScanlineCount = 154;
+constexpr size_t kFrameCycles = kScanlineCycles * kScanlineCount;
+
+constexpr uint8_t kLcdcDisplayEnable = 0x80;
+
+constexpr uint8_t kStatCoincidence = 0x04;
+constexpr uint8_t kStatHBlankInterrupt = 0x08;
+constexpr uint8_t kStatVBlankInterrupt = 0x10;
+constexpr uint8_t kStatOamScanInterrupt = 0x20;
+constexpr uint8_t kStatCoincidenceInterrupt = 0x40;
+
+constexpr uint8_t kPaletteIndexAutoIncrement = 0x80;
+
+}  // namespace
+
+Ppu::Ppu(Interrupts* interrupts, FrameBuffers* frame_buffers,
+         RenderMode render_mode, const VideoOptions& options, Arena* arena)
+    : interrupts_(*interrupts),
+      color_(options.color),
+      video_ram_size_((color_ ? kVideoRamBankCount : 1) *
+                      kVideoRamSize.value()),
+      video_ram_(arena->Allocate<uint8_t>(video_ram_size_)),
+      oam_(arena->Allocate<uint8_t>(kOamSize.value())),
+      renderer_(Renderer::Create(render_mode, video_ram_, oam_, options,
+                                 frame_buffers, arena)),
+      mode_(Mode::kOamScan),
+      mode_cycles_(0),
+      stat_line_(false),
+      frame_count_(0),
+      frame_written_(false),
+      reuse_previous_frame_(false),
+      window_line_(0),
+      lcdc_(0x91),
+      stat_(0),
+      scy_(0),
+      scx_(0),
+      ly_(0),
+      lyc_(0),
+      bgp_(0xFC),
+      obp0_(0xFF),
+      obp1_(0xFF),
+      wy_(0),
+      wx_(0),
+      video_ram_bank_(0),
+      background_palette_index_(0),
+      object_palette_index_(0),
+      background_palette_ram_(),
+      object_palette_ram_() {
+  // Palette RAM starts out white, matching ScanlineRenderer.
+  if (color_) {
+    background_palette_ram_.fill(0xFF);
+    object_palette_ram_.fill(0xFF);
+  }
+}
+
+void Ppu::Tick(size_t cycles) {
+  mode_cycles_ += cycles;
+  if (!(lcdc_ & kLcdcDisplayEnable)) {
+    // Nothing is drawn while the LCD is off, but frames still end on
+    // schedule so that anything paced by them keeps running.
+    if (mode_cycles_ >= kFrameCycles) {
+      mode_cycles_ -= kFrameCycles;
+      EndFrame();
+    }
+    return;
+  }
+
+  while (true) {
+    switch (mode_) {
+      case Mode::kOamScan:
+        if (mode_cycles_ < kOamScanCycles) {
+          return;
+        }
+        mode_cycles_ -= kOamScanCycles;
+        SetMode(Mode::kPixelTransfer);
+        break;
+      case Mode::kPixelTransfer:
+        if (mode_cycles_ < kPixelTransferCycles) {
+          return;
+        }
+        mode_cycles_ -= kPixelTransferCycles;
+        if (reuse_previous_frame_) {
+          renderer_->SkipScanline(ly_);
+        } else {
+          renderer_->RenderScanline(ly_);
+        }
+        if (ScanlineRenderer::DrawsWindow(color_, lcdc_, wy_, wx_, ly_)) {
+          window_line_++;
+        }
+        SetMode(Mode::kHBlank);
+        break;
+      case Mode::kHBlank:
+        if (mode_cycles_ < kHBlankCycles) {
+          return;
+        }
+        mode_cycles_ -= kHBlankCycles;
+        SetLy(ly_ + 1);
+        if (ly_ == kScreenHeight) {
+          interrupts_.Request(Interrupt::kVBlank);
+          SetMode(Mode::kVBlank);
+        } else {
+          SetMode(Mode::kOamScan);
+        }
+        break;
+      case Mode::kVBlank:
+        if (mode_cycles_ < kScanlineCycles) {
+          return;
+        }
+        mode_cycles_ -= kScanlineCycles;
+        if (ly_ + 1 == kScanlineCount) {
+          EndFrame();
+          SetLy(0);
+          SetMode(Mode::kOamScan);
+        } else {
+          SetLy(ly_ + 1);
+        }
+        break;
+    }
+  }
+}
+
+uint8_t Ppu::Read(Address address) const {
+  if (0x8000 <= address.value() && address.value() < 0xA000) {
+    return video_ram_[video_ram_bank_ * kVideoRamSize.value() +
+                      address.value() - 0x8000];
+  } else if (0xFE00 <= address.value() && address.value() < 0xFEA0) {
+    return oam_[address.value() - 0xFE00];
+  }
+
+  switch (address.value()) {
+    case 0xFF40:
+      return lcdc_;
+    case 0xFF41:
+      return static_cast<uint8_t>(0x80 | stat_ |
+                                  static_cast<uint8_t>(mode_));
+    case 0xFF42:
+      return scy_;
+    case 0xFF43:
+      return scx_;
+    case 0xFF44:
+      return ly_;
+    case 0xFF45:
+      return lyc_;
+    case 0xFF47:
+      return bgp_;
+    case 0xFF48:
+      return obp0_;
+    case 0xFF49:
+      return obp1_;
+    case 0xFF4A:
+      return wy_;
+    case 0xFF4B:
+      return wx_;
+  }
+
+  if (!color_) {
+    switch (address.value()) {
+      case 0xFF4F:
+      case 0xFF68:
+      case 0xFF69:
+      case 0xFF6A:
+      case 0xFF6B:
+        return 0xFF;
+    }
+  }
+  switch (address.value()) {
+    case 0xFF4F:
+      return static_cast<uint8_t>(0xFE | video_ram_bank_);
+    case 0xFF68:
+      return static_cast<uint8_t>(0x40 | background_palette_index_);
+    case 0xFF69:
+      return background_palette_ram_[background_palette_index_ &
+                                      (kColorPaletteRamSize - 1)];
+    case 0xFF6A:
+      return static_cast<uint8_t>(0x40 | object_palette_index_);
+    case 0xFF6B:
+      return object_palette_ram_[object_palette_index_ &
+                                 (kColorPaletteRamSize - 1)];
+  }
+  FATAL("Unexpected PPU read address %x", address.value());
+}
+
+void Ppu::Write(Address address, uint8_t value) {
+  if (0x8000 <= address.value() && address.value() < 0xA000) {
+    WriteVisible(&video_ram_[video_ram_bank_ * kVideoRamSize.value() +
+                             address.value() - 0x8000],
+                 address, value);
+    return;
+  } else if (0xFE00 <= address.value() && address.value() < 0xFEA0) {
+    WriteVisible(&oam_[address.value() - 0xFE00], address, value);
+    return;
+  }
+
+  switch (address.value()) {
+    case 0xFF40: {
+      const bool was_enabled = lcdc_ & kLcdcDisplayEnable;
+      WriteVisible(&lcdc_, address, value);
+      if (was_enabled && !(lcdc_ & kLcdcDisplayEnable)) {
+        window_line_ = 0;
+        mode_cycles_ = 0;
+        ly_ = 0;
+        mode_ = Mode::kHBlank;
+        stat_line_ = false;
+      } else if (!was_enabled && (lcdc_ & kLcdcDisplayEnable)) {
+        mode_cycles_ = 0;
+        SetLy(0);
+        SetMode(Mode::kOamScan);
+      }
+      return;
+    }
+    case 0xFF41:
+      stat_ = static_cast<uint8_t>((stat_ & kStatCoincidence) | (value & 0x78));
+      UpdateStatLine();
+      return;
+    case 0xFF42:
+      WriteVisible(&scy_, address, value);
+      return;
+    case 0xFF43:
+      WriteVisible(&scx_, address, value);
+      return;
+    case 0xFF44:
+      // LY is read-only.
+      return;
+    case 0xFF45:
+      lyc_ = value;
+      SetLy(ly_);
+      return;
+    case 0xFF47:
+      WriteVisible(&bgp_, address, value);
+      return;
+    case 0xFF48:
+      WriteVisible(&obp0_, address, value);
+      return;
+    case 0xFF49:
+      WriteVisible(&obp1_, address, value);
+      return;
+    case 0xFF4A:
+      WriteVisible(&wy_, address, value);
+      return;
+    case 0xFF4B:
+      WriteVisible(&wx_, address, value);
+      return;
+  }
+
+  if (!color_) {
+    switch (address.value()) {
+      case 0xFF4F:
+      case 0xFF68:
+      case 0xFF69:
+      case 0xFF6A:
+      case 0xFF6B:
+        return;
+    }
+  }
+  // The bank and palette index registers change nothing on screen by
+  // themselves, but the renderer needs them to interpret later writes.
+  switch (address.value()) {
+    case 0xFF4F:
+      video_ram_bank_ = value & 0x1;
+      renderer_->Write(address, value);
+      return;
+    case 0xFF68:
+      background_palette_index_ = value & 0xBF;
+      renderer_->Write(address, background_palette_index_);
+      return;
+    case 0xFF69:
+      WritePaletteData(&background_palette_ram_, &background_palette_index_,
+                       Address(0xFF68), address, value);
+      return;
+    case 0xFF6A:
+      object_palette_index_ = value & 0xBF;
+      renderer_->Write(address, object_palette_index_);
+      return;
+    case 0xFF6B:
+      WritePaletteData(&object_palette_ram_, &object_palette_index_,
+                       Address(0xFF6A), address, value);
+      return;
+  }
+  FATAL("Unexpected PPU write address %x", address.value());
+}
+
+void Ppu::SaveState(StateWriter* writer) const {
+  writer->WriteBytes(video_ram_, video_ram_size_);
+  writer->WriteBytes(oam_, kOamSize.value());
+  writer->Write(mode_);
+  writer->Write(mode_cycles_);
+  writer->Write(stat_line_);
+  writer->Write(frame_count_);
+  writer->Write(window_line_);
+  writer->Write(lcdc_);
+  writer->Write(stat_);
+  writer->Write(scy_);
+  writer->Write(scx_);
+  writer->Write(ly_);
+  writer->Write(lyc_);
+  writer->Write(bgp_);
+  writer->Write(obp0_);
+  writer->Write(obp1_);
+  writer->Write(wy_);
+  writer->Write(wx_);
+  writer->Write(video_ram_bank_);
+  writer->Write(background_palette_index_);
+  writer->Write(object_palette_index_);
+  writer->Write(background_palette_ram_);
+  writer->Write(object_palette_ram_);
+}
+
+void Ppu::LoadState(StateReader* reader) {
+  reader->ReadBytes(video_ram_, video_ram_size_);
+  reader->ReadBytes(oam_, kOamSize.value());
+  reader->Read(&mode_);
+  reader->Read(&mode_cycles_);
+  reader->Read(&stat_line_);
+  reader->Read(&frame_count_);
+  reader->Read(&window_line_);
+  reader->Read(&lcdc_);
+  reader->Read(&stat_);
+  reader->Read(&scy_);
+  reader->Read(&scx_);
+  reader->Read(&ly_);
+  reader->Read(&lyc_);
+  reader->Read(&bgp_);
+  reader->Read(&obp0_);
+  reader->Read(&obp1_);
+  reader->Read(&wy_);
+  reader->Read(&wx_);
+  reader->Read(&video_ram_bank_);
+  reader->Read(&background_palette_index_);
+  reader->Read(&object_palette_index_);
+  reader->Read(&background_palette_ram_);
+  reader->Read(&object_palette_ram_);
+
+  renderer_->Reload(video_ram_, oam_, window_line_);
+  for (const auto& [address, value] :
+       {std::pair{0xFF40, lcdc_}, {0xFF42, scy_}, {0xFF43, scx_},
+        {0xFF47, bgp_}, {0xFF48, obp0_}, {0xFF49, obp1_}, {0xFF4A, wy_},
+        {0xFF4B, wx_}}) {
+    renderer_->Write(Address(address), value);
+  }
+  if (color_) {
+    renderer_->Write(Address(0xFF4F), video_ram_bank_);
+    // Without auto-increment, each palette RAM byte is written at the index
+    // just set.
+    for (uint8_t i = 0; i < kColorPaletteRamSize; i++) {
+      renderer_->Write(Address(0xFF68), i);
+      renderer_->Write(Address(0xFF69), background_palette_ram_[i]);
+      renderer_->Write(Address(0xFF6A), i);
+      renderer_->Write(Address(0xFF6B), object_palette_ram_[i]);
+    }
+    renderer_->Write(Address(0xFF68), background_palette_index_);
+    renderer_->Write(Address(0xFF6A), object_palette_index_);
+  }
+  // The frame buffers hold pictures from before the load.
+  frame_written_ = true;
+  reuse_previous_frame_ = false;
+}
+
+// A frame following one in which nothing visible changed is identical to it,
+// so it only needs rendering from the first visible change onwards.
+void Ppu::WriteVisible(uint8_t* dest, Address address, uint8_t value) {
+  if (*dest == value) {
+    return;
+  }
+  *dest = value;
+  renderer_->Write(address, value);
+  frame_written_ = true;
+  reuse_previous_frame_ = false;
+}
+
+void Ppu::WritePaletteData(std::array<uint8_t, kColorPaletteRamSize>* ram,
+                           uint8_t* index, Address index_address,
+                           Address data_address, uint8_t value) {
+  uint8_t* dest = &(*ram)[*index & (kColorPaletteRamSize - 1)];
+  const bool changed = *dest != value;
+  WriteVisible(dest, data_address, value);
+  if (*index & kPaletteIndexAutoIncrement) {
+    *index = static_cast<uint8_t>(kPaletteIndexAutoIncrement |
+                                  ((*index + 1) & (kColorPaletteRamSize - 1)));
+    // The renderer advances its own index when it sees a data write, so it
+    // only needs telling when the write was dropped as unchanged.
+    if (!changed) {
+      renderer_->Write(index_address, *index);
+    }
+  }
+}
+
+void Ppu::EndFrame() {
+  renderer_->EndFrame();
+  window_line_ = 0;
+  frame_count_++;
+  reuse_previous_frame_ = !frame_written_;
+  frame_written_ = false;
+}
+
+void Ppu::SetMode(Mode mode) {
+  mode_ = mode;
+  UpdateStatLine();
+}
+
+void Ppu::SetLy(uint8_t ly) {
+  ly_ = ly;
+  if (ly_ == lyc_) {
+    stat_ |= kStatCoincidence;
+  } else {
+    stat_ &= static_cast<uint8_t>(~kStatCoincidence);
+  }
+  UpdateStatLine();
+}
+
+// The STAT interrupt fires on the rising edge of the OR of all enabled
+// conditions, so back-to-back conditions only raise a single interrupt.
+void Ppu::UpdateStatLine() {
+  const bool stat_line =
+      ((stat_ & kStatCoincidenceInterrupt) && (stat_ & kStatCoincidence)) ||
+      ((stat_ & kStatHBlankInterrupt) && mode_ == Mode::kHBlank) ||
+      ((stat_ & kStatVBlankInterrupt) && mode_ == Mode::kVBlank) ||
+      ((stat_ & kStatOamScanInterrupt) && mode_ == Mode::kOamScan);
+  if (stat_line && !stat_line_ && (lcdc_ & kLcdcDisplayEnable)) {
+    interrupts_.Request(Interrupt::kLcdStat);
+  }
+  stat_line_ = stat_line;
+}
+
+}  // namespace gamebun
@@ -0,0 +1,116 @@
+#ifndef PPU_H_
+#define PPU_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.h"
+#include "frame_buffers.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "renderer.h"
+#include "scanline_renderer.h"
+#include "state.h"
+
+namespace gamebun {
+
+class Ppu {
+ public:
+  // Video RAM, OAM and the renderer are placed in `arena`.
+  Ppu(Interrupts* interrupts, FrameBuffers* frame_buffers,
+      RenderMode render_mode, const VideoOptions& options, Arena* arena);
+
+  // Advances the PPU by `cycles` clock cycles, rendering each visible scanline
+  // as its pixel transfer completes.
+  void Tick(size_t cycles);
+
+  // Accesses video RAM, sprite attribute memory and the LCD registers at
+  // 0xFF40-0xFF4B, excluding the DMA register, as well as VBK (0xFF4F) and
+  // the CGB palette registers at 0xFF68-0xFF6B.
+  uint8_t Read(Address address) const;
+  void Write(Address address, uint8_t value);
+
+  // Number of frames completed so far. Frames keep their usual length while
+  // the LCD is off.
+  uint64_t FrameCount() const { return frame_count_; }
+
+  // Waits until every completed frame has been published to the frame
+  // buffers.
+  void FlushFrames() { renderer_->Flush(); }
+
+  // The frame in progress when a state is loaded keeps whatever lines were
+  // already rendered into it, and is rendered in full from there on, as is
+  // the frame after it.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  Ppu(const Ppu&) = delete;
+  Ppu& operator=(const Ppu&) = delete;
+
+ private:
+  enum class Mode : uint8_t {
+    kHBlank = 0,
+    kVBlank = 1,
+    kOamScan = 2,
+    kPixelTransfer = 3,
+  };
+
+  // Stores `value` in `dest` and forwards it to the renderer, unless it would
+  // not change anything.
+  void WriteVisible(uint8_t* dest, Address address, uint8_t value);
+  // Writes the palette RAM byte selected by `*index` through the data
+  // register at `data_address`, keeping the renderer's copy of the index
+  // register at `index_address` in step.
+  void WritePaletteData(std::array<uint8_t, kColorPaletteRamSize>* ram,
+                        uint8_t* index, Address index_address,
+                        Address data_address, uint8_t value);
+  void EndFrame();
+
+  void SetMode(Mode mode);
+  void SetLy(uint8_t ly);
+  void UpdateStatLine();
+
+  Interrupts& interrupts_;
+  const bool color_;
+
+  // Video RAM, with kVideoRamBankCount banks in color mode and one
+  // otherwise, and OAM.
+  const size_t video_ram_size_;
+  uint8_t* const video_ram_;
+  uint8_t* const oam_;
+  ArenaPtr<Renderer> renderer_;
+
+  Mode mode_;
+  size_t mode_cycles_;
+  bool stat_line_;
+
+  uint64_t frame_count_;
+  bool frame_written_;
+  bool reuse_previous_frame_;
+  // The line of the window the renderer draws next, tracked here too so
+  // that a saved state captures it.
+  uint8_t window_line_;
+
+  uint8_t lcdc_;
+  uint8_t stat_;
+  uint8_t scy_;
+  uint8_t scx_;
+  uint8_t ly_;
+  uint8_t lyc_;
+  uint8_t bgp_;
+  uint8_t obp0_;
+  uint8_t obp1_;
+  uint8_t wy_;
+  uint8_t wx_;
+
+  uint8_t video_ram_bank_;
+  uint8_t background_palette_index_;
+  uint8_t object_palette_index_;
+  std::array<uint8_t, kColorPaletteRamSize> background_palette_ram_;
+  std::array<uint8_t, kColorPaletteRamSize> object_palette_ram_;
+};
+
+}  // namespace gamebun
+
+#endif  // PPU_H_
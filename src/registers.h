@@ -3,6 +3,8 @@
 
 #include <cstdint>
 
+#include "state.h"
+
 namespace gamebun {
 
 struct __attribute__((packed)) Flags {
@@ -49,6 +51,23 @@ class Registers {
   uint16_t PC() const { return pc_; }
   uint16_t& PC() { return pc_; }
 
+  void SaveState(StateWriter* writer) const {
+    writer->Write(af_.full);
+    writer->Write(bc_.full);
+    writer->Write(de_.full);
+    writer->Write(hl_.full);
+    writer->Write(sp_);
+    writer->Write(pc_);
+  }
+  void LoadState(StateReader* reader) {
+    reader->Read(&af_.full);
+    reader->Read(&bc_.full);
+    reader->Read(&de_.full);
+    reader->Read(&hl_.full);
+    reader->Read(&sp_);
+    reader->Read(&pc_);
+  }
+
   Registers(const Registers&) = delete;
   Registers& operator=(const Registers&) = delete;
 
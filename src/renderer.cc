@@ -0,0 +1,222 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "arena.h"
+#include "frame_buffers.h"
+#include "memory.h"
+#include "scanline_renderer.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+ArenaPtr<Renderer> Renderer::Create(RenderMode mode, const uint8_t* video_ram,
+                                    const uint8_t* oam,
+                                    const VideoOptions& options,
+                                    FrameBuffers* frame_buffers, Arena* arena) {
+  switch (mode) {
+    case RenderMode::kInline:
+      return arena->New<InlineRenderer>(video_ram, oam, options, frame_buffers,
+                                        arena);
+    case RenderMode::kDeferred:
+      return arena->New<DeferredRenderer>(options, frame_buffers, arena);
+    default:
+      FATAL("Unknown render mode");
+  }
+}
+
+InlineRenderer::InlineRenderer(const uint8_t* video_ram, const uint8_t* oam,
+                               const VideoOptions& options,
+                               FrameBuffers* frame_buffers, Arena* arena)
+    : scanline_renderer_(video_ram, oam, options, arena),
+      frame_buffers_(*frame_buffers) {}
+
+void InlineRenderer::Write(Address address, uint8_t value) {
+  scanline_renderer_.Write(address, value);
+}
+
+void InlineRenderer::RenderScanline(uint8_t ly) {
+  scanline_renderer_.RenderScanline(ly, frame_buffers_.Line(ly));
+}
+
+void InlineRenderer::SkipScanline(uint8_t ly) {
+  scanline_renderer_.SkipScanline(ly);
+}
+
+void InlineRenderer::EndFrame() {
+  // Waiting here could wait on a frame held by the thread running the
+  // emulator, which is this one.
+  frame_buffers_.EndFrame(/*wait=*/false);
+  scanline_renderer_.StartFrame();
+}
+
+// The PPU's arrays are the ones being rendered from, so they are already up
+// to date.
+void InlineRenderer::Reload(const uint8_t* video_ram __attribute__((unused)),
+                            const uint8_t* oam __attribute__((unused)),
+                            uint8_t window_line) {
+  scanline_renderer_.Reload(window_line);
+}
+
+DeferredRenderer::DeferredRenderer(const VideoOptions& options,
+                                   FrameBuffers* frame_buffers, Arena* arena)
+    : color_(options.color),
+      video_ram_(),
+      oam_(),
+      video_ram_bank_(0),
+      scanline_renderer_(video_ram_.data(), oam_.data(), options, arena),
+      frame_buffers_(*frame_buffers),
+      batches_(),
+      filling_(0),
+      pending_(false),
+      stopping_(false) {
+  for (Batch& batch : batches_) {
+    batch.writes.reserve(kMaxBatchWrites);
+    batch.line_count = 0;
+    batch.end_frame = false;
+  }
+  worker_ = std::thread(&DeferredRenderer::RunWorker, this);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  worker_.join();
+}
+
+void DeferredRenderer::Write(Address address, uint8_t value) {
+  if (batches_[filling_].writes.size() == kMaxBatchWrites) {
+    Submit();
+  }
+  Batch& batch = batches_[filling_];
+  batch.writes.push_back(
+      {address.value(), value, static_cast<uint8_t>(batch.line_count)});
+}
+
+void DeferredRenderer::RenderScanline(uint8_t ly) {
+  AddLine(ly, /*skip=*/false);
+}
+
+void DeferredRenderer::SkipScanline(uint8_t ly) {
+  AddLine(ly, /*skip=*/true);
+}
+
+void DeferredRenderer::EndFrame() {
+  batches_[filling_].end_frame = true;
+  Submit();
+}
+
+void DeferredRenderer::Flush() { WaitForWorker(); }
+
+void DeferredRenderer::Reload(const uint8_t* video_ram, const uint8_t* oam,
+                              uint8_t window_line) {
+  WaitForWorker();
+  Batch& batch = batches_[filling_];
+  batch.writes.clear();
+  batch.line_count = 0;
+  batch.end_frame = false;
+
+  // The worker is idle, so its replica can be written from here.
+  const size_t video_ram_size =
+      color_ ? video_ram_.size() : kVideoRamSize.value();
+  std::copy(video_ram, video_ram + video_ram_size, video_ram_.begin());
+  std::copy(oam, oam + oam_.size(), oam_.begin());
+  scanline_renderer_.Reload(window_line);
+}
+
+void DeferredRenderer::Submit() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return !pending_; });
+    pending_ = true;
+    filling_ ^= 1;
+  }
+  condition_.notify_all();
+
+  Batch& batch = batches_[filling_];
+  batch.writes.clear();
+  batch.line_count = 0;
+  batch.end_frame = false;
+}
+
+void DeferredRenderer::AddLine(uint8_t ly, bool skip) {
+  // Switching the LCD off and on again mid-frame can render more lines than
+  // a frame holds before the next EndFrame().
+  if (batches_[filling_].line_count == kScreenHeight) {
+    Submit();
+  }
+  Batch& batch = batches_[filling_];
+  batch.lines[batch.line_count++] = {ly, skip};
+}
+
+void DeferredRenderer::WaitForWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this] { return !pending_; });
+}
+
+void DeferredRenderer::RunWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] { return pending_ || stopping_; });
+    if (!pending_) {
+      return;
+    }
+
+    const Batch& batch = batches_[filling_ ^ 1];
+    lock.unlock();
+    Replay(batch);
+    lock.lock();
+
+    pending_ = false;
+    condition_.notify_all();
+  }
+}
+
+// Each write is applied right before the first line rendered after it, which
+// reproduces exactly the state InlineRenderer sees when rendering that line.
+void DeferredRenderer::Replay(const Batch& batch) {
+  size_t next_write = 0;
+  const auto apply_writes_before = [&](size_t line) {
+    for (; next_write < batch.writes.size() &&
+           batch.writes[next_write].line <= line;
+         next_write++) {
+      const LoggedWrite& write = batch.writes[next_write];
+      if (0x8000 <= write.address && write.address < 0xA000) {
+        video_ram_[video_ram_bank_ * kVideoRamSize.value() + write.address -
+                   0x8000] = write.value;
+      } else if (0xFE00 <= write.address && write.address < 0xFEA0) {
+        oam_[write.address - 0xFE00] = write.value;
+      } else if (write.address == 0xFF4F && color_) {
+        video_ram_bank_ = write.value & 0x1;
+      }
+      scanline_renderer_.Write(Address(write.address), write.value);
+    }
+  };
+
+  for (size_t i = 0; i < batch.line_count; i++) {
+    apply_writes_before(i);
+    const LoggedLine& line = batch.lines[i];
+    if (line.skip) {
+      scanline_renderer_.SkipScanline(line.ly);
+    } else {
+      scanline_renderer_.RenderScanline(line.ly,
+                                        frame_buffers_.Line(line.ly));
+    }
+  }
+  apply_writes_before(batch.line_count);
+
+  if (batch.end_frame) {
+    frame_buffers_.EndFrame(/*wait=*/true);
+    scanline_renderer_.StartFrame();
+  }
+}
+
+}  // namespace gamebun
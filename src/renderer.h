@@ -0,0 +1,155 @@
+#ifndef RENDERER_H_
+#define RENDERER_H_
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "frame_buffers.h"
+#include "memory.h"
+#include "scanline_renderer.h"
+
+namespace gamebun {
+
+enum class RenderMode {
+  // Scanlines are rendered on the emulation thread as the PPU reaches them.
+  kInline,
+  // The emulation thread only logs writes; frames are rendered on a worker
+  // thread while the next frame is emulated.
+  kDeferred,
+};
+
+// Turns the PPU's stream of picture-affecting writes and timing events into
+// frames. Both implementations produce bit-identical output.
+class Renderer {
+ public:
+  // `video_ram` and `oam` are the PPU's arrays, which already hold each write
+  // by the time it is passed to Write(). Completed frames are published to
+  // `frame_buffers`. The renderer and its buffers are placed in `arena`.
+  static ArenaPtr<Renderer> Create(RenderMode mode, const uint8_t* video_ram,
+                                   const uint8_t* oam,
+                                   const VideoOptions& options,
+                                   FrameBuffers* frame_buffers, Arena* arena);
+
+  virtual ~Renderer() {}
+
+  // Called after every write to video RAM, sprite attribute memory or one of
+  // the LCD registers ScanlineRenderer reads, in program order. Video RAM
+  // writes go to the bank selected by the last VBK write.
+  virtual void Write(Address address, uint8_t value) = 0;
+
+  // Called when pixel transfer for line `ly` completes.
+  virtual void RenderScanline(uint8_t ly) = 0;
+
+  // Called instead of RenderScanline() when line `ly` is known to be
+  // identical to the same line of the previous frame.
+  virtual void SkipScanline(uint8_t ly) = 0;
+
+  // Called when the PPU wraps from the last VBlank line back to line 0.
+  virtual void EndFrame() = 0;
+
+  // Waits until every frame ended so far has been published.
+  virtual void Flush() = 0;
+
+  // Called when the PPU's state is replaced wholesale, such as when a saved
+  // state is loaded, with the PPU's new video RAM and OAM and the window
+  // line its frame had reached. Anything not yet rendered is dropped. The
+  // PPU then writes all the registers again.
+  virtual void Reload(const uint8_t* video_ram, const uint8_t* oam,
+                      uint8_t window_line) = 0;
+};
+
+class InlineRenderer final : public Renderer {
+ public:
+  InlineRenderer(const uint8_t* video_ram, const uint8_t* oam,
+                 const VideoOptions& options, FrameBuffers* frame_buffers,
+                 Arena* arena);
+
+  void Write(Address address, uint8_t value) override;
+  void RenderScanline(uint8_t ly) override;
+  void SkipScanline(uint8_t ly) override;
+  void EndFrame() override;
+  void Flush() override {}
+  void Reload(const uint8_t* video_ram, const uint8_t* oam,
+              uint8_t window_line) override;
+
+ private:
+  ScanlineRenderer scanline_renderer_;
+  FrameBuffers& frame_buffers_;
+};
+
+// Logs writes tagged with the number of lines already rendered in the
+// current batch, and hands each frame's log to a worker thread. The worker
+// keeps its own replica of video RAM and OAM, brought up to date by replaying
+// the log, so no memory is copied between the threads.
+class DeferredRenderer final : public Renderer {
+ public:
+  DeferredRenderer(const VideoOptions& options, FrameBuffers* frame_buffers,
+                   Arena* arena);
+  ~DeferredRenderer() override;
+
+  void Write(Address address, uint8_t value) override;
+  void RenderScanline(uint8_t ly) override;
+  void SkipScanline(uint8_t ly) override;
+  void EndFrame() override;
+  void Flush() override;
+  void Reload(const uint8_t* video_ram, const uint8_t* oam,
+              uint8_t window_line) override;
+
+ private:
+  static constexpr size_t kMaxBatchWrites = 16384;
+
+  struct LoggedWrite {
+    uint16_t address;
+    uint8_t value;
+    // Number of lines of the batch rendered before this write.
+    uint8_t line;
+  };
+
+  struct LoggedLine {
+    uint8_t ly;
+    bool skip;
+  };
+
+  struct Batch {
+    std::vector<LoggedWrite> writes;
+    std::array<LoggedLine, kScreenHeight> lines;
+    size_t line_count;
+    bool end_frame;
+  };
+
+  // Hands the batch being filled to the worker, waiting for the worker to
+  // finish the previous one first.
+  void Submit();
+  void AddLine(uint8_t ly, bool skip);
+  void WaitForWorker();
+  void RunWorker();
+  void Replay(const Batch& batch);
+
+  // Only touched by the worker thread, or while it is idle.
+  const bool color_;
+  std::array<uint8_t, kVideoRamBankCount * kVideoRamSize.value()> video_ram_;
+  std::array<uint8_t, kOamSize.value()> oam_;
+  size_t video_ram_bank_;
+  ScanlineRenderer scanline_renderer_;
+  FrameBuffers& frame_buffers_;
+
+  std::array<Batch, 2> batches_;
+  size_t filling_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool pending_;
+  bool stopping_;
+  std::thread worker_;
+};
+
+}  // namespace gamebun
+
+#endif  // RENDERER_H_
@@ -0,0 +1,184 @@
+#include "renderer.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "apu.h"
+#include "cartridge.h"
+#include "emulator.h"
+#include "joypad.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Keeps filling the tile data and the first tile map with a value that goes
+// up by one on each write, and scrolls the background by it as it goes, so
+// that both the picture and the registers change in the middle of lines.
+const std::vector<uint8_t> kScrollProgram = {
+    0xAF,              // 0x100: XOR A
+    0x21, 0x00, 0x80,  // 0x101: LD HL, 0x8000
+    0x3C,              // 0x104: INC A
+    0x22,              // 0x105: LD (HL+), A
+    0xE0, 0x43,        // 0x106: LDH (0x43), A
+    0x47,              // 0x108: LD B, A
+    0x7C,              // 0x109: LD A, H
+    0xFE, 0x9C,        // 0x10A: CP 0x9C
+    0x78,              // 0x10C: LD A, B
+    0x20, 0xF6,        // 0x10D: JR NZ, 0x105
+    0x18, 0xF0,        // 0x10F: JR 0x101
+};
+
+// Fills tile 0, which covers the background, with four dark pixels and then
+// four light ones on every row, then keeps scrolling the background by the
+// value of P1 with every button selected. Until a button is pressed, every
+// write stores the value already there.
+const std::vector<uint8_t> kInputScrollProgram = {
+    0x21, 0x00, 0x80,  // 0x100: LD HL, 0x8000
+    0x3E, 0xF0,        // 0x103: LD A, 0xF0
+    0x22,              // 0x105: LD (HL+), A
+    0xCB, 0x65,        // 0x106: BIT 4, L
+    0x28, 0xFB,        // 0x108: JR Z, 0x105
+    0xAF,              // 0x10A: XOR A
+    0xE0, 0x00,        // 0x10B: LDH (0x00), A
+    0xF0, 0x00,        // 0x10D: LDH A, (0x00)
+    0xE0, 0x43,        // 0x10F: LDH (0x43), A
+    0x18, 0xF7,        // 0x111: JR 0x10A
+};
+
+EmulatorOptions Options(RenderMode mode) {
+  EmulatorOptions options;
+  options.render_mode = mode;
+  options.audio.mode = AudioMode::kRegistersOnly;
+  // So that the deferred renderer never waits on a held frame.
+  options.frame_buffers.count = 3;
+  return options;
+}
+
+// Checks that the latest frames of `inline_emulator` and
+// `deferred_emulator` are the same frame with the same pixels.
+void CheckSameFrame(Emulator* inline_emulator, Emulator* deferred_emulator) {
+  const Frame expected = inline_emulator->AcquireFrame();
+  const Frame actual = deferred_emulator->AcquireFrame();
+  CHECK(actual.sequence == expected.sequence);
+  CHECK(actual.repeated == expected.repeated);
+  CHECK(actual.hash == expected.hash);
+  for (size_t ly = 0; ly < kScreenHeight; ly++) {
+    INFO("line " << ly);
+    CHECK(std::memcmp(actual.pixels + ly * actual.pitch,
+                      expected.pixels + ly * expected.pitch,
+                      kScreenWidth * 4) == 0);
+  }
+  inline_emulator->ReleaseFrame(expected);
+  deferred_emulator->ReleaseFrame(actual);
+}
+
+TEST_CASE("Deferred rendering draws the same frames as inline rendering",
+          "[renderer]") {
+  const Cartridge cart = MakeTestCartridge(kScrollProgram);
+  Emulator inline_emulator(cart, Options(RenderMode::kInline));
+  Emulator deferred_emulator(cart, Options(RenderMode::kDeferred));
+
+  uint64_t last_hash = 0;
+  size_t changed = 0;
+  for (size_t frame = 1; frame <= 20; frame++) {
+    INFO("frame " << frame);
+    inline_emulator.RunFrame();
+    deferred_emulator.RunFrame();
+    CheckSameFrame(&inline_emulator, &deferred_emulator);
+
+    const Frame latest = inline_emulator.AcquireFrame();
+    changed += latest.hash != last_hash;
+    last_hash = latest.hash;
+    inline_emulator.ReleaseFrame(latest);
+  }
+  // Otherwise there would be little to compare.
+  CHECK(changed >= 5);
+
+  SECTION("after loading a state saved in the middle of a frame") {
+    inline_emulator.RunCycles(30000);
+    std::vector<uint8_t> state(inline_emulator.MaxSaveStateSize());
+    state.resize(inline_emulator.SaveState(state.data(), state.size()));
+    REQUIRE(!state.empty());
+    deferred_emulator.RunCycles(50000);
+    REQUIRE(deferred_emulator.LoadState(state.data(), state.size()));
+    REQUIRE(inline_emulator.LoadState(state.data(), state.size()));
+    for (size_t frame = 1; frame <= 5; frame++) {
+      INFO("frame " << frame << " after loading");
+      inline_emulator.RunFrame();
+      deferred_emulator.RunFrame();
+      CheckSameFrame(&inline_emulator, &deferred_emulator);
+    }
+  }
+}
+
+uint32_t Pixel(const Frame& frame, size_t ly, size_t x) {
+  uint32_t pixel;
+  std::memcpy(&pixel, frame.pixels + ly * frame.pitch + x * 4,
+              sizeof(pixel));
+  return pixel;
+}
+
+TEST_CASE("Frames after one with no visible change are repeated",
+          "[renderer]") {
+  const Cartridge cart = MakeTestCartridge(kInputScrollProgram);
+  const RenderMode mode =
+      GENERATE(RenderMode::kInline, RenderMode::kDeferred);
+  Emulator emulator(cart, Options(mode));
+
+  // Frame 1 draws the tile and frame 2 scrolls to 0xCF; from then on,
+  // nothing changes.
+  Frame previous = {};
+  for (size_t frame = 1; frame <= 6; frame++) {
+    INFO("frame " << frame);
+    emulator.RunFrame();
+    const Frame latest = emulator.AcquireFrame();
+    CHECK(latest.sequence == frame);
+    CHECK(latest.repeated == (frame >= 3));
+    if (frame >= 3) {
+      CHECK(latest.buffer == previous.buffer);
+      CHECK(latest.hash == previous.hash);
+    }
+    previous = latest;
+    emulator.ReleaseFrame(latest);
+  }
+
+  // Pressing A halfway through a frame scrolls the background by one pixel
+  // less from there on, while the lines above carry over.
+  emulator.RunCycles(35000);
+  REQUIRE(emulator.QueueInput(
+      {0, JoypadEvent::TimeUnit::kCycles, Button::kA, /*pressed=*/true}));
+  emulator.RunFrame();
+  Frame latest = emulator.AcquireFrame();
+  CHECK_FALSE(latest.repeated);
+  CHECK(latest.hash != previous.hash);
+  const uint32_t dark = Pixel(latest, 0, 1);
+  const uint32_t light = Pixel(latest, 0, 5);
+  CHECK(dark != light);
+  CHECK(Pixel(latest, kScreenHeight - 1, 1) == light);
+  CHECK(Pixel(latest, kScreenHeight - 1, 5) == dark);
+  previous = latest;
+  emulator.ReleaseFrame(latest);
+
+  // The next frame draws every line with the new scroll, and the one after
+  // repeats it.
+  emulator.RunFrame();
+  latest = emulator.AcquireFrame();
+  CHECK_FALSE(latest.repeated);
+  CHECK(Pixel(latest, 0, 1) == light);
+  CHECK(Pixel(latest, 0, 5) == dark);
+  previous = latest;
+  emulator.ReleaseFrame(latest);
+  emulator.RunFrame();
+  latest = emulator.AcquireFrame();
+  CHECK(latest.repeated);
+  CHECK(latest.hash == previous.hash);
+  emulator.ReleaseFrame(latest);
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -0,0 +1,193 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "util/logging.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace gamebun {
+
+namespace {
+
+// Each output sample is filtered from kTaps input samples, which delays the
+// output by about kTaps / 2 input samples.
+constexpr size_t kTaps = 32;
+constexpr int kPhaseBits = 7;
+constexpr size_t kPhases = size_t{1} << kPhaseBits;
+// Fraction of the lower of the two Nyquist frequencies kept.
+constexpr double kPassband = 0.9;
+
+constexpr double kFixedOne = 4294967296.0;
+
+std::vector<float> BuildCoefficients(double cutoff) {
+  constexpr double kPi = 3.14159265358979323846;
+  std::vector<float> coefficients((kPhases + 1) * kTaps);
+  for (size_t phase = 0; phase <= kPhases; phase++) {
+    double taps[kTaps];
+    double sum = 0;
+    for (size_t tap = 0; tap < kTaps; tap++) {
+      // Distance from the tap to the output sample, which lies `phase /
+      // kPhases` of a sample past the center of the taps.
+      const double x = static_cast<double>(tap) - (kTaps / 2 - 1) -
+                       static_cast<double>(phase) / kPhases;
+      const double sinc = std::fabs(x) < 1e-9 ? 1
+                                              : std::sin(kPi * cutoff * x) /
+                                                    (kPi * cutoff * x);
+      // Blackman window over the span of the taps.
+      const double window_position = (x + kTaps / 2.0) / (kTaps + 1);
+      const double window = 0.42 - 0.5 * std::cos(2 * kPi * window_position) +
+                            0.08 * std::cos(4 * kPi * window_position);
+      taps[tap] = sinc * window;
+      sum += taps[tap];
+    }
+    for (size_t tap = 0; tap < kTaps; tap++) {
+      coefficients[phase * kTaps + tap] = static_cast<float>(taps[tap] / sum);
+    }
+  }
+  return coefficients;
+}
+
+int16_t ToSample(float value) {
+  return static_cast<int16_t>(
+      std::clamp(std::lround(value), long{INT16_MIN}, long{INT16_MAX}));
+}
+
+}  // namespace
+
+Resampler::Resampler(uint32_t input_rate, uint32_t output_rate)
+    : coefficients_(BuildCoefficients(
+          kPassband * std::min(1.0, static_cast<double>(output_rate) /
+                                        static_cast<double>(input_rate)))),
+      base_step_(static_cast<double>(input_rate) /
+                 static_cast<double>(output_rate)),
+      step_(0),
+      position_(0),
+      left_(kTaps),
+      right_(kTaps),
+      queued_(kTaps) {
+  if (input_rate == 0 || output_rate == 0) {
+    FATAL("Unsupported resampling from %u Hz to %u Hz", input_rate,
+          output_rate);
+  }
+  SetRateAdjustment(1.0);
+}
+
+void Resampler::SetRateAdjustment(double adjustment) {
+  step_ = static_cast<uint64_t>(base_step_ / adjustment * kFixedOne);
+}
+
+void Resampler::Write(const int16_t* samples, size_t count) {
+  if (queued_ + count > left_.size()) {
+    left_.resize(queued_ + count);
+    right_.resize(queued_ + count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    left_[queued_ + i] = samples[2 * i];
+    right_[queued_ + i] = samples[2 * i + 1];
+  }
+  queued_ += count;
+}
+
+size_t Resampler::Read(int16_t* out, size_t count) {
+  size_t produced = 0;
+  for (; produced < count; produced++) {
+    const size_t index = position_ >> 32;
+    if (index + kTaps > queued_) {
+      break;
+    }
+    const uint32_t fraction = position_ & 0xFFFFFFFF;
+    const size_t phase = fraction >> (32 - kPhaseBits);
+    // Position between this phase and the next, in [0, 1).
+    const float blend =
+        static_cast<float>(fraction & ((1u << (32 - kPhaseBits)) - 1)) /
+        static_cast<float>(1u << (32 - kPhaseBits));
+    const float* taps = &coefficients_[phase * kTaps];
+    const float* next_taps = &taps[kTaps];
+    const float* left = &left_[index];
+    const float* right = &right_[index];
+
+    float left_sum = 0;
+    float right_sum = 0;
+    size_t tap = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    {
+      const __m256 blend_ymm = _mm256_set1_ps(blend);
+      __m256 left_acc = _mm256_setzero_ps();
+      __m256 right_acc = _mm256_setzero_ps();
+      for (; tap < kTaps; tap += 8) {
+        const __m256 current = _mm256_loadu_ps(&taps[tap]);
+        const __m256 next = _mm256_loadu_ps(&next_taps[tap]);
+        const __m256 coefficient = _mm256_fmadd_ps(
+            blend_ymm, _mm256_sub_ps(next, current), current);
+        left_acc =
+            _mm256_fmadd_ps(coefficient, _mm256_loadu_ps(&left[tap]), left_acc);
+        right_acc = _mm256_fmadd_ps(coefficient, _mm256_loadu_ps(&right[tap]),
+                                    right_acc);
+      }
+      // Sums the lanes of both accumulators at once, leaving the left total
+      // in element 0 and the right total in element 1.
+      const __m256 pairs = _mm256_hadd_ps(left_acc, right_acc);
+      const __m256 quads = _mm256_hadd_ps(pairs, pairs);
+      const __m128 sums = _mm_add_ps(_mm256_castps256_ps128(quads),
+                                     _mm256_extractf128_ps(quads, 1));
+      left_sum = _mm_cvtss_f32(sums);
+      right_sum = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, 0x55));
+    }
+#elif defined(__SSE2__)
+    {
+      const __m128 blend_xmm = _mm_set1_ps(blend);
+      __m128 left_acc = _mm_setzero_ps();
+      __m128 right_acc = _mm_setzero_ps();
+      for (; tap < kTaps; tap += 4) {
+        const __m128 current = _mm_loadu_ps(&taps[tap]);
+        const __m128 next = _mm_loadu_ps(&next_taps[tap]);
+        const __m128 coefficient = _mm_add_ps(
+            current, _mm_mul_ps(blend_xmm, _mm_sub_ps(next, current)));
+        left_acc = _mm_add_ps(
+            left_acc, _mm_mul_ps(coefficient, _mm_loadu_ps(&left[tap])));
+        right_acc = _mm_add_ps(
+            right_acc, _mm_mul_ps(coefficient, _mm_loadu_ps(&right[tap])));
+      }
+      float left_lanes[4];
+      float right_lanes[4];
+      _mm_storeu_ps(left_lanes, left_acc);
+      _mm_storeu_ps(right_lanes, right_acc);
+      left_sum =
+          (left_lanes[0] + left_lanes[1]) + (left_lanes[2] + left_lanes[3]);
+      right_sum =
+          (right_lanes[0] + right_lanes[1]) + (right_lanes[2] + right_lanes[3]);
+    }
+#endif
+    for (; tap < kTaps; tap++) {
+      const float coefficient =
+          taps[tap] + blend * (next_taps[tap] - taps[tap]);
+      left_sum += coefficient * left[tap];
+      right_sum += coefficient * right[tap];
+    }
+
+    out[2 * produced] = ToSample(left_sum);
+    out[2 * produced + 1] = ToSample(right_sum);
+    position_ += step_;
+  }
+
+  // Drops the input that no later output sample reaches.
+  const size_t consumed = std::min<size_t>(position_ >> 32, queued_);
+  std::memmove(left_.data(), &left_[consumed],
+               (queued_ - consumed) * sizeof(float));
+  std::memmove(right_.data(), &right_[consumed],
+               (queued_ - consumed) * sizeof(float));
+  queued_ -= consumed;
+  position_ -= static_cast<uint64_t>(consumed) << 32;
+  return produced;
+}
+
+}  // namespace gamebun
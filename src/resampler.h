@@ -0,0 +1,49 @@
+#ifndef RESAMPLER_H_
+#define RESAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gamebun {
+
+// Converts stereo samples between two arbitrary rates with a polyphase
+// windowed-sinc filter, interpolating between neighboring phases so that
+// any ratio is exact. The ratio can be nudged while running, which lets a
+// stream follow a consumer whose clock drifts from the producer's.
+class Resampler {
+ public:
+  Resampler(uint32_t input_rate, uint32_t output_rate);
+
+  // Multiplies the output rate by `adjustment`, which should stay close to 1.
+  void SetRateAdjustment(double adjustment);
+
+  // Queues `count` input stereo samples, left channel first.
+  void Write(const int16_t* samples, size_t count);
+  // Produces up to `count` output stereo samples from the queued input and
+  // returns how many there were.
+  size_t Read(int16_t* out, size_t count);
+
+  Resampler(const Resampler&) = delete;
+  Resampler& operator=(const Resampler&) = delete;
+
+ private:
+  // The filter's taps for each phase, with one more phase at the end
+  // repeating the first one a sample later.
+  std::vector<float> coefficients_;
+  const double base_step_;
+  // Input samples per output sample, as a 32.32 fixed-point number.
+  uint64_t step_;
+  // Position of the next output sample in the queued input, in the same
+  // format.
+  uint64_t position_;
+  // Queued input by channel. Each output sample is filtered from the kTaps
+  // samples from its position onwards.
+  std::vector<float> left_;
+  std::vector<float> right_;
+  size_t queued_;
+};
+
+}  // namespace gamebun
+
+#endif  // RESAMPLER_H_
@@ -0,0 +1,283 @@
+#include "rewind_buffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "arena.h"
+#include "emulator.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// Snapshots are encoded as a series of runs, each a 16-bit count of words
+// left as they were in the keyframe, a 16-bit count of words that differ,
+// and what those words must be XORed with. Runs longer than this are split.
+constexpr size_t kMaxRun = 0xFFFF;
+constexpr size_t kRunHeaderSize = 2 * sizeof(uint16_t);
+
+uint64_t Load64(const uint8_t* bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+void Store64(uint8_t* bytes, uint64_t value) {
+  std::memcpy(bytes, &value, sizeof(value));
+}
+
+uint16_t Load16(const uint8_t* bytes) {
+  uint16_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+void Store16(uint8_t* bytes, size_t value) {
+  const uint16_t narrowed = static_cast<uint16_t>(value);
+  std::memcpy(bytes, &narrowed, sizeof(narrowed));
+}
+
+// The most EncodeDelta() can produce from a state of `words` words: at
+// worst, every other word differs.
+size_t MaxEncodedSize(size_t words) {
+  return words * sizeof(uint64_t) + (words + words / kMaxRun + 1) *
+                                        kRunHeaderSize;
+}
+
+// Encodes the `words` words of `state` as their XOR with `keyframe`, or as
+// they are if `keyframe` is null, into `out`. Returns the encoded size,
+// which is never 0.
+size_t EncodeDelta(const uint8_t* state, const uint8_t* keyframe,
+                   size_t words, uint8_t* out) {
+  const auto difference = [&](size_t word) {
+    const size_t offset = word * sizeof(uint64_t);
+    const uint64_t value = Load64(&state[offset]);
+    return keyframe == nullptr ? value : value ^ Load64(&keyframe[offset]);
+  };
+
+  size_t size = 0;
+  size_t word = 0;
+  do {
+    // Most of the state is unchanged from one frame to the next, so it is
+    // skipped a few words at a time.
+    const size_t run_end = std::min(words, word + kMaxRun);
+    const size_t run_start = word;
+    while (word + 4 <= run_end &&
+           (difference(word) | difference(word + 1) | difference(word + 2) |
+            difference(word + 3)) == 0) {
+      word += 4;
+    }
+    while (word < run_end && difference(word) == 0) {
+      word++;
+    }
+    const size_t unchanged = word - run_start;
+    uint8_t* const header = &out[size];
+    size += kRunHeaderSize;
+    size_t changed = 0;
+    while (word < words && changed < kMaxRun) {
+      const uint64_t value = difference(word);
+      if (value == 0) {
+        break;
+      }
+      Store64(&out[size], value);
+      size += sizeof(uint64_t);
+      changed++;
+      word++;
+    }
+    Store16(header, unchanged);
+    Store16(&header[sizeof(uint16_t)], changed);
+  } while (word < words);
+  return size;
+}
+
+// XORs the words of `state` with the `size` bytes of runs at `delta`.
+void ApplyDelta(const uint8_t* delta, size_t size, uint8_t* state) {
+  size_t position = 0;
+  size_t offset = 0;
+  while (position < size) {
+    offset += Load16(&delta[position]) * sizeof(uint64_t);
+    const size_t changed = Load16(&delta[position + sizeof(uint16_t)]);
+    position += kRunHeaderSize;
+    for (size_t i = 0; i < changed; i++) {
+      Store64(&state[offset],
+              Load64(&state[offset]) ^ Load64(&delta[position]));
+      offset += sizeof(uint64_t);
+      position += sizeof(uint64_t);
+    }
+  }
+}
+
+bool Overlaps(size_t offset, size_t size, size_t other_offset,
+              size_t other_size) {
+  return offset < other_offset + other_size && other_offset < offset + size;
+}
+
+}  // namespace
+
+RewindBuffer::RewindBuffer(Emulator* emulator, const RewindOptions& options)
+    : emulator_(*emulator),
+      interval_(options.interval),
+      keyframe_interval_(
+          std::min(options.keyframe_interval,
+                   std::max(options.capacity / 2, size_t{1}))),
+      state_words_((emulator->state_buffer_size_ + sizeof(uint64_t) - 1) /
+                   sizeof(uint64_t)),
+      capacity_(options.capacity),
+      data_size_(options.max_bytes),
+      arena_(2 * state_words_ * sizeof(uint64_t) +
+                 MaxEncodedSize(state_words_) + data_size_ +
+                 capacity_ * sizeof(Snapshot) + 5 * Arena::kAlignment,
+             false),
+      state_(arena_.Allocate<uint8_t>(state_words_ * sizeof(uint64_t))),
+      keyframe_state_(
+          arena_.Allocate<uint8_t>(state_words_ * sizeof(uint64_t))),
+      encoded_(arena_.Allocate<uint8_t>(MaxEncodedSize(state_words_))),
+      data_(arena_.Allocate<uint8_t>(data_size_)),
+      snapshots_(arena_.Allocate<Snapshot>(capacity_)),
+      first_(0),
+      count_(0),
+      bytes_used_(0),
+      since_keyframe_(0),
+      group_bytes_(0),
+      frames_(0) {
+  if (interval_ == 0 || keyframe_interval_ == 0 || capacity_ == 0) {
+    FATAL("Rewind intervals and capacity must not be 0");
+  }
+  if (data_size_ < MaxEncodedSize(state_words_)) {
+    FATAL("Rewind buffer of %zu bytes is too small for a %zu byte snapshot",
+          data_size_, MaxEncodedSize(state_words_));
+  }
+  arena_.Trim();
+}
+
+void RewindBuffer::EndFrame() {
+  if (++frames_ < interval_) {
+    return;
+  }
+  frames_ = 0;
+
+  const size_t state_size = state_words_ * sizeof(uint64_t);
+  StateWriter writer(state_, state_size);
+  emulator_.WriteState(&writer);
+  emulator_.WriteRamState(&writer);
+  if (writer.overflowed()) {
+    return;
+  }
+  // Padding left over from a longer state would show up as a difference.
+  std::memset(&state_[writer.size()], 0, state_size - writer.size());
+
+  const bool keyframe = count_ == 0 ||
+                        since_keyframe_ == keyframe_interval_ ||
+                        group_bytes_ >= data_size_ / 4;
+  const size_t size = EncodeDelta(
+      state_, keyframe ? nullptr : keyframe_state_, state_words_, encoded_);
+  if (keyframe) {
+    std::swap(state_, keyframe_state_);
+  }
+  Store(size, writer.size(), keyframe);
+}
+
+bool RewindBuffer::Rewind(size_t age) {
+  if (age >= count_) {
+    return false;
+  }
+  const size_t index = count_ - 1 - age;
+  size_t keyframe_index = index;
+  while (!At(keyframe_index).keyframe) {
+    keyframe_index--;
+  }
+
+  const Snapshot& keyframe = At(keyframe_index);
+  std::memset(keyframe_state_, 0, state_words_ * sizeof(uint64_t));
+  ApplyDelta(&data_[keyframe.offset], keyframe.size, keyframe_state_);
+  const Snapshot& snapshot = At(index);
+  const uint8_t* state = keyframe_state_;
+  if (index != keyframe_index) {
+    std::memcpy(state_, keyframe_state_, state_words_ * sizeof(uint64_t));
+    ApplyDelta(&data_[snapshot.offset], snapshot.size, state_);
+    state = state_;
+  }
+  StateReader reader(state, snapshot.state_size);
+  emulator_.ReadState(&reader);
+  emulator_.ReadRamState(&reader);
+
+  while (count_ > index + 1) {
+    bytes_used_ -= At(count_ - 1).size;
+    count_--;
+  }
+  since_keyframe_ = index - keyframe_index + 1;
+  group_bytes_ = 0;
+  for (size_t i = keyframe_index; i <= index; i++) {
+    group_bytes_ += At(i).size;
+  }
+  frames_ = 0;
+  return true;
+}
+
+void RewindBuffer::Clear() {
+  first_ = 0;
+  count_ = 0;
+  bytes_used_ = 0;
+  since_keyframe_ = 0;
+  group_bytes_ = 0;
+  frames_ = 0;
+  arena_.Discard(data_, data_size_);
+}
+
+void RewindBuffer::Store(size_t size, size_t state_size, bool keyframe) {
+  size_t offset;
+  while (true) {
+    offset = 0;
+    if (count_ == 0) {
+      break;
+    }
+    // Snapshots run from the oldest to the latest, wrapping around at most
+    // once. Only wrap again once they no longer do, so that the room taken
+    // is always at the oldest end.
+    const Snapshot& oldest = At(0);
+    const Snapshot& latest = At(count_ - 1);
+    offset = latest.offset + latest.size;
+    if (oldest.offset <= latest.offset && offset + size > data_size_) {
+      offset = 0;
+    }
+    if (count_ < capacity_ &&
+        !Overlaps(offset, size, oldest.offset, oldest.size)) {
+      break;
+    }
+    DropOldest();
+  }
+  if (count_ == 0 && !keyframe) {
+    // Only a buffer too small for a whole group of snapshots gets here.
+    // state_ still holds the snapshot's state, as only keyframes are
+    // swapped out of it.
+    size = EncodeDelta(state_, nullptr, state_words_, encoded_);
+    std::swap(state_, keyframe_state_);
+    keyframe = true;
+  }
+
+  std::memcpy(&data_[offset], encoded_, size);
+  Snapshot& snapshot = At(count_);
+  snapshot.offset = offset;
+  snapshot.size = size;
+  snapshot.state_size = state_size;
+  snapshot.keyframe = keyframe;
+  count_++;
+  bytes_used_ += size;
+  since_keyframe_ = keyframe ? 1 : since_keyframe_ + 1;
+  group_bytes_ = keyframe ? size : group_bytes_ + size;
+}
+
+void RewindBuffer::DropOldest() {
+  do {
+    bytes_used_ -= At(0).size;
+    first_ = (first_ + 1) % capacity_;
+    count_--;
+  } while (count_ != 0 && !At(0).keyframe);
+}
+
+}  // namespace gamebun
@@ -0,0 +1,120 @@
+#ifndef REWIND_BUFFER_H_
+#define REWIND_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.h"
+#include "emulator.h"
+
+namespace gamebun {
+
+struct RewindOptions {
+  // Frames between snapshots.
+  size_t interval = 1;
+  // Snapshots kept, the oldest being dropped first. With the defaults, a
+  // minute at 60 frames a second.
+  size_t capacity = 3600;
+  // Every this many snapshots, one is stored whole. The rest are stored as
+  // their differences from it. At most half of `capacity`, so that dropping
+  // the oldest keyframe, along with the snapshots that depend on it, always
+  // leaves some behind.
+  size_t keyframe_interval = 60;
+  // Memory for the stored snapshots. Once it is full, the oldest are dropped
+  // even if fewer than `capacity` are kept. For the same reason as above, a
+  // keyframe is also taken early once the snapshots since the last one take
+  // up a quarter of it.
+  size_t max_bytes = 16 << 20;
+};
+
+// Keeps the recent past of an emulator, so that play can be taken back.
+//
+// Each snapshot is the emulator's raw state, XORed with that of the last
+// keyframe, so that everything unchanged becomes zero, and then stored as
+// runs of zero words and the words in between. A frame usually changes a
+// few hundred bytes of state, so snapshots are small and quick to take, and
+// restoring any of them only takes decoding its keyframe and itself. All
+// memory is reserved up front.
+class RewindBuffer {
+ public:
+  // The emulator must outlive the buffer.
+  RewindBuffer(Emulator* emulator, const RewindOptions& options);
+
+  // Called after each frame the emulator runs, to take a snapshot every
+  // `interval` frames. Snapshots are skipped while too much input is queued
+  // ahead to save.
+  void EndFrame();
+
+  // Returns the emulator to the snapshot taken `age` snapshots before the
+  // latest one, and returns true. Newer snapshots are dropped, so that the
+  // restored one becomes the latest. Returns false, changing nothing, if
+  // fewer snapshots are stored.
+  bool Rewind(size_t age);
+
+  // Drops every snapshot, giving back the memory they took up.
+  void Clear();
+
+  // Number of snapshots stored, and the bytes they take up.
+  size_t size() const { return count_; }
+  size_t bytes_used() const { return bytes_used_; }
+
+  RewindBuffer(const RewindBuffer&) = delete;
+  RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+ private:
+  struct Snapshot {
+    // Where the snapshot is stored in data_, and its size there.
+    size_t offset;
+    size_t size;
+    // Size of the state it decodes to.
+    size_t state_size;
+    bool keyframe;
+  };
+
+  // The `index`th oldest snapshot.
+  Snapshot& At(size_t index) {
+    return snapshots_[(first_ + index) % capacity_];
+  }
+
+  // Copies the `size` bytes in encoded_ into data_ as the latest snapshot,
+  // first dropping the oldest ones until there is room. Should that drop
+  // the keyframe the snapshot depends on, it is stored as a keyframe
+  // instead.
+  void Store(size_t size, size_t state_size, bool keyframe);
+  // Drops the oldest snapshot, and those that depend on it.
+  void DropOldest();
+
+  Emulator& emulator_;
+  const size_t interval_;
+  const size_t keyframe_interval_;
+  // Words in a raw state, which is zero-padded to a whole number of them.
+  const size_t state_words_;
+  const size_t capacity_;
+  const size_t data_size_;
+  // Holds everything below. Pages are only backed by memory once written.
+  Arena arena_;
+
+  // The state being captured or restored, and that of the keyframe deltas
+  // are taken against. Swapped whenever a keyframe is taken.
+  uint8_t* state_;
+  uint8_t* keyframe_state_;
+  // Room for a snapshot as it is encoded, before it is copied into place.
+  uint8_t* const encoded_;
+  // Snapshots, stored one after another and wrapping back to the start when
+  // the next one does not fit before the end.
+  uint8_t* const data_;
+  Snapshot* const snapshots_;
+  size_t first_;
+  size_t count_;
+  size_t bytes_used_;
+  // Snapshots taken since the latest keyframe, including it, and the bytes
+  // they take up.
+  size_t since_keyframe_;
+  size_t group_bytes_;
+  // Frames ended since the latest snapshot.
+  size_t frames_;
+};
+
+}  // namespace gamebun
+
+#endif  // REWIND_BUFFER_H_
@@ -0,0 +1,189 @@
+#include "rewind_buffer.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "apu.h"
+#include "cartridge.h"
+#include "emulator.h"
+#include "test_util/test_cartridge.h"
+
+namespace gamebun {
+namespace {
+
+// Keeps filling the tile data with a value that goes up by one on each pass,
+// which takes a few frames, so that every frame changes a few kilobytes of
+// state.
+const std::vector<uint8_t> kFillProgram = {
+    0xAF,              // 0x100: XOR A
+    0x21, 0x00, 0x80,  // 0x101: LD HL, 0x8000
+    0x3C,              // 0x104: INC A
+    0x22,              // 0x105: LD (HL+), A
+    0x47,              // 0x106: LD B, A
+    0x7C,              // 0x107: LD A, H
+    0xFE, 0x98,        // 0x108: CP 0x98
+    0x78,              // 0x10A: LD A, B
+    0x20, 0xF8,        // 0x10B: JR NZ, 0x105
+    0x18, 0xF2,        // 0x10D: JR 0x101
+};
+
+EmulatorOptions Options() {
+  EmulatorOptions options;
+  options.audio.mode = AudioMode::kRegistersOnly;
+  return options;
+}
+
+std::vector<uint8_t> SaveState(Emulator* emulator) {
+  std::vector<uint8_t> state(emulator->MaxSaveStateSize());
+  const size_t size = emulator->SaveState(state.data(), state.size());
+  REQUIRE(size != 0);
+  state.resize(size);
+  return state;
+}
+
+// An emulator and its rewind buffer, along with the state after each frame
+// run.
+struct TestRewind {
+  TestRewind(const Cartridge& cart, const RewindOptions& options)
+      : emulator(cart, Options()), rewind(&emulator, options) {}
+
+  void RunFrames(size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+      emulator.RunFrame();
+      rewind.EndFrame();
+      states.push_back(SaveState(&emulator));
+    }
+  }
+
+  // Checks that every stored snapshot, the latest of them taken after the
+  // last frame run, restores the state it was taken of. Only the oldest is
+  // left afterwards.
+  void CheckSnapshots(size_t interval) {
+    while (true) {
+      INFO(rewind.size() << " snapshots left");
+      REQUIRE(rewind.Rewind(0));
+      CHECK(SaveState(&emulator) == states.back());
+      if (rewind.size() == 1) {
+        break;
+      }
+      REQUIRE(rewind.Rewind(1));
+      states.resize(states.size() - interval);
+    }
+  }
+
+  Emulator emulator;
+  RewindBuffer rewind;
+  std::vector<std::vector<uint8_t>> states;
+};
+
+TEST_CASE("Rewinding restores the state of each snapshot", "[rewind]") {
+  const Cartridge cart = MakeTestCartridge(kFillProgram);
+  RewindOptions options;
+  options.interval = 2;
+  options.keyframe_interval = 8;
+  TestRewind test(cart, options);
+  test.RunFrames(40);
+  REQUIRE(test.rewind.size() == 20);
+
+  CHECK_FALSE(test.rewind.Rewind(20));
+  // Back by a few, in the middle of a group, and then on from there.
+  REQUIRE(test.rewind.Rewind(3));
+  test.states.resize(test.states.size() - 6);
+  CHECK(SaveState(&test.emulator) == test.states.back());
+  CHECK(test.rewind.size() == 17);
+  test.RunFrames(10);
+  CHECK(test.rewind.size() == 22);
+  test.CheckSnapshots(options.interval);
+  CHECK(test.rewind.size() == 1);
+
+  test.rewind.Clear();
+  CHECK(test.rewind.size() == 0);
+  CHECK(test.rewind.bytes_used() == 0);
+  CHECK_FALSE(test.rewind.Rewind(0));
+}
+
+TEST_CASE("Full rewind buffers drop their oldest snapshots", "[rewind]") {
+  const Cartridge cart = MakeTestCartridge(kFillProgram);
+  RewindOptions options;
+  options.capacity = 10;
+  options.keyframe_interval = 4;
+
+  SECTION("by count") {
+    TestRewind test(cart, options);
+    for (size_t frame = 1; frame <= 60; frame++) {
+      test.RunFrames(1);
+      INFO("frame " << frame);
+      // Dropping the oldest group of 4 from 10 leaves 6, then the new
+      // snapshot is added.
+      CHECK(test.rewind.size() ==
+            std::min<size_t>(frame, 7 + (frame + 1) % 4));
+    }
+    test.CheckSnapshots(options.interval);
+  }
+  SECTION("with keyframes further apart than the capacity") {
+    // The interval is cut down to 5, so that a group can be dropped
+    // without dropping every snapshot.
+    options.keyframe_interval = 60;
+    TestRewind test(cart, options);
+    test.RunFrames(10);
+    for (size_t frame = 11; frame <= 60; frame++) {
+      test.RunFrames(1);
+      INFO("frame " << frame);
+      CHECK(test.rewind.size() >= 5);
+    }
+    test.CheckSnapshots(options.interval);
+  }
+  SECTION("by bytes") {
+    // Room for under a hundred of these snapshots, far fewer than a group.
+    options.capacity = 1000;
+    options.keyframe_interval = 500;
+    options.max_bytes = 512 << 10;
+    TestRewind test(cart, options);
+    test.RunFrames(100);
+    size_t least = test.rewind.size();
+    for (size_t frame = 101; frame <= 300; frame++) {
+      test.RunFrames(1);
+      least = std::min(least, test.rewind.size());
+      CHECK(test.rewind.bytes_used() <= options.max_bytes);
+    }
+    CHECK(least < 100);
+    CHECK(least >= 20);
+    test.CheckSnapshots(options.interval);
+  }
+}
+
+// Run with "[.benchmark]" to time snapshots with the default options.
+TEST_CASE("Rewind timing", "[.benchmark][rewind]") {
+  constexpr size_t kFrames = 3600;
+  const Cartridge cart = MakeTestCartridge(kFillProgram);
+  using Clock = std::chrono::steady_clock;
+  Emulator emulator(cart, Options());
+  RewindBuffer rewind(&emulator, RewindOptions());
+
+  Clock::duration capture = Clock::duration::zero();
+  for (size_t i = 0; i < kFrames; i++) {
+    emulator.RunFrame();
+    const Clock::time_point start = Clock::now();
+    rewind.EndFrame();
+    capture += Clock::now() - start;
+  }
+  const size_t count = rewind.size();
+  const size_t bytes = rewind.bytes_used();
+  const Clock::time_point start = Clock::now();
+  REQUIRE(rewind.Rewind(count - 1));
+  const Clock::duration restore = Clock::now() - start;
+
+  using Microseconds = std::chrono::duration<double, std::micro>;
+  WARN(count << " snapshots in " << bytes << " bytes; capture "
+                     << Microseconds(capture).count() / kFrames
+                     << " us a frame, restoring the oldest "
+                     << Microseconds(restore).count() << " us");
+}
+
+}  // namespace
+}  // namespace gamebun
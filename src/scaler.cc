@@ -0,0 +1,701 @@
+#include "scaler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "util/logging.h"
+
+#if defined(__SSSE3__) || defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace gamebun {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "RGBA8888 channels are blended as the bytes of a pixel");
+
+namespace {
+
+// A frame, or the output of an earlier pass, to be scaled.
+struct Image {
+  const uint8_t* pixels;
+  size_t pitch;
+  size_t width;
+  size_t height;
+};
+
+// Bilinear weights are in 64ths, so that a pair of them fits the signed
+// bytes of a multiply-add.
+constexpr unsigned kWeightOne = 64;
+
+template <typename Pixel>
+Pixel LoadPixel(const uint8_t* p) {
+  Pixel pixel;
+  std::memcpy(&pixel, p, sizeof(Pixel));
+  return pixel;
+}
+
+template <typename Pixel>
+void StorePixel(uint8_t* p, Pixel pixel) {
+  std::memcpy(p, &pixel, sizeof(Pixel));
+}
+
+// Copies line `y` of `in` into `padded`, with the edge pixels repeated once on
+// either side. Returns the first pixel of the line within `padded`.
+template <typename Pixel>
+const uint8_t* PadLine(const Image& in, size_t y, uint8_t* padded) {
+  const uint8_t* line = &in.pixels[y * in.pitch];
+  const size_t line_size = in.width * sizeof(Pixel);
+  std::memcpy(&padded[sizeof(Pixel)], line, line_size);
+  std::memcpy(&padded[0], &line[0], sizeof(Pixel));
+  std::memcpy(&padded[sizeof(Pixel) + line_size],
+              &line[line_size - sizeof(Pixel)], sizeof(Pixel));
+  return &padded[sizeof(Pixel)];
+}
+
+size_t LineAbove(size_t y) { return y > 0 ? y - 1 : 0; }
+size_t LineBelow(size_t y, size_t height) {
+  return y + 1 < height ? y + 1 : y;
+}
+
+uint32_t LerpPixel(uint32_t a, uint32_t b, unsigned weight) {
+  uint32_t result = 0;
+  for (unsigned shift = 0; shift < 32; shift += 8) {
+    const unsigned channel_a = (a >> shift) & 0xFF;
+    const unsigned channel_b = (b >> shift) & 0xFF;
+    const unsigned channel =
+        (channel_a * (kWeightOne - weight) + channel_b * weight + 32) >> 6;
+    result |= channel << shift;
+  }
+  return result;
+}
+
+uint16_t LerpPixel(uint16_t a, uint16_t b, unsigned weight) {
+  const auto lerp = [weight](unsigned channel_a, unsigned channel_b) {
+    return (channel_a * (kWeightOne - weight) + channel_b * weight + 32) >> 6;
+  };
+  const unsigned red = lerp(a >> 11, b >> 11);
+  const unsigned green = lerp((a >> 5) & 0x3F, (b >> 5) & 0x3F);
+  const unsigned blue = lerp(a & 0x1F, b & 0x1F);
+  return static_cast<uint16_t>((red << 11) | (green << 5) | blue);
+}
+
+#if defined(__SSE4_1__)
+// Blends the pixels of `a` towards those of `b`. For RGBA8888, `weights_lo`
+// and `weights_hi` hold a (64 - weight, weight) byte pair for each byte of the
+// low and high halves of the block. For RGB565, `weights_lo` holds each
+// pixel's weight in a 16-bit lane.
+template <typename Pixel>
+__m128i LerpBlock(__m128i a, __m128i b, __m128i weights_lo,
+                  __m128i weights_hi) {
+  const __m128i round = _mm_set1_epi16(32);
+  if constexpr (sizeof(Pixel) == 4) {
+    const __m128i lo = _mm_maddubs_epi16(_mm_unpacklo_epi8(a, b), weights_lo);
+    const __m128i hi = _mm_maddubs_epi16(_mm_unpackhi_epi8(a, b), weights_hi);
+    return _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, round), 6),
+                            _mm_srli_epi16(_mm_add_epi16(hi, round), 6));
+  } else {
+    const __m128i inverse =
+        _mm_sub_epi16(_mm_set1_epi16(kWeightOne), weights_lo);
+    const auto lerp = [&](__m128i channel_a, __m128i channel_b) {
+      const __m128i sum =
+          _mm_add_epi16(_mm_mullo_epi16(channel_a, inverse),
+                        _mm_mullo_epi16(channel_b, weights_lo));
+      return _mm_srli_epi16(_mm_add_epi16(sum, round), 6);
+    };
+    const __m128i green_mask = _mm_set1_epi16(0x3F);
+    const __m128i blue_mask = _mm_set1_epi16(0x1F);
+    const __m128i red = lerp(_mm_srli_epi16(a, 11), _mm_srli_epi16(b, 11));
+    const __m128i green =
+        lerp(_mm_and_si128(_mm_srli_epi16(a, 5), green_mask),
+             _mm_and_si128(_mm_srli_epi16(b, 5), green_mask));
+    const __m128i blue =
+        lerp(_mm_and_si128(a, blue_mask), _mm_and_si128(b, blue_mask));
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(red, 11),
+                                     _mm_slli_epi16(green, 5)),
+                        blue);
+  }
+}
+
+#if !defined(__AVX2__)
+// Weights for blending every pixel of a block by the same amount.
+template <typename Pixel>
+void UniformWeights(unsigned weight, __m128i* weights) {
+  if constexpr (sizeof(Pixel) == 4) {
+    const int16_t pair =
+        static_cast<int16_t>((weight << 8) | (kWeightOne - weight));
+    *weights = _mm_set1_epi16(pair);
+  } else {
+    *weights = _mm_set1_epi16(static_cast<int16_t>(weight));
+  }
+}
+#endif
+#endif
+
+// Blends `size` bytes of pixels from `line` towards `neighbor` by the same
+// weight throughout.
+template <typename Pixel>
+void LerpLine(const uint8_t* line, const uint8_t* neighbor, unsigned weight,
+              size_t size, uint8_t* dest) {
+  if (weight == 0) {
+    std::memcpy(dest, line, size);
+    return;
+  }
+  size_t offset = 0;
+#if defined(__AVX2__)
+  const __m256i round = _mm256_set1_epi16(32);
+  const auto load = [](const uint8_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(p));
+  };
+  if constexpr (sizeof(Pixel) == 4) {
+    const __m256i weights = _mm256_set1_epi16(
+        static_cast<int16_t>((weight << 8) | (kWeightOne - weight)));
+    const auto lerp = [&](__m256i pairs) {
+      return _mm256_srli_epi16(
+          _mm256_add_epi16(_mm256_maddubs_epi16(pairs, weights), round), 6);
+    };
+    for (; offset + 32 <= size; offset += 32) {
+      const __m256i a = load(&line[offset]);
+      const __m256i b = load(&neighbor[offset]);
+      const __m256i lo = lerp(_mm256_unpacklo_epi8(a, b));
+      const __m256i hi = lerp(_mm256_unpackhi_epi8(a, b));
+      _mm256_storeu_si256(reinterpret_cast<__m256i_u*>(&dest[offset]),
+                          _mm256_packus_epi16(lo, hi));
+    }
+  } else {
+    const __m256i weights = _mm256_set1_epi16(static_cast<int16_t>(weight));
+    const __m256i inverse =
+        _mm256_set1_epi16(static_cast<int16_t>(kWeightOne - weight));
+    const __m256i green_mask = _mm256_set1_epi16(0x3F);
+    const __m256i blue_mask = _mm256_set1_epi16(0x1F);
+    const auto lerp = [&](__m256i channel_a, __m256i channel_b) {
+      const __m256i sum =
+          _mm256_add_epi16(_mm256_mullo_epi16(channel_a, inverse),
+                           _mm256_mullo_epi16(channel_b, weights));
+      return _mm256_srli_epi16(_mm256_add_epi16(sum, round), 6);
+    };
+    for (; offset + 32 <= size; offset += 32) {
+      const __m256i a = load(&line[offset]);
+      const __m256i b = load(&neighbor[offset]);
+      const __m256i red =
+          lerp(_mm256_srli_epi16(a, 11), _mm256_srli_epi16(b, 11));
+      const __m256i green =
+          lerp(_mm256_and_si256(_mm256_srli_epi16(a, 5), green_mask),
+               _mm256_and_si256(_mm256_srli_epi16(b, 5), green_mask));
+      const __m256i blue =
+          lerp(_mm256_and_si256(a, blue_mask), _mm256_and_si256(b, blue_mask));
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i_u*>(&dest[offset]),
+          _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(red, 11),
+                                          _mm256_slli_epi16(green, 5)),
+                          blue));
+    }
+  }
+#elif defined(__SSE4_1__)
+  __m128i weights;
+  UniformWeights<Pixel>(weight, &weights);
+  for (; offset + 16 <= size; offset += 16) {
+    const __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(&line[offset]));
+    const __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(&neighbor[offset]));
+    _mm_storeu_si128(reinterpret_cast<__m128i_u*>(&dest[offset]),
+                     LerpBlock<Pixel>(a, b, weights, weights));
+  }
+#endif
+  for (; offset < size; offset += sizeof(Pixel)) {
+    StorePixel(&dest[offset],
+               LerpPixel(LoadPixel<Pixel>(&line[offset]),
+                         LoadPixel<Pixel>(&neighbor[offset]), weight));
+  }
+}
+
+// Nearest neighbor: each source line is widened once and then copied to the
+// other output lines it covers.
+template <typename Pixel>
+void ScaleNearest(const Image& in, size_t factor, uint8_t* out,
+                  size_t out_pitch) {
+  const size_t out_line_size = in.width * factor * sizeof(Pixel);
+  size_t block_end = 0;
+#if defined(__SSSE3__)
+  // Output block k of every 16-byte source block is a fixed shuffle of it.
+  constexpr size_t kBlockPixels = 16 / sizeof(Pixel);
+  __m128i shuffles[kMaxScaleFactor];
+  for (size_t k = 0; k < factor; k++) {
+    alignas(16) uint8_t indices[16];
+    for (size_t i = 0; i < 16; i++) {
+      const size_t pixel = (k * kBlockPixels + i / sizeof(Pixel)) / factor;
+      indices[i] = static_cast<uint8_t>(pixel * sizeof(Pixel) +
+                                        i % sizeof(Pixel));
+    }
+    shuffles[k] =
+        _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(indices));
+  }
+  block_end = in.width / kBlockPixels * kBlockPixels;
+#endif
+
+  for (size_t y = 0; y < in.height; y++) {
+    const uint8_t* line = &in.pixels[y * in.pitch];
+    uint8_t* dest = &out[y * factor * out_pitch];
+#if defined(__SSSE3__)
+    for (size_t x = 0; x < block_end; x += kBlockPixels) {
+      const __m128i block = _mm_loadu_si128(
+          reinterpret_cast<const __m128i_u*>(&line[x * sizeof(Pixel)]));
+      __m128i_u* block_out =
+          reinterpret_cast<__m128i_u*>(&dest[x * factor * sizeof(Pixel)]);
+      for (size_t k = 0; k < factor; k++) {
+        _mm_storeu_si128(&block_out[k], _mm_shuffle_epi8(block, shuffles[k]));
+      }
+    }
+#endif
+    for (size_t x = block_end; x < in.width; x++) {
+      const Pixel pixel = LoadPixel<Pixel>(&line[x * sizeof(Pixel)]);
+      for (size_t i = 0; i < factor; i++) {
+        StorePixel(&dest[(x * factor + i) * sizeof(Pixel)], pixel);
+      }
+    }
+    for (size_t i = 1; i < factor; i++) {
+      std::memcpy(&dest[i * out_pitch], dest, out_line_size);
+    }
+  }
+}
+
+// Scale2x, also known as EPX. Around each pixel E:
+//
+//   A B C
+//   D E F
+//   G H I
+//
+// each quarter of E takes the color of the two edge neighbors next to it when
+// they match, unless E sits on a straight line (B == H or D == F).
+template <typename Pixel>
+void Scale2x(const Image& in, uint8_t* padded, uint8_t* out,
+             size_t out_pitch) {
+  size_t block_end = 0;
+#if defined(__AVX2__)
+  constexpr size_t kBlockPixels = 32 / sizeof(Pixel);
+  block_end = in.width / kBlockPixels * kBlockPixels;
+  const auto equal = [](__m256i a, __m256i b) {
+    if constexpr (sizeof(Pixel) == 4) {
+      return _mm256_cmpeq_epi32(a, b);
+    } else {
+      return _mm256_cmpeq_epi16(a, b);
+    }
+  };
+  const auto store_interleaved = [](uint8_t* dest, __m256i even,
+                                    __m256i odd) {
+    __m256i lo;
+    __m256i hi;
+    if constexpr (sizeof(Pixel) == 4) {
+      lo = _mm256_unpacklo_epi32(even, odd);
+      hi = _mm256_unpackhi_epi32(even, odd);
+    } else {
+      lo = _mm256_unpacklo_epi16(even, odd);
+      hi = _mm256_unpackhi_epi16(even, odd);
+    }
+    __m256i_u* dest_ymm = reinterpret_cast<__m256i_u*>(dest);
+    _mm256_storeu_si256(&dest_ymm[0], _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(&dest_ymm[1], _mm256_permute2x128_si256(lo, hi, 0x31));
+  };
+  const __m256i all_set = _mm256_set1_epi8(-1);
+#endif
+
+  for (size_t y = 0; y < in.height; y++) {
+    const uint8_t* above = &in.pixels[LineAbove(y) * in.pitch];
+    const uint8_t* below = &in.pixels[LineBelow(y, in.height) * in.pitch];
+    const uint8_t* line = PadLine<Pixel>(in, y, padded);
+    uint8_t* top = &out[2 * y * out_pitch];
+    uint8_t* bottom = &top[out_pitch];
+#if defined(__AVX2__)
+    for (size_t x = 0; x < block_end; x += kBlockPixels) {
+      const size_t offset = x * sizeof(Pixel);
+      const auto load = [](const uint8_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i_u*>(p));
+      };
+      const uint8_t* center = &line[offset];
+      const __m256i e = load(center);
+      const __m256i d = load(center - sizeof(Pixel));
+      const __m256i f = load(center + sizeof(Pixel));
+      const __m256i b = load(&above[offset]);
+      const __m256i h = load(&below[offset]);
+      const __m256i corner =
+          _mm256_andnot_si256(_mm256_or_si256(equal(b, h), equal(d, f)),
+                              all_set);
+      const auto pick = [&](__m256i edge, __m256i match) {
+        return _mm256_blendv_epi8(e, edge, _mm256_and_si256(corner, match));
+      };
+      store_interleaved(&top[2 * offset], pick(d, equal(d, b)),
+                        pick(f, equal(b, f)));
+      store_interleaved(&bottom[2 * offset], pick(d, equal(d, h)),
+                        pick(f, equal(h, f)));
+    }
+#endif
+    for (size_t x = block_end; x < in.width; x++) {
+      const size_t offset = x * sizeof(Pixel);
+      const uint8_t* center = &line[offset];
+      const Pixel e = LoadPixel<Pixel>(center);
+      const Pixel d = LoadPixel<Pixel>(center - sizeof(Pixel));
+      const Pixel f = LoadPixel<Pixel>(center + sizeof(Pixel));
+      const Pixel b = LoadPixel<Pixel>(&above[offset]);
+      const Pixel h = LoadPixel<Pixel>(&below[offset]);
+      const bool corner = b != h && d != f;
+      StorePixel(&top[2 * offset], corner && d == b ? d : e);
+      StorePixel(&top[2 * offset + sizeof(Pixel)], corner && b == f ? f : e);
+      StorePixel(&bottom[2 * offset], corner && d == h ? d : e);
+      StorePixel(&bottom[2 * offset + sizeof(Pixel)],
+                 corner && h == f ? f : e);
+    }
+  }
+}
+
+// Scale3x extends Scale2x to thirds, also filling in the middle of each edge
+// when the diagonal neighbors show a line passing through it.
+template <typename Pixel>
+void Scale3x(const Image& in, uint8_t* padded, uint8_t* out,
+             size_t out_pitch) {
+  const size_t padded_size = (in.width + 2) * sizeof(Pixel);
+  size_t block_end = 0;
+#if defined(__SSE4_1__)
+  // Each output row interleaves three results per source pixel. Output block
+  // j of a row gathers its pixels from the three result blocks through
+  // shuffles that zero the pixels taken from the other two.
+  constexpr size_t kBlockPixels = 16 / sizeof(Pixel);
+  block_end = in.width / kBlockPixels * kBlockPixels;
+  __m128i gathers[3][3];
+  for (size_t j = 0; j < 3; j++) {
+    for (size_t source = 0; source < 3; source++) {
+      alignas(16) uint8_t indices[16];
+      for (size_t i = 0; i < 16; i++) {
+        const size_t out_pixel = j * kBlockPixels + i / sizeof(Pixel);
+        indices[i] = out_pixel % 3 == source
+                         ? static_cast<uint8_t>((out_pixel / 3) *
+                                                    sizeof(Pixel) +
+                                                i % sizeof(Pixel))
+                         : 0x80;
+      }
+      gathers[j][source] =
+          _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(indices));
+    }
+  }
+  const auto equal = [](__m128i a, __m128i b) {
+    if constexpr (sizeof(Pixel) == 4) {
+      return _mm_cmpeq_epi32(a, b);
+    } else {
+      return _mm_cmpeq_epi16(a, b);
+    }
+  };
+  const auto store_interleaved = [&gathers](uint8_t* dest, __m128i first,
+                                            __m128i second, __m128i third) {
+    __m128i_u* dest_xmm = reinterpret_cast<__m128i_u*>(dest);
+    for (size_t j = 0; j < 3; j++) {
+      _mm_storeu_si128(
+          &dest_xmm[j],
+          _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(first, gathers[j][0]),
+                                    _mm_shuffle_epi8(second, gathers[j][1])),
+                       _mm_shuffle_epi8(third, gathers[j][2])));
+    }
+  };
+#endif
+
+  for (size_t y = 0; y < in.height; y++) {
+    const uint8_t* above = PadLine<Pixel>(in, LineAbove(y), &padded[0]);
+    const uint8_t* line = PadLine<Pixel>(in, y, &padded[padded_size]);
+    const uint8_t* below =
+        PadLine<Pixel>(in, LineBelow(y, in.height), &padded[2 * padded_size]);
+    uint8_t* rows[3] = {&out[3 * y * out_pitch],
+                        &out[(3 * y + 1) * out_pitch],
+                        &out[(3 * y + 2) * out_pitch]};
+#if defined(__SSE4_1__)
+    for (size_t x = 0; x < block_end; x += kBlockPixels) {
+      const size_t center = x * sizeof(Pixel);
+      const auto load = [center](const uint8_t* p, ptrdiff_t dx) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(
+            &p[center] + dx * static_cast<ptrdiff_t>(sizeof(Pixel))));
+      };
+      const __m128i a = load(above, -1);
+      const __m128i b = load(above, 0);
+      const __m128i c = load(above, 1);
+      const __m128i d = load(line, -1);
+      const __m128i e = load(line, 0);
+      const __m128i f = load(line, 1);
+      const __m128i g = load(below, -1);
+      const __m128i h = load(below, 0);
+      const __m128i i = load(below, 1);
+
+      const __m128i corner = _mm_andnot_si128(
+          _mm_or_si128(equal(b, h), equal(d, f)), _mm_set1_epi8(-1));
+      const __m128i db = _mm_and_si128(corner, equal(d, b));
+      const __m128i bf = _mm_and_si128(corner, equal(b, f));
+      const __m128i dh = _mm_and_si128(corner, equal(d, h));
+      const __m128i hf = _mm_and_si128(corner, equal(h, f));
+      // Whether both `match` holds and E differs from `other`.
+      const auto unless = [&](__m128i match, __m128i other) {
+        return _mm_andnot_si128(equal(e, other), match);
+      };
+      const auto pick = [e](__m128i edge, __m128i mask) {
+        return _mm_blendv_epi8(e, edge, mask);
+      };
+      store_interleaved(
+          &rows[0][3 * center], pick(d, db),
+          pick(b, _mm_or_si128(unless(db, c), unless(bf, a))), pick(f, bf));
+      store_interleaved(
+          &rows[1][3 * center],
+          pick(d, _mm_or_si128(unless(db, g), unless(dh, a))), e,
+          pick(f, _mm_or_si128(unless(bf, i), unless(hf, c))));
+      store_interleaved(
+          &rows[2][3 * center], pick(d, dh),
+          pick(h, _mm_or_si128(unless(dh, i), unless(hf, g))), pick(f, hf));
+    }
+#endif
+    for (size_t x = block_end; x < in.width; x++) {
+      const size_t center = x * sizeof(Pixel);
+      const auto load = [center](const uint8_t* p, ptrdiff_t dx) {
+        return LoadPixel<Pixel>(&p[center] +
+                                dx * static_cast<ptrdiff_t>(sizeof(Pixel)));
+      };
+      const Pixel a = load(above, -1);
+      const Pixel b = load(above, 0);
+      const Pixel c = load(above, 1);
+      const Pixel d = load(line, -1);
+      const Pixel e = load(line, 0);
+      const Pixel f = load(line, 1);
+      const Pixel g = load(below, -1);
+      const Pixel h = load(below, 0);
+      const Pixel i = load(below, 1);
+
+      Pixel result[9] = {e, e, e, e, e, e, e, e, e};
+      if (b != h && d != f) {
+        result[0] = d == b ? d : e;
+        result[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+        result[2] = b == f ? f : e;
+        result[3] = (d == b && e != g) || (d == h && e != a) ? d : e;
+        result[5] = (b == f && e != i) || (h == f && e != c) ? f : e;
+        result[6] = d == h ? d : e;
+        result[7] = (d == h && e != i) || (h == f && e != g) ? h : e;
+        result[8] = h == f ? f : e;
+      }
+      for (size_t row = 0; row < 3; row++) {
+        std::memcpy(&rows[row][3 * center], &result[row * 3],
+                    3 * sizeof(Pixel));
+      }
+    }
+  }
+}
+
+// Each output pixel samples the source at its own center, (k + 0.5) / factor
+// - 0.5 source pixels from the center of the pixel it lies in, blending with
+// the neighbor on that side. The blend is separable: every source line is
+// widened once, then pairs of widened lines are blended into output lines.
+template <typename Pixel>
+void ScaleBilinear(const Image& in, size_t factor, uint8_t* scratch,
+                   uint8_t* out, size_t out_pitch) {
+  const size_t out_width = in.width * factor;
+  const size_t out_line_size = out_width * sizeof(Pixel);
+  uint8_t* padded = scratch;
+  uint8_t* widened[3];
+  for (size_t i = 0; i < 3; i++) {
+    widened[i] =
+        &scratch[(in.width + 2) * sizeof(Pixel) + i * out_line_size];
+  }
+
+  // The sampling phase k of a factor-wide span leans towards the previous
+  // pixel when 2k + 1 < factor, and towards the next one otherwise.
+  unsigned weights[kMaxScaleFactor];
+  bool towards_previous[kMaxScaleFactor];
+  for (size_t k = 0; k < factor; k++) {
+    const size_t twice_offset = 2 * k + 1;
+    const size_t distance =
+        twice_offset < factor ? factor - twice_offset : twice_offset - factor;
+    weights[k] =
+        static_cast<unsigned>((distance * kWeightOne + factor) / (2 * factor));
+    towards_previous[k] = twice_offset < factor;
+  }
+
+#if defined(__SSE4_1__)
+  // As with nearest neighbor, output block k of each source block takes its
+  // centers, previous and next neighbors through fixed shuffles.
+  constexpr size_t kBlockPixels = 16 / sizeof(Pixel);
+  __m128i shuffles[kMaxScaleFactor];
+  __m128i previous_masks[kMaxScaleFactor];
+  __m128i block_weights_lo[kMaxScaleFactor];
+  __m128i block_weights_hi[kMaxScaleFactor];
+  for (size_t k = 0; k < factor; k++) {
+    alignas(16) uint8_t indices[16];
+    alignas(16) uint8_t masks[16];
+    alignas(16) uint8_t byte_weights[32];
+    alignas(16) uint16_t lane_weights[8];
+    for (size_t i = 0; i < 16; i++) {
+      const size_t out_pixel = k * kBlockPixels + i / sizeof(Pixel);
+      const size_t phase = out_pixel % factor;
+      indices[i] = static_cast<uint8_t>((out_pixel / factor) * sizeof(Pixel) +
+                                        i % sizeof(Pixel));
+      masks[i] = towards_previous[phase] ? 0xFF : 0x00;
+      byte_weights[2 * i] = static_cast<uint8_t>(kWeightOne - weights[phase]);
+      byte_weights[2 * i + 1] = static_cast<uint8_t>(weights[phase]);
+      lane_weights[i / 2] = static_cast<uint16_t>(weights[phase]);
+    }
+    const auto load = [](const void* p) {
+      return _mm_loadu_si128(static_cast<const __m128i_u*>(p));
+    };
+    shuffles[k] = load(indices);
+    previous_masks[k] = load(masks);
+    if constexpr (sizeof(Pixel) == 4) {
+      block_weights_lo[k] = load(&byte_weights[0]);
+      block_weights_hi[k] = load(&byte_weights[16]);
+    } else {
+      block_weights_lo[k] = load(lane_weights);
+      block_weights_hi[k] = block_weights_lo[k];
+    }
+  }
+  const size_t block_end = in.width / kBlockPixels * kBlockPixels;
+#else
+  const size_t block_end = 0;
+#endif
+
+  const auto widen = [&](size_t y, uint8_t* dest) {
+    const uint8_t* line = PadLine<Pixel>(in, y, padded);
+#if defined(__SSE4_1__)
+    for (size_t x = 0; x < block_end; x += kBlockPixels) {
+      const size_t offset = x * sizeof(Pixel);
+      const auto load = [](const uint8_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i_u*>(p));
+      };
+      const __m128i center = load(&line[offset]);
+      const __m128i previous = load(&line[offset] - sizeof(Pixel));
+      const __m128i next = load(&line[offset] + sizeof(Pixel));
+      __m128i_u* block_out =
+          reinterpret_cast<__m128i_u*>(&dest[offset * factor]);
+      for (size_t k = 0; k < factor; k++) {
+        const __m128i neighbor =
+            _mm_blendv_epi8(_mm_shuffle_epi8(next, shuffles[k]),
+                            _mm_shuffle_epi8(previous, shuffles[k]),
+                            previous_masks[k]);
+        _mm_storeu_si128(&block_out[k],
+                         LerpBlock<Pixel>(_mm_shuffle_epi8(center, shuffles[k]),
+                                          neighbor, block_weights_lo[k],
+                                          block_weights_hi[k]));
+      }
+    }
+#endif
+    for (size_t x = block_end; x < in.width; x++) {
+      const size_t offset = x * sizeof(Pixel);
+      const Pixel center = LoadPixel<Pixel>(&line[offset]);
+      const Pixel previous = LoadPixel<Pixel>(&line[offset] - sizeof(Pixel));
+      const Pixel next = LoadPixel<Pixel>(&line[offset] + sizeof(Pixel));
+      for (size_t k = 0; k < factor; k++) {
+        StorePixel(&dest[(x * factor + k) * sizeof(Pixel)],
+                   LerpPixel(center, towards_previous[k] ? previous : next,
+                             weights[k]));
+      }
+    }
+  };
+
+  // Widened lines rotate through three slots, holding the lines above, at
+  // and below the one being scaled.
+  widen(0, widened[0]);
+  for (size_t y = 0; y < in.height; y++) {
+    const size_t below = LineBelow(y, in.height);
+    if (below != y) {
+      widen(below, widened[below % 3]);
+    }
+    const uint8_t* current = widened[y % 3];
+    const uint8_t* previous = widened[LineAbove(y) % 3];
+    const uint8_t* next = widened[below % 3];
+    for (size_t k = 0; k < factor; k++) {
+      LerpLine<Pixel>(current, towards_previous[k] ? previous : next,
+                      weights[k], out_line_size,
+                      &out[(y * factor + k) * out_pitch]);
+    }
+  }
+}
+
+}  // namespace
+
+Scaler::Scaler(ScaleFilter filter, size_t factor, PixelFormat format)
+    : filter_(filter),
+      factor_(factor),
+      format_(format),
+      intermediate_(),
+      lines_() {
+  if (factor < kMinScaleFactor || factor > kMaxScaleFactor) {
+    FATAL("Unsupported scale factor %zu", factor);
+  }
+
+  const size_t bytes_per_pixel = BytesPerPixel(format);
+  switch (filter) {
+    case ScaleFilter::kNearest:
+      break;
+    case ScaleFilter::kScale2x:
+      if (factor == 5) {
+        FATAL("Scale2x cannot scale by 5");
+      }
+      // Scale3x pads three source lines, and the two-pass factors keep the
+      // first pass's output.
+      lines_.resize(3 * (kScreenWidth * 2 + 2) * bytes_per_pixel);
+      if (factor == 4 || factor == 6) {
+        intermediate_.resize(kScreenWidth * kScreenHeight * (factor / 2) *
+                             (factor / 2) * bytes_per_pixel);
+      }
+      break;
+    case ScaleFilter::kBilinear:
+      // One padded source line and three widened lines.
+      lines_.resize(((kScreenWidth + 2) + 3 * kScreenWidth * factor) *
+                    bytes_per_pixel);
+      break;
+    default:
+      FATAL("Unknown scale filter %d", static_cast<int>(filter));
+  }
+}
+
+void Scaler::Scale(const Frame& frame, uint8_t* out, size_t out_pitch) {
+  switch (format_) {
+    case PixelFormat::kRgba8888:
+      ScaleAs<uint32_t>(frame, out, out_pitch);
+      break;
+    case PixelFormat::kRgb565:
+      ScaleAs<uint16_t>(frame, out, out_pitch);
+      break;
+    default:
+      FATAL("Unknown pixel format %d", static_cast<int>(format_));
+  }
+}
+
+template <typename Pixel>
+void Scaler::ScaleAs(const Frame& frame, uint8_t* out, size_t out_pitch) {
+  const Image in = {frame.pixels, frame.pitch, kScreenWidth, kScreenHeight};
+  switch (filter_) {
+    case ScaleFilter::kNearest:
+      ScaleNearest<Pixel>(in, factor_, out, out_pitch);
+      break;
+    case ScaleFilter::kScale2x: {
+      if (factor_ == 2) {
+        Scale2x<Pixel>(in, lines_.data(), out, out_pitch);
+      } else if (factor_ == 3) {
+        Scale3x<Pixel>(in, lines_.data(), out, out_pitch);
+      } else {
+        // Scale3x is the slower pass, so factor 6 runs it first, on the
+        // smaller image.
+        const size_t first_factor = factor_ / 2;
+        const size_t pitch = kScreenWidth * first_factor * sizeof(Pixel);
+        if (first_factor == 2) {
+          Scale2x<Pixel>(in, lines_.data(), intermediate_.data(), pitch);
+        } else {
+          Scale3x<Pixel>(in, lines_.data(), intermediate_.data(), pitch);
+        }
+        const Image scaled = {intermediate_.data(), pitch,
+                              kScreenWidth * first_factor,
+                              kScreenHeight * first_factor};
+        Scale2x<Pixel>(scaled, lines_.data(), out, out_pitch);
+      }
+      break;
+    }
+    case ScaleFilter::kBilinear:
+      ScaleBilinear<Pixel>(in, factor_, lines_.data(), out, out_pitch);
+      break;
+    default:
+      FATAL("Unknown scale filter %d", static_cast<int>(filter_));
+  }
+}
+
+}  // namespace gamebun
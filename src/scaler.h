@@ -0,0 +1,60 @@
+#ifndef SCALER_H_
+#define SCALER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_buffers.h"
+#include "palette.h"
+
+namespace gamebun {
+
+enum class ScaleFilter {
+  // Repeats every pixel factor x factor times.
+  kNearest,
+  // Rounds off diagonal edges without blurring, using Scale2x (EPX) and
+  // Scale3x. Factor 4 applies Scale2x twice and factor 6 applies Scale3x then
+  // Scale2x; there is no factor 5.
+  kScale2x,
+  // Interpolates linearly between the centers of neighboring pixels.
+  kBilinear,
+};
+
+inline constexpr size_t kMinScaleFactor = 2;
+inline constexpr size_t kMaxScaleFactor = 6;
+
+// Upscales frames into caller-provided memory, as a post-processing step for
+// frames borrowed from FrameBuffers. A Scaler owns the scratch memory its
+// filter needs, allocated up front, so each thread scaling at the same time
+// needs its own Scaler; a frame may be scaled on any thread while it is
+// borrowed.
+class Scaler {
+ public:
+  Scaler(ScaleFilter filter, size_t factor, PixelFormat format);
+
+  size_t OutputWidth() const { return kScreenWidth * factor_; }
+  size_t OutputHeight() const { return kScreenHeight * factor_; }
+
+  // Writes the scaled frame to `out`, which must hold OutputHeight() lines of
+  // OutputWidth() pixels, starting `out_pitch` bytes apart.
+  void Scale(const Frame& frame, uint8_t* out, size_t out_pitch);
+
+  Scaler(const Scaler&) = delete;
+  Scaler& operator=(const Scaler&) = delete;
+
+ private:
+  template <typename Pixel>
+  void ScaleAs(const Frame& frame, uint8_t* out, size_t out_pitch);
+
+  const ScaleFilter filter_;
+  const size_t factor_;
+  const PixelFormat format_;
+  // Holds the output of the first pass of a two-pass Scale2x.
+  std::vector<uint8_t> intermediate_;
+  std::vector<uint8_t> lines_;
+};
+
+}  // namespace gamebun
+
+#endif  // SCALER_H_
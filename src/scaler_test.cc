@@ -0,0 +1,276 @@
+#include "scaler.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "frame_buffers.h"
+#include "palette.h"
+#include "scanline_renderer.h"
+
+namespace gamebun {
+namespace {
+
+// An image as one pixel value per element, whatever the format.
+struct TestImage {
+  TestImage(size_t width, size_t height)
+      : width(width), height(height), pixels(width * height) {}
+
+  // Reads the pixel at (`x`, `y`), with coordinates off the edges clamped to
+  // them.
+  uint32_t At(ptrdiff_t x, ptrdiff_t y) const {
+    const auto clamp = [](ptrdiff_t value, size_t size) {
+      return static_cast<size_t>(
+          std::min<ptrdiff_t>(std::max<ptrdiff_t>(value, 0),
+                              static_cast<ptrdiff_t>(size) - 1));
+    };
+    return pixels[clamp(y, height) * width + clamp(x, width)];
+  }
+  uint32_t& operator()(size_t x, size_t y) { return pixels[y * width + x]; }
+
+  size_t width;
+  size_t height;
+  std::vector<uint32_t> pixels;
+};
+
+TestImage ReferenceNearest(const TestImage& in, size_t factor) {
+  TestImage out(in.width * factor, in.height * factor);
+  for (size_t y = 0; y < out.height; y++) {
+    for (size_t x = 0; x < out.width; x++) {
+      out(x, y) = in.At(x / factor, y / factor);
+    }
+  }
+  return out;
+}
+
+TestImage ReferenceScale2x(const TestImage& in) {
+  TestImage out(in.width * 2, in.height * 2);
+  for (size_t y = 0; y < in.height; y++) {
+    for (size_t x = 0; x < in.width; x++) {
+      const ptrdiff_t sx = static_cast<ptrdiff_t>(x);
+      const ptrdiff_t sy = static_cast<ptrdiff_t>(y);
+      const uint32_t b = in.At(sx, sy - 1);
+      const uint32_t d = in.At(sx - 1, sy);
+      const uint32_t e = in.At(sx, sy);
+      const uint32_t f = in.At(sx + 1, sy);
+      const uint32_t h = in.At(sx, sy + 1);
+      uint32_t e0 = e, e1 = e, e2 = e, e3 = e;
+      if (b != h && d != f) {
+        e0 = d == b ? d : e;
+        e1 = b == f ? f : e;
+        e2 = d == h ? d : e;
+        e3 = h == f ? f : e;
+      }
+      out(2 * x, 2 * y) = e0;
+      out(2 * x + 1, 2 * y) = e1;
+      out(2 * x, 2 * y + 1) = e2;
+      out(2 * x + 1, 2 * y + 1) = e3;
+    }
+  }
+  return out;
+}
+
+TestImage ReferenceScale3x(const TestImage& in) {
+  TestImage out(in.width * 3, in.height * 3);
+  for (size_t y = 0; y < in.height; y++) {
+    for (size_t x = 0; x < in.width; x++) {
+      const ptrdiff_t sx = static_cast<ptrdiff_t>(x);
+      const ptrdiff_t sy = static_cast<ptrdiff_t>(y);
+      const uint32_t a = in.At(sx - 1, sy - 1);
+      const uint32_t b = in.At(sx, sy - 1);
+      const uint32_t c = in.At(sx + 1, sy - 1);
+      const uint32_t d = in.At(sx - 1, sy);
+      const uint32_t e = in.At(sx, sy);
+      const uint32_t f = in.At(sx + 1, sy);
+      const uint32_t g = in.At(sx - 1, sy + 1);
+      const uint32_t h = in.At(sx, sy + 1);
+      const uint32_t i = in.At(sx + 1, sy + 1);
+      uint32_t result[3][3] = {{e, e, e}, {e, e, e}, {e, e, e}};
+      if (b != h && d != f) {
+        result[0][0] = d == b ? d : e;
+        result[0][1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+        result[0][2] = b == f ? f : e;
+        result[1][0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+        result[1][2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+        result[2][0] = d == h ? d : e;
+        result[2][1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+        result[2][2] = h == f ? f : e;
+      }
+      for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+          out(3 * x + column, 3 * y + row) = result[row][column];
+        }
+      }
+    }
+  }
+  return out;
+}
+
+// Blends each channel of `a` towards `b` by `weight` 64ths, rounding to
+// nearest.
+uint32_t Lerp(PixelFormat format, uint32_t a, uint32_t b, uint32_t weight) {
+  const auto lerp = [weight](uint32_t channel_a, uint32_t channel_b) {
+    return (channel_a * (64 - weight) + channel_b * weight + 32) / 64;
+  };
+  uint32_t result = 0;
+  if (format == PixelFormat::kRgba8888) {
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+      result |= lerp((a >> shift) & 0xFF, (b >> shift) & 0xFF) << shift;
+    }
+  } else {
+    result |= lerp(a >> 11, b >> 11) << 11;
+    result |= lerp((a >> 5) & 0x3F, (b >> 5) & 0x3F) << 5;
+    result |= lerp(a & 0x1F, b & 0x1F);
+  }
+  return result;
+}
+
+// Output pixel k of each span of `factor` samples the source at
+// (k + 0.5) / factor - 0.5 pixels from its center, blending with the nearer
+// neighbor across the row, and then the same down the column.
+TestImage ReferenceBilinear(const TestImage& in, size_t factor,
+                            PixelFormat format) {
+  const auto sample = [factor](size_t k, ptrdiff_t* step) {
+    const ptrdiff_t twice_offset = static_cast<ptrdiff_t>(2 * k + 1);
+    const ptrdiff_t f = static_cast<ptrdiff_t>(factor);
+    *step = twice_offset < f ? -1 : 1;
+    const size_t distance =
+        static_cast<size_t>(twice_offset < f ? f - twice_offset
+                                             : twice_offset - f);
+    return static_cast<uint32_t>((distance * 64 + factor) / (2 * factor));
+  };
+  TestImage widened(in.width * factor, in.height);
+  for (size_t y = 0; y < in.height; y++) {
+    for (size_t x = 0; x < widened.width; x++) {
+      ptrdiff_t step;
+      const uint32_t weight = sample(x % factor, &step);
+      const ptrdiff_t sx = static_cast<ptrdiff_t>(x / factor);
+      const ptrdiff_t sy = static_cast<ptrdiff_t>(y);
+      widened(x, y) =
+          Lerp(format, in.At(sx, sy), in.At(sx + step, sy), weight);
+    }
+  }
+  TestImage out(widened.width, in.height * factor);
+  for (size_t y = 0; y < out.height; y++) {
+    for (size_t x = 0; x < out.width; x++) {
+      ptrdiff_t step;
+      const uint32_t weight = sample(y % factor, &step);
+      const ptrdiff_t sx = static_cast<ptrdiff_t>(x);
+      const ptrdiff_t sy = static_cast<ptrdiff_t>(y / factor);
+      out(x, y) =
+          Lerp(format, widened.At(sx, sy), widened.At(sx, sy + step), weight);
+    }
+  }
+  return out;
+}
+
+TestImage ReferenceScale(const TestImage& in, ScaleFilter filter,
+                         size_t factor, PixelFormat format) {
+  switch (filter) {
+    case ScaleFilter::kNearest:
+      return ReferenceNearest(in, factor);
+    case ScaleFilter::kScale2x:
+      switch (factor) {
+        case 2:
+          return ReferenceScale2x(in);
+        case 3:
+          return ReferenceScale3x(in);
+        case 4:
+          return ReferenceScale2x(ReferenceScale2x(in));
+        default:
+          return ReferenceScale2x(ReferenceScale3x(in));
+      }
+    case ScaleFilter::kBilinear:
+      return ReferenceBilinear(in, factor, format);
+  }
+  return in;
+}
+
+// A screen of random pixels. Most are one of a handful of colors, so that
+// edges Scale2x and Scale3x round off are common.
+TestImage RandomScreen(PixelFormat format, std::mt19937* random) {
+  const uint32_t mask = format == PixelFormat::kRgba8888 ? 0xFFFFFFFF : 0xFFFF;
+  const auto random_color = [random, mask] {
+    return static_cast<uint32_t>((*random)()) & mask;
+  };
+  const uint32_t colors[3] = {random_color(), random_color(), random_color()};
+  TestImage image(kScreenWidth, kScreenHeight);
+  for (uint32_t& pixel : image.pixels) {
+    const size_t choice = (*random)() % 8;
+    pixel = choice < 7 ? colors[choice % 3] : random_color();
+  }
+  return image;
+}
+
+// Lays out `image` as lines `pitch` bytes apart, with `fill` in between.
+std::vector<uint8_t> Encode(const TestImage& image, PixelFormat format,
+                            size_t pitch, uint8_t fill) {
+  const size_t bytes_per_pixel = BytesPerPixel(format);
+  std::vector<uint8_t> bytes(image.height * pitch, fill);
+  for (size_t y = 0; y < image.height; y++) {
+    for (size_t x = 0; x < image.width; x++) {
+      std::memcpy(&bytes[y * pitch + x * bytes_per_pixel],
+                  &image.pixels[y * image.width + x], bytes_per_pixel);
+    }
+  }
+  return bytes;
+}
+
+void CheckScale(ScaleFilter filter, size_t factor, PixelFormat format) {
+  const size_t bytes_per_pixel = BytesPerPixel(format);
+  std::mt19937 random(static_cast<uint32_t>(factor * 3 +
+                                            static_cast<size_t>(filter)));
+  Scaler scaler(filter, factor, format);
+  REQUIRE(scaler.OutputWidth() == kScreenWidth * factor);
+  REQUIRE(scaler.OutputHeight() == kScreenHeight * factor);
+  for (size_t round = 0; round < 3; round++) {
+    const TestImage in = RandomScreen(format, &random);
+    // Both pitches leave room between lines, which must not be read from or
+    // written to.
+    const size_t in_pitch = kScreenWidth * bytes_per_pixel + 24;
+    const std::vector<uint8_t> in_bytes = Encode(in, format, in_pitch, 0x5A);
+    const Frame frame = {in_bytes.data(), in_pitch, 1, false, 0, 0};
+    const size_t out_pitch = scaler.OutputWidth() * bytes_per_pixel + 40;
+    std::vector<uint8_t> out(scaler.OutputHeight() * out_pitch, 0xA5);
+    scaler.Scale(frame, out.data(), out_pitch);
+
+    const std::vector<uint8_t> expected = Encode(
+        ReferenceScale(in, filter, factor, format), format, out_pitch, 0xA5);
+    for (size_t y = 0; y < scaler.OutputHeight(); y++) {
+      INFO("line " << y);
+      CHECK(std::memcmp(&out[y * out_pitch], &expected[y * out_pitch],
+                        out_pitch) == 0);
+    }
+  }
+}
+
+TEST_CASE("Nearest neighbor scaling repeats every pixel", "[scaler]") {
+  const PixelFormat format =
+      GENERATE(PixelFormat::kRgba8888, PixelFormat::kRgb565);
+  const size_t factor = GENERATE(range(kMinScaleFactor, kMaxScaleFactor + 1));
+  CheckScale(ScaleFilter::kNearest, factor, format);
+}
+
+TEST_CASE("Scale2x and Scale3x match the pixel-at-a-time rules",
+          "[scaler]") {
+  const PixelFormat format =
+      GENERATE(PixelFormat::kRgba8888, PixelFormat::kRgb565);
+  const size_t factor = GENERATE(size_t{2}, size_t{3}, size_t{4}, size_t{6});
+  CheckScale(ScaleFilter::kScale2x, factor, format);
+}
+
+TEST_CASE("Bilinear scaling blends a row and then a column at a time",
+          "[scaler]") {
+  const PixelFormat format =
+      GENERATE(PixelFormat::kRgba8888, PixelFormat::kRgb565);
+  const size_t factor = GENERATE(range(kMinScaleFactor, kMaxScaleFactor + 1));
+  CheckScale(ScaleFilter::kBilinear, factor, format);
+}
+
+}  // namespace
+}  // namespace gamebun
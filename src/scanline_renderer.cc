@@ -0,0 +1,429 @@
+#include "scanline_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "memory.h"
+#include "palette.h"
+#include "tile_cache.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr uint8_t kLcdcBackgroundEnable = 0x01;
+constexpr uint8_t kLcdcSpriteEnable = 0x02;
+constexpr uint8_t kLcdcTallSprites = 0x04;
+constexpr uint8_t kLcdcBackgroundTileMap = 0x08;
+constexpr uint8_t kLcdcUnsignedTileData = 0x10;
+constexpr uint8_t kLcdcWindowEnable = 0x20;
+constexpr uint8_t kLcdcWindowTileMap = 0x40;
+constexpr uint8_t kLcdcDisplayEnable = 0x80;
+
+// Sprite attribute bits. CGB background tile attributes, stored in the second
+// video RAM bank alongside the tile maps, share the same layout apart from the
+// DMG palette bit.
+constexpr uint8_t kAttributePriority = 0x80;
+constexpr uint8_t kAttributeFlipY = 0x40;
+constexpr uint8_t kAttributeFlipX = 0x20;
+constexpr uint8_t kAttributeDmgPalette = 0x10;
+constexpr uint8_t kAttributeBank = 0x08;
+constexpr uint8_t kAttributeColorPalette = 0x07;
+
+constexpr uint8_t kPaletteIndexAutoIncrement = 0x80;
+
+constexpr size_t kMaxSpritesPerLine = 10;
+constexpr size_t kSpriteCount = kOamSize.value() / 4;
+
+constexpr size_t kTileMapLow = 0x1800;
+constexpr size_t kTileMapHigh = 0x1C00;
+constexpr size_t kTileMapWidth = 32;
+
+// Palette entry indices select a palette in their upper bits and a color index
+// in their lower two bits. Sprite pixels in the sprite line buffer set
+// kSpriteOpaque so that color index 0 of OBP0 is distinguishable from no
+// sprite at all, and background pixels of CGB tiles that take priority over
+// sprites set kBackgroundPriority.
+constexpr uint8_t kObjectPalette0Entries = 4;
+constexpr uint8_t kObjectPalette1Entries = 8;
+constexpr uint8_t kColorObjectEntries = 32;
+constexpr uint8_t kPaletteEntryMask = 0x3F;
+constexpr uint8_t kSpriteOpaque = 0x40;
+constexpr uint8_t kSpriteBehindBackground = 0x80;
+constexpr uint8_t kBackgroundPriority = 0x80;
+
+}  // namespace
+
+ScanlineRenderer::ScanlineRenderer(const uint8_t* video_ram, const uint8_t* oam,
+                                   const VideoOptions& options, Arena* arena)
+    : video_ram_(video_ram),
+      oam_(oam),
+      color_(options.color),
+      tile_cache_(video_ram, options.color ? kVideoRamBankCount : 1, arena),
+      palette_table_(options.pixel_format, options.color_correction),
+      sprite_lines_(),
+      sprite_y_(),
+      window_line_(0),
+      lcdc_(0x91),
+      scy_(0),
+      scx_(0),
+      wy_(0),
+      wx_(0),
+      video_ram_bank_(0),
+      background_palette_index_(0),
+      object_palette_index_(0),
+      background_palette_ram_(),
+      object_palette_ram_() {
+  if (color_) {
+    // Palette RAM starts out white.
+    background_palette_ram_.fill(0xFF);
+    object_palette_ram_.fill(0xFF);
+    for (size_t entry = 0; entry < kPaletteEntryCount; entry++) {
+      palette_table_.SetColor(entry, 0x7FFF);
+    }
+  } else {
+    palette_table_.SetDmgPalette(0, 0xFC);
+    palette_table_.SetDmgPalette(1, 0xFF);
+    palette_table_.SetDmgPalette(2, 0xFF);
+  }
+}
+
+void ScanlineRenderer::Write(Address address, uint8_t value) {
+  if (0x8000 <= address.value() && address.value() < 0xA000) {
+    tile_cache_.Invalidate(video_ram_bank_ * kVideoRamSize.value() +
+                           address.value() - 0x8000);
+    return;
+  } else if (0xFE00 <= address.value() && address.value() < 0xFEA0) {
+    const size_t offset = address.value() - 0xFE00;
+    if (offset % 4 == 0) {
+      const size_t sprite = offset / 4;
+      UpdateSpriteLines(sprite, /*present=*/false);
+      sprite_y_[sprite] = value;
+      UpdateSpriteLines(sprite, /*present=*/true);
+    }
+    return;
+  }
+
+  switch (address.value()) {
+    case 0xFF40:
+      // The window restarts from its first line whenever the LCD is
+      // switched off.
+      if (!(value & kLcdcDisplayEnable)) {
+        window_line_ = 0;
+      }
+      if ((lcdc_ ^ value) & kLcdcTallSprites) {
+        for (size_t sprite = 0; sprite < kSpriteCount; sprite++) {
+          UpdateSpriteLines(sprite, /*present=*/false);
+        }
+        lcdc_ = value;
+        for (size_t sprite = 0; sprite < kSpriteCount; sprite++) {
+          UpdateSpriteLines(sprite, /*present=*/true);
+        }
+      }
+      lcdc_ = value;
+      break;
+    case 0xFF42:
+      scy_ = value;
+      break;
+    case 0xFF43:
+      scx_ = value;
+      break;
+    case 0xFF47:
+    case 0xFF48:
+    case 0xFF49:
+      if (!color_) {
+        palette_table_.SetDmgPalette(address.value() - 0xFF47, value);
+      }
+      break;
+    case 0xFF4A:
+      wy_ = value;
+      break;
+    case 0xFF4B:
+      wx_ = value;
+      break;
+    case 0xFF4F:
+      if (color_) {
+        video_ram_bank_ = value & 0x1;
+      }
+      break;
+    case 0xFF68:
+      background_palette_index_ = value;
+      break;
+    case 0xFF69:
+      if (color_) {
+        WritePaletteRam(&background_palette_ram_, &background_palette_index_,
+                        0, value);
+      }
+      break;
+    case 0xFF6A:
+      object_palette_index_ = value;
+      break;
+    case 0xFF6B:
+      if (color_) {
+        WritePaletteRam(&object_palette_ram_, &object_palette_index_,
+                        kColorObjectEntries, value);
+      }
+      break;
+  }
+}
+
+void ScanlineRenderer::StartFrame() { window_line_ = 0; }
+
+void ScanlineRenderer::SkipScanline(uint8_t ly) {
+  if (DrawsWindow(color_, lcdc_, wy_, wx_, ly)) {
+    window_line_++;
+  }
+}
+
+void ScanlineRenderer::Reload(uint8_t window_line) {
+  tile_cache_.InvalidateAll();
+  sprite_lines_.fill(0);
+  for (size_t sprite = 0; sprite < kSpriteCount; sprite++) {
+    sprite_y_[sprite] = oam_[sprite * 4];
+    UpdateSpriteLines(sprite, /*present=*/true);
+  }
+  window_line_ = window_line;
+}
+
+bool ScanlineRenderer::DrawsWindow(bool color, uint8_t lcdc, uint8_t wy,
+                                   uint8_t wx, uint8_t ly) {
+  const bool background_enabled = color || (lcdc & kLcdcBackgroundEnable);
+  return background_enabled && (lcdc & kLcdcWindowEnable) && ly >= wy &&
+         wx <= kScreenWidth + 6;
+}
+
+void ScanlineRenderer::UpdateSpriteLines(size_t sprite, bool present) {
+  // Sprite Y coordinates are offset by 16, so sprites can start off screen.
+  const size_t height = (lcdc_ & kLcdcTallSprites) ? 16 : 8;
+  const size_t bottom = sprite_y_[sprite] + height;
+  const size_t first = sprite_y_[sprite] > 16 ? sprite_y_[sprite] - 16 : 0;
+  const size_t last = std::min(bottom > 16 ? bottom - 16 : 0, kScreenHeight);
+  const uint64_t bit = uint64_t{1} << sprite;
+  for (size_t line = first; line < last; line++) {
+    if (present) {
+      sprite_lines_[line] |= bit;
+    } else {
+      sprite_lines_[line] &= ~bit;
+    }
+  }
+}
+
+void ScanlineRenderer::WritePaletteRam(
+    std::array<uint8_t, kColorPaletteRamSize>* ram, uint8_t* index,
+    size_t first_entry, uint8_t value) {
+  const size_t offset = *index & (kColorPaletteRamSize - 1);
+  (*ram)[offset] = value;
+  const size_t color = offset / 2;
+  palette_table_.SetColor(
+      first_entry + color,
+      static_cast<uint16_t>((*ram)[color * 2] | ((*ram)[color * 2 + 1] << 8)));
+  if (*index & kPaletteIndexAutoIncrement) {
+    *index = static_cast<uint8_t>(kPaletteIndexAutoIncrement |
+                                  ((*index + 1) & (kColorPaletteRamSize - 1)));
+  }
+}
+
+void ScanlineRenderer::RenderScanline(uint8_t ly, uint8_t* out) {
+  alignas(32) std::array<uint8_t, kScreenWidth> background;
+  alignas(32) std::array<uint8_t, kScreenWidth> line;
+
+  if (BackgroundEnabled()) {
+    RenderBackground(ly, background.data());
+    if (WindowVisible(ly)) {
+      RenderWindow(background.data());
+    }
+  } else {
+    background.fill(0);
+  }
+
+  if (lcdc_ & kLcdcSpriteEnable) {
+    RenderSprites(ly, background.data(), line.data());
+  } else {
+    for (size_t x = 0; x < kScreenWidth; x++) {
+      line[x] = background[x] & kPaletteEntryMask;
+    }
+  }
+
+  palette_table_.ConvertLine(line.data(), kScreenWidth, out);
+}
+
+void ScanlineRenderer::RenderBackground(uint8_t ly, uint8_t* line) {
+  constexpr size_t kTileCount = kScreenWidth / 8 + 1;
+
+  const uint8_t y = static_cast<uint8_t>(scy_ + ly);
+  const size_t map_row =
+      ((lcdc_ & kLcdcBackgroundTileMap) ? kTileMapHigh : kTileMapLow) +
+      (y / 8) * kTileMapWidth;
+  const size_t first_tile = scx_ / 8;
+
+  alignas(32) std::array<uint64_t, kTileCount> pixels;
+  for (size_t i = 0; i < kTileCount; i++) {
+    pixels[i] =
+        BackgroundRow(map_row + ((first_tile + i) % kTileMapWidth), y % 8);
+  }
+
+  std::memcpy(line, reinterpret_cast<const uint8_t*>(pixels.data()) + scx_ % 8,
+              kScreenWidth);
+}
+
+void ScanlineRenderer::RenderWindow(uint8_t* line) {
+  // The window's left edge is at WX - 7 and may start partly off screen.
+  const size_t skip = wx_ < 7 ? 7 - wx_ : 0;
+  const size_t start = wx_ < 7 ? 0 : wx_ - 7;
+  const size_t width = kScreenWidth - start + skip;
+  const size_t tile_count = (width + 7) / 8;
+
+  const size_t map_row =
+      ((lcdc_ & kLcdcWindowTileMap) ? kTileMapHigh : kTileMapLow) +
+      (window_line_ / 8) * kTileMapWidth;
+
+  alignas(32) std::array<uint64_t, kScreenWidth / 8 + 1> pixels;
+  for (size_t i = 0; i < tile_count; i++) {
+    pixels[i] = BackgroundRow(map_row + i, window_line_ % 8);
+  }
+
+  std::memcpy(&line[start],
+              reinterpret_cast<const uint8_t*>(pixels.data()) + skip,
+              kScreenWidth - start);
+  window_line_++;
+}
+
+void ScanlineRenderer::RenderSprites(uint8_t ly, const uint8_t* background,
+                                     uint8_t* line) {
+  const int height = (lcdc_ & kLcdcTallSprites) ? 16 : 8;
+
+  // Only the first 10 sprites in OAM order that overlap the line are drawn.
+  // Lowest set bits come first, so this walks the line's sprites in OAM
+  // order.
+  std::array<uint8_t, kMaxSpritesPerLine> selected;
+  size_t selected_count = 0;
+  for (uint64_t candidates = sprite_lines_[ly];
+       candidates != 0 && selected_count < kMaxSpritesPerLine;
+       candidates &= candidates - 1) {
+    selected[selected_count++] =
+        static_cast<uint8_t>(__builtin_ctzll(candidates));
+  }
+
+  // On DMG the sprite with the lower X coordinate wins, with ties going to
+  // the earlier OAM entry. On CGB the earlier OAM entry always wins. Drawing
+  // in reverse priority order lets the winner overwrite everything beneath
+  // it.
+  if (!color_) {
+    std::stable_sort(selected.begin(), selected.begin() + selected_count,
+                     [this](uint8_t a, uint8_t b) {
+                       return oam_[a * 4 + 1] < oam_[b * 4 + 1];
+                     });
+  }
+
+  alignas(32) std::array<uint8_t, kScreenWidth + 16> sprites{};
+  for (size_t i = selected_count; i-- > 0;) {
+    const uint8_t* sprite = &oam_[selected[i] * 4];
+    const uint8_t attributes = sprite[3];
+    if (sprite[1] >= kScreenWidth + 8) {
+      continue;
+    }
+
+    int row = ly + 16 - sprite[0];
+    if (attributes & kAttributeFlipY) {
+      row = height - 1 - row;
+    }
+    size_t tile = sprite[2];
+    if (height == 16) {
+      tile &= 0xFE;
+    }
+    uint8_t first_entry;
+    if (color_) {
+      if (attributes & kAttributeBank) {
+        tile += kTilesPerBank;
+      }
+      first_entry = static_cast<uint8_t>(
+          kColorObjectEntries + (attributes & kAttributeColorPalette) * 4);
+    } else {
+      first_entry = (attributes & kAttributeDmgPalette)
+                        ? kObjectPalette1Entries
+                        : kObjectPalette0Entries;
+    }
+    // The bottom half of a tall sprite is the next tile.
+    const uint64_t decoded =
+        tile_cache_.Row(tile + static_cast<size_t>(row) / 8,
+                        static_cast<size_t>(row) % 8,
+                        attributes & kAttributeFlipX);
+    std::array<uint8_t, 8> pixels;
+    std::memcpy(pixels.data(), &decoded, sizeof(decoded));
+
+    const uint8_t flags = static_cast<uint8_t>(
+        kSpriteOpaque | first_entry |
+        ((attributes & kAttributePriority) ? kSpriteBehindBackground : 0));
+    // The sprite buffer is offset by 8 so sprites hanging off the left edge
+    // need no clipping.
+    uint8_t* dest = &sprites[sprite[1]];
+    for (size_t x = 0; x < 8; x++) {
+      if (pixels[x] != 0) {
+        dest[x] = flags | pixels[x];
+      }
+    }
+  }
+
+  // Clearing LCDC bit 0 on CGB makes sprites cover the background regardless
+  // of either's priority bits.
+  const bool background_priority =
+      !color_ || (lcdc_ & kLcdcBackgroundEnable);
+  for (size_t x = 0; x < kScreenWidth; x++) {
+    const uint8_t sprite = sprites[x + 8];
+    const bool background_wins =
+        background_priority && (background[x] & 0x3) != 0 &&
+        ((sprite & kSpriteBehindBackground) ||
+         (background[x] & kBackgroundPriority));
+    const bool visible = (sprite & kSpriteOpaque) && !background_wins;
+    line[x] = (visible ? sprite : background[x]) & kPaletteEntryMask;
+  }
+}
+
+uint64_t ScanlineRenderer::BackgroundRow(size_t map_offset, size_t row) {
+  const uint8_t tile = video_ram_[map_offset];
+  if (!color_) {
+    return tile_cache_.Row(BackgroundTileIndex(tile), row, /*flip_x=*/false);
+  }
+
+  const uint8_t attributes = video_ram_[kVideoRamSize.value() + map_offset];
+  size_t index = BackgroundTileIndex(tile);
+  if (attributes & kAttributeBank) {
+    index += kTilesPerBank;
+  }
+  if (attributes & kAttributeFlipY) {
+    row = 7 - row;
+  }
+  uint64_t pixels = tile_cache_.Row(index, row, attributes & kAttributeFlipX);
+  // Adding the palette's first entry to every byte cannot carry, as color
+  // indices are at most 3.
+  pixels += static_cast<uint64_t>(attributes & kAttributeColorPalette) * 4 *
+            0x0101010101010101;
+  if (attributes & kAttributePriority) {
+    pixels |= uint64_t{kBackgroundPriority} * 0x0101010101010101;
+  }
+  return pixels;
+}
+
+// On CGB, LCDC bit 0 only affects sprite priority, and the background is
+// always drawn.
+bool ScanlineRenderer::BackgroundEnabled() const {
+  return color_ || (lcdc_ & kLcdcBackgroundEnable);
+}
+
+bool ScanlineRenderer::WindowVisible(uint8_t ly) const {
+  return (lcdc_ & kLcdcWindowEnable) && ly >= wy_ && wx_ <= kScreenWidth + 6;
+}
+
+// Background and window tiles either index the 256 tiles from 0x8000, or
+// index the tiles around 0x9000 as a signed offset.
+size_t ScanlineRenderer::BackgroundTileIndex(uint8_t tile) const {
+  if (lcdc_ & kLcdcUnsignedTileData) {
+    return tile;
+  }
+  return static_cast<size_t>(256 + static_cast<int8_t>(tile));
+}
+
+}  // namespace gamebun
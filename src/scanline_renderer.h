@@ -0,0 +1,130 @@
+#ifndef SCANLINE_RENDERER_H_
+#define SCANLINE_RENDERER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "memory.h"
+#include "palette.h"
+#include "tile_cache.h"
+#include "util/byte_size.h"
+
+namespace gamebun {
+
+class Arena;
+
+inline constexpr size_t kScreenWidth = 160;
+inline constexpr size_t kScreenHeight = 144;
+
+inline constexpr util::ByteSize kVideoRamSize = 8 * util::kKilobytes;
+inline constexpr size_t kVideoRamBankCount = 2;
+inline constexpr util::ByteSize kOamSize = 160 * util::kBytes;
+inline constexpr size_t kColorPaletteRamSize = 64;
+
+// Settings fixed for the lifetime of a PPU.
+struct VideoOptions {
+  // Renders as a CGB, with two video RAM banks, background attributes and
+  // color palettes. Otherwise the CGB registers are ignored.
+  bool color = false;
+  PixelFormat pixel_format = PixelFormat::kRgba8888;
+  // Bakes an approximation of the CGB LCD's response into the 15-bit color
+  // conversion.
+  bool color_correction = false;
+};
+
+// Produces scanlines from video RAM, sprite attribute memory and the LCD
+// registers that affect the picture. It holds no timing state, so the same
+// renderer can be driven either in step with the CPU or from a log of writes
+// replayed on another thread.
+class ScanlineRenderer {
+ public:
+  // `video_ram` (kVideoRamBankCount consecutive banks in color mode, one
+  // otherwise) and `oam` are owned by the caller and must outlive the
+  // renderer. The tile cache is kept in
+  // `arena`.
+  ScanlineRenderer(const uint8_t* video_ram, const uint8_t* oam,
+                   const VideoOptions& options, Arena* arena);
+
+  // Observes a write to video RAM or sprite attribute memory, which must
+  // already have been stored in the caller's arrays, or sets one of LCDC,
+  // SCY, SCX, BGP, OBP0, OBP1, WY or WX. In color mode it also tracks VBK,
+  // which selects the bank later video RAM writes went to, and the palette
+  // RAM written through BCPS/BCPD and OCPS/OCPD. Writes to other addresses
+  // are ignored.
+  void Write(Address address, uint8_t value);
+
+  // Resets the per-frame state before line 0 is rendered.
+  void StartFrame();
+
+  // Renders line `ly` as kScreenWidth host pixels into `out`. Lines must be
+  // rendered in increasing order within a frame.
+  void RenderScanline(uint8_t ly, uint8_t* out);
+
+  // Advances the per-frame state past line `ly` without rendering it, for
+  // lines known to be unchanged since the previous frame.
+  void SkipScanline(uint8_t ly);
+
+  // Catches up with video RAM and sprite attribute memory after they were
+  // replaced wholesale, and resumes the current frame from line
+  // `window_line` of the window. The registers must be written again
+  // afterwards.
+  void Reload(uint8_t window_line);
+
+  // Returns whether rendering line `ly` with these register values draws a
+  // line of the window, which moves the window on to its next line.
+  static bool DrawsWindow(bool color, uint8_t lcdc, uint8_t wy, uint8_t wx,
+                          uint8_t ly);
+
+  ScanlineRenderer(const ScanlineRenderer&) = delete;
+  ScanlineRenderer& operator=(const ScanlineRenderer&) = delete;
+
+ private:
+  // Adds or removes `sprite` from the lines its current Y coordinate and
+  // height make it overlap.
+  void UpdateSpriteLines(size_t sprite, bool present);
+  // Stores `value` at the palette RAM index selected by `*index`, advancing
+  // the index if its auto-increment bit is set.
+  void WritePaletteRam(std::array<uint8_t, kColorPaletteRamSize>* ram,
+                       uint8_t* index, size_t first_entry, uint8_t value);
+
+  void RenderBackground(uint8_t ly, uint8_t* line);
+  void RenderWindow(uint8_t* line);
+  bool BackgroundEnabled() const;
+  bool WindowVisible(uint8_t ly) const;
+  void RenderSprites(uint8_t ly, const uint8_t* background, uint8_t* line);
+  // Returns the palette entries of `row` of the tile at `map_offset` in a
+  // tile map, applying its CGB attributes.
+  uint64_t BackgroundRow(size_t map_offset, size_t row);
+  size_t BackgroundTileIndex(uint8_t tile) const;
+
+  const uint8_t* video_ram_;
+  const uint8_t* oam_;
+  const bool color_;
+  TileCache tile_cache_;
+  PaletteTable palette_table_;
+
+  // Bit i of sprite_lines_[ly] is set if sprite i overlaps line ly. These are
+  // updated as sprite Y coordinates are written, rather than scanning all of
+  // OAM on every line.
+  std::array<uint64_t, kScreenHeight> sprite_lines_;
+  std::array<uint8_t, kOamSize.value() / 4> sprite_y_;
+
+  uint8_t window_line_;
+
+  uint8_t lcdc_;
+  uint8_t scy_;
+  uint8_t scx_;
+  uint8_t wy_;
+  uint8_t wx_;
+
+  uint8_t video_ram_bank_;
+  uint8_t background_palette_index_;
+  uint8_t object_palette_index_;
+  std::array<uint8_t, kColorPaletteRamSize> background_palette_ram_;
+  std::array<uint8_t, kColorPaletteRamSize> object_palette_ram_;
+};
+
+}  // namespace gamebun
+
+#endif  // SCANLINE_RENDERER_H_
@@ -0,0 +1,209 @@
+#include "scanline_renderer.h"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "arena.h"
+#include "memory.h"
+#include "palette.h"
+
+namespace gamebun {
+namespace {
+
+constexpr size_t kLineBytes = kScreenWidth * 4;
+
+// A DMG renderer over its own video RAM and OAM, which start out zeroed, so
+// the background is color 0 of tile 0 everywhere and no sprite is on screen.
+struct TestRenderer {
+  TestRenderer() : arena(1 << 20, false) {
+    video_ram.fill(0);
+    oam.fill(0);
+    renderer = std::make_unique<ScanlineRenderer>(
+        video_ram.data(), oam.data(), VideoOptions(), &arena);
+    renderer->Write(Address(0xFF47), 0xE4);
+    renderer->Write(Address(0xFF48), 0xE4);
+  }
+
+  void Write(uint16_t address, uint8_t value) {
+    if (0x8000 <= address && address < 0xA000) {
+      video_ram[address - 0x8000] = value;
+    } else if (0xFE00 <= address && address < 0xFEA0) {
+      oam[address - 0xFE00] = value;
+    }
+    renderer->Write(Address(address), value);
+  }
+
+  // Fills every row of `tile` with color `color`.
+  void FillTile(size_t tile, uint8_t color) {
+    for (size_t i = 0; i < 16; i += 2) {
+      const uint16_t address = static_cast<uint16_t>(0x8000 + tile * 16 + i);
+      Write(address, (color & 1) ? 0xFF : 0x00);
+      Write(address + 1, (color & 2) ? 0xFF : 0x00);
+    }
+  }
+
+  void RenderFrame() {
+    renderer->StartFrame();
+    for (size_t ly = 0; ly < kScreenHeight; ly++) {
+      renderer->RenderScanline(static_cast<uint8_t>(ly),
+                               frame[ly].data());
+    }
+  }
+
+  // The pixel at `x` on line `ly` of the last frame.
+  uint32_t Pixel(size_t ly, size_t x) const {
+    uint32_t pixel;
+    std::memcpy(&pixel, &frame[ly][x * 4], sizeof(pixel));
+    return pixel;
+  }
+
+  Arena arena;
+  std::array<uint8_t, kVideoRamSize.value()> video_ram;
+  std::array<uint8_t, kOamSize.value()> oam;
+  std::unique_ptr<ScanlineRenderer> renderer;
+  std::array<std::array<uint8_t, kLineBytes>, kScreenHeight> frame;
+};
+
+// The host pixel of color `color` of OBP0 when it is 0xE4.
+uint32_t SpritePixel(uint8_t color) {
+  PaletteTable table(PixelFormat::kRgba8888, false);
+  table.SetDmgPalette(1, 0xE4);
+  const uint8_t entry = static_cast<uint8_t>(4 + color);
+  uint32_t pixel;
+  table.ConvertLine(&entry, 1, reinterpret_cast<uint8_t*>(&pixel));
+  return pixel;
+}
+
+TEST_CASE("Tall sprites draw both of their tiles", "[scanline_renderer]") {
+  TestRenderer test;
+  test.FillTile(2, 1);
+  test.FillTile(3, 3);
+  // Sprite 0 at the top left corner, naming the bottom tile, which tall
+  // sprites ignore the low bit of.
+  test.Write(0xFE00, 16);
+  test.Write(0xFE01, 8);
+  test.Write(0xFE02, 3);
+  test.Write(0xFE03, 0);
+  // LCD, background and tall sprites on, with unsigned tile data.
+  test.Write(0xFF40, 0x97);
+  test.RenderFrame();
+
+  const uint32_t background = test.Pixel(0, 100);
+  for (size_t ly = 0; ly < 16; ly++) {
+    INFO("line " << ly);
+    CHECK(test.Pixel(ly, 0) == SpritePixel(ly < 8 ? 1 : 3));
+    CHECK(test.Pixel(ly, 7) == SpritePixel(ly < 8 ? 1 : 3));
+    CHECK(test.Pixel(ly, 8) == background);
+  }
+  CHECK(test.Pixel(16, 0) == background);
+
+  SECTION("and notice when the bottom tile changes") {
+    test.FillTile(3, 2);
+    test.RenderFrame();
+    CHECK(test.Pixel(7, 0) == SpritePixel(1));
+    CHECK(test.Pixel(8, 0) == SpritePixel(2));
+    CHECK(test.Pixel(15, 0) == SpritePixel(2));
+  }
+  SECTION("flipped vertically") {
+    test.Write(0xFE03, 0x40);
+    test.RenderFrame();
+    CHECK(test.Pixel(0, 0) == SpritePixel(3));
+    CHECK(test.Pixel(7, 0) == SpritePixel(3));
+    CHECK(test.Pixel(8, 0) == SpritePixel(1));
+    CHECK(test.Pixel(15, 0) == SpritePixel(1));
+  }
+}
+
+// Checks that of the lines of the last frame, just those from `first` up to
+// `last` show a sprite of color 3 at `x`.
+void CheckSpriteLines(const TestRenderer& test, size_t x, size_t first,
+                      size_t last) {
+  for (size_t ly = 0; ly < kScreenHeight; ly++) {
+    INFO("line " << ly);
+    CHECK((test.Pixel(ly, x) == SpritePixel(3)) == (first <= ly && ly < last));
+  }
+}
+
+TEST_CASE("Sprites follow writes to their Y coordinates and to LCDC",
+          "[scanline_renderer]") {
+  TestRenderer test;
+  test.FillTile(2, 3);
+  test.FillTile(3, 3);
+  test.Write(0xFE00, 16 + 10);
+  test.Write(0xFE01, 8 + 20);
+  test.Write(0xFE02, 2);
+  // LCD, background and sprites on, with unsigned tile data.
+  test.Write(0xFF40, 0x93);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 10, 18);
+
+  test.Write(0xFE00, 16 + 100);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 100, 108);
+  // Tall sprites.
+  test.Write(0xFF40, 0x97);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 100, 116);
+  // Cut off by the bottom of the screen, and then by the top.
+  test.Write(0xFE00, 16 + 140);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 140, kScreenHeight);
+  test.Write(0xFE00, 4);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 0, 4);
+  // Short sprites again, which end above the screen from there.
+  test.Write(0xFF40, 0x93);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 0, 0);
+  test.Write(0xFE00, 0);
+  test.Write(0xFF40, 0x97);
+  test.RenderFrame();
+  CheckSpriteLines(test, 20, 0, 0);
+
+  SECTION("after sprite attribute memory is replaced") {
+    test.oam[0] = 16 + 30;
+    test.renderer->Reload(0);
+    test.RenderFrame();
+    CheckSpriteLines(test, 20, 30, 46);
+  }
+}
+
+TEST_CASE("Lines draw the first ten sprites on them in OAM order",
+          "[scanline_renderer]") {
+  TestRenderer test;
+  test.FillTile(2, 3);
+  for (size_t sprite = 0; sprite < 11; sprite++) {
+    const uint16_t address = static_cast<uint16_t>(0xFE00 + sprite * 4);
+    test.Write(address, 16 + 50);
+    test.Write(address + 1, static_cast<uint8_t>(8 + sprite * 10));
+    test.Write(address + 2, 2);
+  }
+  test.Write(0xFF40, 0x93);
+  test.RenderFrame();
+  CheckSpriteLines(test, 0, 50, 58);
+  CheckSpriteLines(test, 90, 50, 58);
+  CheckSpriteLines(test, 100, 0, 0);
+
+  // Moving the first sprite off the line lets the eleventh in.
+  test.Write(0xFE00, 16 + 70);
+  test.RenderFrame();
+  CheckSpriteLines(test, 0, 70, 78);
+  CheckSpriteLines(test, 100, 50, 58);
+
+  // And moving it back pushes the eleventh out again.
+  test.Write(0xFE00, 16 + 54);
+  test.RenderFrame();
+  CheckSpriteLines(test, 0, 54, 62);
+  for (size_t ly = 50; ly < 58; ly++) {
+    INFO("line " << ly);
+    CHECK((test.Pixel(ly, 100) == SpritePixel(3)) == (ly < 54));
+  }
+}
+
+}  // namespace
+}  // namespace gamebun
@@ -0,0 +1,189 @@
+#include "serial.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "interrupts.h"
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr uint16_t kData = 0xFF01;
+constexpr uint16_t kControl = 0xFF02;
+
+constexpr uint8_t kTransferStart = 0x80;
+constexpr uint8_t kInternalClock = 0x01;
+// The bits of SC in between are unused and read back as set.
+constexpr uint8_t kControlReadMask = 0x7E;
+
+// Eight bits at 8192 Hz.
+constexpr uint64_t kTransferCycles = 8 * 512;
+// How often the link is checked for messages during a transfer, and
+// otherwise, where only clocks from the other end need to be answered.
+constexpr uint64_t kTransferPollCycles = 512;
+constexpr uint64_t kIdlePollCycles = kTransferCycles;
+constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+constexpr uint8_t kDisconnected = 0xFF;
+
+}  // namespace
+
+Serial::Serial(Interrupts* interrupts)
+    : interrupts_(*interrupts),
+      link_(nullptr),
+      data_(0),
+      control_(0),
+      state_(State::kIdle),
+      time_(0),
+      next_poll_(kNever),
+      transfer_end_(0),
+      awaiting_reply_(false),
+      replied_(false),
+      reply_(0),
+      clocked_(false),
+      clock_end_(0),
+      clock_byte_(0) {}
+
+void Serial::Connect(SerialLink* link) {
+  link_ = link;
+  awaiting_reply_ = false;
+  replied_ = false;
+  clocked_ = false;
+  if (state_ == State::kDriving && link_ != nullptr) {
+    link_->SendClock(transfer_end_, data_);
+    awaiting_reply_ = true;
+  }
+  Poll();
+}
+
+uint8_t Serial::Read(Address address) const {
+  switch (address.value()) {
+    case kData:
+      return data_;
+    case kControl:
+      return control_ | kControlReadMask;
+    default:
+      FATAL("Unexpected serial read address %x", address.value());
+  }
+}
+
+void Serial::Write(Address address, uint8_t value) {
+  switch (address.value()) {
+    case kData:
+      // Transfers are exchanged whole, so the byte being shifted out on this
+      // side's clock was sent when the transfer started, and writes are
+      // dropped until it ends. A listening port has sent nothing yet.
+      if (state_ != State::kDriving) {
+        data_ = value;
+      }
+      return;
+    case kControl:
+      break;
+    default:
+      FATAL("Unexpected serial write address %x", address.value());
+  }
+
+  control_ = value & (kTransferStart | kInternalClock);
+  const State previous = state_;
+  if ((control_ & kTransferStart) == 0) {
+    state_ = State::kIdle;
+  } else if ((control_ & kInternalClock) == 0) {
+    state_ = State::kListening;
+  } else {
+    state_ = State::kDriving;
+  }
+  if (state_ == State::kDriving && previous != State::kDriving) {
+    transfer_end_ = time_ + kTransferCycles;
+    replied_ = false;
+    // A reply still owed for a cancelled transfer answers this one instead,
+    // since the link only carries one clock each way at a time.
+    if (link_ != nullptr && !awaiting_reply_) {
+      link_->SendClock(transfer_end_, data_);
+      awaiting_reply_ = true;
+    }
+  }
+  Poll();
+}
+
+void Serial::SaveState(StateWriter* writer) const {
+  writer->Write(data_);
+  writer->Write(control_);
+  writer->Write(state_);
+  writer->Write(time_);
+  writer->Write(transfer_end_);
+  writer->Write(replied_);
+  writer->Write(reply_);
+}
+
+void Serial::LoadState(StateReader* reader) {
+  reader->Read(&data_);
+  reader->Read(&control_);
+  reader->Read(&state_);
+  reader->Read(&time_);
+  reader->Read(&transfer_end_);
+  reader->Read(&replied_);
+  reader->Read(&reply_);
+  // Clocks and replies belong to the cable, which starts over.
+  awaiting_reply_ = false;
+  clocked_ = false;
+  if (state_ == State::kDriving && link_ != nullptr && !replied_) {
+    link_->SendClock(transfer_end_, data_);
+    awaiting_reply_ = true;
+  }
+  Poll();
+}
+
+void Serial::Poll() {
+  if (link_ != nullptr) {
+    if (!clocked_) {
+      clocked_ = link_->ReceiveClock(&clock_end_, &clock_byte_);
+    }
+    if (clocked_ && state_ == State::kListening) {
+      clocked_ = false;
+      link_->SendReply(data_);
+      CompleteTransfer(clock_byte_);
+    } else if (clocked_ && time_ >= clock_end_) {
+      // This end did not wait for the transfer, so it shifted nothing in and
+      // its line stayed high.
+      clocked_ = false;
+      link_->SendReply(kDisconnected);
+    }
+
+    if (awaiting_reply_ && link_->ReceiveReply(&reply_)) {
+      awaiting_reply_ = false;
+      replied_ = state_ == State::kDriving;
+    }
+    if (state_ == State::kDriving && time_ >= transfer_end_ && replied_) {
+      CompleteTransfer(reply_);
+    }
+    next_poll_ = time_ + (state_ == State::kIdle ? kIdlePollCycles
+                                                 : kTransferPollCycles);
+    if (state_ == State::kDriving && time_ < transfer_end_) {
+      // A reply that is already in ends the transfer right on time.
+      next_poll_ = std::min(next_poll_, transfer_end_);
+    }
+  } else if (state_ == State::kDriving) {
+    if (time_ >= transfer_end_) {
+      CompleteTransfer(kDisconnected);
+      next_poll_ = kNever;
+    } else {
+      next_poll_ = transfer_end_;
+    }
+  } else {
+    next_poll_ = kNever;
+  }
+}
+
+void Serial::CompleteTransfer(uint8_t received) {
+  data_ = received;
+  control_ &= ~kTransferStart;
+  state_ = State::kIdle;
+  interrupts_.Request(Interrupt::kSerial);
+}
+
+}  // namespace gamebun
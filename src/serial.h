@@ -0,0 +1,124 @@
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "memory.h"
+
+namespace gamebun {
+
+class Interrupts;
+class StateReader;
+class StateWriter;
+
+// One end of a link cable. A transfer is exchanged as a single message
+// each way: the side driving the clock sends the byte it shifts out along
+// with the cycle its transfer ends on, and the other side replies with the
+// byte it shifts out in return. Both sides count cycles from power-on. All
+// calls return immediately.
+class SerialLink {
+ public:
+  virtual ~SerialLink() {}
+
+  // Sends the byte shifted out by a transfer on this side's clock.
+  virtual void SendClock(uint64_t time, uint8_t byte) = 0;
+  // Receives a byte clocked in by the other side, if one has arrived.
+  virtual bool ReceiveClock(uint64_t* time, uint8_t* byte) = 0;
+
+  // Answers a received clock with the byte shifted out in return.
+  virtual void SendReply(uint8_t byte) = 0;
+  // Receives the answer to the last SendClock(), if it has arrived.
+  virtual bool ReceiveReply(uint8_t* byte) = 0;
+};
+
+// The serial port at SB (0xFF01) and SC (0xFF02), which shifts a byte out
+// while shifting one in, either on its own 8192 Hz clock or on the clock of
+// the other end of the link cable.
+//
+// Transfers are exchanged whole instead of bit by bit, so the two ends only
+// synchronize at transfer boundaries. A transfer on the internal clock ends
+// once both its 4096 cycles are up and the other end's reply has arrived,
+// and the other end replies as soon as it is waiting for a transfer on the
+// external clock, or with 0xFF once it reaches the end of the transfer
+// without having waited for it. Without a cable, transfers on the internal
+// clock shift in 0xFF and those on the external clock never end.
+//
+// The two ends do not hold each other back, so over a cable, emulation is
+// only deterministic as far as the host's timing is. Which of the two
+// replies the listening end gives depends on how far it has run when the
+// clock arrives. A transfer on the internal clock ends on its last cycle if
+// the reply came in by then, and otherwise on a later one that depends on
+// when the reply arrived. Movies and saved states replay exactly only
+// without a cable.
+//
+// SB can be written while waiting for the other end's clock, but not while
+// shifting on the internal clock, whose byte was sent as the transfer
+// started.
+class Serial {
+ public:
+  explicit Serial(Interrupts* interrupts);
+
+  // Plugs in a link cable, which must outlive the port, or unplugs it if
+  // `link` is null.
+  void Connect(SerialLink* link);
+
+  void Tick(size_t cycles) {
+    time_ += cycles;
+    if (time_ >= next_poll_) {
+      Poll();
+    }
+  }
+
+  uint8_t Read(Address address) const;
+  void Write(Address address, uint8_t value);
+
+  // The link cable and whatever is in flight on it are not part of the
+  // state. A transfer that was waiting on the other end when the state was
+  // saved waits on whatever cable is plugged in when it is loaded.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  Serial(const Serial&) = delete;
+  Serial& operator=(const Serial&) = delete;
+
+ private:
+  enum class State {
+    kIdle,
+    // Shifting on the internal clock.
+    kDriving,
+    // Waiting for the other end to clock a transfer.
+    kListening,
+  };
+
+  // Checks the link for messages, ends the current transfer once it is
+  // complete, and schedules the next poll.
+  void Poll();
+  void CompleteTransfer(uint8_t received);
+
+  Interrupts& interrupts_;
+  SerialLink* link_;
+
+  uint8_t data_;
+  uint8_t control_;
+  State state_;
+
+  // Cycles since power-on.
+  uint64_t time_;
+  uint64_t next_poll_;
+  // Cycle the current transfer on the internal clock ends on.
+  uint64_t transfer_end_;
+  // Whether a clock was sent over the link whose reply has yet to arrive,
+  // and the reply once it has.
+  bool awaiting_reply_;
+  bool replied_;
+  uint8_t reply_;
+  // A clock received from the other end and not yet answered.
+  bool clocked_;
+  uint64_t clock_end_;
+  uint8_t clock_byte_;
+};
+
+}  // namespace gamebun
+
+#endif  // SERIAL_H_
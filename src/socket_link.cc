@@ -0,0 +1,181 @@
+#include "socket_link.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr uint8_t kClockMessage = 'C';
+constexpr uint8_t kReplyMessage = 'R';
+
+// What a disconnected end shifts out.
+constexpr uint8_t kDisconnected = 0xFF;
+
+sockaddr_un SocketAddress(const char* path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (std::strlen(path) >= sizeof(address.sun_path)) {
+    FATAL("Socket path %s is too long", path);
+  }
+  std::strcpy(address.sun_path, path);
+  return address;
+}
+
+int CreateSocket() {
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    FATAL("Unable to create a socket: %s", std::strerror(errno));
+  }
+  return fd;
+}
+
+}  // namespace
+
+std::unique_ptr<SocketLink> SocketLink::Listen(const char* path) {
+  const sockaddr_un address = SocketAddress(path);
+  const int listener = CreateSocket();
+  unlink(path);
+  if (bind(listener, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listener, 1) != 0) {
+    FATAL("Unable to listen on %s: %s", path, std::strerror(errno));
+  }
+  INFO("Waiting for the other end of the link on %s", path);
+  const int fd = accept(listener, nullptr, nullptr);
+  if (fd < 0) {
+    FATAL("Unable to accept a link on %s: %s", path, std::strerror(errno));
+  }
+  close(listener);
+  unlink(path);
+  return std::unique_ptr<SocketLink>(new SocketLink(fd));
+}
+
+std::unique_ptr<SocketLink> SocketLink::Connect(const char* path) {
+  const sockaddr_un address = SocketAddress(path);
+  const int fd = CreateSocket();
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    FATAL("Unable to connect to %s: %s", path, std::strerror(errno));
+  }
+  return std::unique_ptr<SocketLink>(new SocketLink(fd));
+}
+
+SocketLink::SocketLink(int fd)
+    : fd_(fd),
+      closed_(false),
+      message_(),
+      message_size_(0),
+      clocked_(false),
+      clock_time_(0),
+      clock_byte_(0),
+      replied_(false),
+      reply_(0) {}
+
+SocketLink::~SocketLink() { close(fd_); }
+
+void SocketLink::SendClock(uint64_t time, uint8_t byte) {
+  Send(kClockMessage, byte, time);
+}
+
+bool SocketLink::ReceiveClock(uint64_t* time, uint8_t* byte) {
+  Receive();
+  if (!clocked_) {
+    return false;
+  }
+  clocked_ = false;
+  *time = clock_time_;
+  *byte = clock_byte_;
+  return true;
+}
+
+void SocketLink::SendReply(uint8_t byte) { Send(kReplyMessage, byte, 0); }
+
+bool SocketLink::ReceiveReply(uint8_t* byte) {
+  Receive();
+  if (replied_) {
+    replied_ = false;
+    *byte = reply_;
+    return true;
+  } else if (closed_) {
+    *byte = kDisconnected;
+    return true;
+  }
+  return false;
+}
+
+void SocketLink::Send(uint8_t type, uint8_t byte, uint64_t time) {
+  if (closed_) {
+    return;
+  }
+  std::array<uint8_t, kMessageSize> message;
+  message[0] = type;
+  message[1] = byte;
+  for (size_t i = 0; i < sizeof(time); i++) {
+    message[2 + i] = static_cast<uint8_t>(time >> (8 * i));
+  }
+  size_t sent = 0;
+  while (sent < message.size()) {
+    const ssize_t result =
+        send(fd_, &message[sent], message.size() - sent, MSG_NOSIGNAL);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    } else if (result <= 0) {
+      WARNING("Link disconnected: %s", std::strerror(errno));
+      closed_ = true;
+      return;
+    }
+    sent += static_cast<size_t>(result);
+  }
+}
+
+void SocketLink::Receive() {
+  while (!closed_) {
+    const ssize_t result = recv(fd_, &message_[message_size_],
+                                message_.size() - message_size_, MSG_DONTWAIT);
+    if (result < 0 && errno == EAGAIN) {
+      return;
+    } else if (result < 0 && errno == EINTR) {
+      continue;
+    } else if (result <= 0) {
+      WARNING("Link disconnected");
+      closed_ = true;
+      return;
+    }
+    message_size_ += static_cast<size_t>(result);
+    if (message_size_ < message_.size()) {
+      continue;
+    }
+    message_size_ = 0;
+
+    uint64_t time = 0;
+    for (size_t i = 0; i < sizeof(time); i++) {
+      time |= uint64_t{message_[2 + i]} << (8 * i);
+    }
+    switch (message_[0]) {
+      case kClockMessage:
+        clocked_ = true;
+        clock_time_ = time;
+        clock_byte_ = message_[1];
+        break;
+      case kReplyMessage:
+        replied_ = true;
+        reply_ = message_[1];
+        break;
+      default:
+        FATAL("Unexpected link message type %x", message_[0]);
+    }
+  }
+}
+
+}  // namespace gamebun
@@ -0,0 +1,59 @@
+#ifndef SOCKET_LINK_H_
+#define SOCKET_LINK_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "serial.h"
+
+namespace gamebun {
+
+// A link cable to an emulator in another process over a Unix domain socket.
+// Messages are read without waiting whenever the serial port polls for
+// them. If the other process goes away, the cable behaves as if unplugged
+// at the other end.
+class SocketLink final : public SerialLink {
+ public:
+  // Creates a socket at `path` and waits for the other end to connect.
+  static std::unique_ptr<SocketLink> Listen(const char* path);
+  // Connects to a socket created by Listen().
+  static std::unique_ptr<SocketLink> Connect(const char* path);
+
+  ~SocketLink() override;
+
+  void SendClock(uint64_t time, uint8_t byte) override;
+  bool ReceiveClock(uint64_t* time, uint8_t* byte) override;
+  void SendReply(uint8_t byte) override;
+  bool ReceiveReply(uint8_t* byte) override;
+
+  SocketLink(const SocketLink&) = delete;
+  SocketLink& operator=(const SocketLink&) = delete;
+
+ private:
+  // A message type, the byte shifted out, and for clocks the end of the
+  // transfer in little-endian order.
+  static constexpr size_t kMessageSize = 10;
+
+  explicit SocketLink(int fd);
+
+  void Send(uint8_t type, uint8_t byte, uint64_t time);
+  // Reads every complete message that has arrived.
+  void Receive();
+
+  const int fd_;
+  bool closed_;
+  std::array<uint8_t, kMessageSize> message_;
+  size_t message_size_;
+
+  bool clocked_;
+  uint64_t clock_time_;
+  uint8_t clock_byte_;
+  bool replied_;
+  uint8_t reply_;
+};
+
+}  // namespace gamebun
+
+#endif  // SOCKET_LINK_H_
@@ -0,0 +1,518 @@
+#include "sound_channels.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "state.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// Waveforms above half the output sample rate would only alias, so timers
+// faster than these play the waveform's average level instead of stepping it.
+// A pulse repeats every 8 steps and a wave every 32, and 4194304 Hz divided
+// by (8 * 22) or (32 * 6) is above 21 kHz.
+constexpr uint32_t kMinAudiblePulsePeriod = 22;
+constexpr uint32_t kMinAudibleWavePeriod = 6;
+
+constexpr std::array<uint8_t, 4> kDutyPatterns = {0x01, 0x81, 0x87, 0x7E};
+
+// Bits set in each register that always read back as 1.
+constexpr std::array<uint8_t, kChannelRegisterCount> kPulseReadMasks = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF};
+constexpr std::array<uint8_t, kChannelRegisterCount> kWaveReadMasks = {
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF};
+constexpr std::array<uint8_t, kChannelRegisterCount> kNoiseReadMasks = {
+    0xFF, 0xFF, 0x00, 0x00, 0xBF};
+
+constexpr uint8_t kTrigger = 0x80;
+constexpr uint8_t kLengthEnable = 0x40;
+
+constexpr uint16_t kMaxFrequency = 2047;
+
+}  // namespace
+
+void Envelope::Clock() {
+  const uint8_t period = register_ & 0x07;
+  if (period == 0 || --timer_ > 0) {
+    return;
+  }
+  timer_ = period;
+  if ((register_ & 0x08) != 0) {
+    if (volume_ < 15) {
+      volume_++;
+    }
+  } else if (volume_ > 0) {
+    volume_--;
+  }
+}
+
+void SoundChannel::ClockLength(uint32_t time, StereoMixer* mixer) {
+  if (length_.Clock()) {
+    Disable(time, mixer);
+  }
+}
+
+void SoundChannel::SaveState(StateWriter* writer) const {
+  writer->Write(enabled_);
+  writer->Write(dac_enabled_);
+  length_.SaveState(writer);
+  writer->Write(next_step_);
+}
+
+void SoundChannel::LoadState(StateReader* reader) {
+  reader->Read(&enabled_);
+  reader->Read(&dac_enabled_);
+  length_.LoadState(reader);
+  reader->Read(&next_step_);
+}
+
+PulseChannel::PulseChannel(size_t index, bool has_sweep)
+    : SoundChannel(index, 64),
+      has_sweep_(has_sweep),
+      sweep_register_(0),
+      duty_(0),
+      frequency_(0),
+      envelope_(),
+      duty_position_(0),
+      sweep_enabled_(false),
+      shadow_frequency_(0),
+      sweep_timer_(0) {}
+
+uint8_t PulseChannel::Read(size_t reg) const {
+  switch (reg) {
+    case 0:
+      return has_sweep_ ? (sweep_register_ | kPulseReadMasks[0]) : 0xFF;
+    case 1:
+      return static_cast<uint8_t>(duty_ << 6) | kPulseReadMasks[1];
+    case 2:
+      return envelope_.Register();
+    case 3:
+      return kPulseReadMasks[3];
+    case 4:
+      return (length_.enabled() ? kLengthEnable : 0) | kPulseReadMasks[4];
+    default:
+      FATAL("Unexpected pulse channel register %zu", reg);
+  }
+}
+
+void PulseChannel::Write(size_t reg, uint8_t value, uint32_t time,
+                         StereoMixer* mixer) {
+  switch (reg) {
+    case 0:
+      if (has_sweep_) {
+        sweep_register_ = value & 0x7F;
+      }
+      return;
+    case 1:
+      duty_ = value >> 6;
+      LoadLength(value);
+      break;
+    case 2:
+      envelope_.SetRegister(value);
+      dac_enabled_ = envelope_.DacEnabled();
+      if (!dac_enabled_) {
+        enabled_ = false;
+      }
+      break;
+    case 3:
+      frequency_ = (frequency_ & 0x0700) | value;
+      break;
+    case 4:
+      frequency_ =
+          static_cast<uint16_t>((frequency_ & 0x00FF) | ((value & 0x07) << 8));
+      length_.SetEnabled((value & kLengthEnable) != 0);
+      if ((value & kTrigger) != 0) {
+        Trigger(time, mixer);
+      }
+      break;
+    default:
+      FATAL("Unexpected pulse channel register %zu", reg);
+  }
+  Output(time, mixer, Level());
+}
+
+void PulseChannel::Reset(uint32_t time, StereoMixer* mixer) {
+  // The length counter is the one thing powering off leaves alone.
+  for (size_t reg = 0; reg < kChannelRegisterCount; reg++) {
+    if (reg != 1) {
+      Write(reg, 0, time, mixer);
+    }
+  }
+  duty_ = 0;
+  enabled_ = false;
+  duty_position_ = 0;
+  Output(time, mixer, Level());
+}
+
+void PulseChannel::Trigger(uint32_t time, StereoMixer* mixer) {
+  enabled_ = dac_enabled_;
+  length_.Trigger();
+  envelope_.Trigger();
+  next_step_ = time + Period();
+
+  if (has_sweep_) {
+    const uint8_t period = (sweep_register_ >> 4) & 0x07;
+    const uint8_t shift = sweep_register_ & 0x07;
+    shadow_frequency_ = frequency_;
+    sweep_timer_ = period != 0 ? period : 8;
+    sweep_enabled_ = period != 0 || shift != 0;
+    if (shift != 0 && NextSweepFrequency() > kMaxFrequency) {
+      Disable(time, mixer);
+    }
+  }
+}
+
+void PulseChannel::SaveState(StateWriter* writer) const {
+  SoundChannel::SaveState(writer);
+  writer->Write(sweep_register_);
+  writer->Write(duty_);
+  writer->Write(frequency_);
+  envelope_.SaveState(writer);
+  writer->Write(duty_position_);
+  writer->Write(sweep_enabled_);
+  writer->Write(shadow_frequency_);
+  writer->Write(sweep_timer_);
+}
+
+void PulseChannel::LoadState(StateReader* reader) {
+  SoundChannel::LoadState(reader);
+  reader->Read(&sweep_register_);
+  reader->Read(&duty_);
+  reader->Read(&frequency_);
+  envelope_.LoadState(reader);
+  reader->Read(&duty_position_);
+  reader->Read(&sweep_enabled_);
+  reader->Read(&shadow_frequency_);
+  reader->Read(&sweep_timer_);
+}
+
+uint16_t PulseChannel::NextSweepFrequency() const {
+  const uint16_t change = shadow_frequency_ >> (sweep_register_ & 0x07);
+  if ((sweep_register_ & 0x08) != 0) {
+    return shadow_frequency_ - change;
+  }
+  return shadow_frequency_ + change;
+}
+
+int PulseChannel::Level() const {
+  if (!enabled_) {
+    return DacLevel(0);
+  }
+  const uint8_t pattern = kDutyPatterns[duty_];
+  if (Period() < kMinAudiblePulsePeriod) {
+    return DacLevel(envelope_.volume() * __builtin_popcount(pattern) / 8);
+  }
+  return DacLevel((pattern >> duty_position_) & 1 ? envelope_.volume() : 0);
+}
+
+void PulseChannel::Run(uint32_t until, StereoMixer* mixer) {
+  if (!enabled_) {
+    return;
+  }
+  const uint32_t period = Period();
+  const uint32_t steps = StepsUntil(until, period);
+  if (period < kMinAudiblePulsePeriod) {
+    duty_position_ = (duty_position_ + steps) & 0x07;
+    next_step_ += steps * period;
+    return;
+  }
+  for (uint32_t i = 0; i < steps; i++) {
+    duty_position_ = (duty_position_ + 1) & 0x07;
+    Output(next_step_, mixer, Level());
+    next_step_ += period;
+  }
+}
+
+void PulseChannel::ClockSweep(uint32_t time, StereoMixer* mixer) {
+  if (!has_sweep_ || --sweep_timer_ > 0) {
+    return;
+  }
+  const uint8_t period = (sweep_register_ >> 4) & 0x07;
+  sweep_timer_ = period != 0 ? period : 8;
+  if (!enabled_ || !sweep_enabled_ || period == 0) {
+    return;
+  }
+
+  const uint16_t frequency = NextSweepFrequency();
+  if (frequency > kMaxFrequency) {
+    Disable(time, mixer);
+    return;
+  }
+  if ((sweep_register_ & 0x07) != 0) {
+    shadow_frequency_ = frequency;
+    frequency_ = frequency;
+    // The new frequency is checked again, without being applied.
+    if (NextSweepFrequency() > kMaxFrequency) {
+      Disable(time, mixer);
+      return;
+    }
+    Output(time, mixer, Level());
+  }
+}
+
+void PulseChannel::ClockEnvelope(uint32_t time, StereoMixer* mixer) {
+  if (enabled_) {
+    envelope_.Clock();
+    Output(time, mixer, Level());
+  }
+}
+
+WaveChannel::WaveChannel(size_t index)
+    : SoundChannel(index, 256),
+      volume_code_(0),
+      frequency_(0),
+      ram_(),
+      position_(0) {}
+
+uint8_t WaveChannel::Read(size_t reg) const {
+  switch (reg) {
+    case 0:
+      return (dac_enabled_ ? 0x80 : 0) | kWaveReadMasks[0];
+    case 1:
+    case 3:
+      return kWaveReadMasks[reg];
+    case 2:
+      return static_cast<uint8_t>(volume_code_ << 5) | kWaveReadMasks[2];
+    case 4:
+      return (length_.enabled() ? kLengthEnable : 0) | kWaveReadMasks[4];
+    default:
+      FATAL("Unexpected wave channel register %zu", reg);
+  }
+}
+
+void WaveChannel::Write(size_t reg, uint8_t value, uint32_t time,
+                        StereoMixer* mixer) {
+  switch (reg) {
+    case 0:
+      dac_enabled_ = (value & 0x80) != 0;
+      if (!dac_enabled_) {
+        enabled_ = false;
+      }
+      break;
+    case 1:
+      LoadLength(value);
+      break;
+    case 2:
+      volume_code_ = (value >> 5) & 0x03;
+      break;
+    case 3:
+      frequency_ = (frequency_ & 0x0700) | value;
+      break;
+    case 4:
+      frequency_ =
+          static_cast<uint16_t>((frequency_ & 0x00FF) | ((value & 0x07) << 8));
+      length_.SetEnabled((value & kLengthEnable) != 0);
+      if ((value & kTrigger) != 0) {
+        enabled_ = dac_enabled_;
+        length_.Trigger();
+        position_ = 0;
+        next_step_ = time + Period();
+      }
+      break;
+    default:
+      FATAL("Unexpected wave channel register %zu", reg);
+  }
+  Output(time, mixer, Level());
+}
+
+void WaveChannel::Reset(uint32_t time, StereoMixer* mixer) {
+  // The length counter is the one thing powering off leaves alone.
+  for (size_t reg = 0; reg < kChannelRegisterCount; reg++) {
+    if (reg != 1) {
+      Write(reg, 0, time, mixer);
+    }
+  }
+  enabled_ = false;
+  position_ = 0;
+  Output(time, mixer, Level());
+}
+
+void WaveChannel::WriteRam(size_t index, uint8_t value, uint32_t time,
+                           StereoMixer* mixer) {
+  ram_[index] = value;
+  Output(time, mixer, Level());
+}
+
+void WaveChannel::SaveState(StateWriter* writer) const {
+  SoundChannel::SaveState(writer);
+  writer->Write(volume_code_);
+  writer->Write(frequency_);
+  writer->Write(ram_);
+  writer->Write(position_);
+}
+
+void WaveChannel::LoadState(StateReader* reader) {
+  SoundChannel::LoadState(reader);
+  reader->Read(&volume_code_);
+  reader->Read(&frequency_);
+  reader->Read(&ram_);
+  reader->Read(&position_);
+}
+
+uint8_t WaveChannel::Sample(size_t position) const {
+  const uint8_t byte = ram_[position / 2];
+  return position % 2 == 0 ? byte >> 4 : byte & 0x0F;
+}
+
+int WaveChannel::Level() const {
+  if (!enabled_ || volume_code_ == 0) {
+    return DacLevel(0);
+  }
+  const int shift = volume_code_ - 1;
+  if (Period() < kMinAudibleWavePeriod) {
+    int sum = 0;
+    for (size_t position = 0; position < 2 * kWaveRamSize; position++) {
+      sum += Sample(position);
+    }
+    return DacLevel((sum / static_cast<int>(2 * kWaveRamSize)) >> shift);
+  }
+  return DacLevel(Sample(position_) >> shift);
+}
+
+void WaveChannel::Run(uint32_t until, StereoMixer* mixer) {
+  if (!enabled_) {
+    return;
+  }
+  const uint32_t period = Period();
+  const uint32_t steps = StepsUntil(until, period);
+  if (period < kMinAudibleWavePeriod) {
+    position_ = (position_ + steps) % (2 * kWaveRamSize);
+    next_step_ += steps * period;
+    return;
+  }
+  for (uint32_t i = 0; i < steps; i++) {
+    position_ = (position_ + 1) % (2 * kWaveRamSize);
+    Output(next_step_, mixer, Level());
+    next_step_ += period;
+  }
+}
+
+NoiseChannel::NoiseChannel(size_t index)
+    : SoundChannel(index, 64), envelope_(), polynomial_(0), lfsr_(0x7FFF) {}
+
+uint8_t NoiseChannel::Read(size_t reg) const {
+  switch (reg) {
+    case 0:
+    case 1:
+      return kNoiseReadMasks[reg];
+    case 2:
+      return envelope_.Register();
+    case 3:
+      return polynomial_;
+    case 4:
+      return (length_.enabled() ? kLengthEnable : 0) | kNoiseReadMasks[4];
+    default:
+      FATAL("Unexpected noise channel register %zu", reg);
+  }
+}
+
+void NoiseChannel::Write(size_t reg, uint8_t value, uint32_t time,
+                         StereoMixer* mixer) {
+  switch (reg) {
+    case 0:
+      return;
+    case 1:
+      LoadLength(value);
+      break;
+    case 2:
+      envelope_.SetRegister(value);
+      dac_enabled_ = envelope_.DacEnabled();
+      if (!dac_enabled_) {
+        enabled_ = false;
+      }
+      break;
+    case 3:
+      // A running timer takes the new period from its next step, while a
+      // stopped one starts over.
+      if (!Clocked()) {
+        polynomial_ = value;
+        next_step_ = time + Period();
+      }
+      polynomial_ = value;
+      break;
+    case 4:
+      length_.SetEnabled((value & kLengthEnable) != 0);
+      if ((value & kTrigger) != 0) {
+        enabled_ = dac_enabled_;
+        length_.Trigger();
+        envelope_.Trigger();
+        lfsr_ = 0x7FFF;
+        next_step_ = time + Period();
+      }
+      break;
+    default:
+      FATAL("Unexpected noise channel register %zu", reg);
+  }
+  Output(time, mixer, Level());
+}
+
+void NoiseChannel::Reset(uint32_t time, StereoMixer* mixer) {
+  // The length counter is the one thing powering off leaves alone.
+  for (size_t reg = 0; reg < kChannelRegisterCount; reg++) {
+    if (reg != 1) {
+      Write(reg, 0, time, mixer);
+    }
+  }
+  enabled_ = false;
+  Output(time, mixer, Level());
+}
+
+void NoiseChannel::SaveState(StateWriter* writer) const {
+  SoundChannel::SaveState(writer);
+  envelope_.SaveState(writer);
+  writer->Write(polynomial_);
+  writer->Write(lfsr_);
+}
+
+void NoiseChannel::LoadState(StateReader* reader) {
+  SoundChannel::LoadState(reader);
+  envelope_.LoadState(reader);
+  reader->Read(&polynomial_);
+  reader->Read(&lfsr_);
+}
+
+uint32_t NoiseChannel::Period() const {
+  const uint32_t divisor = polynomial_ & 0x07;
+  return (divisor == 0 ? 8 : divisor * 16) << (polynomial_ >> 4);
+}
+
+int NoiseChannel::Level() const {
+  if (!enabled_) {
+    return DacLevel(0);
+  }
+  return DacLevel((lfsr_ & 1) != 0 ? 0 : envelope_.volume());
+}
+
+void NoiseChannel::Run(uint32_t until, StereoMixer* mixer) {
+  if (!enabled_ || !Clocked()) {
+    return;
+  }
+  const uint32_t period = Period();
+  const uint32_t steps = StepsUntil(until, period);
+  const bool short_mode = (polynomial_ & 0x08) != 0;
+  for (uint32_t i = 0; i < steps; i++) {
+    const uint16_t feedback = (lfsr_ ^ (lfsr_ >> 1)) & 1;
+    const uint16_t output = lfsr_ & 1;
+    lfsr_ = static_cast<uint16_t>((lfsr_ >> 1) | (feedback << 14));
+    if (short_mode) {
+      lfsr_ = static_cast<uint16_t>((lfsr_ & ~0x40) | (feedback << 6));
+    }
+    if ((lfsr_ & 1) != output) {
+      Output(next_step_, mixer, Level());
+    }
+    next_step_ += period;
+  }
+}
+
+void NoiseChannel::ClockEnvelope(uint32_t time, StereoMixer* mixer) {
+  if (enabled_) {
+    envelope_.Clock();
+    Output(time, mixer, Level());
+  }
+}
+
+}  // namespace gamebun
@@ -0,0 +1,254 @@
+#ifndef SOUND_CHANNELS_H_
+#define SOUND_CHANNELS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "sound_mixer.h"
+#include "state.h"
+
+namespace gamebun {
+
+// Each channel is controlled through five registers, NRx0 to NRx4.
+inline constexpr size_t kChannelRegisterCount = 5;
+inline constexpr size_t kWaveRamSize = 16;
+
+// Silences a channel once it has played for a set number of 256 Hz steps.
+class LengthCounter {
+ public:
+  explicit LengthCounter(uint16_t max_length)
+      : max_length_(max_length), remaining_(0), enabled_(false) {}
+
+  void Load(uint16_t length) { remaining_ = max_length_ - length; }
+  uint16_t max_length() const { return max_length_; }
+  bool enabled() const { return enabled_; }
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  void Trigger() {
+    if (remaining_ == 0) {
+      remaining_ = max_length_;
+    }
+  }
+  // Returns whether the counter just ran out.
+  bool Clock() {
+    if (!enabled_ || remaining_ == 0) {
+      return false;
+    }
+    return --remaining_ == 0;
+  }
+
+  void SaveState(StateWriter* writer) const {
+    writer->Write(remaining_);
+    writer->Write(enabled_);
+  }
+  void LoadState(StateReader* reader) {
+    reader->Read(&remaining_);
+    reader->Read(&enabled_);
+  }
+
+ private:
+  const uint16_t max_length_;
+  uint16_t remaining_;
+  bool enabled_;
+};
+
+// Steps a channel's volume up or down at 64 Hz, as set by NRx2.
+class Envelope {
+ public:
+  Envelope() : register_(0), volume_(0), timer_(0) {}
+
+  uint8_t Register() const { return register_; }
+  void SetRegister(uint8_t value) { register_ = value; }
+  // A volume of 0 while decreasing switches the channel's DAC off.
+  bool DacEnabled() const { return (register_ & 0xF8) != 0; }
+  void Trigger() {
+    volume_ = register_ >> 4;
+    timer_ = register_ & 0x07;
+  }
+  void Clock();
+  uint8_t volume() const { return volume_; }
+
+  void SaveState(StateWriter* writer) const {
+    writer->Write(register_);
+    writer->Write(volume_);
+    writer->Write(timer_);
+  }
+  void LoadState(StateReader* reader) {
+    reader->Read(&register_);
+    reader->Read(&volume_);
+    reader->Read(&timer_);
+  }
+
+ private:
+  uint8_t register_;
+  uint8_t volume_;
+  uint8_t timer_;
+};
+
+// State shared by the four channels. A channel produces output from its
+// trigger until its length runs out or its DAC is switched off; in between,
+// the channel's timer steps its waveform every period. Run() synthesizes
+// every step up to a given cycle of the current batch, and each change of
+// level is passed to the mixer with the cycle it happened on. A null mixer
+// tracks only the state the CPU can read back, and Run() is not called.
+class SoundChannel {
+ public:
+  bool enabled() const { return enabled_; }
+
+  // Clocks the length counter, from the 256 Hz steps of the frame sequencer.
+  void ClockLength(uint32_t time, StereoMixer* mixer);
+  // Loads the length counter from the low bits of NRx1. Unlike the rest of
+  // the register, this also works while the APU is powered off.
+  void LoadLength(uint8_t value) {
+    length_.Load(value & (length_.max_length() - 1));
+  }
+  // Moves the timer back by `duration` cycles when a new batch starts.
+  void Rebase(uint32_t duration) {
+    next_step_ = next_step_ > duration ? next_step_ - duration : 0;
+  }
+
+  // Saves or restores the state common to all channels. Each channel adds
+  // its own after it.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+ protected:
+  SoundChannel(size_t index, uint16_t max_length)
+      : index_(index),
+        enabled_(false),
+        dac_enabled_(false),
+        length_(max_length),
+        next_step_(0) {}
+
+  // Converts an amplitude between 0 and 15 to a level between -15 and 15.
+  int DacLevel(int amplitude) const {
+    return dac_enabled_ ? 2 * amplitude - 15 : 0;
+  }
+  void Output(uint32_t time, StereoMixer* mixer, int level) {
+    if (mixer != nullptr) {
+      mixer->SetLevel(index_, time, level);
+    }
+  }
+  void Disable(uint32_t time, StereoMixer* mixer) {
+    enabled_ = false;
+    Output(time, mixer, DacLevel(0));
+  }
+  // Returns the number of timer steps in [next_step_, until).
+  uint32_t StepsUntil(uint32_t until, uint32_t period) const {
+    return next_step_ < until ? (until - 1 - next_step_) / period + 1 : 0;
+  }
+
+  const size_t index_;
+  bool enabled_;
+  bool dac_enabled_;
+  LengthCounter length_;
+  // Cycle of the current batch when the timer next steps the waveform.
+  uint32_t next_step_;
+};
+
+// Square waves with four duty cycles and a volume envelope. The first pulse
+// channel can also sweep its frequency up or down.
+class PulseChannel : public SoundChannel {
+ public:
+  PulseChannel(size_t index, bool has_sweep);
+
+  uint8_t Read(size_t reg) const;
+  void Write(size_t reg, uint8_t value, uint32_t time, StereoMixer* mixer);
+  void Reset(uint32_t time, StereoMixer* mixer);
+  // Passes the current level to `mixer`, which missed the changes since it
+  // was last passed to the channel.
+  void Refresh(uint32_t time, StereoMixer* mixer) {
+    Output(time, mixer, Level());
+  }
+
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  void Run(uint32_t until, StereoMixer* mixer);
+  void ClockSweep(uint32_t time, StereoMixer* mixer);
+  void ClockEnvelope(uint32_t time, StereoMixer* mixer);
+
+ private:
+  uint32_t Period() const { return (2048 - frequency_) * 4; }
+  int Level() const;
+  uint16_t NextSweepFrequency() const;
+  void Trigger(uint32_t time, StereoMixer* mixer);
+
+  const bool has_sweep_;
+  uint8_t sweep_register_;
+  uint8_t duty_;
+  uint16_t frequency_;
+  Envelope envelope_;
+  uint8_t duty_position_;
+
+  bool sweep_enabled_;
+  uint16_t shadow_frequency_;
+  uint8_t sweep_timer_;
+};
+
+// Plays back 32 4-bit samples from wave RAM at one of four volumes.
+class WaveChannel : public SoundChannel {
+ public:
+  explicit WaveChannel(size_t index);
+
+  uint8_t Read(size_t reg) const;
+  void Write(size_t reg, uint8_t value, uint32_t time, StereoMixer* mixer);
+  void Reset(uint32_t time, StereoMixer* mixer);
+  void Refresh(uint32_t time, StereoMixer* mixer) {
+    Output(time, mixer, Level());
+  }
+
+  uint8_t ReadRam(size_t index) const { return ram_[index]; }
+  void WriteRam(size_t index, uint8_t value, uint32_t time,
+                StereoMixer* mixer);
+
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  void Run(uint32_t until, StereoMixer* mixer);
+
+ private:
+  uint32_t Period() const { return (2048 - frequency_) * 2; }
+  int Level() const;
+  uint8_t Sample(size_t position) const;
+
+  uint8_t volume_code_;
+  uint16_t frequency_;
+  std::array<uint8_t, kWaveRamSize> ram_;
+  uint8_t position_;
+};
+
+// Pseudo-random noise from a 15-bit (or 7-bit) linear feedback shift
+// register, with a volume envelope.
+class NoiseChannel : public SoundChannel {
+ public:
+  explicit NoiseChannel(size_t index);
+
+  uint8_t Read(size_t reg) const;
+  void Write(size_t reg, uint8_t value, uint32_t time, StereoMixer* mixer);
+  void Reset(uint32_t time, StereoMixer* mixer);
+  void Refresh(uint32_t time, StereoMixer* mixer) {
+    Output(time, mixer, Level());
+  }
+
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  void Run(uint32_t until, StereoMixer* mixer);
+  void ClockEnvelope(uint32_t time, StereoMixer* mixer);
+
+ private:
+  // Whether the shift register is clocked at all. Clock shifts of 14 and 15
+  // stop it.
+  bool Clocked() const { return (polynomial_ >> 4) < 14; }
+  uint32_t Period() const;
+  int Level() const;
+
+  Envelope envelope_;
+  uint8_t polynomial_;
+  uint16_t lfsr_;
+};
+
+}  // namespace gamebun
+
+#endif  // SOUND_CHANNELS_H_
@@ -0,0 +1,82 @@
+#include "sound_mixer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "state.h"
+
+namespace gamebun {
+
+StereoMixer::StereoMixer(uint32_t sample_rate, size_t capacity,
+                         Arena* arena)
+    : levels_(),
+      left_gains_(),
+      right_gains_(),
+      left_outputs_(),
+      right_outputs_(),
+      left_(kSoundClockRate, sample_rate, capacity, arena),
+      right_(kSoundClockRate, sample_rate, capacity, arena) {}
+
+void StereoMixer::SetLevel(size_t channel, uint32_t time, int level) {
+  if (levels_[channel] != level) {
+    levels_[channel] = level;
+    Output(channel, time);
+  }
+}
+
+void StereoMixer::SetPanning(uint32_t time, uint8_t master_volume,
+                             uint8_t panning) {
+  // Each side's master volume scales its output by 1 to 8.
+  const int left_volume = ((master_volume >> 4) & 0x07) + 1;
+  const int right_volume = (master_volume & 0x07) + 1;
+  for (size_t channel = 0; channel < kSoundChannelCount; channel++) {
+    left_gains_[channel] = (panning >> (channel + 4)) & 1 ? left_volume : 0;
+    right_gains_[channel] = (panning >> channel) & 1 ? right_volume : 0;
+    Output(channel, time);
+  }
+}
+
+void StereoMixer::Output(size_t channel, uint32_t time) {
+  const int left = levels_[channel] * left_gains_[channel];
+  const int right = levels_[channel] * right_gains_[channel];
+  if (left != left_outputs_[channel]) {
+    left_.AddDelta(time, left - left_outputs_[channel]);
+    left_outputs_[channel] = left;
+  }
+  if (right != right_outputs_[channel]) {
+    right_.AddDelta(time, right - right_outputs_[channel]);
+    right_outputs_[channel] = right;
+  }
+}
+
+void StereoMixer::EndBatch(uint32_t duration) {
+  left_.EndBatch(duration);
+  right_.EndBatch(duration);
+}
+
+size_t StereoMixer::ReadSamples(int16_t* out, size_t count) {
+  left_.ReadSamples(out, count, 2);
+  return right_.ReadSamples(&out[1], count, 2);
+}
+
+void StereoMixer::SaveState(StateWriter* writer) const {
+  writer->Write(levels_);
+  writer->Write(left_gains_);
+  writer->Write(right_gains_);
+  writer->Write(left_outputs_);
+  writer->Write(right_outputs_);
+  left_.SaveState(writer);
+  right_.SaveState(writer);
+}
+
+void StereoMixer::LoadState(StateReader* reader) {
+  reader->Read(&levels_);
+  reader->Read(&left_gains_);
+  reader->Read(&right_gains_);
+  reader->Read(&left_outputs_);
+  reader->Read(&right_outputs_);
+  left_.LoadState(reader);
+  right_.LoadState(reader);
+}
+
+}  // namespace gamebun
@@ -0,0 +1,60 @@
+#ifndef SOUND_MIXER_H_
+#define SOUND_MIXER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "band_limited_buffer.h"
+
+namespace gamebun {
+
+class Arena;
+class StateReader;
+class StateWriter;
+
+inline constexpr uint32_t kSoundClockRate = 4194304;
+inline constexpr size_t kSoundChannelCount = 4;
+
+// Pans the levels of the four sound channels between the left and right
+// outputs as selected by NR50 and NR51, and resamples each output. Levels
+// are only passed on when they change.
+class StereoMixer {
+ public:
+  StereoMixer(uint32_t sample_rate, size_t capacity, Arena* arena);
+
+  // Sets the level of `channel`, between -15 and 15, from cycle `time` of the
+  // current batch.
+  void SetLevel(size_t channel, uint32_t time, int level);
+  // Applies new values of NR50 and NR51 from cycle `time`.
+  void SetPanning(uint32_t time, uint8_t master_volume, uint8_t panning);
+
+  void EndBatch(uint32_t duration);
+
+  size_t SamplesAvailable() const { return left_.SamplesAvailable(); }
+  // Reads up to `count` stereo samples, left channel first, and returns how
+  // many were read.
+  size_t ReadSamples(int16_t* out, size_t count);
+
+  // Between batches only.
+  void SaveState(StateWriter* writer) const;
+  void LoadState(StateReader* reader);
+
+  StereoMixer(const StereoMixer&) = delete;
+  StereoMixer& operator=(const StereoMixer&) = delete;
+
+ private:
+  void Output(size_t channel, uint32_t time);
+
+  std::array<int, kSoundChannelCount> levels_;
+  std::array<int, kSoundChannelCount> left_gains_;
+  std::array<int, kSoundChannelCount> right_gains_;
+  std::array<int, kSoundChannelCount> left_outputs_;
+  std::array<int, kSoundChannelCount> right_outputs_;
+  BandLimitedBuffer left_;
+  BandLimitedBuffer right_;
+};
+
+}  // namespace gamebun
+
+#endif  // SOUND_MIXER_H_
@@ -0,0 +1,133 @@
+#ifndef STATE_H_
+#define STATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace gamebun {
+
+// Writes the fields of an emulator's state one after another, in the host's
+// byte order, into a buffer owned by the caller. Nothing is allocated.
+// Writing past the end of the buffer is only detected once the state is
+// complete: the writer carries on counting, so the same code also measures
+// how much room a state needs.
+class StateWriter {
+ public:
+  // Writes to `data`, or only counts if it is null.
+  StateWriter(uint8_t* data, size_t capacity)
+      : data_(data), capacity_(capacity), size_(0) {}
+
+  template <typename T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "state fields are copied byte for byte");
+    WriteBytes(&value, sizeof(value));
+  }
+  void WriteBytes(const void* bytes, size_t size) {
+    if (data_ != nullptr && size_ <= capacity_ && size <= capacity_ - size_) {
+      std::memcpy(data_ + size_, bytes, size);
+    }
+    size_ += size;
+  }
+
+  // Starts a section of the state, prefixed with `id` and its length so
+  // that readers can check they consume exactly what was written. Returns
+  // what EndSection() needs.
+  size_t BeginSection(uint16_t id) {
+    Write(id);
+    const size_t start = size_;
+    Write(uint32_t{0});
+    return start;
+  }
+  void EndSection(size_t start) {
+    const uint32_t length =
+        static_cast<uint32_t>(size_ - start - sizeof(uint32_t));
+    if (data_ != nullptr && start + sizeof(length) <= capacity_) {
+      std::memcpy(data_ + start, &length, sizeof(length));
+    }
+  }
+
+  // Bytes written, or that would have been.
+  size_t size() const { return size_; }
+  bool overflowed() const { return size_ > capacity_; }
+
+  StateWriter(const StateWriter&) = delete;
+  StateWriter& operator=(const StateWriter&) = delete;
+
+ private:
+  uint8_t* const data_;
+  const size_t capacity_;
+  size_t size_;
+};
+
+// Reads back what a StateWriter wrote. Reading past the end fills the
+// fields with zeros and marks the reader as failed, so callers only check
+// once at the end.
+class StateReader {
+ public:
+  StateReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), position_(0), failed_(false) {}
+
+  template <typename T>
+  void Read(T* value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "state fields are copied byte for byte");
+    ReadBytes(value, sizeof(*value));
+  }
+  void ReadBytes(void* bytes, size_t size) {
+    if (size > size_ - position_) {
+      failed_ = true;
+      std::memset(bytes, 0, size);
+      return;
+    }
+    std::memcpy(bytes, data_ + position_, size);
+    position_ += size;
+  }
+  void Skip(size_t size) {
+    if (size > size_ - position_) {
+      failed_ = true;
+      return;
+    }
+    position_ += size;
+  }
+
+  // Enters the next section, which must be `id`, and sets `end` to where it
+  // ends. On a mismatch, the reader fails.
+  void BeginSection(uint16_t id, size_t* end) {
+    uint16_t actual_id;
+    uint32_t length;
+    Read(&actual_id);
+    Read(&length);
+    if (actual_id != id || length > remaining()) {
+      failed_ = true;
+      length = 0;
+    }
+    *end = position_ + length;
+  }
+  // Skips over the next section, which must be `id`.
+  void SkipSection(uint16_t id) {
+    size_t end;
+    BeginSection(id, &end);
+    position_ = end;
+  }
+  // Returns whether the section that ends at `end` was read exactly.
+  bool EndSection(size_t end) const { return !failed_ && position_ == end; }
+
+  size_t remaining() const { return size_ - position_; }
+  bool failed() const { return failed_; }
+
+  StateReader(const StateReader&) = delete;
+  StateReader& operator=(const StateReader&) = delete;
+
+ private:
+  const uint8_t* const data_;
+  const size_t size_;
+  size_t position_;
+  bool failed_;
+};
+
+}  // namespace gamebun
+
+#endif  // STATE_H_
@@ -0,0 +1,40 @@
+#ifndef TEST_UTIL_TEST_CARTRIDGE_H_
+#define TEST_UTIL_TEST_CARTRIDGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cartridge.h"
+#include "memory.h"
+
+namespace gamebun {
+
+// The image of a 32 KB MBC1 cartridge with 8 KB of RAM, with `program` at
+// the entry point and zeroes, which are NOPs, everywhere else.
+inline std::vector<uint8_t> MakeTestRom(const std::vector<uint8_t>& program) {
+  std::vector<uint8_t> rom(2 * kRomBankSize.value());
+  for (size_t i = 0; i < program.size(); i++) {
+    rom[0x100 + i] = program[i];
+  }
+  rom[0x147] = 0x01;
+  rom[0x148] = 0x00;
+  rom[0x149] = 0x02;
+  return rom;
+}
+
+// Loads the cartridge whose image is `rom`.
+inline Cartridge LoadTestCartridge(const std::vector<uint8_t>& rom) {
+  std::istringstream stream(std::string(rom.begin(), rom.end()));
+  return Cartridge(&stream);
+}
+
+inline Cartridge MakeTestCartridge(const std::vector<uint8_t>& program) {
+  return LoadTestCartridge(MakeTestRom(program));
+}
+
+}  // namespace gamebun
+
+#endif  // TEST_UTIL_TEST_CARTRIDGE_H_
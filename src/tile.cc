@@ -0,0 +1,100 @@
+#include "tile.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace gamebun {
+
+namespace internal {
+
+namespace {
+
+constexpr std::array<uint64_t, 256> MakeSpreadBits() {
+  std::array<uint64_t, 256> table{};
+  for (unsigned value = 0; value < table.size(); value++) {
+    for (unsigned bit = 0; bit < 8; bit++) {
+      if (value & (1 << bit)) {
+        table[value] |= uint64_t{1} << (bit * 8);
+      }
+    }
+  }
+  return table;
+}
+
+}  // namespace
+
+const std::array<uint64_t, 256> kSpreadBits = MakeSpreadBits();
+
+}  // namespace internal
+
+namespace {
+
+// Repeats a byte in all 8 bytes of a 64-bit word.
+inline int64_t BroadcastByte(uint8_t value) {
+  return static_cast<int64_t>(value * uint64_t{0x0101010101010101});
+}
+
+}  // namespace
+
+// The vector paths broadcast each bitplane byte across the 8 output bytes of
+// its row, then test byte i against bit 7 - i so the leftmost pixel lands in
+// the lowest byte.
+void DecodeTileRows(const uint8_t* planes, size_t count, uint8_t* out) {
+  size_t row = 0;
+#if defined(__AVX2__)
+  const __m256i bits_ymm = _mm256_setr_epi8(
+      -128, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, -128, 0x40, 0x20, 0x10,
+      0x08, 0x04, 0x02, 0x01, -128, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+      -128, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  const __m256i ones_ymm = _mm256_set1_epi8(1);
+  for (; row + 4 <= count; row += 4) {
+    const uint8_t* p = &planes[row * 2];
+    const __m256i lo =
+        _mm256_setr_epi64x(BroadcastByte(p[0]), BroadcastByte(p[2]),
+                           BroadcastByte(p[4]), BroadcastByte(p[6]));
+    const __m256i hi =
+        _mm256_setr_epi64x(BroadcastByte(p[1]), BroadcastByte(p[3]),
+                           BroadcastByte(p[5]), BroadcastByte(p[7]));
+    const __m256i lo_set =
+        _mm256_cmpeq_epi8(_mm256_and_si256(lo, bits_ymm), bits_ymm);
+    const __m256i hi_set =
+        _mm256_cmpeq_epi8(_mm256_and_si256(hi, bits_ymm), bits_ymm);
+    const __m256i pixels = _mm256_sub_epi8(
+        _mm256_and_si256(lo_set, ones_ymm), _mm256_add_epi8(hi_set, hi_set));
+    _mm256_storeu_si256(reinterpret_cast<__m256i_u*>(&out[row * 8]), pixels);
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i bits_xmm =
+      _mm_setr_epi8(-128, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, -128,
+                    0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  const __m128i ones_xmm = _mm_set1_epi8(1);
+  for (; row + 2 <= count; row += 2) {
+    const uint8_t* p = &planes[row * 2];
+    const __m128i lo =
+        _mm_set_epi64x(BroadcastByte(p[2]), BroadcastByte(p[0]));
+    const __m128i hi =
+        _mm_set_epi64x(BroadcastByte(p[3]), BroadcastByte(p[1]));
+    const __m128i lo_set =
+        _mm_cmpeq_epi8(_mm_and_si128(lo, bits_xmm), bits_xmm);
+    const __m128i hi_set =
+        _mm_cmpeq_epi8(_mm_and_si128(hi, bits_xmm), bits_xmm);
+    const __m128i pixels = _mm_sub_epi8(_mm_and_si128(lo_set, ones_xmm),
+                                        _mm_add_epi8(hi_set, hi_set));
+    _mm_storeu_si128(reinterpret_cast<__m128i_u*>(&out[row * 8]), pixels);
+  }
+#endif
+  for (; row < count; row++) {
+    const uint64_t pixels =
+        DecodeTileRow(planes[row * 2], planes[row * 2 + 1]);
+    std::memcpy(&out[row * 8], &pixels, sizeof(pixels));
+  }
+}
+
+}  // namespace gamebun
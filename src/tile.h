@@ -0,0 +1,48 @@
+#ifndef TILE_H_
+#define TILE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace gamebun {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "decoded tile rows are laid out for little-endian hosts");
+
+namespace internal {
+
+// kSpreadBits[b] has bit i of b moved to bit 0 of byte i.
+extern const std::array<uint64_t, 256> kSpreadBits;
+
+}  // namespace internal
+
+// Decodes one row of a 2bpp planar tile into 8 color indices (0-3), one per
+// byte, with the rightmost pixel in the lowest byte. Storing the result to
+// memory therefore yields the row mirrored horizontally.
+inline uint64_t DecodeTileRowFlipped(uint8_t lo, uint8_t hi) {
+#if defined(__BMI2__)
+  return _pdep_u64(lo, 0x0101010101010101) |
+         _pdep_u64(hi, 0x0202020202020202);
+#else
+  return internal::kSpreadBits[lo] | (internal::kSpreadBits[hi] << 1);
+#endif
+}
+
+// Decodes one row of a 2bpp planar tile into 8 color indices (0-3), one per
+// byte, with the leftmost pixel in the lowest byte.
+inline uint64_t DecodeTileRow(uint8_t lo, uint8_t hi) {
+  return __builtin_bswap64(DecodeTileRowFlipped(lo, hi));
+}
+
+// Decodes `count` tile rows, given as consecutive (lo, hi) bitplane pairs, into
+// 8 color indices each. `out` must have room for 8 * `count` bytes.
+void DecodeTileRows(const uint8_t* planes, size_t count, uint8_t* out);
+
+}  // namespace gamebun
+
+#endif  // TILE_H_
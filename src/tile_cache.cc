@@ -0,0 +1,33 @@
+#include "tile_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.h"
+#include "tile.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+TileCache::TileCache(const uint8_t* video_ram, size_t bank_count,
+                     Arena* arena)
+    : video_ram_(video_ram),
+      tiles_(arena->Allocate<DecodedTile>(bank_count * kTilesPerBank)) {
+  if (bank_count > 2) {
+    FATAL("Unsupported number of video RAM banks: %zu", bank_count);
+  }
+  stale_.set();
+}
+
+void TileCache::Decode(size_t tile) {
+  const size_t bank = tile / kTilesPerBank;
+  const uint8_t* data =
+      &video_ram_[bank * kBankSize + (tile % kTilesPerBank) * 16];
+
+  DecodedTile& decoded = tiles_[tile];
+  DecodeTileRows(data, decoded.rows.size(),
+                 reinterpret_cast<uint8_t*>(decoded.rows.data()));
+  stale_.reset(tile);
+}
+
+}  // namespace gamebun
@@ -0,0 +1,68 @@
+#ifndef TILE_CACHE_H_
+#define TILE_CACHE_H_
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace gamebun {
+
+class Arena;
+
+inline constexpr size_t kTilesPerBank = 384;
+inline constexpr size_t kTileDataSize = kTilesPerBank * 16;
+
+// Keeps every tile in video RAM decoded into 8x8 color indices, so that
+// rendering never has to touch the bitplanes. A tile is only decoded again
+// after one of its 16 bytes is written. Flipped rows are a byte swap away, so
+// only one orientation is kept, which halves the cache.
+class TileCache {
+ public:
+  // `video_ram` points at `bank_count` consecutive 8 KB banks, each starting
+  // with kTilesPerBank tiles. The decoded tiles are kept in `arena`.
+  TileCache(const uint8_t* video_ram, size_t bank_count, Arena* arena);
+
+  // Must be called after every write to video RAM, with the offset written.
+  void Invalidate(size_t video_ram_offset) {
+    const size_t bank = video_ram_offset / kBankSize;
+    const size_t offset = video_ram_offset % kBankSize;
+    if (offset < kTileDataSize) {
+      stale_.set(bank * kTilesPerBank + offset / 16);
+    }
+  }
+
+  void InvalidateAll() { stale_.set(); }
+
+  // Returns the 8 color indices of `row` (0 to 7) of `tile`, one per byte
+  // with the leftmost pixel in the lowest byte. `tile` counts from the start
+  // of video RAM, so tiles in bank 1 start at kTilesPerBank.
+  uint64_t Row(size_t tile, size_t row, bool flip_x) {
+    if (stale_[tile]) {
+      Decode(tile);
+    }
+    const uint64_t pixels = tiles_[tile].rows[row];
+    return flip_x ? __builtin_bswap64(pixels) : pixels;
+  }
+
+  TileCache(const TileCache&) = delete;
+  TileCache& operator=(const TileCache&) = delete;
+
+ private:
+  static constexpr size_t kBankSize = 0x2000;
+  static constexpr size_t kMaxTileCount = 2 * kTilesPerBank;
+
+  struct DecodedTile {
+    std::array<uint64_t, 8> rows;
+  };
+
+  void Decode(size_t tile);
+
+  const uint8_t* video_ram_;
+  DecodedTile* const tiles_;
+  std::bitset<kMaxTileCount> stale_;
+};
+
+}  // namespace gamebun
+
+#endif  // TILE_CACHE_H_
@@ -0,0 +1,65 @@
+#include "wav_writer.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "async_file_writer.h"
+
+namespace gamebun {
+
+namespace {
+
+constexpr size_t kHeaderSize = 44;
+constexpr uint16_t kChannels = 2;
+constexpr uint16_t kBitsPerSample = 16;
+constexpr uint16_t kBlockAlign = kChannels * kBitsPerSample / 8;
+
+// Offsets of the RIFF and data chunk lengths within the header.
+constexpr uint64_t kRiffSizeOffset = 4;
+constexpr uint64_t kDataSizeOffset = 40;
+
+void Put16(uint8_t* out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void Put32(uint8_t* out, uint32_t value) {
+  Put16(out, static_cast<uint16_t>(value));
+  Put16(&out[2], static_cast<uint16_t>(value >> 16));
+}
+
+}  // namespace
+
+WavWriter::WavWriter(const char* path, uint32_t sample_rate) : file_(path) {
+  std::array<uint8_t, kHeaderSize> header{};
+  std::memcpy(&header[0], "RIFF", 4);
+  std::memcpy(&header[8], "WAVE", 4);
+  std::memcpy(&header[12], "fmt ", 4);
+  Put32(&header[16], 16);
+  Put16(&header[20], 1);  // PCM
+  Put16(&header[22], kChannels);
+  Put32(&header[24], sample_rate);
+  Put32(&header[28], sample_rate * kBlockAlign);
+  Put16(&header[32], kBlockAlign);
+  Put16(&header[34], kBitsPerSample);
+  std::memcpy(&header[36], "data", 4);
+  file_.Append(header.data(), header.size());
+}
+
+WavWriter::~WavWriter() {
+  file_.Finish();
+  const uint32_t data_size = static_cast<uint32_t>(file_.size() - kHeaderSize);
+  std::array<uint8_t, 4> field;
+  Put32(field.data(), data_size + kHeaderSize - 8);
+  file_.WriteAt(kRiffSizeOffset, field.data(), field.size());
+  Put32(field.data(), data_size);
+  file_.WriteAt(kDataSizeOffset, field.data(), field.size());
+}
+
+void WavWriter::WriteSamples(const int16_t* samples, size_t count) {
+  file_.Append(samples, count * kBlockAlign);
+}
+
+}  // namespace gamebun
@@ -0,0 +1,30 @@
+#ifndef WAV_WRITER_H_
+#define WAV_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "async_file_writer.h"
+
+namespace gamebun {
+
+// Writes interleaved 16-bit stereo samples as a PCM WAV file. The header's
+// length fields are filled in when the writer is destroyed.
+class WavWriter {
+ public:
+  WavWriter(const char* path, uint32_t sample_rate);
+  ~WavWriter();
+
+  // Appends `count` stereo samples, left channel first.
+  void WriteSamples(const int16_t* samples, size_t count);
+
+  WavWriter(const WavWriter&) = delete;
+  WavWriter& operator=(const WavWriter&) = delete;
+
+ private:
+  AsyncFileWriter file_;
+};
+
+}  // namespace gamebun
+
+#endif  // WAV_WRITER_H_
@@ -0,0 +1,167 @@
+#include "y4m_writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "async_file_writer.h"
+#include "frame_buffers.h"
+#include "palette.h"
+#include "scanline_renderer.h"
+#include "util/logging.h"
+
+namespace gamebun {
+
+namespace {
+
+// The frame rate is the exact ratio of the 4 MiHz clock to the 70224 cycles
+// in a frame.
+constexpr char kHeader[] =
+    "YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 C444\n";
+constexpr char kFrameHeader[] = "FRAME\n";
+constexpr size_t kFrameHeaderSize = sizeof(kFrameHeader) - 1;
+constexpr size_t kPlaneSize = kScreenWidth * kScreenHeight;
+
+#if defined(__AVX2__)
+// Converts 16 pixels, given as one 16-bit lane per channel, with the same
+// arithmetic as the scalar loop in ConvertLine(). The intermediate sums fit
+// in 16 bits, treating the luma sum as unsigned.
+void ConvertPixels(__m256i r, __m256i g, __m256i b, uint8_t* y, uint8_t* cb,
+                   uint8_t* cr) {
+  const auto weigh = [r, g, b](int16_t r_weight, int16_t g_weight,
+                               int16_t b_weight) {
+    const __m256i rg =
+        _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(r_weight)),
+                         _mm256_mullo_epi16(g, _mm256_set1_epi16(g_weight)));
+    return _mm256_add_epi16(
+        rg, _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(b_weight)),
+                             _mm256_set1_epi16(128)));
+  };
+  // Packing to bytes works within 128-bit lanes, leaving the first 8 bytes
+  // in the first quarter and the last 8 in the third.
+  const auto store = [](uint8_t* out, __m256i values) {
+    const __m256i packed = _mm256_packus_epi16(values, values);
+    _mm_storeu_si128(reinterpret_cast<__m128i_u*>(out),
+                     _mm256_castsi256_si128(
+                         _mm256_permute4x64_epi64(packed, 0x08)));
+  };
+  store(y, _mm256_add_epi16(_mm256_srli_epi16(weigh(66, 129, 25), 8),
+                            _mm256_set1_epi16(16)));
+  store(cb, _mm256_add_epi16(_mm256_srai_epi16(weigh(-38, -74, 112), 8),
+                             _mm256_set1_epi16(128)));
+  store(cr, _mm256_add_epi16(_mm256_srai_epi16(weigh(112, -94, -18), 8),
+                             _mm256_set1_epi16(128)));
+}
+
+// Widens 5 or 6-bit channel values to 8 bits by repeating their top bits.
+__m256i Expand5(__m256i value) {
+  return _mm256_or_si256(_mm256_slli_epi16(value, 3),
+                         _mm256_srli_epi16(value, 2));
+}
+
+__m256i Expand6(__m256i value) {
+  return _mm256_or_si256(_mm256_slli_epi16(value, 2),
+                         _mm256_srli_epi16(value, 4));
+}
+#endif
+
+// Converts one line to BT.601 studio-swing Y'CbCr, the YUV4MPEG2 default.
+template <PixelFormat format>
+void ConvertLine(const uint8_t* pixels, uint8_t* y, uint8_t* cb, uint8_t* cr) {
+#if defined(__AVX2__)
+  static_assert(kScreenWidth % 16 == 0,
+                "lines are converted 16 pixels at a time");
+  for (size_t x = 0; x < kScreenWidth; x += 16) {
+    if constexpr (format == PixelFormat::kRgba8888) {
+      const __m256i first = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i_u*>(&pixels[x * 4]));
+      const __m256i second = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i_u*>(&pixels[x * 4 + 32]));
+      // Narrowing two registers of 32-bit pixels interleaves their 128-bit
+      // lanes, which the permute undoes.
+      const auto channel = [first, second](int shift) {
+        const __m256i mask = _mm256_set1_epi32(0xFF);
+        const __m256i packed = _mm256_packus_epi32(
+            _mm256_and_si256(_mm256_srli_epi32(first, shift), mask),
+            _mm256_and_si256(_mm256_srli_epi32(second, shift), mask));
+        return _mm256_permute4x64_epi64(packed, 0xD8);
+      };
+      ConvertPixels(channel(0), channel(8), channel(16), &y[x], &cb[x],
+                    &cr[x]);
+    } else {
+      const __m256i pixel = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i_u*>(&pixels[x * 2]));
+      const __m256i r5 = _mm256_srli_epi16(pixel, 11);
+      const __m256i g6 = _mm256_and_si256(_mm256_srli_epi16(pixel, 5),
+                                          _mm256_set1_epi16(0x3F));
+      const __m256i b5 = _mm256_and_si256(pixel, _mm256_set1_epi16(0x1F));
+      ConvertPixels(Expand5(r5), Expand6(g6), Expand5(b5), &y[x], &cb[x],
+                    &cr[x]);
+    }
+  }
+#else
+  for (size_t x = 0; x < kScreenWidth; x++) {
+    int r;
+    int g;
+    int b;
+    if constexpr (format == PixelFormat::kRgba8888) {
+      r = pixels[x * 4];
+      g = pixels[x * 4 + 1];
+      b = pixels[x * 4 + 2];
+    } else {
+      const int pixel = pixels[x * 2] | (pixels[x * 2 + 1] << 8);
+      const int r5 = pixel >> 11;
+      const int g6 = (pixel >> 5) & 0x3F;
+      const int b5 = pixel & 0x1F;
+      r = (r5 << 3) | (r5 >> 2);
+      g = (g6 << 2) | (g6 >> 4);
+      b = (b5 << 3) | (b5 >> 2);
+    }
+    y[x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    cb[x] =
+        static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    cr[x] =
+        static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+  }
+#endif
+}
+
+}  // namespace
+
+Y4mWriter::Y4mWriter(const char* path, PixelFormat format)
+    : format_(format), file_(path) {
+  file_.Append(kHeader, sizeof(kHeader) - 1);
+}
+
+void Y4mWriter::WriteFrame(const Frame& frame) {
+  uint8_t* out = file_.Reserve(kFrameHeaderSize + 3 * kPlaneSize);
+  std::memcpy(out, kFrameHeader, kFrameHeaderSize);
+  uint8_t* y = &out[kFrameHeaderSize];
+  uint8_t* cb = &y[kPlaneSize];
+  uint8_t* cr = &cb[kPlaneSize];
+
+  for (size_t line = 0; line < kScreenHeight; line++) {
+    const uint8_t* pixels = &frame.pixels[line * frame.pitch];
+    const size_t offset = line * kScreenWidth;
+    switch (format_) {
+      case PixelFormat::kRgba8888:
+        ConvertLine<PixelFormat::kRgba8888>(pixels, &y[offset], &cb[offset],
+                                            &cr[offset]);
+        break;
+      case PixelFormat::kRgb565:
+        ConvertLine<PixelFormat::kRgb565>(pixels, &y[offset], &cb[offset],
+                                          &cr[offset]);
+        break;
+      default:
+        FATAL("Unknown pixel format");
+    }
+  }
+
+  file_.Commit(kFrameHeaderSize + 3 * kPlaneSize);
+}
+
+}  // namespace gamebun
@@ -0,0 +1,32 @@
+#ifndef Y4M_WRITER_H_
+#define Y4M_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "async_file_writer.h"
+#include "frame_buffers.h"
+#include "palette.h"
+
+namespace gamebun {
+
+// Writes frames as an uncompressed YUV4MPEG2 stream with 4:4:4 sampling, which
+// most video tools read directly. Each frame is converted straight into the
+// file writer's buffers.
+class Y4mWriter {
+ public:
+  Y4mWriter(const char* path, PixelFormat format);
+
+  void WriteFrame(const Frame& frame);
+
+  Y4mWriter(const Y4mWriter&) = delete;
+  Y4mWriter& operator=(const Y4mWriter&) = delete;
+
+ private:
+  const PixelFormat format_;
+  AsyncFileWriter file_;
+};
+
+}  // namespace gamebun
+
+#endif  // Y4M_WRITER_H_